@@ -0,0 +1,348 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // syscall、MAP_POPULATE
+#include "aio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define AIO_HAVE_URING 1
+#endif
+#endif
+
+// ---- 同步读写 ----
+
+int aio_sync(AioRequest *req) {
+    size_t done = 0;
+    req->result = 0;
+    while (done < req->len) {
+        ssize_t n;
+        if (req->write) {
+            n = pwrite(req->fd, (const char*)req->buf + done, req->len - done, (off_t)(req->offset + done));
+        } else {
+            n = pread(req->fd, (char*)req->buf + done, req->len - done, (off_t)(req->offset + done));
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            req->result = -1;
+            break;
+        }
+        if (n == 0) {
+            if (req->write) {
+                req->result = -1;
+            } else {
+                memset((char*)req->buf + done, 0, req->len - done);  // 文件尾之后按全零处理
+            }
+            break;
+        }
+        done += (size_t)n;
+    }
+    return req->result;
+}
+
+// ---- io_uring ----
+
+#ifdef AIO_HAVE_URING
+
+static int ring_setup(AioRing *ring, unsigned depth) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(AioRing));
+    ring->fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+    if (ring->fd < 0) return -1;
+    
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+    
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) goto fail_fd;
+    if (single) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) goto fail_sq;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail_cq;
+    
+    char *sq = ring->sq_ptr;
+    char *cq = ring->cq_ptr;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = cq + params.cq_off.cqes;
+    return 0;
+
+fail_cq:
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+fail_sq:
+    munmap(ring->sq_ptr, ring->sq_size);
+fail_fd:
+    close(ring->fd);
+    ring->fd = -1;
+    return -1;
+}
+
+static void ring_teardown(AioRing *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+}
+
+// 把请求 index 填入提交队列（只由持有上下文的线程写 sq_tail）
+static void ring_prep(AioRing *ring, AioRequest *req, size_t index) {
+    unsigned tail = *ring->sq_tail;
+    unsigned slot = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe*)ring->sqes)[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req->write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = req->fd;
+    sqe->addr = (uint64_t)(uintptr_t)req->buf;
+    sqe->len = (uint32_t)req->len;
+    sqe->off = req->offset;
+    sqe->user_data = index;
+    ring->sq_array[slot] = slot;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// 处理一个完成项：失败或短读写时在调用线程中同步补完
+static void ring_complete(AioRequest *req, int res) {
+    if (res < 0) {
+        // -EINVAL 等（例如内核不支持 IORING_OP_READ）：整个请求改为同步执行
+        aio_sync(req);
+        return;
+    }
+    if ((size_t)res >= req->len) {
+        req->result = 0;
+        return;
+    }
+    AioRequest rest = *req;
+    rest.buf = (char*)req->buf + res;
+    rest.len = req->len - (size_t)res;
+    rest.offset = req->offset + (uint64_t)res;
+    req->result = aio_sync(&rest);
+}
+
+// 收取完成队列中的全部完成项，返回收取的个数（user_data 超出本组请求的完成项直接丢弃）
+static unsigned ring_reap(AioRing *ring, AioRequest *reqs, size_t count) {
+    unsigned reaped = 0;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &((struct io_uring_cqe*)ring->cqes)[head & *ring->cq_mask];
+        if (cqe->user_data < count) {
+            ring_complete(&reqs[cqe->user_data], cqe->res);
+            reaped++;
+        }
+        head++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+// 无法恢复的错误之后：不再提交，等内核交回全部在途请求，之后它们的缓冲区不会再被内核读写。
+// 仍然等不到时返回 -1（调用者随后关闭 io_uring）
+static int ring_drain(AioRing *ring, AioRequest *reqs, size_t count, unsigned inflight) {
+    int failures = 0;
+    while (inflight > 0) {
+        unsigned reaped = ring_reap(ring, reqs, count);
+        inflight -= reaped < inflight ? reaped : inflight;
+        if (inflight == 0) break;
+        int ret = (int)syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR && ++failures >= 3) return -1;
+    }
+    return 0;
+}
+
+static int ring_run(AioContext *ctx, AioRequest *reqs, size_t count) {
+    AioRing *ring = &ctx->ring;
+    size_t next = 0, done = 0;
+    unsigned inflight = 0;
+    unsigned unsubmitted = 0;  // 已填入提交队列但内核尚未取走的项
+    
+    while (done < count) {
+        // 补满队列深度后一次提交，至少等到一个完成
+        while (next < count && inflight < ctx->depth) {
+            ring_prep(ring, &reqs[next], next);
+            next++;
+            inflight++;
+            unsubmitted++;
+        }
+        int ret = (int)syscall(__NR_io_uring_enter, ring->fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            // 无法恢复的错误：先收回已交给内核的请求（尚未取走的项不再提交），再把未完成的请求全部同步执行
+            ring_drain(ring, reqs, count, inflight - unsubmitted);
+            for (size_t i = 0; i < count; i++) {
+                if (reqs[i].result == 1) aio_sync(&reqs[i]);
+            }
+            return -1;
+        }
+        unsubmitted -= (unsigned)ret < unsubmitted ? (unsigned)ret : unsubmitted;
+        ctx->submits++;
+        
+        unsigned reaped = ring_reap(ring, reqs, count);
+        inflight -= reaped;
+        done += reaped;
+    }
+    return 0;
+}
+
+#endif // AIO_HAVE_URING
+
+// ---- 线程池 ----
+
+static void* aio_worker(void *arg) {
+    AioThreads *pool = arg;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->stop && (!pool->reqs || pool->next >= pool->count)) {
+            pthread_cond_wait(&pool->work_cv, &pool->mutex);
+        }
+        if (pool->stop) break;
+        AioRequest *req = &pool->reqs[pool->next++];
+        pthread_mutex_unlock(&pool->mutex);
+        aio_sync(req);
+        pthread_mutex_lock(&pool->mutex);
+        if (++pool->done == pool->count) {
+            pthread_cond_signal(&pool->done_cv);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static void threads_stop(AioThreads *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_cond_destroy(&pool->done_cv);
+    free(pool->threads);
+}
+
+static int threads_start(AioThreads *pool, unsigned depth) {
+    memset(pool, 0, sizeof(AioThreads));
+    pool->threads = malloc(depth * sizeof(pthread_t));
+    if (!pool->threads) return -1;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+    for (unsigned i = 0; i < depth; i++) {
+        if (pthread_create(&pool->threads[i], NULL, aio_worker, pool) != 0) {
+            threads_stop(pool);
+            return -1;
+        }
+        pool->nthreads++;
+    }
+    return 0;
+}
+
+static void threads_run(AioContext *ctx, AioRequest *reqs, size_t count) {
+    AioThreads *pool = &ctx->pool;
+    pthread_mutex_lock(&pool->mutex);
+    pool->reqs = reqs;
+    pool->count = count;
+    pool->next = 0;
+    pool->done = 0;
+    pthread_cond_broadcast(&pool->work_cv);
+    while (pool->done < count) {
+        pthread_cond_wait(&pool->done_cv, &pool->mutex);
+    }
+    pool->reqs = NULL;
+    pthread_mutex_unlock(&pool->mutex);
+    ctx->submits++;
+}
+
+// ---- 接口 ----
+
+int aio_init(AioContext *ctx, unsigned depth, AioBackend backend) {
+    memset(ctx, 0, sizeof(AioContext));
+    if (depth == 0) depth = AIO_DEFAULT_DEPTH;
+    if (depth > AIO_MAX_DEPTH) depth = AIO_MAX_DEPTH;
+    ctx->depth = depth;
+
+#ifdef AIO_HAVE_URING
+    if (backend != AIO_BACKEND_THREADS && ring_setup(&ctx->ring, depth) == 0) {
+        ctx->backend = AIO_BACKEND_URING;
+        return 0;
+    }
+#endif
+    if (backend == AIO_BACKEND_URING) return -1;
+    
+    if (threads_start(&ctx->pool, depth) < 0) return -1;
+    ctx->backend = AIO_BACKEND_THREADS;
+    return 0;
+}
+
+void aio_destroy(AioContext *ctx) {
+#ifdef AIO_HAVE_URING
+    if (ctx->backend == AIO_BACKEND_URING) {
+        ring_teardown(&ctx->ring);
+        return;
+    }
+#endif
+    if (ctx->backend == AIO_BACKEND_THREADS && ctx->pool.nthreads > 0) {
+        threads_stop(&ctx->pool);
+    }
+}
+
+int aio_run(AioContext *ctx, AioRequest *reqs, size_t count) {
+    if (count == 0) return 0;
+    for (size_t i = 0; i < count; i++) {
+        reqs[i].result = 1;  // 未完成
+    }
+
+#ifdef AIO_HAVE_URING
+    if (ctx->backend == AIO_BACKEND_URING) {
+        if (ring_run(ctx, reqs, count) < 0) {
+            // io_uring 不再可用：关闭它（内核随之取消仍未完成的请求），之后改用线程池
+            ring_teardown(&ctx->ring);
+            if (threads_start(&ctx->pool, ctx->depth) < 0) {
+                memset(&ctx->pool, 0, sizeof(AioThreads));
+            }
+            ctx->backend = AIO_BACKEND_THREADS;
+        }
+    } else
+#endif
+    if (ctx->pool.nthreads == 0) {
+        // 线程池也无法启动：逐个同步执行
+        for (size_t i = 0; i < count; i++) {
+            aio_sync(&reqs[i]);
+        }
+    } else {
+        threads_run(ctx, reqs, count);
+    }
+    
+    int failed = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (reqs[i].result != 0) failed++;
+    }
+    ctx->requests += count;
+    return failed;
+}
+
+const char* aio_backend_name(const AioContext *ctx) {
+    return ctx->backend == AIO_BACKEND_URING ? "io_uring" : "threads";
+}
@@ -0,0 +1,85 @@
+#ifndef AIO_H
+#define AIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// 批量页面 I/O：一次提交一组读写请求并等待全部完成，同时在途的请求数不超过队列深度。
+//
+// 优先使用 io_uring（直接通过 io_uring_setup / io_uring_enter 系统调用，不依赖 liburing）：
+// 请求填入提交队列后一次 io_uring_enter 提交，完成一个补充一个。内核不支持 io_uring 或被禁用时
+// 回退到线程池：队列深度个工作线程各自 pread/pwrite。
+// 短读写和内核不支持的操作码由调用线程用 pread/pwrite 补完，结果与逐个同步读写相同。
+
+#define AIO_DEFAULT_DEPTH 32      // 默认队列深度
+#define AIO_MAX_DEPTH 256
+
+typedef enum {
+    AIO_BACKEND_AUTO = 0,     // 优先 io_uring，不可用时使用线程池
+    AIO_BACKEND_URING = 1,    // 只用 io_uring（不可用时初始化失败）
+    AIO_BACKEND_THREADS = 2   // 只用线程池
+} AioBackend;
+
+// 一个读写请求：读到文件尾之后的部分填 0
+typedef struct {
+    int fd;
+    bool write;
+    void *buf;
+    size_t len;
+    uint64_t offset;
+    int result;               // 完成后填写：0 成功，-1 失败
+} AioRequest;
+
+// io_uring 的映射区域
+typedef struct {
+    int fd;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size;
+    void *sqes;               // struct io_uring_sqe 数组
+    size_t sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    void *cqes;               // struct io_uring_cqe 数组
+} AioRing;
+
+// 线程池回退：aio_run 发布一组请求，工作线程逐个领取
+typedef struct {
+    pthread_t *threads;
+    int nthreads;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cv;   // 有新请求或要求退出
+    pthread_cond_t done_cv;   // 一组请求全部完成
+    AioRequest *reqs;
+    size_t count;
+    size_t next;              // 下一个待领取的请求
+    size_t done;              // 已完成的请求数
+    bool stop;
+} AioThreads;
+
+typedef struct {
+    AioBackend backend;       // 实际使用的后端（AIO_BACKEND_URING 或 AIO_BACKEND_THREADS）
+    unsigned depth;           // 队列深度
+    AioRing ring;
+    AioThreads pool;
+    uint64_t submits;         // 发出的 io_uring_enter 次数（线程池为 aio_run 次数）
+    uint64_t requests;        // 完成的请求总数
+} AioContext;
+
+// 初始化：depth 为 0 时使用 AIO_DEFAULT_DEPTH，超过 AIO_MAX_DEPTH 时取上限
+int aio_init(AioContext *ctx, unsigned depth, AioBackend backend);
+
+// 释放 io_uring 或结束工作线程
+void aio_destroy(AioContext *ctx);
+
+// 执行 count 个请求并等待全部完成，返回失败的请求数（同一上下文不能被多个线程同时调用）
+int aio_run(AioContext *ctx, AioRequest *reqs, size_t count);
+
+// 在调用线程中同步执行一个请求（pread/pwrite 直到完成），返回并填写 result
+int aio_sync(AioRequest *req);
+
+// 后端名称（"io_uring" / "threads"）
+const char* aio_backend_name(const AioContext *ctx);
+
+#endif // AIO_H
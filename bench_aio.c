@@ -0,0 +1,204 @@
+#define _GNU_SOURCE  // O_DIRECT
+#include "storage.h"
+#include "bufpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 批量 I/O 基准：
+// 1. 在本地文件上以队列深度 1~64 做 4KB 随机读和随机写（写完 fdatasync），分别使用 io_uring 和线程池，
+//    输出 IOPS 和 MB/s。每个深度开始前用 posix_fadvise 丢弃页缓存；第 3 个参数为 1 时用 O_DIRECT 绕过页缓存。
+// 2. 缓冲池模式下冷启动的批量查找：io_depth 为 1 / 8 / 64 时 storage_get_batch 的吞吐（逐层预读）。
+// 用法：./bench_aio [文件大小 MB，默认 256] [每个深度的请求数，默认 20000] [O_DIRECT，默认 0]
+
+#define CHUNK 1024                // 每次 aio_run 的请求数（缓冲区数）
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static void drop_cache(int fd) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+// 以指定深度做 ops 次随机页面读写，返回每秒请求数
+static double run_depth(AioBackend backend, unsigned depth, int fd, size_t pages, long ops, bool write,
+                        uint8_t *buffers, AioRequest *reqs) {
+    AioContext aio;
+    if (aio_init(&aio, depth, backend) < 0) return 0;
+    drop_cache(fd);
+    
+    double start = now_sec();
+    for (long done = 0; done < ops; ) {
+        size_t count = ops - done < CHUNK ? (size_t)(ops - done) : CHUNK;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t page = mix64((uint64_t)(done + i) * 2 + write) % pages;
+            AioRequest req = {fd, write, buffers + i * PAGE_SIZE, PAGE_SIZE, page * PAGE_SIZE, 0};
+            reqs[i] = req;
+        }
+        if (aio_run(&aio, reqs, count) != 0) {
+            fprintf(stderr, "I/O 失败\n");
+            break;
+        }
+        done += count;
+    }
+    if (write) fdatasync(fd);
+    double elapsed = now_sec() - start;
+    aio_destroy(&aio);
+    return ops / elapsed;
+}
+
+typedef struct {
+    long next;
+    long count;
+    char key[32];
+    char value[128];
+} LoadSource;
+
+static int load_next(void *ctx, const char **key, size_t *klen, const char **value, size_t *vlen) {
+    LoadSource *src = ctx;
+    if (src->next >= src->count) return 0;
+    *klen = (size_t)snprintf(src->key, sizeof(src->key), "key%010ld", src->next);
+    int n = snprintf(src->value, sizeof(src->value), "v%ld.", src->next);
+    memset(src->value + n, 'a' + src->next % 26, 100 - n);
+    src->next++;
+    *key = src->key;
+    *value = src->value;
+    *vlen = 100;
+    return 1;
+}
+
+// 冷缓冲池上的批量查找：每个批次 256 个随机 key
+static void bench_multiget(long total, long lookups) {
+    const char *db = "bench_aio.db";
+    char path[64];
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) return;
+    LoadSource src = {0, total, "", ""};
+    storage_bulk_load(&engine, load_next, &src, 0);
+    size_t file_pages = engine.pm.page_count;
+    storage_close(&engine);
+    printf("\n冷缓冲池批量查找：%ld 个 key，索引文件 %zu 页，缓冲池 %zu 页，每批 256 个 key\n",
+           total, file_pages, file_pages / 4);
+    
+    enum { BATCH = 256 };
+    static char keys[BATCH][32], bufs[BATCH][128];
+    BTreeBatchItem items[BATCH];
+    static const unsigned depths[] = {1, 8, 64};
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        snprintf(path, sizeof(path), "%s.idx", db);
+        int fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            drop_cache(fd);
+            close(fd);
+        }
+        options.buffer_pool_pages = file_pages / 4;
+        options.io_depth = depths[d];
+        if (storage_init_ex(&engine, db, &options) < 0) return;
+        
+        long found = 0;
+        double start = now_sec();
+        for (long done = 0; done < lookups; done += BATCH) {
+            for (int i = 0; i < BATCH; i++) {
+                snprintf(keys[i], sizeof(keys[i]), "key%010ld", (long)(mix64(done + i) % total));
+                items[i].key = keys[i];
+                items[i].buf = bufs[i];
+                items[i].buf_size = sizeof(bufs[i]);
+            }
+            found += storage_get_batch(&engine, items, BATCH);
+        }
+        double elapsed = now_sec() - start;
+        printf("  %-8s 深度 %2u：%9.0f keys/s，预读 %llu 页，批量读盘 %llu 次，命中 %ld\n",
+               aio_backend_name(&engine.pm.pool->aio), depths[d], found / elapsed,
+               (unsigned long long)engine.pm.stats.pool_prefetched,
+               (unsigned long long)engine.pm.stats.io_batches, found);
+        storage_close(&engine);
+    }
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+}
+
+int main(int argc, char **argv) {
+    long size_mb = argc > 1 ? atol(argv[1]) : 256;
+    long ops = argc > 2 ? atol(argv[2]) : 20000;
+    bool direct = argc > 3 && atoi(argv[3]) == 1;
+    const char *file = "bench_aio.dat";
+    size_t pages = (size_t)size_mb * 1024 * 1024 / PAGE_SIZE;
+    
+    uint8_t *buffers = NULL;
+    AioRequest *reqs = malloc(CHUNK * sizeof(AioRequest));
+    if (posix_memalign((void**)&buffers, PAGE_SIZE, (size_t)CHUNK * PAGE_SIZE) != 0 || !reqs || pages == 0) {
+        return 1;
+    }
+    memset(buffers, 'x', (size_t)CHUNK * PAGE_SIZE);
+    
+    // 先顺序写满文件，随机读不会落在空洞上
+    int fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 1;
+    for (size_t p = 0; p < pages; p += CHUNK) {
+        size_t n = pages - p < CHUNK ? pages - p : CHUNK;
+        if (pwrite(fd, buffers, n * PAGE_SIZE, (off_t)(p * PAGE_SIZE)) < 0) return 1;
+    }
+    fdatasync(fd);
+    if (direct) {
+        close(fd);
+        fd = open(file, O_RDWR | O_DIRECT);
+        if (fd < 0) {
+            fprintf(stderr, "文件系统不支持 O_DIRECT\n");
+            return 1;
+        }
+    }
+    printf("文件 %ld MB（%zu 页），每个深度 %ld 次 4KB 随机请求%s\n", size_mb, pages, ops,
+           direct ? "，O_DIRECT" : "");
+    
+    AioContext probe;
+    bool uring = aio_init(&probe, 1, AIO_BACKEND_URING) == 0;
+    if (uring) aio_destroy(&probe);
+    static const AioBackend backends[] = {AIO_BACKEND_URING, AIO_BACKEND_THREADS};
+    for (int b = uring ? 0 : 1; b < 2; b++) {
+        printf("%s：\n", backends[b] == AIO_BACKEND_URING ? "io_uring" : "线程池");
+        for (unsigned depth = 1; depth <= 64; depth *= 2) {
+            double r = run_depth(backends[b], depth, fd, pages, ops, false, buffers, reqs);
+            double w = run_depth(backends[b], depth, fd, pages, ops, true, buffers, reqs);
+            printf("  深度 %2u：随机读 %8.0f IOPS（%6.1f MB/s），随机写 %8.0f IOPS（%6.1f MB/s）\n", depth,
+                   r, r * PAGE_SIZE / 1048576, w, w * PAGE_SIZE / 1048576);
+        }
+    }
+    close(fd);
+    remove(file);
+    
+    bench_multiget(500000, 51200);
+    free(buffers);
+    free(reqs);
+    return 0;
+}
@@ -0,0 +1,105 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 批量接口基准：对不同批大小，比较 storage_put_batch / storage_get_batch
+// 与逐个调用单 key 接口写入、查找同样随机 key 的吞吐。
+// 用法：./bench_batch [每轮 key 数量，默认 200000]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static int open_empty(StorageEngine *engine, const char *db) {
+    StorageOptions options;
+    char path[64];
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    return storage_init_ex(engine, db, &options);
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 200000;
+    static const long sizes[] = {1, 10, 100, 1000, 10000};
+    const char *db = "bench_batch.db";
+    StorageEngine engine;
+    
+    char (*keys)[24] = malloc(total * sizeof(*keys));
+    char (*bufs)[24] = malloc(total * sizeof(*bufs));
+    BTreeBatchItem *items = malloc(total * sizeof(BTreeBatchItem));
+    if (!keys || !bufs || !items) return 1;
+    for (long i = 0; i < total; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "%016llx", (unsigned long long)mix64(i));
+        items[i].key = keys[i];
+        items[i].value = keys[i];
+        items[i].buf = bufs[i];
+        items[i].buf_size = sizeof(bufs[i]);
+    }
+    
+    // 基线：逐个调用单 key 接口
+    if (open_empty(&engine, db) < 0) return 1;
+    double start = now_sec();
+    for (long i = 0; i < total; i++) {
+        storage_put(&engine, keys[i], keys[i]);
+    }
+    double put_time = now_sec() - start;
+    start = now_sec();
+    for (long i = 0; i < total; i++) {
+        storage_get(&engine, keys[i], bufs[i], sizeof(bufs[i]));
+    }
+    double get_time = now_sec() - start;
+    storage_close(&engine);
+    printf("%8s  %14s  %14s\n", "批大小", "put（ns/key）", "get（ns/key）");
+    printf("%8s  %14.0f  %14.0f\n", "单 key", put_time * 1e9 / total, get_time * 1e9 / total);
+    
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        long batch = sizes[s];
+        if (open_empty(&engine, db) < 0) return 1;
+        
+        start = now_sec();
+        for (long i = 0; i < total; i += batch) {
+            long n = total - i < batch ? total - i : batch;
+            storage_put_batch(&engine, items + i, n);
+        }
+        put_time = now_sec() - start;
+        
+        long hits = 0;
+        start = now_sec();
+        for (long i = 0; i < total; i += batch) {
+            long n = total - i < batch ? total - i : batch;
+            hits += storage_get_batch(&engine, items + i, n);
+        }
+        get_time = now_sec() - start;
+        storage_close(&engine);
+        
+        printf("%8ld  %14.0f  %14.0f%s\n", batch, put_time * 1e9 / total, get_time * 1e9 / total,
+               hits == total ? "" : "  （查找未全部命中）");
+    }
+    
+    free(keys);
+    free(bufs);
+    free(items);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 批量加载基准：同样 N 个有序 key，对比逐个 storage_put 和 storage_bulk_load 的
+// 吞吐（keys/s）以及得到的叶子数和填充率。
+// 用法：./bench_bulk [key 数量，默认 10000000]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    long next;
+    long total;
+    char key[32];
+    char value[32];
+} Source;
+
+static int source_next(void *ctx, const char **key, size_t *klen, const char **value, size_t *vlen) {
+    Source *src = ctx;
+    if (src->next >= src->total) return 0;
+    *klen = snprintf(src->key, sizeof(src->key), "%016ld", src->next);
+    *vlen = snprintf(src->value, sizeof(src->value), "v%ld", src->next);
+    *key = src->key;
+    *value = src->value;
+    src->next++;
+    return 1;
+}
+
+static int open_empty(StorageEngine *engine, const char *db) {
+    StorageOptions options;
+    char path[64];
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    return storage_init_ex(engine, db, &options);
+}
+
+static void report(const char *name, StorageEngine *engine, long total, double elapsed) {
+    BTreeStats stats;
+    storage_stats(engine, &stats);
+    printf("%s：%.0f keys/s，树高 %u，叶子 %llu，叶子填充率 %.1f%%\n", name, total / elapsed,
+           stats.depth, (unsigned long long)stats.leaf_count, stats.leaf_fill * 100);
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 10000000;
+    const char *db = "bench_bulk.db";
+    StorageEngine engine;
+    Source src = {0, total, "", ""};
+    const char *key, *value;
+    size_t klen, vlen;
+    
+    if (open_empty(&engine, db) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    double start = now_sec();
+    while (source_next(&src, &key, &klen, &value, &vlen) == 1) {
+        storage_put(&engine, key, value);
+    }
+    storage_checkpoint(&engine);
+    report("逐个 put", &engine, total, now_sec() - start);
+    storage_close(&engine);
+    
+    if (open_empty(&engine, db) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    src.next = 0;
+    start = now_sec();
+    int ret = storage_bulk_load(&engine, source_next, &src, 0);
+    report("批量加载", &engine, total, now_sec() - start);
+    storage_close(&engine);
+    
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 插入/删除各半的持续更替基准：先加载 N 个随机 key，之后每次操作以各 50% 的概率
+// 插入一个新 key 或删除一个随机的现存 key，key 总数保持在 N 附近。
+// 第 4 个参数为 1 时改为滑动窗口：按递增顺序插入新 key、删除最早插入的 key（类似队列/时序数据），
+// 被删空的旧区间只能靠合并回收。
+// 每隔一段输出吞吐、树高、叶子/内部节点数、叶子填充率和文件页面数，观察树是否随时间退化。
+// 用法：./bench_churn [初始 key 数量，默认 200000] [操作次数，默认 2000000] [输出间隔，默认 200000] [滑动窗口 0/1]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// 编号对应的 key：随机模式打散，滑动窗口模式保持递增
+static void make_key(char *key, size_t size, uint64_t id, int window) {
+    snprintf(key, size, "%016llx", (unsigned long long)(window ? id : mix64(id)));
+}
+
+static void report(StorageEngine *engine, long ops, double elapsed, long live) {
+    BTreeStats stats;
+    storage_stats(engine, &stats);
+    printf("%10ld %10.0f %8ld %6u %9llu %9llu %7.0f%% %8.0f%% %10u\n", ops,
+           elapsed > 0 ? ops / elapsed : 0, live, stats.depth,
+           (unsigned long long)stats.leaf_count, (unsigned long long)stats.internal_count,
+           stats.leaf_fill * 100, stats.internal_fill * 100, engine->pm.page_count);
+}
+
+int main(int argc, char **argv) {
+    long initial = argc > 1 ? atol(argv[1]) : 200000;
+    long total = argc > 2 ? atol(argv[2]) : 2000000;
+    long interval = argc > 3 ? atol(argv[3]) : 200000;
+    int window = argc > 4 ? atoi(argv[4]) : 0;
+    const char *db = "bench_churn.db";
+    char key[32], value[64], path[64];
+    if (initial < 1 || interval < 1) return 1;
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    
+    // 现存 key 的编号：随机模式删除时与末尾交换，滑动窗口模式从头部依次删除
+    uint64_t *live = malloc((initial + total) * sizeof(uint64_t));
+    if (!live) return 1;
+    long live_count = 0, head = 0;
+    uint64_t next_id = 0;
+    for (; live_count < initial; live_count++) {
+        live[live_count] = next_id++;
+        make_key(key, sizeof(key), live[live_count], window);
+        snprintf(value, sizeof(value), "value-%llu", (unsigned long long)live[live_count]);
+        storage_put(&engine, key, value);
+    }
+    
+    printf("=== 插入/删除各 50%% 更替（%s）：初始 %ld 个 key，%ld 次操作 ===\n",
+           window ? "滑动窗口" : "随机", initial, total);
+    printf("%10s %10s %8s %6s %9s %9s %8s %9s %10s\n", "ops", "ops/s", "keys", "depth",
+           "leaves", "internal", "leaf%", "internal%", "file_pages");
+    report(&engine, 0, 0, live_count);
+    
+    uint64_t rng = 12345;
+    double start = now_sec();
+    for (long op = 1; op <= total; op++) {
+        rng = mix64(rng + op);
+        if ((rng & 1) || live_count == head) {
+            live[live_count] = next_id++;
+            make_key(key, sizeof(key), live[live_count], window);
+            snprintf(value, sizeof(value), "value-%llu", (unsigned long long)live[live_count]);
+            storage_put(&engine, key, value);
+            live_count++;
+        } else {
+            long victim = window ? head : head + (long)((rng >> 1) % (uint64_t)(live_count - head));
+            make_key(key, sizeof(key), live[victim], window);
+            if (storage_delete(&engine, key) != 0) {
+                fprintf(stderr, "删除失败: %s\n", key);
+                return 1;
+            }
+            if (window) {
+                head++;
+            } else {
+                live[victim] = live[--live_count];
+            }
+        }
+        if (op % interval == 0) {
+            report(&engine, op, now_sec() - start, live_count - head);
+        }
+    }
+    
+    free(live);
+    storage_close(&engine);
+    remove("bench_churn.db.idx");
+    remove("bench_churn.db.dat");
+    remove("bench_churn.db.wal");
+    return 0;
+}
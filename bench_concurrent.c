@@ -0,0 +1,137 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// 多线程读吞吐基准：加载 N 个随机 key 后，读线程数从 1 翻倍到 max_threads，
+// 每个线程执行固定次数的随机 storage_get，输出总吞吐；可选再加一个持续写入的线程。
+// 用法：./bench_concurrent [key 数量，默认 1000000] [最大线程数，默认 8] [每线程查找次数，默认 500000] [是否带写线程，默认 0]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+typedef struct {
+    StorageEngine *engine;
+    long total;
+    long lookups;
+    long seed;
+    long found;
+    volatile int *stop;
+    long writes;
+} ThreadArgs;
+
+static void *reader(void *arg) {
+    ThreadArgs *args = arg;
+    char key[32];
+    char value[64];
+    
+    for (long i = 0; i < args->lookups; i++) {
+        uint64_t k = mix64(args->seed * 1000003 + i) % args->total;
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(k));
+        args->found += storage_get(args->engine, key, value, sizeof(value)) == 0;
+    }
+    return NULL;
+}
+
+static void *writer(void *arg) {
+    ThreadArgs *args = arg;
+    char key[32];
+    char value[64];
+    
+    while (!*args->stop) {
+        uint64_t k = mix64(args->writes) % args->total;
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(k));
+        snprintf(value, sizeof(value), "w%ld", args->writes);
+        storage_put(args->engine, key, value);
+        args->writes++;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 1000000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+    long lookups = argc > 3 ? atol(argv[3]) : 500000;
+    int with_writer = argc > 4 ? atoi(argv[4]) : 0;
+    const char *db = "bench_concurrent.db";
+    char key[32];
+    char value[64];
+    
+    snprintf(value, sizeof(value), "%s.idx", db);
+    remove(value);
+    snprintf(value, sizeof(value), "%s.dat", db);
+    remove(value);
+    snprintf(value, sizeof(value), "%s.wal", db);
+    remove(value);
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    for (long i = 0; i < total; i++) {
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(i));
+        snprintf(value, sizeof(value), "v%ld", i);
+        storage_put(&engine, key, value);
+    }
+    
+    pthread_t *threads = malloc(max_threads * sizeof(pthread_t));
+    ThreadArgs *args = malloc(max_threads * sizeof(ThreadArgs));
+    if (!threads || !args) return 1;
+    printf("%6s  %14s  %10s\n", "读线程", "查找（ops/s）", "写入次数");
+    
+    int ok = 1;
+    for (int n = 1; n <= max_threads; n *= 2) {
+        volatile int stop = 0;
+        pthread_t writer_thread;
+        ThreadArgs writer_args = {&engine, total, 0, 0, 0, &stop, 0};
+        if (with_writer) {
+            pthread_create(&writer_thread, NULL, writer, &writer_args);
+        }
+        
+        double start = now_sec();
+        for (int t = 0; t < n; t++) {
+            ThreadArgs a = {&engine, total, lookups, t + 1, 0, &stop, 0};
+            args[t] = a;
+            pthread_create(&threads[t], NULL, reader, &args[t]);
+        }
+        long found = 0;
+        for (int t = 0; t < n; t++) {
+            pthread_join(threads[t], NULL);
+            found += args[t].found;
+        }
+        double elapsed = now_sec() - start;
+        
+        stop = 1;
+        if (with_writer) {
+            pthread_join(writer_thread, NULL);
+        }
+        printf("%6d  %14.0f  %10ld\n", n, n * lookups / elapsed, writer_args.writes);
+        ok &= found == n * lookups;
+        if (n == max_threads) break;
+        if (n * 2 > max_threads) n = max_threads / 2;
+    }
+    
+    free(threads);
+    free(args);
+    storage_close(&engine);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 每次插入弄脏的页面数：逐个插入随机 key，每次插入后刷盘，由 PageStats.pages_dirtied 的增量
+// 得到该次插入修改的不同页面数（索引文件，不含数据文件），输出平均值、分位数和最大值，
+// 并按是否发生分裂分别统计。
+// 用法：./bench_dirty [key 数量，默认 200000]
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 200000;
+    const char *db = "bench_dirty.db";
+    char key[32], value[64], path[64];
+    uint32_t *samples = malloc(total * sizeof(uint32_t));
+    if (!samples || total < 1) return 1;
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    
+    // 分裂至少弄脏旧节点、新节点和父节点
+    uint64_t sum = 0, split_sum = 0, splits = 0;
+    page_flush(&engine.pm);
+    for (long i = 0; i < total; i++) {
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(i));
+        snprintf(value, sizeof(value), "value-%ld", i);
+        uint64_t before = engine.pm.stats.pages_dirtied;
+        storage_put(&engine, key, value);
+        samples[i] = (uint32_t)(engine.pm.stats.pages_dirtied - before);
+        page_flush(&engine.pm);
+        sum += samples[i];
+        if (samples[i] >= 3) {
+            split_sum += samples[i];
+            splits++;
+        }
+    }
+    qsort(samples, total, sizeof(uint32_t), compare_u32);
+    
+    BTreeStats stats;
+    storage_stats(&engine, &stats);
+    printf("=== 每次插入弄脏的页面数：%ld 个随机 key，树高 %u ===\n", total, stats.depth);
+    printf("平均 %.3f，p50 %u，p99 %u，p99.99 %u，最大 %u\n", (double)sum / total,
+           samples[total / 2], samples[total * 99 / 100], samples[total * 9999 / 10000], samples[total - 1]);
+    printf("发生分裂的插入 %llu 次，平均弄脏 %.2f 页\n", (unsigned long long)splits,
+           splits ? (double)split_sum / splits : 0.0);
+    
+    free(samples);
+    storage_close(&engine);
+    remove("bench_dirty.db.idx");
+    remove("bench_dirty.db.dat");
+    remove("bench_dirty.db.wal");
+    return 0;
+}
@@ -0,0 +1,154 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 后台刷盘基准：在 N 个 key 上随机覆盖写入（100 字节 value），测量每次 storage_put 的延迟。
+// 1. 前台检查点：关闭后台刷盘，WAL 超过阈值时由写入线程调用 storage_checkpoint（同步写回全部脏页）。
+// 2. 后台刷盘：后台线程按周期写回脏页，WAL 超过同一阈值时做检查点。
+// 两种方式分别在 mmap 和缓冲池（索引文件页面数的 1/4）上运行，输出吞吐、p50 / p99 / p99.9 / 最大延迟、
+// 检查点次数、后台写回速率和结束时的日志滞后（崩溃后需要重放的记录数）。
+// 用法：./bench_flusher [key 数量，默认 100000] [写入次数，默认 300000] [检查点阈值 KB，默认 4096]
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    long next;
+    long count;
+    char key[32];
+    char value[128];
+} LoadSource;
+
+static int load_next(void *ctx, const char **key, size_t *klen, const char **value, size_t *vlen) {
+    LoadSource *src = ctx;
+    if (src->next >= src->count) return 0;
+    *klen = (size_t)snprintf(src->key, sizeof(src->key), "key%010ld", src->next);
+    int n = snprintf(src->value, sizeof(src->value), "v%ld.", src->next);
+    memset(src->value + n, 'a' + src->next % 26, 100 - n);
+    src->next++;
+    *key = src->key;
+    *value = src->value;
+    *vlen = 100;
+    return 1;
+}
+
+static void remove_db(const char *db) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+}
+
+// 写入 ops 次并记录每次的延迟；background 为 false 时 WAL 超过阈值由写入线程做检查点
+static void run_puts(StorageEngine *engine, const char *name, long total, long ops, bool background,
+                     uint64_t wal_bytes, uint32_t *samples) {
+    char key[32], value[128];
+    uint64_t checkpoints = 0;
+    uint64_t begin = now_ns();
+    for (long i = 0; i < ops; i++) {
+        long k = (long)(mix64((uint64_t)i) % total);
+        snprintf(key, sizeof(key), "key%010ld", k);
+        int n = snprintf(value, sizeof(value), "v%ld.%ld.", k, i);
+        memset(value + n, 'a' + i % 26, 100 - n);
+        value[100] = '\0';
+        
+        uint64_t start = now_ns();
+        storage_put(engine, key, value);
+        if (!background && wal_size(&engine->wal) >= wal_bytes) {
+            storage_checkpoint(engine);
+            checkpoints++;
+        }
+        samples[i] = (uint32_t)(now_ns() - start);
+    }
+    double elapsed = (now_ns() - begin) / 1e9;
+    qsort(samples, ops, sizeof(uint32_t), compare_u32);
+    
+    StorageFlusherStats stats;
+    storage_flusher_stats(engine, &stats);
+    if (background) checkpoints = stats.checkpoints;
+    printf("  %-10s %8.0f 次/秒，p50 %6u ns，p99 %8u ns，p99.9 %9u ns，最大 %9u ns\n", name, ops / elapsed,
+           samples[ops / 2], samples[ops * 99 / 100], samples[ops * 999 / 1000], samples[ops - 1]);
+    printf("  %-10s 检查点 %llu 次", "", (unsigned long long)checkpoints);
+    if (background) {
+        printf("（最长持锁 %.2f ms），后台写回 %llu 页（最近 %.0f 页/秒）", stats.max_checkpoint_ms,
+               (unsigned long long)stats.pages_written, stats.pages_per_sec);
+    }
+    printf("，结束时滞后 %llu 条日志（%.1f KB），脏页 %llu\n", (unsigned long long)stats.lag_records,
+           stats.lag_bytes / 1024.0, (unsigned long long)stats.dirty_pages);
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 100000;
+    long ops = argc > 2 ? atol(argv[2]) : 300000;
+    uint64_t wal_bytes = (uint64_t)(argc > 3 ? atol(argv[3]) : 4096) * 1024;
+    const char *db = "bench_flusher.db";
+    uint32_t *samples = malloc(ops * sizeof(uint32_t));
+    if (!samples || total < 1 || ops < 1) return 1;
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    options.checkpoint_wal_bytes = wal_bytes;
+    printf("key 数量：%ld，写入 %ld 次，检查点阈值 %llu KB\n", total, ops, (unsigned long long)(wal_bytes / 1024));
+    
+    for (int pool = 0; pool <= 1; pool++) {
+        for (int background = 0; background <= 1; background++) {
+            remove_db(db);
+            options.buffer_pool_pages = 0;
+            options.background_flush = false;
+            if (storage_init_ex(&engine, db, &options) < 0) {
+                fprintf(stderr, "初始化存储引擎失败\n");
+                return 1;
+            }
+            LoadSource src = {0, total, "", ""};
+            if (storage_bulk_load(&engine, load_next, &src, 0) < 0) {
+                fprintf(stderr, "批量加载失败\n");
+                return 1;
+            }
+            size_t file_pages = engine.pm.page_count;
+            storage_close(&engine);
+            
+            options.buffer_pool_pages = pool ? file_pages / 4 : 0;
+            options.background_flush = background;
+            if (storage_init_ex(&engine, db, &options) < 0) {
+                fprintf(stderr, "打开存储引擎失败\n");
+                return 1;
+            }
+            if (!background) printf("%s（索引文件 %zu 页）：\n", pool ? "缓冲池" : "mmap", file_pages);
+            run_puts(&engine, background ? "后台刷盘" : "前台检查点", total, ops, background, wal_bytes, samples);
+            
+            uint64_t start = now_ns();
+            storage_close(&engine);
+            printf("  %-10s 关闭 %.1f ms\n", "", (now_ns() - start) / 1e6);
+        }
+    }
+    
+    remove_db(db);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 点查延迟分布基准：开启和关闭上层节点缓存时分别加载 N 个随机 key，
+// 逐次计时随机查找，输出平均值、p50、p99 延迟。
+// 用法：./bench_latency [key 数量，默认 1000000] [查找次数，默认 1000000]
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 1000000;
+    long lookups = argc > 2 ? atol(argv[2]) : 1000000;
+    const char *db = "bench_latency.db";
+    char key[32], value[64], path[64];
+    uint32_t *samples = malloc(lookups * sizeof(uint32_t));
+    if (!samples) return 1;
+    
+    for (int cache = 0; cache <= 1; cache++) {
+        snprintf(path, sizeof(path), "%s.idx", db);
+        remove(path);
+        snprintf(path, sizeof(path), "%s.dat", db);
+        remove(path);
+        snprintf(path, sizeof(path), "%s.wal", db);
+        remove(path);
+        
+        StorageEngine engine;
+        StorageOptions options;
+        storage_default_options(&options);
+        options.sync_mode = WAL_SYNC_NONE;
+        options.node_cache = cache;
+        if (storage_init_ex(&engine, db, &options) < 0) {
+            fprintf(stderr, "初始化存储引擎失败\n");
+            return 1;
+        }
+        for (long i = 0; i < total; i++) {
+            snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(i));
+            snprintf(value, sizeof(value), "v%ld", i);
+            storage_put(&engine, key, value);
+        }
+        
+        long found = 0;
+        double sum = 0;
+        for (long r = 0; r < lookups; r++) {
+            snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(mix64(r) % total));
+            uint64_t start = now_ns();
+            found += storage_get(&engine, key, value, sizeof(value)) == 0;
+            samples[r] = (uint32_t)(now_ns() - start);
+            sum += samples[r];
+        }
+        qsort(samples, lookups, sizeof(uint32_t), compare_u32);
+        
+        BTreeStats stats;
+        storage_stats(&engine, &stats);
+        printf("缓存%s：树高 %u，缓存节点 %llu，平均 %.0f ns，p50 %u ns，p99 %u ns（命中 %ld/%ld）\n",
+               cache ? "开启" : "关闭", stats.depth, (unsigned long long)stats.cached_nodes,
+               sum / lookups, samples[lookups / 2], samples[lookups * 99 / 100], found, lookups);
+        storage_close(&engine);
+    }
+    
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 批量加载基准测试：持续插入 N 个随机顺序的 key，
+// 按区间统计吞吐量和索引文件大小，观察文件增长过程中吞吐是否保持平稳。
+// 用法：./bench_load [key 数量，默认 100000000] [数据库文件名]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 将序号打散成伪随机 key（64 位混合函数，保证不重复）
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+int main(int argc, char **argv) {
+    uint64_t total = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000000ULL;
+    const char *db = argc > 2 ? argv[2] : "bench_load.db";
+    uint64_t interval = total / 20 > 0 ? total / 20 : 1;
+    
+    char path[512];
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    
+    StorageEngine engine;
+    if (storage_init(&engine, db) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    
+    printf("加载 %llu 个 key\n", (unsigned long long)total);
+    printf("%12s %14s %12s %10s\n", "keys", "keys/sec", "idx(MB)", "failed");
+    
+    char key[32];
+    char value[32];
+    uint64_t failed = 0;
+    double start = now_sec();
+    double last = start;
+    
+    for (uint64_t i = 0; i < total; i++) {
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(i));
+        snprintf(value, sizeof(value), "v%llu", (unsigned long long)i);
+        if (storage_put(&engine, key, value) != 0) {
+            failed++;
+        }
+        
+        if ((i + 1) % interval == 0 || i + 1 == total) {
+            double t = now_sec();
+            uint64_t n = (i + 1) % interval == 0 ? interval : (i + 1) % interval;
+            printf("%12llu %14.0f %12.1f %10llu\n",
+                   (unsigned long long)(i + 1), n / (t - last),
+                   engine.pm.index_size / (1024.0 * 1024.0),
+                   (unsigned long long)failed);
+            fflush(stdout);
+            last = t;
+        }
+    }
+    
+    double elapsed = now_sec() - start;
+    printf("总计：%.2f 秒，平均 %.0f keys/sec\n", elapsed, total / elapsed);
+    
+    storage_close(&engine);
+    return failed == 0 ? 0 : 1;
+}
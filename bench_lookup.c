@@ -0,0 +1,70 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 点查延迟基准：加载 N 个随机 key 后输出树的深度/扇出/填充率，
+// 再随机查找并统计平均延迟。
+// 用法：./bench_lookup [key 数量，默认 1000000] [查找次数，默认 1000000]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 1000000;
+    long lookups = argc > 2 ? atol(argv[2]) : 1000000;
+    const char *db = "bench_lookup.db";
+    char key[32];
+    char value[64];
+    
+    snprintf(value, sizeof(value), "%s.idx", db);
+    remove(value);
+    snprintf(value, sizeof(value), "%s.dat", db);
+    remove(value);
+    
+    StorageEngine engine;
+    if (storage_init(&engine, db) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    
+    for (long i = 0; i < total; i++) {
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(i));
+        snprintf(value, sizeof(value), "v%ld", i);
+        storage_put(&engine, key, value);
+    }
+    
+    BTreeStats stats;
+    storage_stats(&engine, &stats);
+    printf("key 数量：%llu（加载 %ld）\n", (unsigned long long)stats.key_count, total);
+    printf("树高：%u，内部节点：%llu，叶子节点：%llu\n", stats.depth,
+           (unsigned long long)stats.internal_count, (unsigned long long)stats.leaf_count);
+    printf("平均扇出：%.1f，叶子填充率：%.1f%%，内部节点填充率：%.1f%%\n",
+           stats.avg_fanout, stats.leaf_fill * 100, stats.internal_fill * 100);
+    
+    long found = 0;
+    double start = now_sec();
+    for (long i = 0; i < lookups; i++) {
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(mix64(i) % total));
+        found += storage_get(&engine, key, value, sizeof(value)) == 0;
+    }
+    double elapsed = now_sec() - start;
+    printf("随机查找 %ld 次：%.0f ns/次，命中 %ld\n", lookups, elapsed * 1e9 / lookups, found);
+    
+    storage_close(&engine);
+    return found == lookups ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 单节点查找微基准：比较版本 1 页内格式（逐条 strlen 线性定位第 i 个 entry）
+// 与当前 slotted page 格式（slot 数组 O(1) 定位）的每节点查找开销。
+// 两种格式装入同样数量的 key，树只有一个叶子节点（根即叶子）。
+// 用法：./bench_node_search [查找次数，默认 2000000]
+
+#define KEY_FMT "key%06d"
+#define VALUE "value123"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ---- 版本 1 格式的参考实现：key\0 vlen(u16) value 依次排列 ----
+
+static char* v1_get_key(char *data, int index) {
+    char *ptr = data;
+    for (int i = 0; i < index; i++) {
+        ptr += strlen(ptr) + 1;
+        uint16_t val_len;
+        memcpy(&val_len, ptr, sizeof(uint16_t));
+        ptr += sizeof(uint16_t) + val_len;
+    }
+    return ptr;
+}
+
+static int v1_find(char *data, int count, const char *key) {
+    int left = 0, right = count;
+    while (left < right) {
+        int mid = (left + right) / 2;
+        int cmp = strcmp(key, v1_get_key(data, mid));
+        if (cmp < 0) {
+            right = mid;
+        } else if (cmp > 0) {
+            left = mid + 1;
+        } else {
+            return mid;
+        }
+    }
+    return -1;
+}
+
+static int v1_build(char *data, size_t cap, int count) {
+    char key[32];
+    size_t off = 0;
+    uint16_t vlen = strlen(VALUE);
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), KEY_FMT, i);
+        size_t klen = strlen(key) + 1;
+        if (off + klen + sizeof(uint16_t) + vlen > cap) return i;
+        memcpy(data + off, key, klen);
+        memcpy(data + off + klen, &vlen, sizeof(uint16_t));
+        memcpy(data + off + klen + sizeof(uint16_t), VALUE, vlen);
+        off += klen + sizeof(uint16_t) + vlen;
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    long lookups = argc > 1 ? atol(argv[1]) : 2000000;
+    const char *db = "bench_node_search.db";
+    char key[32];
+    char value[64];
+    
+    // 当前格式每个 entry 占 slot(2) + klen(2) + vlen(2) + key + value
+    size_t entry = 3 * sizeof(uint16_t) + 9 + strlen(VALUE);
+    int count = (int)((PAGE_SIZE - sizeof(BTreeNode)) / entry);
+    
+    char *v1_data = calloc(1, PAGE_SIZE);
+    count = v1_build(v1_data, PAGE_SIZE - 16, count);
+    
+    snprintf(value, sizeof(value), "%s.idx", db);
+    remove(value);
+    snprintf(value, sizeof(value), "%s.dat", db);
+    remove(value);
+    
+    StorageEngine engine;
+    if (storage_init(&engine, db) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), KEY_FMT, i);
+        storage_put(&engine, key, VALUE);
+    }
+    
+    // 预先生成查找序列，避免把 snprintf 计入耗时
+    char (*keys)[16] = malloc(sizeof(*keys) * 4096);
+    srand(42);
+    for (int i = 0; i < 4096; i++) {
+        snprintf(keys[i], sizeof(keys[i]), KEY_FMT, rand() % count);
+    }
+    
+    printf("每节点 %d 个 key，%ld 次查找\n", count, lookups);
+    
+    long hits = 0;
+    double t0 = now_sec();
+    for (long i = 0; i < lookups; i++) {
+        hits += v1_find(v1_data, count, keys[i & 4095]) >= 0;
+    }
+    double t1 = now_sec();
+    printf("  版本 1（线性定位 entry）：%8.1f ns/查找\n", (t1 - t0) * 1e9 / lookups);
+    
+    t0 = now_sec();
+    for (long i = 0; i < lookups; i++) {
+        hits += storage_get(&engine, keys[i & 4095], value, sizeof(value)) == 0;
+    }
+    t1 = now_sec();
+    printf("  slotted page（storage_get）：%8.1f ns/查找\n", (t1 - t0) * 1e9 / lookups);
+    
+    if (hits != 2 * lookups) {
+        fprintf(stderr, "查找结果不一致：%ld/%ld\n", hits, 2 * lookups);
+    }
+    
+    storage_close(&engine);
+    free(keys);
+    free(v1_data);
+    return 0;
+}
@@ -0,0 +1,165 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 索引文件后端对比基准：批量加载 N 个 key（100 字节 value），缓冲池取索引文件页面数的 1/4，
+// 分别用 mmap 和缓冲池打开，依次测量：均匀随机查找、热点查找（1/16 的 key 占全部查找）、
+// 一次全表扫描之后的热点查找（检验扫描是否冲掉热点页面），输出吞吐、p99 延迟和缓冲池命中率。
+// 每种后端打开前用 posix_fadvise 丢弃索引文件的页缓存，两者都从冷缓存开始。
+// 用法：./bench_pool [key 数量，默认 1000000] [每个阶段的查找次数，默认 200000]
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    long next;
+    long count;
+    char key[32];
+    char value[128];
+} LoadSource;
+
+static int load_next(void *ctx, const char **key, size_t *klen, const char **value, size_t *vlen) {
+    LoadSource *src = ctx;
+    if (src->next >= src->count) return 0;
+    *klen = (size_t)snprintf(src->key, sizeof(src->key), "key%010ld", src->next);
+    int n = snprintf(src->value, sizeof(src->value), "v%ld.", src->next);
+    memset(src->value + n, 'a' + src->next % 26, 100 - n);
+    src->next++;
+    *key = src->key;
+    *value = src->value;
+    *vlen = 100;
+    return 1;
+}
+
+static int scan_count(void *ctx, const char *key, size_t klen, const char *value, size_t vlen) {
+    (void)key; (void)klen; (void)value; (void)vlen;
+    (*(long*)ctx)++;
+    return 0;
+}
+
+static void drop_cache(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// 查找 ops 次：hot 为 0 时在全部 key 中均匀选取，否则只在前 total/16 个 key 中选取
+static long run_lookups(StorageEngine *engine, const char *name, long total, long ops, int hot,
+                        uint64_t seed, uint32_t *samples) {
+    char key[32], value[128];
+    long range = hot ? total / 16 : total;
+    long found = 0;
+    PageStats before = engine->pm.stats;
+    uint64_t begin = now_ns();
+    for (long i = 0; i < ops; i++) {
+        snprintf(key, sizeof(key), "key%010ld", (long)(mix64(seed + i) % range));
+        uint64_t start = now_ns();
+        found += storage_get(engine, key, value, sizeof(value)) == 0;
+        samples[i] = (uint32_t)(now_ns() - start);
+    }
+    double elapsed = (now_ns() - begin) / 1e9;
+    qsort(samples, ops, sizeof(uint32_t), compare_u32);
+    
+    printf("  %-14s %9.0f 次/秒，p99 %6u ns", name, ops / elapsed, samples[ops * 99 / 100]);
+    uint64_t hits = engine->pm.stats.pool_hits - before.pool_hits;
+    uint64_t misses = engine->pm.stats.pool_misses - before.pool_misses;
+    if (engine->pm.pool) {
+        printf("，缓冲池命中率 %.1f%%", hits + misses ? 100.0 * hits / (hits + misses) : 0);
+    }
+    printf("\n");
+    return found;
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 1000000;
+    long ops = argc > 2 ? atol(argv[2]) : 200000;
+    const char *db = "bench_pool.db";
+    char path[64];
+    uint32_t *samples = malloc(ops * sizeof(uint32_t));
+    if (!samples || total < 16) return 1;
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    LoadSource src = {0, total, "", ""};
+    if (storage_bulk_load(&engine, load_next, &src, 0) < 0) {
+        fprintf(stderr, "批量加载失败\n");
+        return 1;
+    }
+    size_t file_pages = engine.pm.page_count;
+    storage_close(&engine);
+    
+    size_t pool_pages = file_pages / 4;
+    printf("key 数量：%ld，索引文件 %zu 页（%.1f MB），缓冲池 %zu 页（%.1f MB）\n", total, file_pages,
+           file_pages * (double)PAGE_SIZE / 1048576, pool_pages, pool_pages * (double)PAGE_SIZE / 1048576);
+    
+    long expect = 0, found = 0;
+    for (int pool = 0; pool <= 1; pool++) {
+        snprintf(path, sizeof(path), "%s.idx", db);
+        drop_cache(path);
+        options.buffer_pool_pages = pool ? pool_pages : 0;
+        if (storage_init_ex(&engine, db, &options) < 0) {
+            fprintf(stderr, "打开存储引擎失败\n");
+            return 1;
+        }
+        printf("%s：\n", pool ? "缓冲池（2Q）" : "mmap");
+        
+        // 先做一轮均匀查找预热，再正式测量
+        found += run_lookups(&engine, "均匀（预热）", total, ops, 0, 1, samples);
+        found += run_lookups(&engine, "均匀", total, ops, 0, 2, samples);
+        found += run_lookups(&engine, "热点", total, ops, 1, 3, samples);
+        
+        long scanned = 0;
+        uint64_t start = now_ns();
+        storage_scan(&engine, NULL, NULL, scan_count, &scanned);
+        printf("  全表扫描       %ld 个 key，%.0f ms\n", scanned, (now_ns() - start) / 1e6);
+        found += run_lookups(&engine, "扫描后热点", total, ops, 1, 4, samples);
+        expect += ops * 4;
+        
+        if (pool) {
+            PageStats *ps = &engine.pm.stats;
+            printf("  合计：淘汰 %llu，写回 %llu，额外页框 %llu\n", (unsigned long long)ps->pool_evictions,
+                   (unsigned long long)ps->pool_writebacks, (unsigned long long)ps->pool_overflow);
+        }
+        storage_close(&engine);
+    }
+    
+    free(samples);
+    return found == expect ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 长公共前缀 key 的树形基准：key 形如 tenant0003:region-eu-west-2:bucket-07:object:0000001234，
+// 分别乱序 put 和批量加载 N 个 key，输出树高、扇出、节点数和随机点查延迟。
+// 用法：./bench_prefix [key 数量，默认 200000]
+
+#define REGIONS 3
+#define BUCKETS 10
+#define OBJECTS 1000
+#define KEY_BUF 96
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// 第 i 个 key（写入 KEY_BUF 字节的 buf），i 的顺序即 key 的字节序
+static size_t make_key(long i, char *buf) {
+    static const char *regions[REGIONS] = {"ap-south-1", "eu-west-2", "us-east-1"};
+    long o = i % OBJECTS;
+    long b = i / OBJECTS % BUCKETS;
+    long r = i / OBJECTS / BUCKETS % REGIONS;
+    long t = i / OBJECTS / BUCKETS / REGIONS;
+    return (size_t)snprintf(buf, KEY_BUF, "tenant%04ld:region-%s:bucket-%02ld:object:%010ld",
+                            t % 10000, regions[r], b, o);
+}
+
+typedef struct {
+    long next;
+    long total;
+    char key[KEY_BUF];
+} KeySource;
+
+static int next_key(void *ctx, const char **key, size_t *klen, const char **value, size_t *vlen) {
+    KeySource *src = ctx;
+    if (src->next >= src->total) return 0;
+    *klen = make_key(src->next++, src->key);
+    *key = src->key;
+    *value = "value123";
+    *vlen = 8;
+    return 1;
+}
+
+static void open_db(StorageEngine *engine, const char *db) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        exit(1);
+    }
+}
+
+static void report(StorageEngine *engine, const char *name, long total) {
+    BTreeStats stats;
+    char key[KEY_BUF], value[64];
+    storage_stats(engine, &stats);
+    
+    long found = 0;
+    double start = now_sec();
+    for (long r = 0; r < total; r++) {
+        size_t klen = make_key((long)(mix64(r + 777) % total), key);
+        size_t vlen;
+        found += storage_get2(engine, key, klen, value, sizeof(value), &vlen) == 0;
+    }
+    double ns = (now_sec() - start) * 1e9 / total;
+    
+    printf("%-8s 树高 %u，内部节点 %llu，叶子 %llu，平均扇出 %.1f，叶子填充率 %.1f%%，点查 %.0f ns（%ld/%ld 命中）\n",
+           name, stats.depth, (unsigned long long)stats.internal_count, (unsigned long long)stats.leaf_count,
+           stats.avg_fanout, stats.leaf_fill * 100, ns, found, total);
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 200000;
+    StorageEngine engine;
+    char key[KEY_BUF];
+    
+    // 乱序逐个写入
+    open_db(&engine, "bench_prefix.db");
+    for (long i = 0; i < total; i++) {
+        size_t klen = make_key((long)(mix64(i) % total), key);
+        storage_put2(&engine, key, klen, "value123", 8);
+    }
+    report(&engine, "乱序 put", total);
+    storage_close(&engine);
+    
+    // 有序批量加载
+    open_db(&engine, "bench_prefix.db");
+    KeySource src = {0, total, {0}};
+    if (storage_bulk_load(&engine, next_key, &src, 0) < 0) {
+        fprintf(stderr, "批量加载失败\n");
+        return 1;
+    }
+    report(&engine, "批量加载", total);
+    storage_close(&engine);
+    return 0;
+}
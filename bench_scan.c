@@ -0,0 +1,84 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 前缀扫描基准：加载 groups 组、每组 per_group 个同前缀 key，
+// 对比逐个 storage_get 与一次 storage_scan_prefix 读完整组的耗时。
+// 用法：./bench_scan [组数，默认 2000] [每组 key 数，默认 100] [查询组数，默认 2000]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int count_cb(void *ctx, const char *key, size_t klen, const char *value, size_t vlen) {
+    (void)key;
+    (void)klen;
+    (void)value;
+    *(long*)ctx += (long)vlen > 0;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    long groups = argc > 1 ? atol(argv[1]) : 2000;
+    long per_group = argc > 2 ? atol(argv[2]) : 100;
+    long queries = argc > 3 ? atol(argv[3]) : 2000;
+    const char *db = "bench_scan.db";
+    char key[64];
+    char value[64];
+    
+    snprintf(value, sizeof(value), "%s.idx", db);
+    remove(value);
+    snprintf(value, sizeof(value), "%s.dat", db);
+    remove(value);
+    snprintf(value, sizeof(value), "%s.wal", db);
+    remove(value);
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    
+    for (long g = 0; g < groups; g++) {
+        for (long i = 0; i < per_group; i++) {
+            snprintf(key, sizeof(key), "user%08ld:item%06ld", g, i);
+            snprintf(value, sizeof(value), "v%ld", i);
+            storage_put(&engine, key, value);
+        }
+    }
+    
+    long found = 0;
+    double start = now_sec();
+    for (long q = 0; q < queries; q++) {
+        long g = (q * 7919) % groups;
+        for (long i = 0; i < per_group; i++) {
+            snprintf(key, sizeof(key), "user%08ld:item%06ld", g, i);
+            found += storage_get(&engine, key, value, sizeof(value)) == 0;
+        }
+    }
+    double get_time = now_sec() - start;
+    
+    long scanned = 0;
+    start = now_sec();
+    for (long q = 0; q < queries; q++) {
+        snprintf(key, sizeof(key), "user%08ld:", (q * 7919) % groups);
+        storage_scan_prefix(&engine, key, count_cb, &scanned);
+    }
+    double scan_time = now_sec() - start;
+    
+    printf("每组 %ld 个 key，查询 %ld 组\n", per_group, queries);
+    printf("逐个 get：%.1f us/组（命中 %ld）\n", get_time * 1e6 / queries, found);
+    printf("前缀扫描：%.1f us/组（扫描 %ld），加速 %.1fx\n",
+           scan_time * 1e6 / queries, scanned, get_time / scan_time);
+    
+    storage_close(&engine);
+    return found == scanned ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#define _POSIX_C_SOURCE 200809L
+#include "search.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 单节点前缀查找微基准：在不同节点大小下比较标量二分、SSE4.2、AVX2 三种实现
+// 在有序 uint64_t 前缀数组上做 lower bound 的开销（CPU 不支持的实现跳过）。
+// 查找的 key 按随机顺序取自数组，并与标量结果逐一核对。
+// 用法：./bench_simd_search [每种节点大小的查找次数，默认 2000000]
+
+static const char *impl_names[] = {"scalar", "sse4.2", "avx2"};
+static const size_t node_sizes[] = {16, 64, 128, 256, 512};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_rand(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+int main(int argc, char *argv[]) {
+    size_t lookups = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    const char *best = prefix_search_impl();
+    printf("=== 单节点前缀查找：%zu 次/节点大小，默认实现 %s ===\n", lookups, best);
+    
+    uint64_t *probes = malloc(lookups * sizeof(uint64_t));
+    size_t *expect = malloc(lookups * sizeof(size_t));
+    if (!probes || !expect) return 1;
+    
+    printf("%8s", "keys");
+    for (size_t m = 0; m < sizeof(impl_names) / sizeof(impl_names[0]); m++) {
+        printf(" %12s", impl_names[m]);
+    }
+    printf("\n");
+    
+    for (size_t s = 0; s < sizeof(node_sizes) / sizeof(node_sizes[0]); s++) {
+        size_t n = node_sizes[s];
+        uint64_t keys[512];
+        uint64_t state = 88172645463325252ULL;
+        // 递增但间隔不均匀，高位变化覆盖无符号比较的符号位
+        uint64_t v = 0x7ff0000000000000ULL;
+        for (size_t i = 0; i < n; i++) {
+            v += (next_rand(&state) >> 44) + 1;
+            keys[i] = v;
+        }
+        prefix_search_set_impl("scalar");
+        for (size_t i = 0; i < lookups; i++) {
+            uint64_t r = next_rand(&state);
+            probes[i] = keys[r % n] + (r >> 63);  // 一半命中，一半落在两个 key 之间
+            expect[i] = prefix_lower_bound(keys, n, probes[i]);
+        }
+        
+        printf("%8zu", n);
+        for (size_t m = 0; m < sizeof(impl_names) / sizeof(impl_names[0]); m++) {
+            if (prefix_search_set_impl(impl_names[m]) != 0) {
+                printf(" %12s", "n/a");
+                continue;
+            }
+            size_t sum = 0;
+            double start = now_sec();
+            for (size_t i = 0; i < lookups; i++) {
+                size_t pos = prefix_lower_bound(keys, n, probes[i]);
+                if (pos != expect[i]) {
+                    fprintf(stderr, "%s 结果错误: n=%zu probe=%zu\n", impl_names[m], n, i);
+                    return 1;
+                }
+                sum += pos;
+            }
+            double elapsed = now_sec() - start;
+            printf(" %9.1f ns", elapsed * 1e9 / lookups);
+            (void)sum;
+        }
+        printf("\n");
+    }
+    prefix_search_set_impl(best);
+    
+    free(probes);
+    free(expect);
+    return 0;
+}
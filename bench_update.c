@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 覆盖写基准：加载 N 个 100B value 的随机 key 后，依次执行等长覆盖、16~240B 随机长度覆盖
+// 和 16B~1KB 随机长度覆盖（部分 value 在内联与数据文件之间切换），每阶段 N 次随机 key 的更新。
+// 分别用 storage_put 直接替换和先 storage_delete 再 storage_put 两种方式在各自的新数据库上运行，
+// 输出每阶段的吞吐、叶子数和叶子填充率。
+// 用法：./bench_update [key 数量，默认 500000]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static void fill_value(char *value, size_t len, uint64_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        value[i] = 'a' + (char)((seed + i) % 26);
+    }
+}
+
+static int run(long total, int with_delete) {
+    const char *db = "bench_update.db";
+    const char *stage_names[] = {"等长", "16~240B", "16B~1KB"};
+    const size_t min_len[] = {100, 16, 16};
+    const size_t max_len[] = {100, 240, 1024};
+    char key[32], value[1024], path[64];
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return -1;
+    }
+    for (long i = 0; i < total; i++) {
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(i));
+        fill_value(value, 100, i);
+        storage_put2(&engine, key, 16, value, 100);
+    }
+    
+    int ok = 0;
+    for (int stage = 0; stage < 3; stage++) {
+        double start = now_sec();
+        for (long i = 0; i < total; i++) {
+            uint64_t r = mix64(((uint64_t)stage << 40) + i);
+            snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(r % total));
+            size_t len = min_len[stage] + (r >> 32) % (max_len[stage] - min_len[stage] + 1);
+            fill_value(value, len, r);
+            if (with_delete) {
+                ok |= storage_delete2(&engine, key, 16);
+            }
+            ok |= storage_put2(&engine, key, 16, value, len);
+        }
+        double elapsed = now_sec() - start;
+        
+        BTreeStats stats;
+        storage_stats(&engine, &stats);
+        ok |= stats.key_count != (uint64_t)total;
+        printf("%-14s  %-8s  %12.0f  %8llu  %10.1f%%\n", with_delete ? "delete + put" : "put",
+               stage_names[stage], total / elapsed,
+               (unsigned long long)stats.leaf_count, stats.leaf_fill * 100);
+    }
+    
+    storage_close(&engine);
+    remove("bench_update.db.idx");
+    remove("bench_update.db.dat");
+    remove("bench_update.db.wal");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 500000;
+    if (total < 1) return 1;
+    
+    printf("%-14s  %-8s  %12s  %8s  %11s\n", "方式", "value", "更新（ops/s）", "叶子数", "叶子填充率");
+    if (run(total, 0) != 0 || run(total, 1) != 0) {
+        fprintf(stderr, "更新结果不正确\n");
+        return 1;
+    }
+    return 0;
+}
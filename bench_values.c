@@ -0,0 +1,101 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 大小 value 混合基准：写入 N 个 key，其中每 large_every 个有一个 64KB value，其余为 100 字节，
+// 输出写入吞吐、两类 value 的随机读取延迟以及叶子数/扇出（大 value 存放在 .dat 中，不影响叶子密度）。
+// 用法：./bench_values [key 数量，默认 20000] [每多少个 key 一个 64KB value，默认 10]
+
+#define SMALL_SIZE 100
+#define LARGE_SIZE (64 * 1024)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 20000;
+    long large_every = argc > 2 ? atol(argv[2]) : 10;
+    const char *db = "bench_values.db";
+    char key[32];
+    char path[64];
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    char *small = malloc(SMALL_SIZE + 1);
+    char *large = malloc(LARGE_SIZE + 1);
+    char *buf = malloc(LARGE_SIZE + 1);
+    if (!small || !large || !buf) return 1;
+    memset(small, 's', SMALL_SIZE);
+    small[SMALL_SIZE] = '\0';
+    memset(large, 'L', LARGE_SIZE);
+    large[LARGE_SIZE] = '\0';
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    
+    double start = now_sec();
+    for (long i = 0; i < total; i++) {
+        snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(i));
+        storage_put(&engine, key, i % large_every == 0 ? large : small);
+    }
+    storage_checkpoint(&engine);
+    double elapsed = now_sec() - start;
+    long large_count = (total + large_every - 1) / large_every;
+    double mb = (large_count * (double)LARGE_SIZE + (total - large_count) * (double)SMALL_SIZE) / 1048576;
+    printf("写入 %ld 个 key（%ld 个 64KB）：%.0f keys/s，%.1f MB/s\n",
+           total, large_count, total / elapsed, mb / elapsed);
+    
+    BTreeStats stats;
+    storage_stats(&engine, &stats);
+    printf("树高：%u，叶子节点：%llu，平均扇出：%.1f，叶子填充率：%.1f%%\n", stats.depth,
+           (unsigned long long)stats.leaf_count, stats.avg_fanout, stats.leaf_fill * 100);
+    
+    // 分别测两类 value 的随机读取
+    for (int large_pass = 0; large_pass <= 1; large_pass++) {
+        long reads = 0, ok = 0;
+        start = now_sec();
+        for (long r = 0; r < total; r++) {
+            long i = (long)(mix64(r + 12345) % total);
+            if ((i % large_every == 0) != large_pass) continue;
+            snprintf(key, sizeof(key), "%016llx", (unsigned long long)mix64(i));
+            ok += storage_get(&engine, key, buf, LARGE_SIZE + 1) == 0 &&
+                  strlen(buf) == (size_t)(large_pass ? LARGE_SIZE : SMALL_SIZE);
+            reads++;
+        }
+        elapsed = now_sec() - start;
+        printf("随机读取 %s value：%.0f ns/次（%ld/%ld 正确）\n", large_pass ? "64KB" : "100B",
+               reads ? elapsed * 1e9 / reads : 0, ok, reads);
+    }
+    
+    storage_close(&engine);
+    free(small);
+    free(large);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,114 @@
+#define _POSIX_C_SOURCE 200809L
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 复制读取与视图读取对比：对每种 value 长度写入 N 个 key，分别用 storage_get2（复制到调用者缓冲区）
+// 和 storage_get_view（直接引用映射区域）随机读取，读取后对 value 做一次校验和模拟"只哈希/转发"的读者。
+// 用法：./bench_view [每种长度的 key 数量，默认 2000]
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// 每 64 字节取一个字节，代表读者对 value 的轻量访问
+static uint64_t touch(const char *data, size_t len) {
+    uint64_t sum = len;
+    for (size_t i = 0; i < len; i += 64) {
+        sum += (unsigned char)data[i];
+    }
+    return sum;
+}
+
+int main(int argc, char **argv) {
+    long total = argc > 1 ? atol(argv[1]) : 2000;
+    static const size_t sizes[] = {100, 4096, 65536, 1 << 20};
+    enum { NSIZES = sizeof(sizes) / sizeof(sizes[0]) };
+    const char *db = "bench_view.db";
+    char key[32];
+    char path[64];
+    
+    snprintf(path, sizeof(path), "%s.idx", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.dat", db);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", db);
+    remove(path);
+    
+    size_t max_size = sizes[NSIZES - 1];
+    char *value = malloc(max_size);
+    char *buf = malloc(max_size);
+    if (!value || !buf) return 1;
+    memset(value, 'v', max_size);
+    
+    StorageEngine engine;
+    StorageOptions options;
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    if (storage_init_ex(&engine, db, &options) < 0) {
+        fprintf(stderr, "初始化存储引擎失败\n");
+        return 1;
+    }
+    
+    for (int s = 0; s < NSIZES; s++) {
+        // 1MB value 的 key 数量减少到 1/16，避免数据文件过大
+        long count = sizes[s] >= (1 << 20) ? (total + 15) / 16 : total;
+        for (long i = 0; i < count; i++) {
+            snprintf(key, sizeof(key), "%d:%016llx", s, (unsigned long long)mix64(i));
+            storage_put2(&engine, key, strlen(key), value, sizes[s]);
+        }
+    }
+    storage_checkpoint(&engine);
+    
+    printf("%-10s %14s %14s %10s\n", "value", "复制 (ns/次)", "视图 (ns/次)", "加速比");
+    for (int s = 0; s < NSIZES; s++) {
+        long count = sizes[s] >= (1 << 20) ? (total + 15) / 16 : total;
+        long reads = count * 4;
+        uint64_t sum_copy = 0, sum_view = 0;
+        
+        double start = now_sec();
+        for (long r = 0; r < reads; r++) {
+            snprintf(key, sizeof(key), "%d:%016llx", s, (unsigned long long)mix64(mix64(r) % count));
+            size_t vlen;
+            if (storage_get2(&engine, key, strlen(key), buf, max_size, &vlen) == 0) {
+                sum_copy += touch(buf, vlen);
+            }
+        }
+        double copy_ns = (now_sec() - start) * 1e9 / reads;
+        
+        start = now_sec();
+        for (long r = 0; r < reads; r++) {
+            snprintf(key, sizeof(key), "%d:%016llx", s, (unsigned long long)mix64(mix64(r) % count));
+            StorageView view;
+            if (storage_get_view(&engine, key, strlen(key), &view) == 0) {
+                sum_view += touch(view.data, view.len);
+                storage_view_release(&view);
+            }
+        }
+        double view_ns = (now_sec() - start) * 1e9 / reads;
+        
+        if (sum_copy != sum_view) {
+            fprintf(stderr, "复制与视图读取的结果不一致\n");
+            return 1;
+        }
+        printf("%-10zu %14.0f %14.0f %9.1fx\n", sizes[s], copy_ns, view_ns, copy_ns / view_ns);
+    }
+    
+    storage_close(&engine);
+    free(value);
+    free(buf);
+    return 0;
+}
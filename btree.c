@@ -1,19 +1,42 @@
+#define _POSIX_C_SOURCE 200809L
 #include "btree.h"
 #include "page.h"
+#include "search.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
-// 文件头结构（前向声明）
-typedef struct {
-    uint32_t magic;
-    uint32_t version;
-    uint32_t page_count;
-    uint32_t root_page;
-    uint32_t free_page_list;
-    char reserved[PAGE_SIZE - 20];
-} FileHeader;
+#define LEAF_CELL_HEADER (2 * sizeof(uint16_t))                       // klen + vlen
+#define VALUE_OVERFLOW 0x8000                                         // vlen 字段的溢出标志
+#define VALUE_LEN_MASK 0x7FFF                                         // vlen 字段中的内联长度
+#define VALUE_REF_SIZE (sizeof(uint64_t) + sizeof(uint32_t))          // 溢出 value 的引用：offset + len
+#define INTERNAL_CELL_HEADER (sizeof(uint32_t) + sizeof(uint16_t))    // child + klen
+
+// 节点容量按字节计算：页面写满才分裂，扇出由 key/value 长度决定
+#define NODE_CAPACITY (PAGE_SIZE - sizeof(BTreeNode))  // slot + cell 可用字节数
+#define MIN_FILL_BYTES (NODE_CAPACITY / 4)              // 低于该填充量视为下溢
+
+// 读写可能未对齐的整数（cell 紧凑存放，偏移不保证对齐）
+static inline uint16_t get_u16(const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void put_u16(uint8_t *p, uint16_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t get_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
 
 // 从页面获取节点
 static BTreeNode* get_node(PageManager *pm, uint32_t page_id) {
@@ -22,81 +45,168 @@ static BTreeNode* get_node(PageManager *pm, uint32_t page_id) {
     return (BTreeNode*)page->data;
 }
 
-// 获取叶子节点的 key
-static char* leaf_get_key(BTreeNode *node, int index) {
-    char *ptr = (char*)(node + 1);
-    for (int i = 0; i < index; i++) {
-        ptr += strlen(ptr) + 1;  // 跳过 key
-        uint16_t val_len;
-        memcpy(&val_len, ptr, sizeof(uint16_t));
-        ptr += sizeof(uint16_t) + val_len;  // 跳过 value
+// slot 数组紧跟在节点头之后
+static inline uint16_t* node_slots(BTreeNode *node) {
+    return (uint16_t*)(node + 1);
+}
+
+// 获取第 index 个 cell 的起始地址
+static inline uint8_t* node_cell(BTreeNode *node, int index) {
+    return (uint8_t*)node + node_slots(node)[index];
+}
+
+// 计算 cell 占用的字节数
+static size_t cell_size(BTreeNode *node, const uint8_t *cell) {
+    if (node->is_leaf) {
+        return LEAF_CELL_HEADER + get_u16(cell) + (get_u16(cell + sizeof(uint16_t)) & VALUE_LEN_MASK);
     }
-    return ptr;
+    return INTERNAL_CELL_HEADER + get_u16(cell + sizeof(uint32_t));
+}
+
+// 节点中所有 key 的公共前缀存放在页尾 [PAGE_SIZE - prefix_len, PAGE_SIZE)，cell 区在它之前向前增长
+static inline const char* node_prefix(BTreeNode *node) {
+    return (const char*)node + PAGE_SIZE - node->prefix_len;
 }
 
-// 获取叶子节点的 value
-static char* leaf_get_value(BTreeNode *node, int index) {
-    char *ptr = (char*)(node + 1);
-    for (int i = 0; i < index; i++) {
-        ptr += strlen(ptr) + 1;  // 跳过 key
-        uint16_t val_len;
-        memcpy(&val_len, ptr, sizeof(uint16_t));
-        ptr += sizeof(uint16_t) + val_len;  // 跳过 value
+// 获取节点第 index 个 key 去掉公共前缀后的后缀（叶子和内部节点通用）
+static const char* node_get_suffix(BTreeNode *node, int index, size_t *slen) {
+    uint8_t *cell = node_cell(node, index);
+    if (node->is_leaf) {
+        *slen = get_u16(cell);
+        return (const char*)cell + LEAF_CELL_HEADER;
     }
-    ptr += strlen(ptr) + 1;  // 跳过 key
-    return ptr;
+    *slen = get_u16(cell + sizeof(uint32_t));
+    return (const char*)cell + INTERNAL_CELL_HEADER;
 }
 
-// 获取内部节点的 key（格式：child0, key0, child1, key1, ..., childN）
-static char* internal_get_key(BTreeNode *node, int index) {
-    char *ptr = (char*)(node + 1);
-    // 跳过第一个 child
-    ptr += sizeof(uint32_t);
-    // 跳过前面的 key 和 child
-    for (int i = 0; i < index; i++) {
-        ptr += strlen(ptr) + 1;  // 跳过 key
-        ptr += sizeof(uint32_t);  // 跳过 child
+// 把第 index 个完整 key（前缀 + 后缀）复制到 buf（至少 MAX_KEY_SIZE 字节），返回 key 长度
+static size_t node_copy_key(BTreeNode *node, int index, char *buf) {
+    size_t slen;
+    const char *suffix = node_get_suffix(node, index, &slen);
+    memcpy(buf, node_prefix(node), node->prefix_len);
+    memcpy(buf + node->prefix_len, suffix, slen);
+    return node->prefix_len + slen;
+}
+
+// key 是否以节点的公共前缀开头
+static inline bool node_has_prefix(BTreeNode *node, const char *key, size_t klen) {
+    return klen >= node->prefix_len && memcmp(key, node_prefix(node), node->prefix_len) == 0;
+}
+
+// 获取叶子节点的 value：内联 value 指向 cell，溢出 value 指向数据文件的映射区域
+static const char* leaf_get_value(PageManager *pm, BTreeNode *node, int index, size_t *vlen) {
+    uint8_t *cell = node_cell(node, index);
+    uint16_t field = get_u16(cell + sizeof(uint16_t));
+    const uint8_t *data = cell + LEAF_CELL_HEADER + get_u16(cell);
+    
+    if (!(field & VALUE_OVERFLOW)) {
+        *vlen = field;
+        return (const char*)data;
     }
-    return ptr;
+    
+    uint64_t offset;
+    memcpy(&offset, data, sizeof(uint64_t));
+    *vlen = get_u32(data + sizeof(uint64_t));
+    return page_data_get(pm, offset, *vlen);
 }
 
-// 获取内部节点的 child（内部节点：child0, key0, child1, key1, ..., childN）
-static uint32_t* internal_get_child(BTreeNode *node, int index) {
-    char *ptr = (char*)(node + 1);
-    // 第一个 child 在数据开始处
-    if (index == 0) {
-        return (uint32_t*)ptr;
+// 准备写入叶子的 value：长 value 先追加到数据文件，cell 中只保存引用
+typedef struct {
+    const char *data;               // 写入 cell 的字节
+    uint16_t field;                 // 写入 cell 的 vlen 字段
+    uint8_t ref[VALUE_REF_SIZE];    // 溢出时 data 指向这里
+} StoredValue;
+
+static int store_value(PageManager *pm, const char *value, size_t vlen, StoredValue *sv) {
+    if (vlen <= MAX_INLINE_VAL) {
+        sv->data = value;
+        sv->field = (uint16_t)vlen;
+        return 0;
     }
-    // 后续的 child 在对应的 key 之后
-    for (int i = 0; i < index; i++) {
-        ptr += strlen(ptr) + 1;  // 跳过 key
-        if (i < index - 1) {
-            ptr += sizeof(uint32_t);  // 跳过 child（除了最后一个）
-        }
+    
+    uint64_t offset = page_data_append(pm, value, vlen);
+    if (offset == UINT64_MAX) return -1;
+    memcpy(sv->ref, &offset, sizeof(uint64_t));
+    put_u32(sv->ref + sizeof(uint64_t), (uint32_t)vlen);
+    sv->data = (const char*)sv->ref;
+    sv->field = VALUE_OVERFLOW | VALUE_REF_SIZE;
+    return 0;
+}
+
+// 叶子 cell 的字节数
+static inline size_t leaf_cell_size(size_t klen, const StoredValue *sv) {
+    return LEAF_CELL_HEADER + klen + (sv->field & VALUE_LEN_MASK);
+}
+
+// 写入叶子 cell
+static void write_leaf_cell(uint8_t *cell, const char *key, size_t klen, const StoredValue *sv) {
+    put_u16(cell, (uint16_t)klen);
+    put_u16(cell + sizeof(uint16_t), sv->field);
+    memcpy(cell + LEAF_CELL_HEADER, key, klen);
+    memcpy(cell + LEAF_CELL_HEADER + klen, sv->data, sv->field & VALUE_LEN_MASK);
+}
+
+// 获取内部节点的 child（child0 在节点头中，child[i] 存放在 key[i-1] 的 cell 中）
+static uint32_t internal_get_child(BTreeNode *node, int index) {
+    if (index == 0) {
+        return node->child0;
     }
-    ptr += strlen(ptr) + 1;  // 跳过 key
-    return (uint32_t*)ptr;
+    return get_u32(node_cell(node, index - 1));
+}
+
+// 比较两个 key（按字节序，较短的前缀更小，与 strcmp 的顺序一致）
+static int compare_key(const char *a, size_t alen, const char *b, size_t blen) {
+    size_t n = alen < blen ? alen : blen;
+    int cmp = memcmp(a, b, n);
+    if (cmp != 0) return cmp;
+    return (alen > blen) - (alen < blen);
+}
+
+// 两个 key 的最长公共前缀长度
+static size_t common_prefix(const char *a, size_t alen, const char *b, size_t blen) {
+    size_t n = alen < blen ? alen : blen;
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) i++;
+    return i;
+}
+
+// 比较 key 与节点第 index 个 key
+static int node_compare_key(BTreeNode *node, int index, const char *key, size_t klen) {
+    size_t plen = node->prefix_len;
+    int cmp = memcmp(key, node_prefix(node), klen < plen ? klen : plen);
+    if (cmp != 0) return cmp;
+    if (klen < plen) return -1;
+    
+    size_t slen;
+    const char *suffix = node_get_suffix(node, index, &slen);
+    return compare_key(key + plen, klen - plen, suffix, slen);
 }
 
-// 在节点中查找 key 的位置（返回应该插入的位置）
-static int find_key_position(BTreeNode *node, const char *key) {
+// 在节点中查找 key 的位置（返回应该插入的位置，found 表示是否精确命中）
+// 先与公共前缀比较一次：不以前缀开头的 key 落在节点两端，其余 key 的二分探测只比较后缀
+static int find_key_position(BTreeNode *node, const char *key, size_t klen, bool *found) {
     int left = 0, right = node->key_count;
     
+    *found = false;
+    size_t plen = node->prefix_len;
+    int cmp = memcmp(key, node_prefix(node), klen < plen ? klen : plen);
+    if (cmp < 0 || (cmp == 0 && klen < plen)) return 0;
+    if (cmp > 0) return node->key_count;
+    key += plen;
+    klen -= plen;
+    
     while (left < right) {
         int mid = (left + right) / 2;
-        char *node_key;
-        if (node->is_leaf) {
-            node_key = leaf_get_key(node, mid);
-        } else {
-            node_key = internal_get_key(node, mid);
-        }
+        size_t slen;
+        const char *suffix = node_get_suffix(node, mid, &slen);
         
-        int cmp = strcmp(key, node_key);
+        cmp = compare_key(key, klen, suffix, slen);
         if (cmp < 0) {
             right = mid;
         } else if (cmp > 0) {
             left = mid + 1;
         } else {
+            *found = true;
             return mid;  // 找到
         }
     }
@@ -104,764 +214,2180 @@ static int find_key_position(BTreeNode *node, const char *key) {
     return left;  // 返回插入位置
 }
 
-// 创建新节点
-static uint32_t create_node(PageManager *pm, bool is_leaf) {
-    uint32_t page_id = page_alloc(pm);
-    BTreeNode *node = get_node(pm, page_id);
-    memset(node, 0, sizeof(BTreeNode));
-    node->type = is_leaf ? PAGE_TYPE_LEAF : PAGE_TYPE_INTERNAL;
-    node->is_leaf = is_leaf;
-    node->parent = 0;
-    node->next = 0;
-    node->key_count = 0;
-    page_mark_dirty(pm, page_id);
-    return page_id;
+// 内部节点：key >= key[pos] 时去右子树（pos+1），否则去左子树（pos）
+static int find_child_index(BTreeNode *node, const char *key, size_t klen) {
+    bool found;
+    int pos = find_key_position(node, key, klen, &found);
+    return found ? pos + 1 : pos;
 }
 
-// 分裂叶子节点
-static void split_leaf(PageManager *pm, uint32_t page_id, uint32_t *new_page_id) {
-    BTreeNode *old_node = get_node(pm, page_id);
-    uint32_t new_id = create_node(pm, true);
-    BTreeNode *new_node = get_node(pm, new_id);
-    
-    int mid = old_node->key_count / 2;
-    new_node->key_count = old_node->key_count - mid;
-    old_node->key_count = mid;
-    
-    // 移动数据
-    char *old_data = (char*)(old_node + 1);
-    char *new_data = (char*)(new_node + 1);
-    
-    // 计算需要移动的数据大小
-    size_t move_size = 0;
-    for (int i = mid; i < old_node->key_count + new_node->key_count; i++) {
-        char *key = leaf_get_key(old_node, i);
-        move_size += strlen(key) + 1;
-        char *val = leaf_get_value(old_node, i);
-        uint16_t val_len;
-        memcpy(&val_len, val, sizeof(uint16_t));
-        move_size += sizeof(uint16_t) + val_len;
-    }
-    
-    // 找到 mid 位置的数据起始点
-    size_t skip_size = 0;
-    for (int i = 0; i < mid; i++) {
-        char *key = leaf_get_key(old_node, i);
-        skip_size += strlen(key) + 1;
-        char *val = leaf_get_value(old_node, i);
-        uint16_t val_len;
-        memcpy(&val_len, val, sizeof(uint16_t));
-        skip_size += sizeof(uint16_t) + val_len;
-    }
-    
-    memcpy(new_data, old_data + skip_size, move_size);
-    memset(old_data + skip_size, 0, move_size);
-    
-    // 更新链表
-    new_node->next = old_node->next;
-    old_node->next = new_id;
-    new_node->parent = old_node->parent;
-    
-    page_mark_dirty(pm, page_id);
-    page_mark_dirty(pm, new_id);
-    *new_page_id = new_id;
+// slot 数组与 cell 区之间的连续空闲字节数
+static size_t node_contiguous_free(BTreeNode *node) {
+    return node->cell_start - (sizeof(BTreeNode) + node->key_count * sizeof(uint16_t));
 }
 
-// 分裂内部节点
-static void split_internal(PageManager *pm, uint32_t page_id, uint32_t *new_page_id, char *promote_key) {
-    BTreeNode *old_node = get_node(pm, page_id);
-    uint32_t new_id = create_node(pm, false);
-    BTreeNode *new_node = get_node(pm, new_id);
-    
-    int mid = old_node->key_count / 2;
-    
-    // 获取提升的 key（mid 位置的 key 会被提升）
-    char *mid_key = internal_get_key(old_node, mid);
-    strcpy(promote_key, mid_key);
-    
-    // 新节点包含 mid+1 之后的所有 key 和 child
-    // 格式：child0, key0, child1, key1, ...
-    // 分裂后：旧节点保留 child0...child_mid, key0...key_mid-1
-    //         新节点包含 child_mid+1...child_n, key_mid+1...key_n-1
-    //         提升 key_mid
-    
-    // 计算需要移动的数据
-    char *old_data = (char*)(old_node + 1);
-    char *new_data = (char*)(new_node + 1);
-    
-    // 计算 mid+1 之后的数据大小
-    size_t move_size = 0;
-    // 第一个 child (mid+1)
-    move_size += sizeof(uint32_t);
-    // 后续的 key 和 child
-    for (int i = mid + 1; i < old_node->key_count; i++) {
-        char *key = internal_get_key(old_node, i);
-        move_size += strlen(key) + 1 + sizeof(uint32_t);
-    }
-    
-    // 计算需要跳过的数据大小（到 mid+1 之前）
-    size_t skip_size = 0;
-    // 跳过 child0 到 child_mid
-    for (int i = 0; i <= mid; i++) {
-        if (i > 0) {
-            char *key = internal_get_key(old_node, i - 1);
-            skip_size += strlen(key) + 1;
-        }
-        if (i <= mid) {
-            skip_size += sizeof(uint32_t);
-        }
-    }
-    // 跳过 key0 到 key_mid-1
-    for (int i = 0; i < mid; i++) {
-        char *key = internal_get_key(old_node, i);
-        skip_size += strlen(key) + 1;
-    }
-    
-    // 移动数据
-    memcpy(new_data, old_data + skip_size, move_size);
-    memset(old_data + skip_size, 0, move_size);
-    
-    // 更新 key_count
-    new_node->key_count = old_node->key_count - mid - 1;
-    old_node->key_count = mid;
-    
-    // 更新父节点指针
-    new_node->parent = old_node->parent;
-    // 更新新节点所有子节点的父指针
-    for (int i = 0; i <= new_node->key_count; i++) {
-        uint32_t *child = internal_get_child(new_node, i);
-        if (child && *child != 0) {
-            BTreeNode *child_node = get_node(pm, *child);
-            if (child_node) {
-                child_node->parent = new_id;
-                page_mark_dirty(pm, *child);
-            }
-        }
-    }
-    
-    page_mark_dirty(pm, page_id);
-    page_mark_dirty(pm, new_id);
-    *new_page_id = new_id;
+// 节点的总空闲字节数（连续空闲区 + 碎片）
+static size_t node_free_space(BTreeNode *node) {
+    return node_contiguous_free(node) + node->frag_bytes;
 }
 
-// 插入到叶子节点
-static int insert_into_leaf(PageManager *pm, uint32_t page_id, const char *key, const char *value) {
-    BTreeNode *node = get_node(pm, page_id);
-    int pos = find_key_position(node, key);
-    
-    // 检查 key 是否已存在
-    if (pos < node->key_count) {
-        char *existing_key = leaf_get_key(node, pos);
-        if (strcmp(key, existing_key) == 0) {
-            // 更新现有值
-            char *val_ptr = leaf_get_value(node, pos);
-            uint16_t val_len = strlen(value);
-            if (val_len > MAX_VAL_SIZE) val_len = MAX_VAL_SIZE;
-            memcpy(val_ptr, &val_len, sizeof(uint16_t));
-            memcpy(val_ptr + sizeof(uint16_t), value, val_len);
-            page_mark_dirty(pm, page_id);
-            return 0;
-        }
-    }
-    
-    // 计算需要移动的数据大小
-    size_t key_size = strlen(key) + 1;
-    uint16_t val_len = strlen(value);
-    if (val_len > MAX_VAL_SIZE) val_len = MAX_VAL_SIZE;
-    size_t val_size = sizeof(uint16_t) + val_len;
-    size_t total_size = key_size + val_size;
-    
-    // 检查空间是否足够
-    size_t used = 0;
-    for (int i = 0; i < node->key_count; i++) {
-        char *k = leaf_get_key(node, i);
-        used += strlen(k) + 1;
-        char *v = leaf_get_value(node, i);
-        uint16_t vlen;
-        memcpy(&vlen, v, sizeof(uint16_t));
-        used += sizeof(uint16_t) + vlen;
-    }
-    
-    if (used + total_size > PAGE_SIZE - sizeof(BTreeNode)) {
-        return -1;  // 空间不足，需要分裂
-    }
-    
-    // 移动现有数据
-    char *data_start = (char*)(node + 1);
-    size_t move_offset = 0;
-    for (int i = 0; i < pos; i++) {
-        char *k = leaf_get_key(node, i);
-        move_offset += strlen(k) + 1;
-        char *v = leaf_get_value(node, i);
-        uint16_t vlen;
-        memcpy(&vlen, v, sizeof(uint16_t));
-        move_offset += sizeof(uint16_t) + vlen;
-    }
-    
-    memmove(data_start + move_offset + total_size, 
-            data_start + move_offset, 
-            used - move_offset);
-    
-    // 插入新数据
-    memcpy(data_start + move_offset, key, key_size);
-    memcpy(data_start + move_offset + key_size, &val_len, sizeof(uint16_t));
-    memcpy(data_start + move_offset + key_size + sizeof(uint16_t), value, val_len);
-    
-    node->key_count++;
-    page_mark_dirty(pm, page_id);
-    return 0;
+// 节点已使用的字节数（slot + cell，不含碎片）
+static size_t node_used_space(BTreeNode *node) {
+    return NODE_CAPACITY - node_free_space(node);
 }
 
-// 插入到内部节点（格式：child0, key0, child1, key1, ..., childN）
-static int insert_into_internal(PageManager *pm, uint32_t page_id, const char *key, uint32_t right_child_id) {
-    BTreeNode *node = get_node(pm, page_id);
-    int pos = find_key_position(node, key);
-    
-    // 计算需要移动的数据大小
-    size_t key_size = strlen(key) + 1;
-    size_t total_size = key_size + sizeof(uint32_t);  // key + right child
+// 整理 cell 区，消除删除留下的碎片
+static void node_compact(BTreeNode *node) {
+    uint8_t buf[PAGE_SIZE];
+    uint16_t *slots = node_slots(node);
+    size_t top = PAGE_SIZE - node->prefix_len;
+    size_t end = top;
     
-    // 检查空间是否足够
-    size_t used = sizeof(uint32_t);  // 第一个 child
     for (int i = 0; i < node->key_count; i++) {
-        char *k = internal_get_key(node, i);
-        used += strlen(k) + 1 + sizeof(uint32_t);
-    }
-    
-    if (used + total_size > PAGE_SIZE - sizeof(BTreeNode)) {
-        return -1;  // 空间不足，需要分裂
-    }
-    
-    // 计算插入位置
-    char *data_start = (char*)(node + 1);
-    size_t insert_offset = sizeof(uint32_t);  // 跳过第一个 child
-    
-    // 跳过前面的 key 和 child
-    for (int i = 0; i < pos; i++) {
-        char *k = internal_get_key(node, i);
-        insert_offset += strlen(k) + 1 + sizeof(uint32_t);
+        uint8_t *cell = node_cell(node, i);
+        size_t size = cell_size(node, cell);
+        end -= size;
+        memcpy(buf + end, cell, size);
+        slots[i] = (uint16_t)end;
     }
     
-    // 移动现有数据（从插入位置开始的所有数据）
-    size_t move_size = used - insert_offset;
-    if (move_size > 0) {
-        memmove(data_start + insert_offset + total_size, 
-                data_start + insert_offset, 
-                move_size);
+    memcpy((uint8_t*)node + end, buf + end, top - end);
+    node->cell_start = (uint16_t)end;
+    node->frag_bytes = 0;
+}
+
+// 在 pos 处为新 cell 预留 size 字节，返回 cell 地址；空间不足时返回 NULL
+// 插入只需移动一次 slot 数组
+static uint8_t* node_reserve_cell(BTreeNode *node, int pos, size_t size) {
+    if (node_free_space(node) < size + sizeof(uint16_t)) {
+        return NULL;  // 空间不足，需要分裂
     }
-    
-    // 插入新数据：先插入 key，再插入 right child
-    memcpy(data_start + insert_offset, key, key_size);
-    memcpy(data_start + insert_offset + key_size, &right_child_id, sizeof(uint32_t));
-    
-    // 更新被插入子节点的父指针
-    BTreeNode *right_child = get_node(pm, right_child_id);
-    if (right_child) {
-        right_child->parent = page_id;
-        page_mark_dirty(pm, right_child_id);
+    if (node_contiguous_free(node) < size + sizeof(uint16_t)) {
+        node_compact(node);
     }
     
+    uint16_t *slots = node_slots(node);
+    memmove(&slots[pos + 1], &slots[pos], (node->key_count - pos) * sizeof(uint16_t));
+    node->cell_start -= size;
+    slots[pos] = node->cell_start;
     node->key_count++;
-    page_mark_dirty(pm, page_id);
-    return 0;
+    return (uint8_t*)node + node->cell_start;
 }
 
-// 初始化 B+ 树
-int btree_init(BTree *tree, PageManager *pm) {
-    tree->pm = pm;
-    
-    // 从文件头读取根节点
-    FileHeader *header = (FileHeader*)page_get(pm, 0);
-    if (!header) return -1;
+// 删除 pos 处的 cell：紧邻空闲区的 cell 直接归还，否则记为碎片
+static void node_remove_cell(BTreeNode *node, int pos) {
+    uint16_t *slots = node_slots(node);
+    size_t size = cell_size(node, node_cell(node, pos));
     
-    if (header->root_page == 0 || pm->page_count <= 1) {
-        // 创建新的根节点
-        tree->root_page = create_node(pm, true);  // 创建根叶子节点
-        header->root_page = tree->root_page;
-        page_mark_dirty(pm, 0);
+    if (slots[pos] == node->cell_start) {
+        node->cell_start += size;
     } else {
-        // 从文件头读取根节点
-        tree->root_page = header->root_page;
-        BTreeNode *root = get_node(pm, tree->root_page);
-        if (!root || root->type == PAGE_TYPE_FREE) {
-            tree->root_page = create_node(pm, true);
-            header->root_page = tree->root_page;
-            page_mark_dirty(pm, 0);
-        }
+        node->frag_bytes += size;
     }
     
-    return 0;
+    memmove(&slots[pos], &slots[pos + 1], (node->key_count - pos - 1) * sizeof(uint16_t));
+    node->key_count--;
 }
 
-// 插入键值对
-int btree_insert(BTree *tree, const char *key, const char *value) {
-    if (!tree || !key || !value) return -1;
-    
-    // 查找插入位置
-    uint32_t leaf_page = tree->root_page;
-    BTreeNode *node = get_node(tree->pm, leaf_page);
-    
-    // 如果不是叶子节点，向下查找
-    while (!node->is_leaf) {
-        int pos = find_key_position(node, key);
-        // 内部节点：如果 key >= node_key[pos]，则去右子树（pos+1）
-        if (pos < node->key_count) {
-            char *node_key = internal_get_key(node, pos);
-            if (strcmp(key, node_key) >= 0) {
-                pos++;  // 去右子树
-            }
-        }
-        uint32_t *child = internal_get_child(node, pos);
-        leaf_page = *child;
-        node = get_node(tree->pm, leaf_page);
-        if (!node) return -1;
-    }
-    
-    // 尝试插入
-    if (insert_into_leaf(tree->pm, leaf_page, key, value) == 0) {
+// 将 src 的第 index 个 cell 追加到 dst 末尾（该 key 必须以 dst 的前缀开头）
+static int node_append_cell(BTreeNode *dst, BTreeNode *src, int index) {
+    uint8_t *cell = node_cell(src, index);
+    size_t size = cell_size(src, cell);
+    size_t plen = dst->prefix_len;
+    
+    // 前缀相同时 cell 原样复制
+    if (src->prefix_len == plen && memcmp(node_prefix(src), node_prefix(dst), plen) == 0) {
+        uint8_t *new_cell = node_reserve_cell(dst, dst->key_count, size);
+        if (!new_cell) return -1;
+        memcpy(new_cell, cell, size);
         return 0;
     }
     
-    // 需要分裂
-    uint32_t new_page_id;
-    split_leaf(tree->pm, leaf_page, &new_page_id);
-    
-    // 确定插入到哪个节点
-    char *first_key_new = leaf_get_key(get_node(tree->pm, new_page_id), 0);
-    if (strcmp(key, first_key_new) < 0) {
-        insert_into_leaf(tree->pm, leaf_page, key, value);
-    } else {
-        insert_into_leaf(tree->pm, new_page_id, key, value);
-    }
-    
-    // 获取提升的 key（新节点的第一个 key）
-    char *promote_key = leaf_get_key(get_node(tree->pm, new_page_id), 0);
-    char key_buf[MAX_KEY_SIZE + 1];
-    strcpy(key_buf, promote_key);
-    
-    // 如果根节点分裂，创建新根
-    if (leaf_page == tree->root_page) {
-        uint32_t new_root = create_node(tree->pm, false);
-        BTreeNode *root_node = get_node(tree->pm, new_root);
-        
-        // 内部节点格式：child0, key0, child1
-        // 设置第一个 child
-        uint32_t *first_child = (uint32_t*)((char*)(root_node + 1));
-        *first_child = leaf_page;
-        
-        // 插入 key 和第二个 child
-        char *data = (char*)(root_node + 1) + sizeof(uint32_t);
-        strcpy(data, key_buf);
-        uint32_t *second_child = (uint32_t*)(data + strlen(key_buf) + 1);
-        *second_child = new_page_id;
-        
-        root_node->key_count = 1;
-        
-        // 更新父节点
-        BTreeNode *old_root = get_node(tree->pm, leaf_page);
-        old_root->parent = new_root;
-        BTreeNode *new_leaf = get_node(tree->pm, new_page_id);
-        new_leaf->parent = new_root;
-        
-        tree->root_page = new_root;
-        // 更新文件头
-        FileHeader *header = (FileHeader*)page_get(tree->pm, 0);
-        if (header) {
-            header->root_page = new_root;
-            page_mark_dirty(tree->pm, 0);
-        }
-        page_mark_dirty(tree->pm, new_root);
-        page_mark_dirty(tree->pm, leaf_page);
-        page_mark_dirty(tree->pm, new_page_id);
+    // 否则按 dst 的前缀重新切分 key，cell 中 key 之后的部分（value 或其引用）原样复制
+    char key[MAX_KEY_SIZE];
+    size_t klen = node_copy_key(src, index, key);
+    size_t header = src->is_leaf ? LEAF_CELL_HEADER : INTERNAL_CELL_HEADER;
+    size_t rest = size - header - (klen - src->prefix_len);
+    uint8_t *new_cell = node_reserve_cell(dst, dst->key_count, header + klen - plen + rest);
+    if (!new_cell) return -1;
+    
+    if (src->is_leaf) {
+        put_u16(new_cell, (uint16_t)(klen - plen));
+        put_u16(new_cell + sizeof(uint16_t), get_u16(cell + sizeof(uint16_t)));
     } else {
-        // 向上插入分裂的 key（递归处理）
-        uint32_t parent_page = get_node(tree->pm, leaf_page)->parent;
-        if (insert_into_internal(tree->pm, parent_page, key_buf, new_page_id) != 0) {
-            // 父节点也需要分裂
-            uint32_t new_parent_id;
-            char parent_promote_key[MAX_KEY_SIZE + 1];
-            split_internal(tree->pm, parent_page, &new_parent_id, parent_promote_key);
-            
-            // 确定插入到哪个父节点
-            BTreeNode *old_parent = get_node(tree->pm, parent_page);
-            BTreeNode *new_parent = get_node(tree->pm, new_parent_id);
-            
-            // 比较 key 和提升的 key
-            if (strcmp(key_buf, parent_promote_key) < 0) {
-                // 插入到旧父节点
-                insert_into_internal(tree->pm, parent_page, key_buf, new_page_id);
-            } else {
-                // 插入到新父节点
-                insert_into_internal(tree->pm, new_parent_id, key_buf, new_page_id);
-            }
-            
-            // 递归向上传播
-            if (parent_page == tree->root_page) {
-                // 根节点分裂，创建新根
-                uint32_t new_root = create_node(tree->pm, false);
-                BTreeNode *root_node = get_node(tree->pm, new_root);
-                
-                uint32_t *first_child = (uint32_t*)((char*)(root_node + 1));
-                *first_child = parent_page;
-                
-                char *data = (char*)(root_node + 1) + sizeof(uint32_t);
-                strcpy(data, parent_promote_key);
-                uint32_t *second_child = (uint32_t*)(data + strlen(parent_promote_key) + 1);
-                *second_child = new_parent_id;
-                
-                root_node->key_count = 1;
-                
-                // 更新父节点
-                old_parent->parent = new_root;
-                new_parent->parent = new_root;
-                
-                tree->root_page = new_root;
-                FileHeader *header = (FileHeader*)page_get(tree->pm, 0);
-                if (header) {
-                    header->root_page = new_root;
-                    page_mark_dirty(tree->pm, 0);
-                }
-                page_mark_dirty(tree->pm, new_root);
-            } else {
-                // 继续向上传播
-                uint32_t grandparent = old_parent->parent;
-                if (insert_into_internal(tree->pm, grandparent, parent_promote_key, new_parent_id) != 0) {
-                    // 继续递归处理（简化：这里可以继续递归，但为了代码简洁，我们暂时只处理两层）
-                    // 实际应用中应该递归处理所有层级
-                }
-            }
-        }
-        
-        page_mark_dirty(tree->pm, leaf_page);
-        page_mark_dirty(tree->pm, new_page_id);
+        put_u32(new_cell, get_u32(cell));
+        put_u16(new_cell + sizeof(uint32_t), (uint16_t)(klen - plen));
     }
-    
+    memcpy(new_cell + header, key + plen, klen - plen);
+    memcpy(new_cell + header + klen - plen, cell + size - rest, rest);
     return 0;
 }
 
-// 查找值
-int btree_get(BTree *tree, const char *key, char *value, size_t value_size) {
-    if (!tree || !key || !value) return -1;
-    
-    uint32_t page_id = tree->root_page;
-    BTreeNode *node = get_node(tree->pm, page_id);
-    
-    // 向下查找
-    while (!node->is_leaf) {
-        int pos = find_key_position(node, key);
-        // 内部节点：如果 key >= node_key[pos]，则去右子树（pos+1）
-        // 否则去左子树（pos）
-        if (pos < node->key_count) {
-            char *node_key = internal_get_key(node, pos);
-            if (strcmp(key, node_key) >= 0) {
-                pos++;  // 去右子树
-            }
-        }
-        // pos 现在指向要访问的子节点索引
-        uint32_t *child = internal_get_child(node, pos);
-        page_id = *child;
-        node = get_node(tree->pm, page_id);
-        if (!node) return -1;
-    }
-    
-    // 在叶子节点中查找
-    int pos = find_key_position(node, key);
-    if (pos < node->key_count) {
-        char *node_key = leaf_get_key(node, pos);
-        if (strcmp(key, node_key) == 0) {
-            char *val_ptr = leaf_get_value(node, pos);
-            uint16_t val_len;
-            memcpy(&val_len, val_ptr, sizeof(uint16_t));
-            size_t copy_len = val_len < value_size - 1 ? val_len : value_size - 1;
-            memcpy(value, val_ptr + sizeof(uint16_t), copy_len);
-            value[copy_len] = '\0';
-            return 0;
-        }
-    }
-    
-    return -1;  // 未找到
+// 空节点使用与 src 相同的前缀（分裂时 cell 可以原样复制，占用不变）
+static void node_copy_prefix(BTreeNode *dst, BTreeNode *src) {
+    dst->prefix_len = src->prefix_len;
+    dst->cell_start = (uint16_t)(PAGE_SIZE - src->prefix_len);
+    memcpy((uint8_t*)dst + dst->cell_start, node_prefix(src), src->prefix_len);
 }
 
-// 从叶子节点删除键值对
-static int delete_from_leaf(PageManager *pm, uint32_t page_id, int pos) {
-    BTreeNode *node = get_node(pm, page_id);
-    if (!node || pos >= node->key_count) {
-        return -1;
-    }
-    
-    // 计算要删除的数据大小
-    char *key_to_delete = leaf_get_key(node, pos);
-    size_t key_size = strlen(key_to_delete) + 1;
-    char *val_to_delete = leaf_get_value(node, pos);
-    uint16_t val_len;
-    memcpy(&val_len, val_to_delete, sizeof(uint16_t));
-    size_t val_size = sizeof(uint16_t) + val_len;
-    size_t total_size = key_size + val_size;
-    
-    // 计算需要移动的数据大小
-    size_t move_size = 0;
-    for (int i = pos + 1; i < node->key_count; i++) {
-        char *k = leaf_get_key(node, i);
-        move_size += strlen(k) + 1;
-        char *v = leaf_get_value(node, i);
-        uint16_t vlen;
-        memcpy(&vlen, v, sizeof(uint16_t));
-        move_size += sizeof(uint16_t) + vlen;
-    }
-    
-    // 移动数据覆盖要删除的数据
-    if (move_size > 0) {
-        char *data_start = (char*)(node + 1);
-        size_t delete_offset = 0;
-        for (int i = 0; i < pos; i++) {
-            char *k = leaf_get_key(node, i);
-            delete_offset += strlen(k) + 1;
-            char *v = leaf_get_value(node, i);
-            uint16_t vlen;
-            memcpy(&vlen, v, sizeof(uint16_t));
-            delete_offset += sizeof(uint16_t) + vlen;
-        }
-        
-        char *src = data_start + delete_offset + total_size;
-        char *dst = data_start + delete_offset;
-        memmove(dst, src, move_size);
-        
-        // 清零末尾数据
-        memset(dst + move_size, 0, total_size);
-    } else {
-        // 直接清零
-        char *data_start = (char*)(node + 1);
-        size_t delete_offset = 0;
-        for (int i = 0; i < pos; i++) {
-            char *k = leaf_get_key(node, i);
-            delete_offset += strlen(k) + 1;
-            char *v = leaf_get_value(node, i);
-            uint16_t vlen;
-            memcpy(&vlen, v, sizeof(uint16_t));
-            delete_offset += sizeof(uint16_t) + vlen;
-        }
-        memset(data_start + delete_offset, 0, total_size);
+// 以 prefix 的前 plen 字节作为新的公共前缀重写节点（节点中所有 key 都必须以它开头，调用者保证放得下）
+static void node_set_prefix(BTreeNode *node, const char *prefix, size_t plen) {
+    uint8_t buf[PAGE_SIZE];
+    char saved[MAX_KEY_SIZE];
+    BTreeNode *old = (BTreeNode*)buf;
+    
+    memcpy(saved, prefix, plen);  // prefix 可能指向节点内部
+    memcpy(buf, node, PAGE_SIZE);
+    node->key_count = 0;
+    node->frag_bytes = 0;
+    node->prefix_len = (uint16_t)plen;
+    node->cell_start = (uint16_t)(PAGE_SIZE - plen);
+    memcpy((uint8_t*)node + node->cell_start, saved, plen);
+    for (int i = 0; i < old->key_count; i++) {
+        node_append_cell(node, old, i);
     }
-    
-    node->key_count--;
-    page_mark_dirty(pm, page_id);
-    return 0;
 }
 
-// 获取节点的最小 key 数量（用于判断下溢）
-#define MIN_KEYS_LEAF 1      // 叶子节点最少 1 个 key
-#define MIN_KEYS_INTERNAL 1  // 内部节点最少 1 个 key
+// 前缀改为 plen 字节后节点占用的字节数：前缀区变化一次，每个 cell 的后缀反向变化一次
+static size_t node_used_with_prefix(BTreeNode *node, size_t plen) {
+    long delta = ((long)node->prefix_len - (long)plen) * ((long)node->key_count - 1);
+    return (size_t)((long)node_used_space(node) + delta);
+}
 
-// 获取兄弟节点（左兄弟或右兄弟）
-static uint32_t get_sibling(PageManager *pm, uint32_t page_id, bool *is_left) {
-    BTreeNode *node = get_node(pm, page_id);
-    if (!node || node->parent == 0) return 0;
-    
-    BTreeNode *parent = get_node(pm, node->parent);
-    if (!parent) return 0;
-    
-    // 找到当前节点在父节点中的位置
-    uint32_t *first_child = internal_get_child(parent, 0);
-    if (*first_child == page_id) {
-        // 是第一个子节点，只有右兄弟
-        *is_left = false;
-        if (parent->key_count > 0) {
-            return *internal_get_child(parent, 1);
-        }
+// 为写入 key 准备节点：key 不以当前前缀开头，或节点按当前前缀放不下时，
+// 把前缀调整为所有 key（含新 key）的最长公共前缀——可能缩短也可能加长。
+// fixed 为 cell 中 key 以外的字节数；写入后（含 slot）占用不超过 limit 返回 0，否则返回 -1 且节点不变
+static int node_prepare_insert(BTreeNode *node, const char *key, size_t klen, size_t fixed, size_t limit) {
+    size_t plen = node->prefix_len;
+    if (node_has_prefix(node, key, klen) &&
+        node_used_space(node) + fixed + klen - plen + sizeof(uint16_t) <= limit) {
         return 0;
     }
     
-    // 查找当前节点位置
-    for (int i = 1; i <= parent->key_count; i++) {
-        uint32_t *child = internal_get_child(parent, i);
-        if (*child == page_id) {
-            // 找到，有左兄弟
-            *is_left = true;
-            return *internal_get_child(parent, i - 1);
-        }
+    // key 有序，节点内所有 key 的公共前缀就是首尾两个 key 的公共前缀
+    plen = klen;
+    if (node->key_count > 0) {
+        char first[MAX_KEY_SIZE], last[MAX_KEY_SIZE];
+        size_t first_len = node_copy_key(node, 0, first);
+        size_t last_len = node_copy_key(node, node->key_count - 1, last);
+        size_t n;
+        plen = common_prefix(first, first_len, last, last_len);
+        if ((n = common_prefix(first, first_len, key, klen)) < plen) plen = n;
+        if ((n = common_prefix(last, last_len, key, klen)) < plen) plen = n;
     }
     
+    if (node_used_with_prefix(node, plen) + fixed + klen - plen + sizeof(uint16_t) > limit) {
+        return -1;
+    }
+    if (plen != node->prefix_len || !node_has_prefix(node, key, klen)) {
+        node_set_prefix(node, key, plen);
+    }
     return 0;
 }
 
-// 合并两个叶子节点
-static void merge_leaf_nodes(PageManager *pm, uint32_t left_id, uint32_t right_id) {
-    BTreeNode *left = get_node(pm, left_id);
-    BTreeNode *right = get_node(pm, right_id);
-    
-    if (!left || !right) return;
-    
-    // 计算左节点数据大小
-    size_t left_size = 0;
-    for (int i = 0; i < left->key_count; i++) {
-        char *k = leaf_get_key(left, i);
-        left_size += strlen(k) + 1;
-        char *v = leaf_get_value(left, i);
-        uint16_t vlen;
-        memcpy(&vlen, v, sizeof(uint16_t));
-        left_size += sizeof(uint16_t) + vlen;
+// 在 pos 处写入内部 cell（调用者已通过 node_prepare_insert 确认放得下）
+static void internal_put_cell(BTreeNode *node, int pos, const char *key, size_t klen, uint32_t child) {
+    size_t plen = node->prefix_len;
+    uint8_t *cell = node_reserve_cell(node, pos, INTERNAL_CELL_HEADER + klen - plen);
+    put_u32(cell, child);
+    put_u16(cell + sizeof(uint32_t), (uint16_t)(klen - plen));
+    memcpy(cell + INTERNAL_CELL_HEADER, key + plen, klen - plen);
+}
+
+// 能区分 left 最后一个 key 与 right 第一个 key 的最短 key（后缀截断），写入 buf 并返回长度：
+// left 的 key < 结果 <= right 的 key，作为分隔 key 时两侧的查找路由不变
+static size_t separator_key(const char *left, size_t left_len, const char *right, size_t right_len, char *buf) {
+    size_t len = common_prefix(left, left_len, right, right_len) + 1;
+    if (len > right_len) len = right_len;  // right > left 时不会发生
+    memmove(buf, right, len);
+    return len;
+}
+
+// 创建新节点，优先使用 hint 附近的空闲页面（0 表示没有提示）
+static uint32_t create_node(PageManager *pm, bool is_leaf, uint32_t hint) {
+    uint32_t page_id = page_alloc_near(pm, hint);
+    if (page_id == 0) return 0;  // 分配失败
+    BTreeNode *node = get_node(pm, page_id);
+    if (!node) return 0;
+    memset(node, 0, sizeof(BTreeNode));
+    node->type = is_leaf ? PAGE_TYPE_LEAF : PAGE_TYPE_INTERNAL;
+    node->is_leaf = is_leaf;
+    node->cell_start = PAGE_SIZE;
+    node->key_count = 0;
+    page_mark_dirty(pm, page_id);
+    return page_id;
+}
+
+// ---- 上层内部节点缓存 ----
+// 每个缓存节点把分隔 key 去掉公共前缀后的前 8 字节按大端存成 uint64_t 数组，二分查找先比较整数，
+// 只有前 8 字节相同时才比较缓存中保存的完整后缀；子节点已缓存时直接通过指针下降，不访问页面。
+struct BTreeCacheNode {
+    uint64_t *keys;                  // 分隔 key 后缀的前 8 字节（不足补 0），按缓存行对齐
+    BTreeCacheNode **child_nodes;    // 已缓存的子节点（key_count + 1 个，未缓存为 NULL）
+    uint32_t *children;              // 子节点页面 ID（key_count + 1 个）
+    uint16_t *offsets;               // 后缀在 pool 中的偏移
+    uint8_t *lens;                   // 后缀长度
+    char *pool;                      // 全部后缀
+    void *block;                     // 以上数组共用的内存块
+    size_t block_size;
+    uint32_t page_id;
+    int level;                       // 所在层（根为 0）
+    int key_count;
+    size_t prefix_len;
+    char prefix[MAX_KEY_SIZE];       // 全部分隔 key 的公共前缀
+};
+
+#define CACHE_LINE 64
+
+// key 的前 8 字节按大端拼成整数，整数大小关系与按字节比较一致
+static inline uint64_t key_prefix64(const char *key, size_t klen) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < 8; i++) {
+        v = (v << 8) | (i < klen ? (uint8_t)key[i] : 0);
     }
-    
-    // 计算右节点数据大小
-    size_t right_size = 0;
-    for (int i = 0; i < right->key_count; i++) {
-        char *k = leaf_get_key(right, i);
-        right_size += strlen(k) + 1;
-        char *v = leaf_get_value(right, i);
-        uint16_t vlen;
-        memcpy(&vlen, v, sizeof(uint16_t));
-        right_size += sizeof(uint16_t) + vlen;
+    return v;
+}
+
+// 哈希表中 page_id 所在（或应插入）的槽位
+static size_t cache_slot(BTreeCache *cache, uint32_t page_id) {
+    size_t mask = cache->slot_count - 1;
+    size_t i = (page_id * 2654435761u) & mask;
+    while (cache->slots[i] && cache->slots[i]->page_id != page_id) {
+        i = (i + 1) & mask;
     }
-    
-    // 将右节点的数据复制到左节点
-    char *left_data = (char*)(left + 1);
-    char *right_data = (char*)(right + 1);
-    memcpy(left_data + left_size, right_data, right_size);
-    
-    left->key_count += right->key_count;
-    left->next = right->next;
-    
-    // 释放右节点
-    page_free(pm, right_id);
-    page_mark_dirty(pm, left_id);
+    return i;
 }
 
-// 从内部节点删除 key
-static int delete_from_internal(PageManager *pm, uint32_t page_id, int key_pos) {
-    BTreeNode *node = get_node(pm, page_id);
-    if (!node || key_pos >= node->key_count) return -1;
-    
-    // 计算要删除的数据大小
-    char *key_to_delete = internal_get_key(node, key_pos);
-    size_t key_size = strlen(key_to_delete) + 1;
-    size_t total_size = key_size + sizeof(uint32_t);
+static BTreeCacheNode* cache_find(BTreeCache *cache, uint32_t page_id) {
+    if (!cache->slots) return NULL;
+    return cache->slots[cache_slot(cache, page_id)];
+}
+
+// 按页面内容重建缓存节点，子节点指针通过哈希表解析
+static int cache_fill(BTree *tree, BTreeCacheNode *c, BTreeNode *node) {
+    int n = node->key_count;
+    char first[MAX_KEY_SIZE], last[MAX_KEY_SIZE];
+    size_t first_len = 0, last_len = 0, pool_size = 0;
+    
+    c->prefix_len = 0;
+    if (n > 0) {
+        first_len = node_copy_key(node, 0, first);
+        last_len = node_copy_key(node, n - 1, last);
+        c->prefix_len = common_prefix(first, first_len, last, last_len);
+        memcpy(c->prefix, first, c->prefix_len);
+        pool_size = node_used_space(node);  // 后缀总长不超过节点占用
+    }
     
-    // 计算需要移动的数据大小
-    size_t move_size = 0;
-    for (int i = key_pos + 1; i < node->key_count; i++) {
-        char *k = internal_get_key(node, i);
-        move_size += strlen(k) + 1 + sizeof(uint32_t);
+    size_t keys_size = ((size_t)n * sizeof(uint64_t) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    size_t size = keys_size + (n + 1) * (sizeof(BTreeCacheNode*) + sizeof(uint32_t)) +
+                  n * (sizeof(uint16_t) + sizeof(uint8_t)) + pool_size;
+    if (size > c->block_size) {
+        void *block;
+        if (posix_memalign(&block, CACHE_LINE, size) != 0) return -1;
+        free(c->block);
+        c->block = block;
+        c->block_size = size;
     }
     
-    // 移动数据
-    char *data_start = (char*)(node + 1);
-    size_t delete_offset = sizeof(uint32_t);  // 跳过第一个 child
+    char *p = c->block;
+    c->keys = (uint64_t*)p;
+    p += keys_size;
+    c->child_nodes = (BTreeCacheNode**)p;
+    p += (n + 1) * sizeof(BTreeCacheNode*);
+    c->children = (uint32_t*)p;
+    p += (n + 1) * sizeof(uint32_t);
+    c->offsets = (uint16_t*)p;
+    p += n * sizeof(uint16_t);
+    c->lens = (uint8_t*)p;
+    p += n * sizeof(uint8_t);
+    c->pool = p;
     
-    for (int i = 0; i < key_pos; i++) {
-        char *k = internal_get_key(node, i);
-        delete_offset += strlen(k) + 1 + sizeof(uint32_t);
+    size_t used = 0;
+    for (int i = 0; i < n; i++) {
+        char key[MAX_KEY_SIZE];
+        size_t klen = node_copy_key(node, i, key) - c->prefix_len;
+        memcpy(c->pool + used, key + c->prefix_len, klen);
+        c->keys[i] = key_prefix64(key + c->prefix_len, klen);
+        c->offsets[i] = (uint16_t)used;
+        c->lens[i] = (uint8_t)klen;
+        used += klen;
     }
-    
-    if (move_size > 0) {
-        memmove(data_start + delete_offset, 
-                data_start + delete_offset + total_size, 
-                move_size);
+    for (int i = 0; i <= n; i++) {
+        c->children[i] = internal_get_child(node, i);
+        c->child_nodes[i] = cache_find(&tree->cache, c->children[i]);
     }
-    
-    // 清零末尾
-    memset(data_start + delete_offset + move_size, 0, total_size);
-    
-    node->key_count--;
-    page_mark_dirty(pm, page_id);
+    c->key_count = n;
     return 0;
 }
 
-// 处理叶子节点删除后的下溢
-static void handle_leaf_underflow(BTree *tree, uint32_t page_id) {
-    BTreeNode *node = get_node(tree->pm, page_id);
-    if (!node || node->key_count >= MIN_KEYS_LEAF) return;
-    
-    // 如果是根节点，允许少于最小 key 数
-    if (page_id == tree->root_page) return;
-    
-    bool is_left;
-    uint32_t sibling_id = get_sibling(tree->pm, page_id, &is_left);
-    if (sibling_id == 0) return;
-    
-    BTreeNode *sibling = get_node(tree->pm, sibling_id);
-    if (!sibling) return;
-    
-    // 如果兄弟节点有足够的 key，可以借用（简化：这里直接合并）
-    // 实际应该先尝试借用，借用失败才合并
-    if (is_left) {
-        merge_leaf_nodes(tree->pm, sibling_id, page_id);
-        // 从父节点删除对应的 key
-        BTreeNode *parent = get_node(tree->pm, node->parent);
-        if (parent) {
-            // 找到对应的 key 位置
-            for (int i = 0; i < parent->key_count; i++) {
-                uint32_t *child = internal_get_child(parent, i + 1);
-                if (*child == page_id) {
-                    delete_from_internal(tree->pm, node->parent, i);
-                    // 递归处理父节点
-                    if (parent->key_count < MIN_KEYS_INTERNAL && node->parent != tree->root_page) {
-                        // handle_internal_underflow(tree, node->parent);
-                    }
-                    break;
-                }
-            }
-        }
-    } else {
-        merge_leaf_nodes(tree->pm, page_id, sibling_id);
-        // 从父节点删除对应的 key
-        BTreeNode *parent = get_node(tree->pm, node->parent);
-        if (parent) {
-            for (int i = 0; i < parent->key_count; i++) {
-                uint32_t *child = internal_get_child(parent, i + 1);
-                if (*child == sibling_id) {
-                    delete_from_internal(tree->pm, node->parent, i);
-                    break;
-                }
-            }
+// 清空缓存
+static void cache_clear(BTreeCache *cache) {
+    for (size_t i = 0; i < cache->slot_count; i++) {
+        if (cache->slots[i]) {
+            free(cache->slots[i]->block);
+            free(cache->slots[i]);
         }
     }
+    free(cache->slots);
+    cache->slots = NULL;
+    cache->slot_count = 0;
+    cache->node_count = 0;
+    cache->root = NULL;
 }
 
-// 删除键值对
-int btree_delete(BTree *tree, const char *key) {
-    if (!tree || !key) return -1;
+// 缓存 page_id 对应的内部节点（已缓存时只刷新内容），失败或超出容量返回 NULL
+static BTreeCacheNode* cache_add(BTree *tree, uint32_t page_id, int level) {
+    BTreeCache *cache = &tree->cache;
+    BTreeNode *node = get_node(tree->pm, page_id);
+    if (!node || node->is_leaf || level >= BTREE_CACHE_LEVELS) return NULL;
+    
+    BTreeCacheNode *c = cache_find(cache, page_id);
+    if (!c) {
+        if (!cache->slots || cache->node_count >= BTREE_CACHE_NODES) return NULL;
+        c = calloc(1, sizeof(BTreeCacheNode));
+        if (!c) return NULL;
+        c->page_id = page_id;
+        c->level = level;
+        cache->slots[cache_slot(cache, page_id)] = c;
+        cache->node_count++;
+    }
+    if (cache_fill(tree, c, node) < 0) {
+        cache_clear(cache);  // 内存不足：放弃整个缓存，查找改走页面，下次重建时再恢复
+        return NULL;
+    }
+    return c;
+}
+
+// 从根开始按层重建缓存：先缓存下层，上层节点的子节点指针才能解析到它们
+static void cache_rebuild(BTree *tree) {
+    BTreeCache *cache = &tree->cache;
+    cache_clear(cache);
+    if (!cache->enabled) return;
+    
+    BTreeNode *root = get_node(tree->pm, tree->root_page);
+    if (!root || root->is_leaf) return;
+    cache->slot_count = BTREE_CACHE_NODES * 2;
+    cache->slots = calloc(cache->slot_count, sizeof(BTreeCacheNode*));
+    if (!cache->slots) {
+        cache->slot_count = 0;
+        return;
+    }
+    
+    // 广度优先收集各层的页面
+    uint32_t *pages = malloc(BTREE_CACHE_NODES * sizeof(uint32_t));
+    int level_start[BTREE_CACHE_LEVELS + 1];
+    size_t count = 0;
+    if (!pages) {
+        cache_clear(cache);
+        return;
+    }
+    pages[count++] = tree->root_page;
+    level_start[0] = 0;
+    size_t pins = page_pin_mark(tree->pm);  // 逐个节点释放钉住的页面，缓冲池不必容纳整个上层
+    int levels = 1;
+    for (; levels < BTREE_CACHE_LEVELS; levels++) {
+        size_t end = count;
+        level_start[levels] = (int)count;
+        for (size_t i = level_start[levels - 1]; i < end; i++) {
+            BTreeNode *node = get_node(tree->pm, pages[i]);
+            for (int j = 0; j <= node->key_count; j++) {
+                BTreeNode *child = get_node(tree->pm, internal_get_child(node, j));
+                if (!child || child->is_leaf || count >= BTREE_CACHE_NODES) break;
+                pages[count++] = internal_get_child(node, j);
+            }
+            page_unpin_to(tree->pm, pins);
+        }
+        if (count == end) break;
+    }
+    level_start[levels] = (int)count;
+    
+    for (int level = levels - 1; level >= 0; level--) {
+        for (int i = level_start[level]; i < level_start[level + 1]; i++) {
+            cache_add(tree, pages[i], level);
+            page_unpin_to(tree->pm, pins);
+        }
+    }
+    cache->root = cache_find(cache, tree->root_page);
+    free(pages);
+}
+
+// 内部节点被修改后刷新其缓存（未缓存的节点不处理）
+static void cache_update(BTree *tree, uint32_t page_id) {
+    BTreeCacheNode *c = cache_find(&tree->cache, page_id);
+    if (c) cache_add(tree, page_id, c->level);
+}
+
+// 已缓存的内部节点分裂后，把新的兄弟节点加入同一层
+static void cache_add_sibling(BTree *tree, uint32_t page_id, uint32_t sibling_id) {
+    BTreeCacheNode *c = cache_find(&tree->cache, page_id);
+    if (c) {
+        cache_add(tree, sibling_id, c->level);
+        cache_add(tree, page_id, c->level);
+    }
+}
+
+// 在缓存节点中选择子节点：返回第一个大于 key 的分隔 key 的位置（与 find_child_index 一致）
+static int cache_child_index(const BTreeCacheNode *c, const char *key, size_t klen) {
+    size_t plen = c->prefix_len;
+    int cmp = memcmp(key, c->prefix, klen < plen ? klen : plen);
+    if (cmp < 0 || (cmp == 0 && klen < plen)) return 0;
+    if (cmp > 0) return c->key_count;
+    key += plen;
+    klen -= plen;
+    
+    // 8 字节前缀小于 key 的分隔 key 都不大于 key；前缀相同的一段再比较完整 key
+    uint64_t prefix = key_prefix64(key, klen);
+    size_t n = c->key_count;
+    size_t left = prefix_lower_bound(c->keys, n, prefix);
+    size_t right = left;
+    if (left < n && c->keys[left] == prefix) {
+        right = prefix == UINT64_MAX ? n : left + prefix_lower_bound(c->keys + left, n - left, prefix + 1);
+    }
+    while (left < right) {
+        size_t mid = (left + right) / 2;
+        if (compare_key(c->pool + c->offsets[mid], c->lens[mid], key, klen) <= 0) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return (int)left;
+}
+
+// ---- 写时复制 ----
+
+// 页面是否可能被活跃快照看到：最新的快照开始之后才分配的页面只属于当前树
+static bool page_shared(BTree *tree, uint32_t page_id) {
+    if (!tree->snap_newest) return false;
+    uint32_t gen = page_id < tree->page_gen_cap ? tree->page_gen[page_id] : 0;
+    return gen <= tree->snap_newest->gen;
+}
+
+// 记录有活跃快照期间新分配页面的代数（记录失败时页面被视为共享，只会多复制一次）
+static void page_set_gen(BTree *tree, uint32_t page_id) {
+    if (!tree->snap_newest) return;
+    if (page_id >= tree->page_gen_cap) {
+        size_t cap = tree->page_gen_cap ? tree->page_gen_cap : 1024;
+        while (cap <= page_id) cap *= 2;
+        uint32_t *gen = realloc(tree->page_gen, cap * sizeof(uint32_t));
+        if (!gen) return;
+        memset(gen + tree->page_gen_cap, 0, (cap - tree->page_gen_cap) * sizeof(uint32_t));
+        tree->page_gen = gen;
+        tree->page_gen_cap = cap;
+    }
+    tree->page_gen[page_id] = tree->write_gen;
+}
+
+// 切换根节点。有检查点镜像时文件头必须一直指向镜像的根，新根由下一次检查点写入
+static void tree_set_root(BTree *tree, uint32_t root) {
+    tree->root_page = root;
+    if (tree->shadow) return;
+    FileHeader *header = (FileHeader*)page_get(tree->pm, 0);
+    if (header) {
+        header->root_page = root;  // 一次对齐的 4 字节写入
+        page_mark_dirty(tree->pm, 0);
+    }
+}
+
+// 为当前树创建新节点
+static uint32_t tree_create_node(BTree *tree, bool is_leaf, uint32_t hint) {
+    uint32_t page_id = create_node(tree->pm, is_leaf, hint);
+    if (page_id != 0) page_set_gen(tree, page_id);
+    return page_id;
+}
+
+// 确保待回收列表还能再记录 n 个页面（修改树之前调用，之后的 tree_free_page 不会失败）
+static int pending_reserve(BTree *tree, size_t n) {
+    if (tree->pending_count + n <= tree->pending_cap) return 0;
+    size_t cap = tree->pending_cap ? tree->pending_cap : 64;
+    while (cap < tree->pending_count + n) cap *= 2;
+    BTreePendingFree *pending = realloc(tree->pending, cap * sizeof(BTreePendingFree));
+    if (!pending) return -1;
+    tree->pending = pending;
+    tree->pending_cap = cap;
+    return 0;
+}
+
+// 释放不再属于当前树的页面：仍可能被快照看到时推迟到这些快照结束。
+// 待回收列表无法扩展时返回 -1（页面的代数只在内存中，丢掉记录就再也回收不了）
+static int tree_free_page(BTree *tree, uint32_t page_id) {
+    if (!page_shared(tree, page_id)) {
+        page_free(tree->pm, page_id);
+        return 0;
+    }
+    if (pending_reserve(tree, 1) < 0) return -1;
+    tree->pending[tree->pending_count].page_id = page_id;
+    tree->pending[tree->pending_count].gen = tree->write_gen;
+    tree->pending_count++;
+    return 0;
+}
+
+// 回收所有活跃快照都已看不到的页面：释放代数不晚于最早快照的开始代数
+static void release_pending(BTree *tree) {
+    size_t n = 0;
+    size_t pins = page_pin_mark(tree->pm);
+    while (n < tree->pending_count &&
+           (!tree->snap_oldest || tree->pending[n].gen <= tree->snap_oldest->gen)) {
+        page_free(tree->pm, tree->pending[n].page_id);
+        page_unpin_to(tree->pm, pins);
+        n++;
+    }
+    if (n == 0) return;  // 包括还没有分配过列表（pending 为 NULL）
+    if (n < tree->pending_count) {
+        memmove(tree->pending, tree->pending + n, (tree->pending_count - n) * sizeof(BTreePendingFree));
+    }
+    tree->pending_count -= n;
+}
+
+// 修改内部节点第 index 个子节点的页面 ID
+static void internal_set_child(BTreeNode *node, int index, uint32_t child) {
+    if (index == 0) {
+        node->child0 = child;
+    } else {
+        put_u32(node_cell(node, index - 1), child);
+    }
+}
+
+// 缓存节点改用新的页面 ID（对象不变，父节点缓存中的指针仍然有效）
+static void cache_rekey(BTreeCache *cache, uint32_t old_id, uint32_t new_id) {
+    BTreeCacheNode *c = cache_find(cache, old_id);
+    if (!c) return;
+    
+    // 从线性探测表中删除：同一探测链上后续的项重新插入
+    size_t mask = cache->slot_count - 1;
+    size_t i = cache_slot(cache, old_id);
+    cache->slots[i] = NULL;
+    for (size_t j = (i + 1) & mask; cache->slots[j]; j = (j + 1) & mask) {
+        BTreeCacheNode *e = cache->slots[j];
+        cache->slots[j] = NULL;
+        cache->slots[cache_slot(cache, e->page_id)] = e;
+    }
+    c->page_id = new_id;
+    cache->slots[cache_slot(cache, new_id)] = c;
+}
+
+// 把页面复制到新分配的 new_id，并让父节点（parent_id 为 0 时为根）的第 index 个子节点指向副本，
+// 原页面仍可能被快照看到时推迟回收。父节点必须已经是私有的。
+// 无法记录待回收的原页面时不做任何修改并返回 -1（new_id 由调用者释放）
+static int move_page(BTree *tree, uint32_t page_id, uint32_t new_id, uint32_t parent_id, int index) {
+    PageManager *pm = tree->pm;
+    if (pending_reserve(tree, 1) < 0) return -1;
+    page_set_gen(tree, new_id);
+    memcpy(get_node(pm, new_id), get_node(pm, page_id), PAGE_SIZE);
+    page_mark_dirty(pm, new_id);
+    cache_rekey(&tree->cache, page_id, new_id);
+    
+    if (parent_id == 0) {
+        tree_set_root(tree, new_id);
+    } else {
+        internal_set_child(get_node(pm, parent_id), index, new_id);
+        page_mark_dirty(pm, parent_id);
+        cache_update(tree, parent_id);
+    }
+    return tree_free_page(tree, page_id);
+}
+
+// 修改前确保页面只属于当前树：被快照共享时复制到它附近的新页面，并让父节点（parent_id 为 0 时为根）
+// 的第 index 个子节点指向副本。父节点必须已经是私有的。返回可以修改的页面 ID，失败返回 0
+static uint32_t cow_page(BTree *tree, uint32_t page_id, uint32_t parent_id, int index) {
+    if (!page_shared(tree, page_id)) return page_id;
+    
+    uint32_t new_id = page_alloc_near(tree->pm, page_id);
+    if (new_id == 0) return 0;
+    if (move_page(tree, page_id, new_id, parent_id, index) < 0) {
+        page_free(tree->pm, new_id);
+        return 0;
+    }
+    return new_id;
+}
+
+// 有活跃快照时把根到叶子的路径变为私有页面：自顶向下复制，父节点先成为私有再改写其中的子节点指针。
+// path 和 leaf 更新为副本的页面 ID
+static int cow_path(BTree *tree, const char *key, size_t klen, uint32_t *path, int depth, uint32_t *leaf) {
+    if (!tree->snap_newest) return 0;
+    uint32_t parent = 0;
+    for (int level = 0; level <= depth; level++) {
+        uint32_t *page_id = level < depth ? &path[level] : leaf;
+        int index = parent ? find_child_index(get_node(tree->pm, parent), key, klen) : 0;
+        *page_id = cow_page(tree, *page_id, parent, index);
+        if (*page_id == 0) return -1;
+        parent = *page_id;
+    }
+    return 0;
+}
+
+// 分裂叶子节点，为插入 key（cell 中 key 以外占 fixed 字节）腾出空间
+// 按字节均分：把待插入的 cell 也计入，使两半的占用尽量接近，保证分裂后新 cell 一定能放进它所属的一半。
+// 两半沿用原节点的前缀，cell 原样移动；key 不以该前缀开头时它只能落在节点一端，
+// 此时就在它的位置分裂，让它单独进入一个节点，原有 cell 不必按更短的前缀重写。
+// key 已存在（覆盖写放不下）时新节点分配成功之后才删除旧 cell，分配失败时节点不变。
+// insert_right 返回新 cell 应插入的节点（true 为新节点）。
+static int split_leaf(BTree *tree, uint32_t page_id, const char *key, size_t klen, size_t fixed,
+                      uint32_t *new_page_id, bool *insert_right) {
+    PageManager *pm = tree->pm;
+    uint32_t new_id = tree_create_node(tree, true, page_id);  // 新叶子优先紧跟在被分裂的叶子之后
+    if (new_id == 0) return -1;
+    BTreeNode *old_node = get_node(pm, page_id);
+    BTreeNode *new_node = get_node(pm, new_id);
+    node_copy_prefix(new_node, old_node);
+    
+    bool found;
+    int insert_pos = find_key_position(old_node, key, klen, &found);
+    if (found) node_remove_cell(old_node, insert_pos);
+    int count = old_node->key_count;
+    int mid = 0;
+    
+    if (!node_has_prefix(old_node, key, klen)) {
+        mid = insert_pos > 0 ? insert_pos : 1;  // insert_pos 只可能是 0 或 count
+    } else {
+        // 在包含新 cell 的虚拟序列（共 count + 1 个）中找均分点 mid：前 mid 个留在旧节点
+        size_t insert_size = fixed + klen - old_node->prefix_len;
+        size_t total = node_used_space(old_node) + insert_size + sizeof(uint16_t);
+        size_t left = 0;
+        for (int v = 0; v <= count; v++) {
+            size_t size = v == insert_pos ? insert_size
+                        : cell_size(old_node, node_cell(old_node, v < insert_pos ? v : v - 1));
+            size += sizeof(uint16_t);
+            if (left + size / 2 >= total / 2 && v > 0) break;
+            left += size;
+            mid = v + 1;
+        }
+        if (mid > count) mid = count;  // 至少有一个 cell 进入新节点
+    }
+    
+    // 虚拟序列中的 [mid, count] 进入新节点，对应旧节点的真实下标
+    *insert_right = insert_pos >= mid;
+    int first_moved = *insert_right ? mid : mid - 1;
+    
+    // 后半部分 cell 移到新节点
+    for (int i = first_moved; i < count; i++) {
+        node_append_cell(new_node, old_node, i);
+    }
+    for (int i = count - 1; i >= first_moved; i--) {
+        node_remove_cell(old_node, i);
+    }
+    
+    page_mark_dirty(pm, page_id);
+    page_mark_dirty(pm, new_id);
+    *new_page_id = new_id;
+    return 0;
+}
+
+// 分裂内部节点，为插入 key 腾出空间
+// 旧节点保留 child0...child_mid 和 key0...key_mid-1，
+// 新节点包含 child_mid+1...child_n 和 key_mid+1...key_n-1，提升 key_mid。
+// 与叶子相同，两半沿用原前缀；key 不以该前缀开头时提升最靠近它的一端的 key，让它进入只剩一个子节点的一半
+static int split_internal(BTree *tree, uint32_t page_id, const char *key, size_t klen,
+                          uint32_t *new_page_id, char *promote_key, size_t *promote_len) {
+    PageManager *pm = tree->pm;
+    uint32_t new_id = tree_create_node(tree, false, page_id);
+    if (new_id == 0) return -1;
+    BTreeNode *old_node = get_node(pm, page_id);
+    BTreeNode *new_node = get_node(pm, new_id);
+    node_copy_prefix(new_node, old_node);
+    
+    int count = old_node->key_count;
+    int mid = 0;
+    if (!node_has_prefix(old_node, key, klen)) {
+        bool found;
+        mid = find_key_position(old_node, key, klen, &found) == 0 ? 0 : count - 1;
+    } else {
+        // 按字节找均分点，mid 位置的 key 会被提升
+        size_t half = node_used_space(old_node) / 2;
+        size_t left = 0;
+        while (mid < count - 1) {
+            size_t size = cell_size(old_node, node_cell(old_node, mid)) + sizeof(uint16_t);
+            if (left + size / 2 >= half && mid > 0) break;
+            left += size;
+            mid++;
+        }
+    }
+    
+    // 获取提升的 key
+    *promote_len = node_copy_key(old_node, mid, promote_key);
+    
+    // key_mid 右侧的 child 成为新节点的 child0
+    new_node->child0 = internal_get_child(old_node, mid + 1);
+    for (int i = mid + 1; i < count; i++) {
+        node_append_cell(new_node, old_node, i);
+    }
+    for (int i = count - 1; i >= mid; i--) {
+        node_remove_cell(old_node, i);
+    }
+    
+    page_mark_dirty(pm, page_id);
+    page_mark_dirty(pm, new_id);
+    cache_add_sibling(tree, page_id, new_id);
+    *new_page_id = new_id;
+    return 0;
+}
+
+// 替换叶子第 pos 个 cell 的 value，slot 顺序和前缀不变，页面放不下时返回 -1 且节点不变。
+// 新 value 不长于旧 value 时原地覆盖，多出的尾部记为碎片；变长时位于 cell 区最低处的 cell 直接向空闲区扩展，
+// 否则在空闲区写新 cell 并把旧 cell 记为碎片
+static int leaf_update_value(BTreeNode *node, int pos, const StoredValue *sv) {
+    uint8_t *cell = node_cell(node, pos);
+    size_t head = LEAF_CELL_HEADER + get_u16(cell);
+    size_t old_len = get_u16(cell + sizeof(uint16_t)) & VALUE_LEN_MASK;
+    size_t new_len = sv->field & VALUE_LEN_MASK;
+    
+    if (new_len <= old_len) {
+        node->frag_bytes += old_len - new_len;
+    } else {
+        size_t grow = new_len - old_len;
+        uint16_t *slots = node_slots(node);
+        if (node_free_space(node) < grow) {
+            return -1;  // 空间不足，需要分裂
+        }
+        if (slots[pos] == node->cell_start && node_contiguous_free(node) >= grow) {
+            memmove(cell - grow, cell, head);
+            node->cell_start -= grow;
+            slots[pos] = node->cell_start;
+        } else if (node_contiguous_free(node) >= head + new_len) {
+            memcpy((uint8_t*)node + node->cell_start - head - new_len, cell, head);
+            node->frag_bytes += head + old_len;
+            node->cell_start -= head + new_len;
+            slots[pos] = node->cell_start;
+        } else {
+            // 连续空闲区不够：删除旧 cell 后重新预留，由 node_reserve_cell 整理碎片
+            uint8_t saved[LEAF_CELL_HEADER + MAX_KEY_SIZE];
+            memcpy(saved, cell, head);
+            node_remove_cell(node, pos);
+            memcpy(node_reserve_cell(node, pos, head + new_len), saved, head);
+        }
+        cell = node_cell(node, pos);
+    }
+    
+    put_u16(cell + sizeof(uint16_t), sv->field);
+    memcpy(cell + head, sv->data, new_len);
+    return 0;
+}
+
+// 插入到叶子节点（key 已存在时替换其 value）
+static int insert_into_leaf(PageManager *pm, uint32_t page_id, const char *key, size_t klen,
+                            const StoredValue *sv) {
+    BTreeNode *node = get_node(pm, page_id);
+    bool found;
+    int pos = find_key_position(node, key, klen, &found);
+    
+    // key 已存在：在页内替换 value；页面放不下时节点不变，由 split_leaf 在分裂时删除旧 cell
+    if (found) {
+        if (leaf_update_value(node, pos, sv) == 0) {
+            page_mark_dirty(pm, page_id);
+            return 0;
+        }
+        return -1;
+    }
+    
+    if (node_prepare_insert(node, key, klen, leaf_cell_size(0, sv), NODE_CAPACITY) < 0) {
+        return -1;  // 空间不足，需要分裂
+    }
+    size_t plen = node->prefix_len;
+    write_leaf_cell(node_reserve_cell(node, pos, leaf_cell_size(klen - plen, sv)), key + plen, klen - plen, sv);
+    
+    page_mark_dirty(pm, page_id);
+    return 0;
+}
+
+// 插入到内部节点
+static int insert_into_internal(BTree *tree, uint32_t page_id, const char *key, size_t klen,
+                                uint32_t right_child_id) {
+    PageManager *pm = tree->pm;
+    BTreeNode *node = get_node(pm, page_id);
+    bool found;
+    int pos = find_key_position(node, key, klen, &found);
+    
+    if (node_prepare_insert(node, key, klen, INTERNAL_CELL_HEADER, NODE_CAPACITY) < 0) {
+        return -1;  // 空间不足，需要分裂
+    }
+    internal_put_cell(node, pos, key, klen, right_child_id);
+    
+    page_mark_dirty(pm, page_id);
+    cache_update(tree, page_id);
+    return 0;
+}
+
+// 根节点分裂后创建新根：child0 = left，唯一的 key 指向 right
+static int create_root(BTree *tree, uint32_t left_id, const char *key, size_t klen, uint32_t right_id) {
+    uint32_t new_root = tree_create_node(tree, false, 0);
+    if (new_root == 0) return -1;
+    BTreeNode *root_node = get_node(tree->pm, new_root);
+    root_node->child0 = left_id;
+    insert_into_internal(tree, new_root, key, klen, right_id);
+    
+    tree_set_root(tree, new_root);
+    cache_rebuild(tree);  // 树长高一层，缓存覆盖的层随之下移
+    page_mark_dirty(tree->pm, new_root);
+    return 0;
+}
+
+// 从根向下查找 key 所在的叶子节点；path 不为 NULL 时记录经过的内部节点（根在前），depth 返回其个数
+static uint32_t find_leaf_path(BTree *tree, const char *key, size_t klen, uint32_t *path, int *depth) {
+    uint32_t page_id = tree->root_page;
+    int d = 0;
+    
+    // 缓存覆盖的上层在紧凑结构中查找，走出缓存后再访问页面
+    for (BTreeCacheNode *c = tree->cache.root; c; ) {
+        int index = cache_child_index(c, key, klen);
+        if (path) path[d] = page_id;
+        d++;
+        page_id = c->children[index];
+        c = c->child_nodes[index];
+    }
+    
+    BTreeNode *node = get_node(tree->pm, page_id);
+    if (!node) return 0;
+    
+    while (!node->is_leaf) {
+        if (d >= BTREE_MAX_DEPTH) return 0;
+        if (path) path[d] = page_id;
+        d++;
+        page_id = internal_get_child(node, find_child_index(node, key, klen));
+        node = get_node(tree->pm, page_id);
+        if (!node) return 0;
+    }
+    
+    if (depth) *depth = d;
+    return page_id;
+}
+
+static uint32_t find_leaf(BTree *tree, const char *key, size_t klen) {
+    return find_leaf_path(tree, key, klen, NULL, NULL);
+}
+
+// 插入键值对（value 已按 store_value 准备好）
+// 分裂沿下降时记录的路径逐层向上传播，直到某个祖先放得下分隔 key 或根分裂出新根
+static int insert_kv(BTree *tree, const char *key, size_t klen, const StoredValue *sv) {
+    uint32_t path[BTREE_MAX_DEPTH];
+    int depth;
+    uint32_t leaf_page = find_leaf_path(tree, key, klen, path, &depth);
+    if (leaf_page == 0 || cow_path(tree, key, klen, path, depth, &leaf_page) < 0) return -1;
+    
+    // 尝试插入
+    if (insert_into_leaf(tree->pm, leaf_page, key, klen, sv) == 0) {
+        return 0;
+    }
+    
+    // 需要分裂：先预留最坏情况下的页面（叶子、路径上每个祖先和新根），分裂中途不会因分配失败
+    // 留下只分裂了一半的树；预留失败时树不变。按字节均分，新 cell 计入分裂点的选择
+    if (page_reserve(tree->pm, (uint32_t)depth + 2) < 0) {
+        return -1;
+    }
+    uint32_t new_page_id;
+    bool insert_right;
+    if (split_leaf(tree, leaf_page, key, klen, leaf_cell_size(0, sv),
+                   &new_page_id, &insert_right) < 0) {
+        return -1;
+    }
+    
+    // 插入到新 cell 所属的节点
+    uint32_t target = insert_right ? new_page_id : leaf_page;
+    if (insert_into_leaf(tree->pm, target, key, klen, sv) != 0) {
+        return -1;
+    }
+    
+    // 提升能区分左右两个叶子的最短 key
+    char key_buf[MAX_KEY_SIZE], last[MAX_KEY_SIZE];
+    BTreeNode *left = get_node(tree->pm, leaf_page);
+    size_t last_len = node_copy_key(left, left->key_count - 1, last);
+    size_t key_len = node_copy_key(get_node(tree->pm, new_page_id), 0, key_buf);
+    key_len = separator_key(last, last_len, key_buf, key_len, key_buf);
+    
+    // 逐层向上插入分隔 key：left_id 是刚分裂的节点，right_id 是分裂出的新节点
+    uint32_t left_id = leaf_page, right_id = new_page_id;
+    for (int level = depth - 1; level >= 0; level--) {
+        uint32_t parent_page = path[level];
+        if (insert_into_internal(tree, parent_page, key_buf, key_len, right_id) == 0) {
+            return 0;
+        }
+        
+        // 父节点也需要分裂
+        uint32_t new_parent_id;
+        char promote_key[MAX_KEY_SIZE];
+        size_t promote_len;
+        if (split_internal(tree, parent_page, key_buf, key_len, &new_parent_id,
+                           promote_key, &promote_len) < 0) {
+            return -1;
+        }
+        
+        // 比较 key 和提升的 key，确定插入到哪个父节点
+        uint32_t half = compare_key(key_buf, key_len, promote_key, promote_len) < 0
+                      ? parent_page : new_parent_id;
+        if (insert_into_internal(tree, half, key_buf, key_len, right_id) != 0) {
+            return -1;
+        }
+        
+        left_id = parent_page;
+        right_id = new_parent_id;
+        memcpy(key_buf, promote_key, promote_len);
+        key_len = promote_len;
+    }
+    
+    // 根节点分裂，创建新根
+    return create_root(tree, left_id, key_buf, key_len, right_id);
+}
+
+// ---- 版本 1 文件升级 ----
+// 版本 1 节点格式：16 字节头，叶子数据为 key\0 vlen(u16) value 依次排列，
+// 内部节点数据为 child0 key0\0 child1 key1\0 ... childN。
+// 升级时沿叶子链表读出所有键值对，再以当前格式重建整棵树。
+// 版本 1 文件最多 1024 页（4MB），可以整体读入内存。
+#define V1_MAX_VAL_SIZE 1024  // 版本 1 的 value 长度上限
+
+typedef struct {
+    uint32_t type;
+    uint32_t parent;
+    uint32_t next;
+    uint16_t key_count;
+    uint16_t is_leaf;
+} BTreeNodeV1;
+
+static int upgrade_from_v1(BTree *tree, FileHeader *header) {
+    PageManager *pm = tree->pm;
+    
+    // 沿最左子节点找到第一个叶子
+    uint32_t page_id = header->root_page;
+    uint32_t steps = 0;
+    BTreeNodeV1 *node = (BTreeNodeV1*)page_get(pm, page_id);
+    while (node && !node->is_leaf && steps++ < pm->page_count) {
+        memcpy(&page_id, node + 1, sizeof(uint32_t));
+        node = (BTreeNodeV1*)page_get(pm, page_id);
+    }
+    if (!node) return -1;
+    
+    // 读出所有键值对：klen(u16) vlen(u16) key value
+    size_t cap = (size_t)pm->page_count * PAGE_SIZE;
+    uint8_t *records = malloc(cap);
+    if (!records) return -1;
+    size_t used = 0;
+    size_t count = 0;
+    
+    for (steps = 0; page_id != 0 && steps < pm->page_count; steps++) {
+        node = (BTreeNodeV1*)page_get(pm, page_id);
+        if (!node) break;
+        
+        const char *ptr = (const char*)(node + 1);
+        const char *end = (const char*)node + PAGE_SIZE;
+        for (int i = 0; i < node->key_count; i++) {
+            size_t klen = strnlen(ptr, end - ptr);
+            if (klen > MAX_KEY_SIZE || ptr + klen + 1 + sizeof(uint16_t) > end) break;
+            uint16_t vlen;
+            memcpy(&vlen, ptr + klen + 1, sizeof(uint16_t));
+            const char *value = ptr + klen + 1 + sizeof(uint16_t);
+            if (vlen > V1_MAX_VAL_SIZE || value + vlen > end) break;
+            
+            uint8_t *rec = records + used;
+            put_u16(rec, (uint16_t)klen);
+            put_u16(rec + sizeof(uint16_t), vlen);
+            memcpy(rec + LEAF_CELL_HEADER, ptr, klen);
+            memcpy(rec + LEAF_CELL_HEADER + klen, value, vlen);
+            used += LEAF_CELL_HEADER + klen + vlen;
+            count++;
+            
+            ptr = value + vlen;
+        }
+        
+        page_id = node->next;
+    }
+    
+    // 丢弃旧页面，以当前格式重建
+    pm->page_count = 1;
+    page_free_map_reset(pm);
+    header->free_page_list = 0;
+    tree->root_page = create_node(pm, true, 0);
+    header->root_page = tree->root_page;
+    
+    int ret = tree->root_page != 0 ? 0 : -1;
+    size_t off = 0;
+    for (size_t i = 0; i < count && ret == 0; i++) {
+        uint8_t *rec = records + off;
+        size_t klen = get_u16(rec);
+        size_t vlen = get_u16(rec + sizeof(uint16_t));
+        const char *key = (const char*)rec + LEAF_CELL_HEADER;
+        StoredValue sv;
+        ret = store_value(pm, key + klen, vlen, &sv);
+        if (ret == 0) ret = insert_kv(tree, key, klen, &sv);
+        off += LEAF_CELL_HEADER + klen + vlen;
+    }
+    free(records);
+    
+    if (ret == 0) {
+        header->version = FORMAT_VERSION;
+        header->page_count = pm->page_count;
+    }
+    page_mark_dirty(pm, 0);
+    return ret;
+}
+
+// 初始化 B+ 树
+int btree_init(BTree *tree, PageManager *pm) {
+    memset(tree, 0, sizeof(BTree));
+    tree->pm = pm;
+    tree->cache.enabled = true;
+    tree->write_gen = 1;
+    
+    // 从文件头读取根节点
+    FileHeader *header = (FileHeader*)page_get(pm, 0);
+    if (!header) return -1;
+    
+    if (header->root_page == 0 || pm->page_count <= 1) {
+        // 创建新的根节点
+        tree->root_page = create_node(pm, true, 0);  // 创建根叶子节点
+        if (tree->root_page == 0) return -1;
+        header->root_page = tree->root_page;
+        header->version = FORMAT_VERSION;
+        page_mark_dirty(pm, 0);
+    } else if (header->version == 2 || header->version == 3) {
+        // 版本 2 节点头中前缀长度的位置一直为 0，即没有公共前缀，可以直接按当前格式读取；
+        // 版本 3 只是空闲页面用链表记录，打开时已由页面管理器转换为位图
+        tree->root_page = header->root_page;
+        header->version = FORMAT_VERSION;
+        page_mark_dirty(pm, 0);
+    } else if (header->version == 1) {
+        // 旧格式文件，升级到当前格式
+        int ret = upgrade_from_v1(tree, header);
+        cache_rebuild(tree);
+        return ret;
+    } else if (header->version != FORMAT_VERSION) {
+        return -1;  // 不支持的版本
+    } else {
+        // 从文件头读取根节点
+        tree->root_page = header->root_page;
+        BTreeNode *root = get_node(pm, tree->root_page);
+        if (!root || root->type == PAGE_TYPE_FREE) {
+            tree->root_page = create_node(pm, true, 0);
+            header->root_page = tree->root_page;
+            page_mark_dirty(pm, 0);
+        }
+    }
+    
+    cache_rebuild(tree);
+    return 0;
+}
+
+// 插入键值对
+int btree_insert(BTree *tree, const char *key, const char *value) {
+    if (!key || !value) return -1;
+    return btree_insert2(tree, key, strlen(key), value, strlen(value));
+}
+
+// 插入键值对（显式长度，key/value 可以包含任意字节）
+int btree_insert2(BTree *tree, const void *key, size_t klen, const void *value, size_t vlen) {
+    if (!tree || !key || !value) return -1;
+    if (klen > MAX_KEY_SIZE || vlen > MAX_VAL_SIZE) return -1;
+    
+    StoredValue sv;
+    if (store_value(tree->pm, value, vlen, &sv) < 0) return -1;
+    return insert_kv(tree, key, klen, &sv);
+}
+
+// 查找值（value 以 '\0' 结尾，超出缓冲区的部分被截断）
+int btree_get(BTree *tree, const char *key, char *value, size_t value_size) {
+    if (!key || !value || value_size == 0) return -1;
+    
+    size_t vlen;
+    if (btree_get2(tree, key, strlen(key), value, value_size - 1, &vlen) < 0) return -1;
+    value[vlen < value_size - 1 ? vlen : value_size - 1] = '\0';
+    return 0;
+}
+
+// 查找值（显式长度）：最多复制 value_size 字节，vlen 返回 value 的完整长度
+int btree_get2(BTree *tree, const void *key, size_t klen, void *value, size_t value_size, size_t *vlen) {
+    if (!tree || !key || (!value && value_size > 0)) return -1;
+    
+    uint32_t page_id = find_leaf(tree, key, klen);
+    BTreeNode *node = get_node(tree->pm, page_id);
+    if (!node) return -1;
+    
+    // 在叶子节点中查找
+    bool found;
+    int pos = find_key_position(node, key, klen, &found);
+    if (!found) return -1;  // 未找到
+    
+    size_t val_len;
+    const char *val_ptr = leaf_get_value(tree->pm, node, pos, &val_len);
+    if (!val_ptr) return -1;
+    if (value_size > 0) memcpy(value, val_ptr, val_len < value_size ? val_len : value_size);
+    if (vlen) *vlen = val_len;
+    return 0;
+}
+
+// 查找值并返回其地址：内联 value 指向叶子页面（树被修改后失效），溢出 value 指向数据文件映射区域
+const char* btree_get_ref(BTree *tree, const void *key, size_t klen, size_t *vlen) {
+    if (!tree || !key || !vlen) return NULL;
+    
+    BTreeNode *node = get_node(tree->pm, find_leaf(tree, key, klen));
+    if (!node) return NULL;
+    
+    bool found;
+    int pos = find_key_position(node, key, klen, &found);
+    if (!found) return NULL;
+    return leaf_get_value(tree->pm, node, pos, vlen);
+}
+
+// 批量加载时记录的页面列表
+typedef struct {
+    uint32_t *pages;
+    size_t count;
+    size_t capacity;
+} PageList;
+
+static int page_list_push(PageList *list, uint32_t page_id) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        uint32_t *pages = realloc(list->pages, capacity * sizeof(uint32_t));
+        if (!pages) return -1;
+        list->pages = pages;
+        list->capacity = capacity;
+    }
+    list->pages[list->count++] = page_id;
+    return 0;
+}
+
+// 子树中最小（last 为 true 时最大）的 key，复制到 buf 并返回长度，子树为空返回 -1
+static int subtree_edge_key(PageManager *pm, uint32_t page_id, bool last, char *buf, size_t *klen) {
+    BTreeNode *node = get_node(pm, page_id);
+    while (node && !node->is_leaf) {
+        node = get_node(pm, internal_get_child(node, last ? node->key_count : 0));
+    }
+    if (!node || node->key_count == 0) return -1;
+    *klen = node_copy_key(node, last ? node->key_count - 1 : 0, buf);
+    return 0;
+}
+
+// 把下一层的节点按顺序打包成内部节点：分隔 key 取能区分相邻两棵子树的最短 key
+static int bulk_build_level(BTree *tree, const PageList *children, PageList *parents,
+                            PageList *allocated, size_t limit) {
+    PageManager *pm = tree->pm;
+    size_t i = 0;
+    
+    while (i < children->count) {
+        size_t node_pins = page_pin_mark(pm);
+        uint32_t page_id = tree_create_node(tree, false, parents->count ? parents->pages[parents->count - 1] : 0);
+        if (page_id == 0 || page_list_push(allocated, page_id) < 0 ||
+            page_list_push(parents, page_id) < 0) {
+            return -1;
+        }
+        BTreeNode *node = get_node(pm, page_id);
+        node->child0 = children->pages[i];
+        i++;
+        size_t pins = page_pin_mark(pm);
+        
+        while (i < children->count) {
+            char prev[MAX_KEY_SIZE], key[MAX_KEY_SIZE];
+            size_t prev_len, klen;
+            if (subtree_edge_key(pm, children->pages[i - 1], true, prev, &prev_len) < 0 ||
+                subtree_edge_key(pm, children->pages[i], false, key, &klen) < 0) {
+                return -1;
+            }
+            page_unpin_to(pm, pins);  // 两侧子树的边界 key 已复制出来
+            klen = separator_key(prev, prev_len, key, klen, key);
+            
+            // 达到目标填充率后换新节点，但不让最后一个子节点单独成为一个节点
+            bool last = i + 1 == children->count;
+            if (node_prepare_insert(node, key, klen, INTERNAL_CELL_HEADER, last ? NODE_CAPACITY : limit) < 0) {
+                break;
+            }
+            internal_put_cell(node, node->key_count, key, klen, children->pages[i]);
+            i++;
+        }
+        page_mark_dirty(pm, page_id);
+        page_unpin_to(pm, node_pins);
+    }
+    
+    return 0;
+}
+
+// 顺序写满叶子，返回叶子列表
+static int bulk_build_leaves(BTree *tree, BTreeBulkNext next, void *ctx, PageList *leaves,
+                             PageList *allocated, size_t limit) {
+    PageManager *pm = tree->pm;
+    BTreeNode *leaf = NULL;
+    uint32_t leaf_id = 0;
+    const char *key, *value;
+    size_t klen, vlen;
+    size_t pins = page_pin_mark(pm);
+    int ret;
+    
+    while ((ret = next(ctx, &key, &klen, &value, &vlen)) == 1) {
+        if (!key || !value || klen > MAX_KEY_SIZE || vlen > MAX_VAL_SIZE) return -1;
+        
+        // key 必须严格递增
+        if (leaf && node_compare_key(leaf, leaf->key_count - 1, key, klen) <= 0) return -1;
+        
+        StoredValue sv;
+        if (store_value(pm, value, vlen, &sv) < 0) return -1;
+        if (!leaf || node_prepare_insert(leaf, key, klen, leaf_cell_size(0, &sv), limit) < 0) {
+            uint32_t new_id = tree_create_node(tree, true, leaf_id);
+            if (new_id == 0 || page_list_push(allocated, new_id) < 0 ||
+                page_list_push(leaves, new_id) < 0) {
+                return -1;
+            }
+            if (leaf) page_mark_dirty(pm, leaf_id);
+            page_unpin_to(pm, pins);  // 写满的叶子不会再被访问
+            leaf_id = new_id;
+            leaf = get_node(pm, leaf_id);
+        }
+        
+        size_t plen = leaf->prefix_len;
+        uint8_t *cell = node_reserve_cell(leaf, leaf->key_count, leaf_cell_size(klen - plen, &sv));
+        if (!cell) return -1;
+        write_leaf_cell(cell, key + plen, klen - plen, &sv);
+    }
+    
+    if (leaf) page_mark_dirty(pm, leaf_id);
+    return ret;
+}
+
+// 批量加载
+// 新页面全部写完并刷盘后才把文件头指向新根，中途崩溃时文件头仍指向原来的空根。
+int btree_bulk_load(BTree *tree, BTreeBulkNext next, void *ctx, double fill_factor) {
+    if (!tree || !next) return -1;
+    if (fill_factor <= 0 || fill_factor > 1) fill_factor = BTREE_BULK_FILL;
+    
+    PageManager *pm = tree->pm;
+    BTreeNode *root = get_node(pm, tree->root_page);
+    if (!root || !root->is_leaf || root->key_count != 0) return -1;  // 只支持空树
+    
+    size_t limit = (size_t)(NODE_CAPACITY * fill_factor);
+    PageList allocated = {0};
+    PageList level = {0};
+    int ret = bulk_build_leaves(tree, next, ctx, &level, &allocated, limit);
+    
+    // 自底向上逐层构建，直到只剩一个节点
+    while (ret == 0 && level.count > 1) {
+        PageList parents = {0};
+        ret = bulk_build_level(tree, &level, &parents, &allocated, limit);
+        free(level.pages);
+        level = parents;
+    }
+    
+    if (ret == 0 && level.count == 1) {
+        uint32_t old_root = tree->root_page;
+        
+        if (page_flush(pm) == 0 && pending_reserve(tree, 1) == 0) {
+            tree_set_root(tree, level.pages[0]);
+            tree_free_page(tree, old_root);
+            allocated.count = 0;  // 新树已生效，页面不再回收
+            cache_rebuild(tree);
+            ret = page_flush_page(pm, 0);
+        } else {
+            ret = -1;
+        }
+    }
     
-    uint32_t page_id = tree->root_page;
-    BTreeNode *node = get_node(tree->pm, page_id);
+    // 失败时回收已分配的页面，树保持为空
+    if (ret < 0) {
+        for (size_t i = 0; i < allocated.count; i++) {
+            page_free(pm, allocated.pages[i]);
+        }
+    }
+    
+    free(level.pages);
+    free(allocated.pages);
+    return ret < 0 ? -1 : 0;
+}
+
+// 初始化游标
+void btree_cursor_init(BTreeCursor *cursor, BTree *tree) {
+    memset(cursor, 0, sizeof(BTreeCursor));
+    cursor->tree = tree;
+}
+
+// 从 page_id 向下走到叶子并记录路径：key 非空时按 key 选择子节点，否则走最左（last 为 true 时走最右）
+static BTreeNode* cursor_descend(BTreeCursor *cursor, uint32_t page_id, const char *key, size_t klen,
+                                 bool last) {
+    BTreeNode *node = get_node(cursor->tree->pm, page_id);
+    
+    while (node && !node->is_leaf) {
+        if (cursor->depth >= BTREE_MAX_DEPTH) return NULL;
+        int index = key ? find_child_index(node, key, klen) : (last ? node->key_count : 0);
+        cursor->path_page[cursor->depth] = page_id;
+        cursor->path_index[cursor->depth] = (uint16_t)index;
+        cursor->depth++;
+        page_id = internal_get_child(node, index);
+        node = get_node(cursor->tree->pm, page_id);
+    }
+    
+    if (node) cursor->page_id = page_id;
+    return node;
+}
+
+// 没有有效路径时（批量写入修改过叶子）用当前叶子的第 index 个 key 重新下降一次
+static int cursor_restore_path(BTreeCursor *cursor, BTreeNode *node, int index) {
+    if (cursor->path_valid) return 0;
+    if (node->key_count == 0) return -1;
+    char key[MAX_KEY_SIZE];
+    size_t klen = node_copy_key(node, index, key);
+    cursor->depth = 0;
+    if (!cursor_descend(cursor, cursor->tree->root_page, key, klen, false)) return -1;
+    cursor->path_valid = true;
+    return 0;
+}
+
+// 借助下降路径移动到下一个非空叶子的第一个 key
+static int cursor_next_leaf(BTreeCursor *cursor) {
+    BTreeNode *node = get_node(cursor->tree->pm, cursor->page_id);
+    if (!node || cursor_restore_path(cursor, node, node->key_count - 1) < 0) {
+        cursor->valid = false;
+        return -1;
+    }
+    
+    // 回到最近一个还有右兄弟子树的祖先，再沿该子树的最左路径下降
+    while (cursor->depth > 0) {
+        int level = cursor->depth - 1;
+        BTreeNode *parent = get_node(cursor->tree->pm, cursor->path_page[level]);
+        if (!parent) break;
+        if (cursor->path_index[level] >= parent->key_count) {
+            cursor->depth--;
+            continue;
+        }
+        cursor->path_index[level]++;
+        node = cursor_descend(cursor, internal_get_child(parent, cursor->path_index[level]), NULL, 0, false);
+        if (!node) break;
+        if (node->key_count > 0) {
+            cursor->index = 0;
+            cursor->valid = true;
+            return 0;
+        }
+    }
+    
+    cursor->valid = false;
+    return -1;
+}
+
+// 借助下降路径移动到前一个非空叶子的最后一个 key
+static int cursor_prev_leaf(BTreeCursor *cursor) {
+    BTreeNode *node = get_node(cursor->tree->pm, cursor->page_id);
+    if (!node || cursor_restore_path(cursor, node, 0) < 0) return -1;
+    
+    // 回到最近一个还有左兄弟子树的祖先，再沿该子树的最右路径下降
+    while (cursor->depth > 0) {
+        int level = cursor->depth - 1;
+        if (cursor->path_index[level] == 0) {
+            cursor->depth--;
+            continue;
+        }
+        cursor->path_index[level]--;
+        BTreeNode *parent = get_node(cursor->tree->pm, cursor->path_page[level]);
+        if (!parent) break;
+        node = cursor_descend(cursor, internal_get_child(parent, cursor->path_index[level]), NULL, 0, true);
+        if (!node) break;
+        if (node->key_count > 0) {
+            cursor->index = node->key_count - 1;
+            cursor->valid = true;
+            return 0;
+        }
+    }
+    
+    cursor->valid = false;
+    return -1;
+}
+
+// 定位到第一个 >= key 的键值对
+int btree_cursor_seek(BTreeCursor *cursor, const char *key) {
+    return btree_cursor_seek2(cursor, key, key ? strlen(key) : 0);
+}
+
+// 定位到第一个 >= key 的键值对（显式长度）
+int btree_cursor_seek2(BTreeCursor *cursor, const void *key, size_t klen) {
+    if (!cursor || !cursor->tree) return -1;
+    
+    cursor->depth = 0;
+    cursor->valid = false;
+    BTreeNode *node = cursor_descend(cursor, cursor->tree->root_page, key, klen, false);
     if (!node) return -1;
+    cursor->path_valid = true;
     
-    // 查找叶子节点
-    while (!node->is_leaf) {
-        int pos = find_key_position(node, key);
-        if (pos < node->key_count) {
-            char *node_key = internal_get_key(node, pos);
-            if (strcmp(key, node_key) >= 0) {
-                pos++;  // 去右子树
+    bool found;
+    int pos = key ? find_key_position(node, key, klen, &found) : 0;
+    if (pos < node->key_count) {
+        cursor->index = pos;
+        cursor->valid = true;
+        return 0;
+    }
+    
+    // 比当前叶子的所有 key 都大：结果在后继叶子的开头
+    return cursor_next_leaf(cursor);
+}
+
+// 定位到最后一个键值对
+int btree_cursor_last(BTreeCursor *cursor) {
+    if (!cursor || !cursor->tree) return -1;
+    
+    cursor->depth = 0;
+    cursor->valid = false;
+    BTreeNode *node = cursor_descend(cursor, cursor->tree->root_page, NULL, 0, true);
+    if (!node) return -1;
+    cursor->path_valid = true;
+    
+    if (node->key_count > 0) {
+        cursor->index = node->key_count - 1;
+        cursor->valid = true;
+        return 0;
+    }
+    return cursor_prev_leaf(cursor);
+}
+
+// 移动到下一个键值对（同一叶子内只移动下标，跨叶子借助下降路径）
+int btree_cursor_next(BTreeCursor *cursor) {
+    if (!cursor || !cursor->valid) return -1;
+    
+    BTreeNode *node = get_node(cursor->tree->pm, cursor->page_id);
+    if (node && cursor->index + 1 < node->key_count) {
+        cursor->index++;
+        return 0;
+    }
+    return cursor_next_leaf(cursor);
+}
+
+// 移动到上一个键值对
+int btree_cursor_prev(BTreeCursor *cursor) {
+    if (!cursor || !cursor->valid) return -1;
+    
+    if (cursor->index > 0) {
+        cursor->index--;
+        return 0;
+    }
+    return cursor_prev_leaf(cursor);
+}
+
+// 游标是否有效
+bool btree_cursor_valid(const BTreeCursor *cursor) {
+    return cursor && cursor->valid;
+}
+
+// 获取当前 key：节点没有公共前缀时直接指向 cell，否则拼接到游标的缓冲区
+const char* btree_cursor_key(BTreeCursor *cursor, size_t *klen) {
+    if (!btree_cursor_valid(cursor)) return NULL;
+    BTreeNode *node = get_node(cursor->tree->pm, cursor->page_id);
+    if (node->prefix_len == 0) {
+        return node_get_suffix(node, cursor->index, klen);
+    }
+    *klen = node_copy_key(node, cursor->index, cursor->key);
+    return cursor->key;
+}
+
+// 获取当前 value
+const char* btree_cursor_value(const BTreeCursor *cursor, size_t *vlen) {
+    if (!btree_cursor_valid(cursor)) return NULL;
+    return leaf_get_value(cursor->tree->pm, get_node(cursor->tree->pm, cursor->page_id), cursor->index, vlen);
+}
+
+// 按 key 有序地定位叶子：key 不小于上一次定位的 key 时，从下降路径上
+// 仍然覆盖 key 的最深一层继续向下，而不是每次从根开始。
+static BTreeNode* cursor_locate(BTreeCursor *cursor, const char *key, size_t klen) {
+    int level = -1;
+    
+    if (cursor->path_valid) {
+        // 自底向上找到第一个分隔 key 大于 key 的层：该层所选子节点的范围覆盖 key
+        for (level = cursor->depth - 1; level >= 0; level--) {
+            BTreeNode *node = get_node(cursor->tree->pm, cursor->path_page[level]);
+            int index = cursor->path_index[level];
+            if (index < node->key_count && node_compare_key(node, index, key, klen) < 0) break;
+        }
+    }
+    
+    uint32_t start = cursor->tree->root_page;
+    cursor->depth = 0;
+    if (level >= 0) {
+        BTreeNode *node = get_node(cursor->tree->pm, cursor->path_page[level]);
+        start = internal_get_child(node, cursor->path_index[level]);
+        cursor->depth = level + 1;
+    }
+    
+    BTreeNode *leaf = cursor_descend(cursor, start, key, klen, false);
+    cursor->path_valid = leaf != NULL;
+    return leaf;
+}
+
+// 批量操作按 key 排序用的索引项
+typedef struct {
+    uint64_t prefix;          // key 前 8 字节按大端拼成的整数，多数比较只看它
+    const char *key;
+    size_t klen;
+    size_t index;
+} BatchEntry;
+
+static int compare_batch_entry(const void *a, const void *b) {
+    const BatchEntry *x = a;
+    const BatchEntry *y = b;
+    if (x->prefix != y->prefix) return x->prefix < y->prefix ? -1 : 1;
+    int cmp = compare_key(x->key, x->klen, y->key, y->klen);
+    if (cmp != 0) return cmp;
+    return (x->index > y->index) - (x->index < y->index);  // 同一 key 保持原顺序
+}
+
+// 按 key 排序批量项（相同 key 保持原顺序），返回需要调用者释放的索引数组
+static BatchEntry* sort_batch(BTreeBatchItem *items, size_t count) {
+    BatchEntry *entries = malloc(count * sizeof(BatchEntry));
+    if (!entries) return NULL;
+    
+    for (size_t i = 0; i < count; i++) {
+        entries[i].key = items[i].key;
+        entries[i].klen = items[i].key ? strlen(items[i].key) : 0;
+        entries[i].index = i;
+        entries[i].prefix = 0;
+        for (size_t j = 0; j < 8; j++) {
+            uint8_t c = j < entries[i].klen ? (uint8_t)items[i].key[j] : 0;
+            entries[i].prefix = (entries[i].prefix << 8) | c;
+        }
+    }
+    qsort(entries, count, sizeof(BatchEntry), compare_batch_entry);
+    return entries;
+}
+
+// 缓冲池模式下的逐层预读：每层先求出所有 key 要访问的节点，把不在缓冲池中的一次批量读入，
+// 再下降到下一层，直到叶子。缓存覆盖的上层不访问页面，从缓存以下开始；之后的逐个处理大多直接命中
+static void batch_prefetch(BTree *tree, const BatchEntry *entries, size_t count) {
+    PageManager *pm = tree->pm;
+    if (!pm->pool || count < 2) return;
+    
+    uint32_t *pages = malloc(count * sizeof(uint32_t));  // 每个 key 当前层的节点，0 表示已到叶子
+    uint32_t *ids = malloc(count * sizeof(uint32_t));
+    if (!pages || !ids) {
+        free(pages);
+        free(ids);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint32_t page_id = tree->root_page;
+        if (entries[i].key) {
+            for (BTreeCacheNode *c = tree->cache.root; c; ) {
+                int index = cache_child_index(c, entries[i].key, entries[i].klen);
+                page_id = c->children[index];
+                c = c->child_nodes[index];
             }
         }
-        uint32_t *child = internal_get_child(node, pos);
-        page_id = *child;
-        node = get_node(tree->pm, page_id);
-        if (!node) return -1;
+        pages[i] = entries[i].key ? page_id : 0;
     }
     
-    // 在叶子节点中查找并删除
-    int pos = find_key_position(node, key);
-    if (pos < node->key_count) {
-        char *node_key = leaf_get_key(node, pos);
-        if (strcmp(key, node_key) == 0) {
-            // 找到，执行删除
-            int ret = delete_from_leaf(tree->pm, page_id, pos);
-            if (ret == 0) {
-                // 处理下溢
-                handle_leaf_underflow(tree, page_id);
+    size_t pins = page_pin_mark(pm);
+    for (int level = 0; level < BTREE_MAX_DEPTH; level++) {
+        // key 已排序，访问同一节点的项相邻
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (pages[i] && (n == 0 || ids[n - 1] != pages[i])) ids[n++] = pages[i];
+        }
+        if (n == 0) break;
+        page_prefetch(pm, ids, n);
+        
+        uint32_t last_id = 0;
+        BTreeNode *node = NULL;
+        for (size_t i = 0; i < count; i++) {
+            if (!pages[i]) continue;
+            // 同一时刻只钉住一个节点，一层的节点数超过缓冲池时也不会撑大缓冲池
+            if (pages[i] != last_id) {
+                page_unpin_to(pm, pins);
+                last_id = pages[i];
+                node = get_node(pm, last_id);
             }
-            return ret;
+            pages[i] = node && !node->is_leaf ?
+                       internal_get_child(node, find_child_index(node, entries[i].key, entries[i].klen)) : 0;
+        }
+        page_unpin_to(pm, pins);
+    }
+    free(pages);
+    free(ids);
+}
+
+// 批量插入
+int btree_put_batch(BTree *tree, BTreeBatchItem *items, size_t count) {
+    if (!tree || (!items && count > 0)) return -1;
+    if (count == 0) return 0;
+    
+    BatchEntry *entries = sort_batch(items, count);
+    if (!entries) return -1;
+    
+    batch_prefetch(tree, entries, count);
+    BTreeCursor cursor;
+    btree_cursor_init(&cursor, tree);
+    size_t pins = page_pin_mark(tree->pm);
+    int ret = 0;
+    
+    // 游标只保存页面 ID，每一项处理完即可释放期间钉住的页面
+    for (size_t i = 0; i < count; i++) {
+        page_unpin_to(tree->pm, pins);
+        BTreeBatchItem *item = &items[entries[i].index];
+        size_t klen = entries[i].klen;
+        size_t vlen = item->value ? strlen(item->value) : 0;
+        
+        item->result = -1;
+        if (!item->key || !item->value || klen > MAX_KEY_SIZE || vlen > MAX_VAL_SIZE) {
+            ret = -1;
+            continue;
+        }
+        
+        StoredValue sv;
+        if (store_value(tree->pm, item->value, vlen, &sv) < 0) {
+            ret = -1;
+            continue;
+        }
+        
+        // 叶子放得下时直接插入，路径保持有效；需要分裂时走完整插入流程并丢弃路径
+        BTreeNode *leaf = cursor_locate(&cursor, item->key, klen);
+        // 有活跃快照时叶子可能被共享，一律走完整插入流程（先复制路径）
+        if (leaf && !tree->snap_newest && insert_into_leaf(tree->pm, cursor.page_id, item->key, klen, &sv) == 0) {
+            item->result = 0;
+            continue;
+        }
+        cursor.path_valid = false;
+        item->result = insert_kv(tree, item->key, klen, &sv);
+        if (item->result < 0) ret = -1;
+    }
+    
+    free(entries);
+    return ret;
+}
+
+// 批量查找
+int btree_get_batch(BTree *tree, BTreeBatchItem *items, size_t count) {
+    if (!tree || (!items && count > 0)) return -1;
+    if (count == 0) return 0;
+    
+    BatchEntry *entries = sort_batch(items, count);
+    if (!entries) return -1;
+    
+    batch_prefetch(tree, entries, count);
+    BTreeCursor cursor;
+    btree_cursor_init(&cursor, tree);
+    size_t pins = page_pin_mark(tree->pm);
+    int hits = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        page_unpin_to(tree->pm, pins);
+        BTreeBatchItem *item = &items[entries[i].index];
+        item->result = -1;
+        if (!item->key || !item->buf || item->buf_size == 0) continue;
+        
+        BTreeNode *leaf = cursor_locate(&cursor, item->key, entries[i].klen);
+        if (!leaf) continue;
+        
+        bool found;
+        int pos = find_key_position(leaf, item->key, entries[i].klen, &found);
+        if (found) {
+            size_t vlen;
+            const char *value = leaf_get_value(tree->pm, leaf, pos, &vlen);
+            if (!value) continue;
+            size_t copy_len = vlen < item->buf_size - 1 ? vlen : item->buf_size - 1;
+            memcpy(item->buf, value, copy_len);
+            item->buf[copy_len] = '\0';
+            item->result = 0;
+            hits++;
+        }
+    }
+    
+    free(entries);
+    return hits;
+}
+
+// 从叶子节点删除键值对
+static int delete_from_leaf(PageManager *pm, uint32_t page_id, int pos) {
+    BTreeNode *node = get_node(pm, page_id);
+    if (!node || pos >= node->key_count) {
+        return -1;
+    }
+    
+    node_remove_cell(node, pos);
+    page_mark_dirty(pm, page_id);
+    return 0;
+}
+
+// 从内部节点删除 key（连同其右侧的 child）
+static int delete_from_internal(BTree *tree, uint32_t page_id, int key_pos) {
+    BTreeNode *node = get_node(tree->pm, page_id);
+    if (!node || key_pos >= node->key_count) return -1;
+    
+    node_remove_cell(node, key_pos);
+    page_mark_dirty(tree->pm, page_id);
+    cache_update(tree, page_id);
+    return 0;
+}
+
+// 相邻两个兄弟节点的 cell 按 key 顺序排成的序列，用于合并和重新分配。
+// 两个节点先复制出来，序列引用副本，重写原页面时不受影响；
+// 内部节点在两者之间插入父节点中的分隔 key，其 child 为右节点的 child0。
+#define SEQ_MAX (2 * NODE_CAPACITY / (LEAF_CELL_HEADER + sizeof(uint16_t)) + 1)
+
+typedef struct {
+    uint8_t pages[3][PAGE_SIZE];      // 左节点、分隔 key、右节点的副本
+    BTreeNode *src[SEQ_MAX];          // 第 i 项所在的副本
+    int index[SEQ_MAX];               // 第 i 项在副本中的位置
+    size_t sum[SEQ_MAX + 1];          // 前 i 项按完整 key 计算的占用（含 slot）
+    int count;
+} SiblingSeq;
+
+static void seq_append_node(SiblingSeq *seq, BTreeNode *node) {
+    for (int i = 0; i < node->key_count; i++) {
+        int n = seq->count++;
+        seq->src[n] = node;
+        seq->index[n] = i;
+        seq->sum[n + 1] = seq->sum[n] + cell_size(node, node_cell(node, i)) + node->prefix_len + sizeof(uint16_t);
+    }
+}
+
+static void seq_load(SiblingSeq *seq, PageManager *pm, uint32_t left_id, uint32_t right_id,
+                     const char *sep, size_t sep_len) {
+    BTreeNode *left = (BTreeNode*)seq->pages[0];
+    BTreeNode *right = (BTreeNode*)seq->pages[2];
+    memcpy(left, get_node(pm, left_id), PAGE_SIZE);
+    memcpy(right, get_node(pm, right_id), PAGE_SIZE);
+    seq->count = 0;
+    seq->sum[0] = 0;
+    seq_append_node(seq, left);
+    if (!left->is_leaf) {
+        BTreeNode *sep_node = (BTreeNode*)seq->pages[1];
+        memset(sep_node, 0, sizeof(BTreeNode));
+        sep_node->cell_start = PAGE_SIZE;
+        internal_put_cell(sep_node, 0, sep, sep_len, right->child0);
+        seq_append_node(seq, sep_node);
+    }
+    seq_append_node(seq, right);
+}
+
+static size_t seq_key(const SiblingSeq *seq, int i, char *buf) {
+    return node_copy_key(seq->src[i], seq->index[i], buf);
+}
+
+// [a, b) 中的 key 的公共前缀长度（有序，只需比较首尾）
+static size_t seq_prefix(const SiblingSeq *seq, int a, int b, char *first) {
+    char last[MAX_KEY_SIZE];
+    if (a >= b) return 0;
+    size_t first_len = seq_key(seq, a, first);
+    size_t last_len = seq_key(seq, b - 1, last);
+    return common_prefix(first, first_len, last, last_len);
+}
+
+// [a, b) 单独放进一个节点时占用的字节数（公共前缀只存一份）
+static size_t seq_size(const SiblingSeq *seq, int a, int b) {
+    char first[MAX_KEY_SIZE];
+    size_t plen = seq_prefix(seq, a, b, first);
+    if (a >= b) return 0;
+    return seq->sum[b] - seq->sum[a] - (size_t)(b - a - 1) * plen;
+}
+
+// 用 [a, b) 重写节点的 cell 区，节点头中的其他字段不变
+static void seq_write(const SiblingSeq *seq, BTreeNode *node, int a, int b) {
+    char prefix[MAX_KEY_SIZE];
+    size_t plen = seq_prefix(seq, a, b, prefix);
+    node->key_count = 0;
+    node->frag_bytes = 0;
+    node->prefix_len = (uint16_t)plen;
+    node->cell_start = (uint16_t)(PAGE_SIZE - plen);
+    memcpy((uint8_t*)node + node->cell_start, prefix, plen);
+    for (int i = a; i < b; i++) {
+        node_append_cell(node, seq->src[i], seq->index[i]);
+    }
+}
+
+// 把父节点 sep_pos 处的分隔 key 换成 key（右侧子节点不变）；父节点放不下时保持原样并返回 -1
+static int replace_separator(BTree *tree, uint32_t parent_id, int sep_pos, const char *key, size_t klen) {
+    BTreeNode *parent = get_node(tree->pm, parent_id);
+    char old[MAX_KEY_SIZE];
+    size_t old_len = node_copy_key(parent, sep_pos, old);
+    uint32_t child = internal_get_child(parent, sep_pos + 1);
+    
+    node_remove_cell(parent, sep_pos);
+    if (node_prepare_insert(parent, key, klen, INTERNAL_CELL_HEADER, NODE_CAPACITY) < 0) {
+        node_prepare_insert(parent, old, old_len, INTERNAL_CELL_HEADER, NODE_CAPACITY);
+        internal_put_cell(parent, sep_pos, old, old_len, child);
+        return -1;
+    }
+    internal_put_cell(parent, sep_pos, key, klen, child);
+    page_mark_dirty(tree->pm, parent_id);
+    cache_update(tree, parent_id);
+    return 0;
+}
+
+// 平衡父节点中 sep_pos 处分隔 key 两侧的兄弟节点（其中一个已下溢）：
+// 合起来放得下一页时合并到左节点并释放右节点，返回 1（父节点少了一个 key）；
+// 否则按字节均分两者的 cell（内部节点经由父节点轮换分隔 key），返回 0
+static int rebalance_siblings(BTree *tree, uint32_t parent_id, int sep_pos) {
+    PageManager *pm = tree->pm;
+    BTreeNode *parent = get_node(pm, parent_id);
+    // 父节点和下溢的节点已在下降路径上变为私有，兄弟节点可能还被快照共享
+    uint32_t left_id = cow_page(tree, internal_get_child(parent, sep_pos), parent_id, sep_pos);
+    uint32_t right_id = cow_page(tree, internal_get_child(parent, sep_pos + 1), parent_id, sep_pos + 1);
+    if (left_id == 0 || right_id == 0 || pending_reserve(tree, 1) < 0) return -1;
+    BTreeNode *left = get_node(pm, left_id);
+    BTreeNode *right = get_node(pm, right_id);
+    
+    SiblingSeq *seq = malloc(sizeof(SiblingSeq));
+    if (!seq) return -1;
+    char sep[MAX_KEY_SIZE];
+    size_t sep_len = node_copy_key(parent, sep_pos, sep);
+    seq_load(seq, pm, left_id, right_id, sep, sep_len);
+    bool is_leaf = left->is_leaf;
+    int n = seq->count;
+    
+    if (seq_size(seq, 0, n) <= NODE_CAPACITY) {
+        seq_write(seq, left, 0, n);
+        page_mark_dirty(pm, left_id);
+        tree_free_page(tree, right_id);
+        delete_from_internal(tree, parent_id, sep_pos);
+        if (!is_leaf) cache_rebuild(tree);  // 被释放的内部节点可能在缓存中
+        free(seq);
+        return 1;
+    }
+    
+    // 选择使较大一半最小的分界点 m：叶子左半为 [0, m)、右半为 [m, n)；
+    // 内部节点第 m 项提升为新的分隔 key，左半为 [0, m)、右半为 [m + 1, n)
+    int skip = is_leaf ? 0 : 1;
+    int best = -1;
+    size_t best_size = NODE_CAPACITY + 1;
+    for (int m = 1; m + skip < n; m++) {
+        size_t l = seq_size(seq, 0, m);
+        size_t r = seq_size(seq, m + skip, n);
+        size_t larger = l > r ? l : r;
+        if (larger < best_size) {
+            best_size = larger;
+            best = m;
+        }
+    }
+    if (best < 0 || best == left->key_count) {  // 已经是当前的分界
+        free(seq);
+        return 0;
+    }
+    
+    char key[MAX_KEY_SIZE];
+    size_t klen = seq_key(seq, best, key);
+    if (is_leaf) {
+        char last[MAX_KEY_SIZE];
+        size_t last_len = seq_key(seq, best - 1, last);
+        klen = separator_key(last, last_len, key, klen, key);
+    }
+    if (replace_separator(tree, parent_id, sep_pos, key, klen) < 0) {
+        free(seq);
+        return 0;
+    }
+    
+    seq_write(seq, left, 0, best);
+    if (is_leaf) {
+        seq_write(seq, right, best, n);
+    } else {
+        right->child0 = internal_get_child(seq->src[best], seq->index[best] + 1);
+        seq_write(seq, right, best + 1, n);
+        cache_update(tree, left_id);
+        cache_update(tree, right_id);
+    }
+    page_mark_dirty(pm, left_id);
+    page_mark_dirty(pm, right_id);
+    free(seq);
+    return 0;
+}
+
+// 删除后自底向上处理下溢：path 为下降时经过的内部节点（根在前），page_id 为被删除 key 所在的叶子。
+// 下溢的节点与相邻兄弟合并或重新分配；合并使父节点少一个 key，继续检查父节点。
+// 最后根节点只剩一个子节点时由该子节点成为新根，树高减一。
+static void rebalance_after_delete(BTree *tree, const uint32_t *path, int depth, uint32_t page_id,
+                                   const char *key, size_t klen) {
+    PageManager *pm = tree->pm;
+    for (int level = depth - 1; level >= 0; level--) {
+        BTreeNode *node = get_node(pm, page_id);
+        if (node_used_space(node) >= MIN_FILL_BYTES) return;
+        
+        // 分隔 key 未变，按 key 重新定位 node 在父节点中的位置；最左子节点与右兄弟配对
+        uint32_t parent_id = path[level];
+        BTreeNode *parent = get_node(pm, parent_id);
+        if (parent->key_count > 0) {
+            int index = find_child_index(parent, key, klen);
+            if (rebalance_siblings(tree, parent_id, index > 0 ? index - 1 : 0) != 1) return;
+        }
+        page_id = parent_id;
+    }
+    
+    BTreeNode *root = get_node(pm, tree->root_page);
+    bool collapsed = false;
+    while (!root->is_leaf && root->key_count == 0 && pending_reserve(tree, 1) == 0) {
+        uint32_t old_root = tree->root_page;
+        tree->root_page = root->child0;
+        tree_free_page(tree, old_root);
+        root = get_node(pm, tree->root_page);
+        collapsed = true;
+    }
+    if (collapsed) {
+        tree_set_root(tree, tree->root_page);
+        cache_rebuild(tree);
+    }
+}
+
+// 删除键值对
+int btree_delete(BTree *tree, const char *key) {
+    if (!key) return -1;
+    return btree_delete2(tree, key, strlen(key));
+}
+
+// 删除键值对（显式长度）
+int btree_delete2(BTree *tree, const void *key, size_t klen) {
+    if (!tree || !key) return -1;
+    
+    uint32_t path[BTREE_MAX_DEPTH];
+    int depth;
+    uint32_t page_id = find_leaf_path(tree, key, klen, path, &depth);
+    BTreeNode *node = get_node(tree->pm, page_id);
+    if (!node) return -1;
+    
+    // 在叶子节点中查找并删除
+    bool found;
+    int pos = find_key_position(node, key, klen, &found);
+    if (found) {
+        // 找到，执行删除（页面被快照共享时先复制路径）
+        if (cow_path(tree, key, klen, path, depth, &page_id) < 0) return -1;
+        int ret = delete_from_leaf(tree->pm, page_id, pos);
+        if (ret == 0) {
+            // 处理下溢
+            rebalance_after_delete(tree, path, depth, page_id, key, klen);
         }
+        return ret;
     }
     
     return -1;  // 未找到
 }
 
+// 递归统计子树
+static void collect_stats(BTree *tree, uint32_t page_id, uint32_t level, BTreeStats *stats,
+                          uint64_t *leaf_bytes, uint64_t *internal_bytes) {
+    BTreeNode *node = get_node(tree->pm, page_id);
+    if (!node) return;
+    
+    if (level > stats->depth) {
+        stats->depth = level;
+    }
+    
+    if (node->is_leaf) {
+        stats->leaf_count++;
+        stats->key_count += node->key_count;
+        *leaf_bytes += node_used_space(node);
+        return;
+    }
+    
+    stats->internal_count++;
+    *internal_bytes += node_used_space(node);
+    size_t pins = page_pin_mark(tree->pm);
+    for (int i = 0; i <= node->key_count; i++) {
+        collect_stats(tree, internal_get_child(node, i), level + 1, stats, leaf_bytes, internal_bytes);
+        page_unpin_to(tree->pm, pins);
+    }
+}
+
+// 统计树的深度、扇出和填充率
+int btree_stats(BTree *tree, BTreeStats *stats) {
+    if (!tree || !stats) return -1;
+    
+    memset(stats, 0, sizeof(BTreeStats));
+    uint64_t leaf_bytes = 0, internal_bytes = 0;
+    collect_stats(tree, tree->root_page, 1, stats, &leaf_bytes, &internal_bytes);
+    stats->cached_nodes = tree->cache.node_count;
+    stats->pending_pages = tree->pending_count;
+    stats->free_pages = tree->pm->free_count;
+    stats->total_pages = tree->pm->page_count;
+    
+    if (stats->internal_count > 0) {
+        // 除根以外的每个节点都是某个内部节点的子节点
+        uint64_t children = stats->internal_count + stats->leaf_count - 1;
+        stats->avg_fanout = (double)children / stats->internal_count;
+        stats->internal_fill = (double)internal_bytes / (stats->internal_count * NODE_CAPACITY);
+    }
+    if (stats->leaf_count > 0) {
+        stats->leaf_fill = (double)leaf_bytes / (stats->leaf_count * NODE_CAPACITY);
+    }
+    return 0;
+}
+
+// 开启或关闭上层内部节点缓存
+void btree_set_node_cache(BTree *tree, bool enabled) {
+    tree->cache.enabled = enabled;
+    cache_rebuild(tree);
+}
+
+// 开始读快照：之后写入的页面代数大于快照的代数，快照能看到的页面在修改前都会被复制
+void btree_snapshot_begin(BTree *tree, BTreeSnapshot *snap) {
+    memset(&snap->tree, 0, sizeof(BTree));
+    snap->tree.pm = tree->pm;
+    snap->tree.root_page = tree->root_page;
+    snap->gen = tree->write_gen++;
+    snap->next = NULL;
+    snap->prev = tree->snap_newest;
+    if (tree->snap_newest) {
+        tree->snap_newest->next = snap;
+    } else {
+        tree->snap_oldest = snap;
+    }
+    tree->snap_newest = snap;
+}
+
+// 结束读快照
+void btree_snapshot_end(BTree *tree, BTreeSnapshot *snap) {
+    if (snap->prev) {
+        snap->prev->next = snap->next;
+    } else {
+        tree->snap_oldest = snap->next;
+    }
+    if (snap->next) {
+        snap->next->prev = snap->prev;
+    } else {
+        tree->snap_newest = snap->prev;
+    }
+    snap->prev = snap->next = NULL;
+    release_pending(tree);
+    
+    // 没有快照时所有页面都可以原地修改，之后的快照按代数判断，记录的代数不再需要
+    if (!tree->snap_newest) {
+        free(tree->page_gen);
+        tree->page_gen = NULL;
+        tree->page_gen_cap = 0;
+    }
+}
+
+// 推进检查点镜像：先冻结当前的树，旧镜像结束后只有它独占的页面被回收
+void btree_shadow_advance(BTree *tree, BTreeSnapshot *snap) {
+    BTreeSnapshot *old = tree->shadow;
+    btree_snapshot_begin(tree, snap);
+    tree->shadow = snap;
+    if (old) btree_snapshot_end(tree, old);
+}
+
+// 结束检查点镜像
+void btree_shadow_end(BTree *tree) {
+    if (!tree->shadow) return;
+    BTreeSnapshot *old = tree->shadow;
+    tree->shadow = NULL;
+    btree_snapshot_end(tree, old);
+}
+
+// 树高：沿最左路径数出的内部节点层数（只有根叶子时为 0）
+static uint32_t tree_height(BTree *tree) {
+    PageManager *pm = tree->pm;
+    size_t pins = page_pin_mark(pm);
+    uint32_t height = 0;
+    BTreeNode *node = get_node(pm, tree->root_page);
+    while (node && !node->is_leaf && height < BTREE_MAX_DEPTH) {
+        node = get_node(pm, node->child0);
+        height++;
+    }
+    page_unpin_to(pm, pins);
+    return height;
+}
+
+// 标记从 page_id 出发可达的页面，height 为节点以下的层数（0 为叶子）。叶子不引用其他页面，不必读入
+static void mark_reachable(BTree *tree, uint32_t page_id, uint32_t height, uint64_t *bitmap) {
+    if (page_id >= tree->pm->page_count) return;
+    bitmap[page_id / 64] |= 1ULL << (page_id % 64);
+    if (height == 0) return;
+    
+    BTreeNode *node = get_node(tree->pm, page_id);
+    if (!node || node->is_leaf) return;
+    size_t pins = page_pin_mark(tree->pm);
+    for (int i = 0; i <= node->key_count; i++) {
+        mark_reachable(tree, internal_get_child(node, i), height - 1, bitmap);
+        page_unpin_to(tree->pm, pins);
+    }
+}
+
+// 重建空闲位图
+// 后台写回期间空闲页面会被重新分配并写入新内容，崩溃后磁盘上的位图不再可信；
+// 检查点镜像本身没有被改写，从根出发可达的页面就是全部在用的页面（位图页下次刷盘时重新分配）
+int btree_rebuild_free_map(BTree *tree) {
+    PageManager *pm = tree->pm;
+    uint32_t count = pm->page_count;
+    uint64_t *reachable = calloc(((size_t)count + 63) / 64, sizeof(uint64_t));
+    if (!reachable) return -1;
+    reachable[0] |= 1;  // 文件头
+    mark_reachable(tree, tree->root_page, tree_height(tree), reachable);
+    
+    page_free_map_reset(pm);
+    for (uint32_t page_id = 1; page_id < count; page_id++) {
+        if (!(reachable[page_id / 64] & (1ULL << (page_id % 64)))) {
+            page_free(pm, page_id);
+        }
+    }
+    free(reachable);
+    return 0;
+}
+
+// ---- 压缩 ----
+// 在用页面数为 used 时，页号不小于 used 的页面和页号小于 used 的空闲页面一样多：
+// 把前者逐个复制到后者中页号最小的一个，文件尾部就只剩空闲页面，可以截掉
+
+typedef struct {
+    uint32_t limit;                       // 页号不小于它的页面需要搬动
+    size_t max;                           // 最多搬动的页面数（0 不限）
+    size_t moved;
+    uint32_t path[BTREE_MAX_DEPTH + 1];   // 根到当前节点经过的页面
+    int index[BTREE_MAX_DEPTH];           // path[i + 1] 是 path[i] 的第几个子节点
+} CompactState;
+
+// 搬动 path[depth]：先让路径上被快照共享的祖先成为私有页面（同样尽量复制到前部），再复制它本身。
+// 前部没有空闲页面时返回 1
+static int compact_move(BTree *tree, CompactState *st, int depth) {
+    for (int level = 0; level <= depth; level++) {
+        uint32_t page_id = st->path[level];
+        if (level < depth && !page_shared(tree, page_id)) continue;
+        uint32_t new_id = page_alloc_below(tree->pm, st->limit);
+        if (new_id == 0 && level < depth) new_id = page_alloc_near(tree->pm, page_id);
+        if (new_id == 0) return level < depth ? -1 : 1;
+        if (move_page(tree, page_id, new_id, level ? st->path[level - 1] : 0, level ? st->index[level - 1] : 0) < 0) {
+            page_free(tree->pm, new_id);
+            return -1;
+        }
+        st->path[level] = new_id;
+    }
+    st->moved++;
+    return 0;
+}
+
+// 先序遍历：节点需要搬动时先搬，再检查它的子节点。height 为节点以下的层数（0 为叶子），叶子不必读入
+static int compact_visit(BTree *tree, CompactState *st, int depth, uint32_t height) {
+    if (st->path[depth] >= st->limit) {
+        if (st->max && st->moved >= st->max) return 1;
+        int ret = compact_move(tree, st, depth);
+        if (ret != 0) return ret;
+    }
+    if (height == 0) return 0;
+    
+    PageManager *pm = tree->pm;
+    size_t pins = page_pin_mark(pm);
+    BTreeNode *node = get_node(pm, st->path[depth]);
+    if (!node) return -1;
+    int count = node->is_leaf ? -1 : node->key_count;
+    page_unpin_to(pm, pins);
+    for (int i = 0; i <= count; i++) {
+        // 搬动子节点时当前节点可能被复制，每次按 path 重新读取
+        node = get_node(pm, st->path[depth]);
+        if (!node) return -1;
+        st->index[depth] = i;
+        st->path[depth + 1] = internal_get_child(node, i);
+        page_unpin_to(pm, pins);
+        int ret = compact_visit(tree, st, depth + 1, height - 1);
+        if (ret != 0) return ret;
+    }
+    return 0;
+}
+
+// 把页号较大的节点搬到文件前部
+int btree_compact(BTree *tree, size_t max, size_t *moved) {
+    PageManager *pm = tree->pm;
+    CompactState st;
+    memset(&st, 0, sizeof(CompactState));
+    st.limit = pm->page_count - pm->free_count;
+    st.max = max;
+    st.path[0] = tree->root_page;
+    
+    int ret = compact_visit(tree, &st, 0, tree_height(tree));
+    *moved = st.moved;
+    return ret < 0 ? -1 : 0;
+}
+
 // 销毁 B+ 树
 void btree_destroy(BTree *tree) {
-    // 资源由 PageManager 管理，这里不需要特殊处理
+    // 页面由 PageManager 管理，这里只释放缓存和写时复制的记录
+    cache_clear(&tree->cache);
+    free(tree->page_gen);
+    free(tree->pending);
+    tree->page_gen = NULL;
+    tree->pending = NULL;
+    tree->pending_count = tree->pending_cap = tree->page_gen_cap = 0;
+    tree->shadow = NULL;
     tree->root_page = 0;
     tree->pm = NULL;
 }
-
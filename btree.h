@@ -6,41 +6,218 @@
 #include <stdbool.h>
 #include <stddef.h>
 
-// B+ 树配置
-#define BTREE_ORDER 4         // B+ 树的阶数（每个节点最多 key 数量）
+// B+ 树配置（节点按页面字节容量分裂，不限制 key 数量）
 #define MAX_KEY_SIZE 255      // 最大 key 长度
-#define MAX_VAL_SIZE 1024     // 最大 value 长度
+#define MAX_VAL_SIZE (64 * 1024 * 1024)  // 最大 value 长度
+#define MAX_INLINE_VAL 256    // 不超过该长度的 value 内联在叶子中，更长的存放在数据文件（.dat）中
 
-// B+ 树节点结构（存储在页面中）
+// B+ 树节点结构（存储在页面中，slotted page 格式）
+// 页面布局：节点头 | slot 数组（uint16_t 页内偏移，按 key 有序）| 空闲区 | cell 区（向前增长）| 公共前缀
+// 节点中所有 key 共享的前缀只在页尾存一份，cell 中的 key 只保存后缀，klen 为后缀长度
+//   叶子 cell：klen(u16) vlen(u16) key value
+//     vlen 最高位为溢出标志：置位时 value 存放在数据文件中，cell 中只保存 offset(u64) len(u32)
+//   内部 cell：child(u32) klen(u16) key   —— child 为该 key 右侧的子节点，最左子节点存于 child0
 typedef struct {
-    PageType type;            // 节点类型
-    uint32_t parent;          // 父节点页面 ID
-    uint32_t next;            // 下一个叶子节点（仅叶子节点使用）
-    uint16_t key_count;       // 当前 key 数量
+    uint16_t type;            // 节点类型（PageType）
     uint16_t is_leaf;         // 是否为叶子节点
-    // 数据部分：
-    // 对于叶子节点：key1, val1, key2, val2, ...
-    // 对于内部节点：key1, child1, key2, child2, ...
+    uint16_t key_count;       // 当前 key 数量（即 slot 数量）
+    uint16_t cell_start;      // cell 区起始偏移
+    uint16_t frag_bytes;      // 删除 cell 后留在 cell 区中的碎片字节数
+    uint16_t prefix_len;      // 公共前缀长度（版本 2 中为保留字段，恒为 0）
+    uint32_t reserved[2];     // 保留（曾为父节点页面 ID 和叶子的 next 指针，现已不再维护，旧文件中的值被忽略）
+    uint32_t child0;          // 最左子节点（仅内部节点使用）
 } BTreeNode;
 
+// 上层内部节点缓存：树顶 BTREE_CACHE_LEVELS 层的内部节点在内存中保存一份紧凑的查找结构
+// （分隔 key 的定长前缀 + 直接指向已缓存子节点的指针），节点分裂、合并时同步更新。
+// 查找只在写锁下修改缓存，持读锁的线程可以并发使用。
+#define BTREE_CACHE_LEVELS 3      // 缓存的层数（从根开始）
+#define BTREE_CACHE_NODES 4096    // 最多缓存的节点数
+
+typedef struct BTreeCacheNode BTreeCacheNode;
+
+typedef struct {
+    bool enabled;
+    BTreeCacheNode *root;         // 根节点的缓存（根为叶子或缓存关闭时为 NULL）
+    BTreeCacheNode **slots;       // 按页面 ID 开放寻址的哈希表
+    size_t slot_count;
+    size_t node_count;
+} BTreeCache;
+
+typedef struct BTreeSnapshot BTreeSnapshot;
+
+// 等待快照结束后才能回收的页面
+typedef struct {
+    uint32_t page_id;
+    uint32_t gen;             // 释放时的写入代数，早于它开始的快照可能还在读这个页面
+} BTreePendingFree;
+
 // B+ 树结构
+// 写时复制：有活跃快照时，快照能看到的页面不再原地修改，而是先复制到新页面（沿路径一直复制到根，
+// 再切换文件头中的根），旧页面等到引用它的快照全部结束后才标记为空闲。没有快照时照常原地修改。
 typedef struct {
     PageManager *pm;
     uint32_t root_page;       // 根节点页面 ID
+    BTreeCache cache;         // 上层内部节点缓存
+    uint32_t write_gen;       // 当前写入代数，每开始一个快照加一
+    uint32_t *page_gen;       // 有活跃快照期间分配的页面的代数（按页面 ID 索引，其余视为 0）
+    size_t page_gen_cap;
+    BTreeSnapshot *snap_oldest;       // 活跃快照链表（按开始顺序，代数递增）
+    BTreeSnapshot *snap_newest;
+    BTreePendingFree *pending;        // 按释放顺序排列（代数递增）
+    size_t pending_count;
+    size_t pending_cap;
+    BTreeSnapshot *shadow;            // 检查点镜像（见 btree_shadow_advance），存在时根的变化不写入文件头
 } BTree;
 
+// 读快照：保存开始时的根节点。tree 是该时刻的只读视图（不使用节点缓存），
+// 可以直接传给 btree_get2、游标等只读接口，不受之后写入的影响
+struct BTreeSnapshot {
+    BTree tree;
+    uint32_t gen;             // 开始时的写入代数
+    BTreeSnapshot *prev;
+    BTreeSnapshot *next;
+};
+
+// B+ 树形状统计
+typedef struct {
+    uint32_t depth;           // 树高（根到叶子的层数，只有根叶子时为 1）
+    uint64_t internal_count;  // 内部节点数
+    uint64_t leaf_count;      // 叶子节点数
+    uint64_t key_count;       // 键值对总数
+    double avg_fanout;        // 内部节点平均子节点数
+    double leaf_fill;         // 叶子节点平均字节填充率（0~1）
+    double internal_fill;     // 内部节点平均字节填充率（0~1）
+    uint64_t cached_nodes;    // 上层缓存中的内部节点数
+    uint64_t pending_pages;   // 等待快照结束后回收的页面数
+    uint64_t free_pages;      // 索引文件中的空闲页面数
+    uint64_t total_pages;     // 索引文件的页面总数（含文件头）
+} BTreeStats;
+
+// 游标下降路径的最大深度
+#define BTREE_MAX_DEPTH 32
+
+// 有序游标：定位到叶子中的一个 cell，next / prev 借助下降路径移动到相邻叶子（叶子之间没有链表，
+// 写时复制改变页面 ID 时不必改写兄弟节点）。
+// 游标直接指向页面内的 cell，树被修改后需要重新 seek。
+typedef struct {
+    BTree *tree;
+    uint32_t page_id;                       // 当前叶子页面 ID
+    int index;                              // 当前 cell 在叶子中的位置
+    bool valid;                             // 是否指向有效的键值对
+    bool path_valid;                        // path 是否对应当前叶子（批量写入修改叶子后失效）
+    int depth;                              // path 中的内部节点层数
+    uint32_t path_page[BTREE_MAX_DEPTH];    // 根到叶子经过的内部节点
+    uint16_t path_index[BTREE_MAX_DEPTH];   // 在每个内部节点中选择的子节点位置
+    char key[MAX_KEY_SIZE];                 // 拼接前缀后的当前 key
+} BTreeCursor;
+
+// 批量 put/get 的一项
+typedef struct {
+    const char *key;
+    const char *value;        // put：要写入的 value
+    char *buf;                // get：输出缓冲区
+    size_t buf_size;          // get：输出缓冲区大小
+    int result;               // 该项的结果：0 成功，-1 失败或未找到
+} BTreeBatchItem;
+
+// 批量加载默认的节点填充率
+#define BTREE_BULK_FILL 0.9
+
+// 批量加载的数据源：产生一个键值对返回 1，数据结束返回 0，出错返回 -1。
+// key/value 只需在下一次调用前有效。
+typedef int (*BTreeBulkNext)(void *ctx, const char **key, size_t *klen,
+                             const char **value, size_t *vlen);
+
 // 初始化 B+ 树
 int btree_init(BTree *tree, PageManager *pm);
 
 // 插入键值对
 int btree_insert(BTree *tree, const char *key, const char *value);
 
-// 查找值
+// 查找值（value 以 '\0' 结尾，超出缓冲区的部分被截断）
 int btree_get(BTree *tree, const char *key, char *value, size_t value_size);
 
 // 删除键值对
 int btree_delete(BTree *tree, const char *key);
 
+// 以下为显式长度版本：key/value 可以包含任意字节（包括 '\0'），按字节序比较
+
+// 插入键值对
+int btree_insert2(BTree *tree, const void *key, size_t klen, const void *value, size_t vlen);
+
+// 查找值：最多复制 value_size 字节（不追加 '\0'），vlen 返回 value 的完整长度
+int btree_get2(BTree *tree, const void *key, size_t klen, void *value, size_t value_size, size_t *vlen);
+
+// 查找值并返回其地址（未找到返回 NULL）：不超过 MAX_INLINE_VAL 的 value 指向叶子页面，
+// 只在树下次被修改前有效；更长的 value 指向数据文件的映射区域，数据文件只追加，地址一直有效
+const char* btree_get_ref(BTree *tree, const void *key, size_t klen, size_t *vlen);
+
+// 删除键值对
+int btree_delete2(BTree *tree, const void *key, size_t klen);
+
+// 批量插入：内部按 key 排序后依次插入，相邻 key 复用上一次的下降路径（同一 key 以后出现的为准）
+int btree_put_batch(BTree *tree, BTreeBatchItem *items, size_t count);
+
+// 批量查找：内部按 key 排序后依次查找，相邻 key 复用上一次的下降路径，返回命中数
+int btree_get_batch(BTree *tree, BTreeBatchItem *items, size_t count);
+
+// 向空树批量加载按 key 严格递增的键值对：顺序写满叶子，再逐层构建内部节点，最后写文件头。
+// fill_factor 为节点目标填充率（0~1，传 0 使用 BTREE_BULK_FILL）；树非空或 key 无序时返回 -1。
+int btree_bulk_load(BTree *tree, BTreeBulkNext next, void *ctx, double fill_factor);
+
+// 初始化游标（不指向任何 key）
+void btree_cursor_init(BTreeCursor *cursor, BTree *tree);
+
+// 定位到第一个 >= key 的键值对（key 为 NULL 时定位到第一个），没有则返回 -1
+int btree_cursor_seek(BTreeCursor *cursor, const char *key);
+int btree_cursor_seek2(BTreeCursor *cursor, const void *key, size_t klen);
+
+// 定位到最后一个键值对，树为空时返回 -1
+int btree_cursor_last(BTreeCursor *cursor);
+
+// 移动到下一个键值对，已到末尾返回 -1
+int btree_cursor_next(BTreeCursor *cursor);
+
+// 移动到上一个键值对，已到开头返回 -1
+int btree_cursor_prev(BTreeCursor *cursor);
+
+// 游标是否指向有效的键值对
+bool btree_cursor_valid(const BTreeCursor *cursor);
+
+// 获取当前 key / value（指向页面或游标内部，不以 '\0' 结尾，树修改或游标移动前有效）
+const char* btree_cursor_key(BTreeCursor *cursor, size_t *klen);
+const char* btree_cursor_value(const BTreeCursor *cursor, size_t *vlen);
+
+// 开始一个读快照（调用者保证期间没有写入）；快照结束前它能看到的页面不会被修改或回收
+void btree_snapshot_begin(BTree *tree, BTreeSnapshot *snap);
+
+// 结束快照，回收不再被任何快照引用的页面（调用者保证期间没有写入和其他快照操作）
+void btree_snapshot_end(BTree *tree, BTreeSnapshot *snap);
+
+// 检查点镜像：用一个内部快照 snap 冻结当前的树，此后的修改全部写时复制到新页面，磁盘上被文件头引用的页面
+// 不会被改写，脏页可以在两次检查点之间随时写回；期间根的变化只记在内存中，由检查点写入文件头。
+// 已有镜像时先冻结当前的树，再结束旧镜像（回收此后被替换掉的页面，旧镜像的快照结构可以再次使用）。
+// 调用者保证期间没有写入，且当前的树已经连同文件头落盘
+void btree_shadow_advance(BTree *tree, BTreeSnapshot *snap);
+
+// 结束检查点镜像，恢复原地修改（调用者保证期间没有写入）
+void btree_shadow_end(BTree *tree);
+
+// 重建空闲位图：从根不可达的页面全部标记为空闲（崩溃恢复时使用，见 HEADER_FLAG_SHADOW）
+int btree_rebuild_free_map(BTree *tree);
+
+// 压缩一步：把编号不小于已用页面数（page_count - 空闲页面数）的节点搬到最靠前的空闲页面，
+// 最多搬动 max 个，搬动数写入 moved。被快照共享的祖先先写时复制；被替换的旧页面按 tree_free_page 回收
+// （有快照或检查点镜像时要等它们结束）。调用者持有写锁；返回 0 成功，-1 失败
+int btree_compact(BTree *tree, size_t max, size_t *moved);
+
+// 开启或关闭上层内部节点缓存（默认开启）
+void btree_set_node_cache(BTree *tree, bool enabled);
+
+// 统计树的深度、扇出和填充率（遍历整棵树）
+int btree_stats(BTree *tree, BTreeStats *stats);
+
 // 销毁 B+ 树（释放资源）
 void btree_destroy(BTree *tree);
 
@@ -0,0 +1,646 @@
+#define _POSIX_C_SOURCE 200809L
+#include "bufpool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define FRAME_NONE (-1)
+
+// 页框所在的队列
+enum {
+    QUEUE_FREE = 0,
+    QUEUE_A1IN = 1,
+    QUEUE_AM = 2
+};
+
+// 线程的钉住栈：按钉住顺序记录页框下标，同一页框可以出现多次
+typedef struct {
+    int32_t *frames;
+    size_t count;
+    size_t cap;
+} PinStack;
+
+static void pin_stack_free(void *ptr) {
+    PinStack *stack = ptr;
+    if (stack) {
+        free(stack->frames);
+        free(stack);
+    }
+}
+
+// 获取调用线程的钉住栈并保证还能再压入一项
+static PinStack* pin_stack_reserve(BufferPool *pool) {
+    PinStack *stack = pthread_getspecific(pool->pins_key);
+    if (!stack) {
+        stack = calloc(1, sizeof(PinStack));
+        if (!stack || pthread_setspecific(pool->pins_key, stack) != 0) {
+            free(stack);
+            return NULL;
+        }
+    }
+    if (stack->count == stack->cap) {
+        size_t cap = stack->cap ? stack->cap * 2 : 64;
+        int32_t *frames = realloc(stack->frames, cap * sizeof(int32_t));
+        if (!frames) return NULL;
+        stack->frames = frames;
+        stack->cap = cap;
+    }
+    return stack;
+}
+
+// ---- 队列（双向链表，以页框下标相连） ----
+
+static FrameQueue* queue_of(BufferPool *pool, int queue) {
+    if (queue == QUEUE_A1IN) return &pool->a1in;
+    if (queue == QUEUE_AM) return &pool->am;
+    return &pool->free_frames;
+}
+
+static void queue_push_head(BufferPool *pool, int queue, int32_t f) {
+    FrameQueue *q = queue_of(pool, queue);
+    BufferFrame *frame = &pool->frames[f];
+    frame->queue = (uint8_t)queue;
+    frame->prev = FRAME_NONE;
+    frame->next = q->head;
+    if (q->head != FRAME_NONE) {
+        pool->frames[q->head].prev = f;
+    } else {
+        q->tail = f;
+    }
+    q->head = f;
+    q->count++;
+}
+
+static void queue_remove(BufferPool *pool, int32_t f) {
+    BufferFrame *frame = &pool->frames[f];
+    FrameQueue *q = queue_of(pool, frame->queue);
+    if (frame->prev != FRAME_NONE) {
+        pool->frames[frame->prev].next = frame->next;
+    } else {
+        q->head = frame->next;
+    }
+    if (frame->next != FRAME_NONE) {
+        pool->frames[frame->next].prev = frame->prev;
+    } else {
+        q->tail = frame->prev;
+    }
+    q->count--;
+}
+
+// ---- 页号哈希表 ----
+
+static inline size_t bucket_of(BufferPool *pool, uint32_t page_id) {
+    return (page_id * 2654435761u) & pool->bucket_mask;
+}
+
+static int32_t hash_find(BufferPool *pool, uint32_t page_id) {
+    int32_t f = pool->buckets[bucket_of(pool, page_id)];
+    while (f != FRAME_NONE && pool->frames[f].page_id != page_id) {
+        f = pool->frames[f].hash_next;
+    }
+    return f;
+}
+
+static void hash_insert(BufferPool *pool, int32_t f) {
+    size_t b = bucket_of(pool, pool->frames[f].page_id);
+    pool->frames[f].hash_next = pool->buckets[b];
+    pool->buckets[b] = f;
+}
+
+static void hash_remove(BufferPool *pool, int32_t f) {
+    int32_t *link = &pool->buckets[bucket_of(pool, pool->frames[f].page_id)];
+    while (*link != f) {
+        link = &pool->frames[*link].hash_next;
+    }
+    *link = pool->frames[f].hash_next;
+}
+
+// ---- A1out：只记页号的幽灵队列 ----
+// 第 n 个进入 A1out 的页号记下序号 n，序号落后最新序号不到 kout 的页号仍在队列中
+
+static void ghost_add(BufferPool *pool, uint32_t page_id) {
+    if (page_id >= pool->ghost_cap) {
+        size_t cap = pool->ghost_cap ? pool->ghost_cap : 1024;
+        while (cap <= page_id) cap *= 2;
+        uint32_t *ghost = realloc(pool->ghost, cap * sizeof(uint32_t));
+        if (!ghost) return;  // 记不下只是少一次晋升机会
+        memset(ghost + pool->ghost_cap, 0, (cap - pool->ghost_cap) * sizeof(uint32_t));
+        pool->ghost = ghost;
+        pool->ghost_cap = cap;
+    }
+    if (++pool->ghost_seq == 0) pool->ghost_seq = 1;
+    pool->ghost[page_id] = pool->ghost_seq;
+}
+
+// 页号在 A1out 中时将其移出并返回 true
+static bool ghost_take(BufferPool *pool, uint32_t page_id) {
+    if (page_id >= pool->ghost_cap || pool->ghost[page_id] == 0) return false;
+    bool hit = pool->ghost_seq - pool->ghost[page_id] < pool->kout;
+    pool->ghost[page_id] = 0;
+    return hit;
+}
+
+// ---- 读写页面 ----
+
+static int pread_page(int fd, uint8_t *buf, uint32_t page_id) {
+    AioRequest req = {fd, false, buf, PAGE_SIZE, (uint64_t)page_id * PAGE_SIZE, 0};
+    return aio_sync(&req);
+}
+
+static int pwrite_page(int fd, const uint8_t *buf, uint32_t page_id) {
+    AioRequest req = {fd, true, (void*)buf, PAGE_SIZE, (uint64_t)page_id * PAGE_SIZE, 0};
+    return aio_sync(&req);
+}
+
+// ---- 分配与淘汰 ----
+
+// 淘汰一个未被钉住的页框：脏页先写回，A1in 中的页号记入 A1out
+static int frame_evict(BufferPool *pool, int32_t f) {
+    BufferFrame *frame = &pool->frames[f];
+    if (frame->dirty) {
+        if (pwrite_page(pool->fd, frame->data, frame->page_id) < 0) return -1;
+        frame->dirty = false;
+        pool->stats->pool_writebacks++;
+    }
+    if (frame->queue == QUEUE_A1IN) {
+        ghost_add(pool, frame->page_id);
+    }
+    queue_remove(pool, f);
+    hash_remove(pool, f);
+    pool->stats->pool_evictions++;
+    return 0;
+}
+
+// 从队尾向前淘汰第一个未被钉住的页框
+static int32_t queue_evict(BufferPool *pool, FrameQueue *q) {
+    for (int32_t f = q->tail; f != FRAME_NONE; f = pool->frames[f].prev) {
+        if (pool->frames[f].pins == 0 && frame_evict(pool, f) == 0) return f;
+    }
+    return FRAME_NONE;
+}
+
+// 所有页框都被钉住时增加一个页框
+static int32_t frame_grow(BufferPool *pool) {
+    BufferFrame *frames = realloc(pool->frames, (pool->frame_count + 1) * sizeof(BufferFrame));
+    if (!frames) return FRAME_NONE;
+    pool->frames = frames;
+    
+    void *data;
+    if (posix_memalign(&data, PAGE_SIZE, PAGE_SIZE) != 0) return FRAME_NONE;
+    int32_t f = (int32_t)pool->frame_count++;
+    memset(&pool->frames[f], 0, sizeof(BufferFrame));
+    pool->frames[f].data = data;
+    pool->stats->pool_overflow++;
+    return f;
+}
+
+// 超出 capacity 的页框不再被钉住时淘汰回空闲队列；页框数组末尾的空闲页框随即释放内存，
+// 页框数回落到 capacity（中间的留在空闲队列中，下次分配优先复用）
+static void frame_release(BufferPool *pool, int32_t f) {
+    BufferFrame *frame = &pool->frames[f];
+    if ((size_t)f >= pool->capacity && frame->pins == 0 && frame->queue != QUEUE_FREE &&
+        frame_evict(pool, f) == 0) {
+        queue_push_head(pool, QUEUE_FREE, f);
+    }
+    while (pool->frame_count > pool->capacity) {
+        int32_t last = (int32_t)pool->frame_count - 1;
+        frame = &pool->frames[last];
+        if (frame->pins > 0 || frame->queue != QUEUE_FREE) break;
+        queue_remove(pool, last);
+        free(frame->data);
+        pool->frame_count--;
+    }
+}
+
+// 取得一个空页框（已移出所有队列和哈希表）
+static int32_t frame_alloc(BufferPool *pool) {
+    int32_t f = pool->free_frames.tail;
+    if (f != FRAME_NONE) {
+        queue_remove(pool, f);
+        return f;
+    }
+    
+    // A1in 超过目标长度时先淘汰 A1in，否则先淘汰 Am；优先的队列全被钉住时再试另一个
+    bool a1in_first = pool->a1in.count > pool->kin || pool->am.count == 0;
+    f = queue_evict(pool, a1in_first ? &pool->a1in : &pool->am);
+    if (f == FRAME_NONE) f = queue_evict(pool, a1in_first ? &pool->am : &pool->a1in);
+    if (f == FRAME_NONE) f = frame_grow(pool);
+    return f;
+}
+
+// 把已读入数据的空页框登记为 page_id：在 A1out 中的页号直接进入 Am
+static void frame_install(BufferPool *pool, int32_t f, uint32_t page_id) {
+    BufferFrame *frame = &pool->frames[f];
+    frame->page_id = page_id;
+    frame->pins = 0;
+    frame->dirty = false;
+    hash_insert(pool, f);
+    queue_push_head(pool, ghost_take(pool, page_id) ? QUEUE_AM : QUEUE_A1IN, f);
+}
+
+// 找到或读入页面所在的页框（调用者持有互斥锁）
+static int32_t frame_fetch(BufferPool *pool, uint32_t page_id) {
+    int32_t f = hash_find(pool, page_id);
+    if (f != FRAME_NONE) {
+        pool->stats->pool_hits++;
+        // Am 中的页面移到 LRU 头部；A1in 中的页面保持不动，短时间内的重复访问不算热点
+        if (pool->frames[f].queue == QUEUE_AM && pool->am.head != f) {
+            queue_remove(pool, f);
+            queue_push_head(pool, QUEUE_AM, f);
+        }
+        return f;
+    }
+    
+    pool->stats->pool_misses++;
+    f = frame_alloc(pool);
+    if (f == FRAME_NONE) return FRAME_NONE;
+    BufferFrame *frame = &pool->frames[f];
+    if (pread_page(pool->fd, frame->data, page_id) < 0) {
+        queue_push_head(pool, QUEUE_FREE, f);
+        return FRAME_NONE;
+    }
+    frame_install(pool, f, page_id);
+    return f;
+}
+
+// ---- 接口 ----
+
+BufferPool* bufpool_create(int fd, size_t capacity, PageStats *stats, unsigned io_depth, AioBackend io_backend) {
+    if (capacity < BUFPOOL_MIN_FRAMES) capacity = BUFPOOL_MIN_FRAMES;
+    if (capacity > INT32_MAX / 2) return NULL;
+    
+    BufferPool *pool = calloc(1, sizeof(BufferPool));
+    if (!pool) return NULL;
+    pool->fd = fd;
+    pool->stats = stats;
+    pool->capacity = capacity;
+    pool->frame_count = capacity;
+    pool->kin = capacity / 4;
+    pool->kout = capacity / 2;
+    
+    size_t buckets = 1;
+    while (buckets < capacity * 2) buckets *= 2;
+    pool->bucket_mask = buckets - 1;
+    pool->frames = calloc(capacity, sizeof(BufferFrame));
+    pool->buckets = malloc(buckets * sizeof(int32_t));
+    void *block = NULL;
+    if (!pool->frames || !pool->buckets || posix_memalign(&block, PAGE_SIZE, capacity * PAGE_SIZE) != 0) {
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
+        return NULL;
+    }
+    pool->block = block;
+    if (aio_init(&pool->aio, io_depth, io_backend) < 0) {
+        free(pool->block);
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
+        return NULL;
+    }
+    if (pthread_key_create(&pool->pins_key, pin_stack_free) != 0) {
+        aio_destroy(&pool->aio);
+        free(pool->block);
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    
+    for (size_t b = 0; b < buckets; b++) {
+        pool->buckets[b] = FRAME_NONE;
+    }
+    pool->free_frames.head = pool->free_frames.tail = FRAME_NONE;
+    pool->a1in.head = pool->a1in.tail = FRAME_NONE;
+    pool->am.head = pool->am.tail = FRAME_NONE;
+    for (size_t i = 0; i < capacity; i++) {
+        pool->frames[i].data = pool->block + i * PAGE_SIZE;
+        queue_push_head(pool, QUEUE_FREE, (int32_t)i);
+    }
+    return pool;
+}
+
+void bufpool_destroy(BufferPool *pool) {
+    if (!pool) return;
+    
+    // 其他线程的钉住栈在线程退出时由析构函数释放
+    pin_stack_free(pthread_getspecific(pool->pins_key));
+    pthread_setspecific(pool->pins_key, NULL);
+    pthread_key_delete(pool->pins_key);
+    pthread_mutex_destroy(&pool->mutex);
+    aio_destroy(&pool->aio);
+    if (pool->writeback_ready) aio_destroy(&pool->writeback_aio);
+    
+    for (size_t i = pool->capacity; i < pool->frame_count; i++) {
+        free(pool->frames[i].data);
+    }
+    free(pool->block);
+    free(pool->frames);
+    free(pool->buckets);
+    free(pool->ghost);
+    free(pool);
+}
+
+Page* bufpool_get(BufferPool *pool, uint32_t page_id) {
+    PinStack *stack = pin_stack_reserve(pool);
+    if (!stack) return NULL;
+    
+    pthread_mutex_lock(&pool->mutex);
+    Page *page = NULL;
+    int32_t f = frame_fetch(pool, page_id);
+    if (f != FRAME_NONE) {
+        pool->frames[f].pins++;
+        stack->frames[stack->count++] = f;
+        page = (Page*)pool->frames[f].data;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return page;
+}
+
+Page* bufpool_pin(BufferPool *pool, uint32_t page_id) {
+    pthread_mutex_lock(&pool->mutex);
+    Page *page = NULL;
+    int32_t f = frame_fetch(pool, page_id);
+    if (f != FRAME_NONE) {
+        pool->frames[f].pins++;
+        page = (Page*)pool->frames[f].data;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return page;
+}
+
+size_t bufpool_pin_mark(BufferPool *pool) {
+    PinStack *stack = pthread_getspecific(pool->pins_key);
+    return stack ? stack->count : 0;
+}
+
+void bufpool_unpin_to(BufferPool *pool, size_t mark) {
+    PinStack *stack = pthread_getspecific(pool->pins_key);
+    if (!stack || stack->count <= mark) return;
+    
+    pthread_mutex_lock(&pool->mutex);
+    while (stack->count > mark) {
+        int32_t f = stack->frames[--stack->count];
+        if (--pool->frames[f].pins == 0 && pool->frame_count > pool->capacity) frame_release(pool, f);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+bool bufpool_mark_dirty(BufferPool *pool, uint32_t page_id) {
+    pthread_mutex_lock(&pool->mutex);
+    bool became_dirty = false;
+    int32_t f = hash_find(pool, page_id);
+    if (f != FRAME_NONE && !pool->frames[f].dirty) {
+        pool->frames[f].dirty = true;
+        became_dirty = true;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return became_dirty;
+}
+
+// 刷盘时按页号排序的脏页框
+typedef struct {
+    uint32_t page_id;
+    int32_t frame;
+} DirtyEntry;
+
+static int compare_dirty(const void *a, const void *b) {
+    uint32_t x = ((const DirtyEntry*)a)->page_id;
+    uint32_t y = ((const DirtyEntry*)b)->page_id;
+    return (x > y) - (x < y);
+}
+
+int bufpool_flush(BufferPool *pool) {
+    int ret = 0;
+    pthread_mutex_lock(&pool->mutex);
+    
+    size_t count = 0;
+    DirtyEntry *dirty = malloc(pool->frame_count * sizeof(DirtyEntry));
+    AioRequest *reqs = malloc(pool->frame_count * sizeof(AioRequest));
+    if (!dirty || !reqs) {
+        pthread_mutex_unlock(&pool->mutex);
+        free(dirty);
+        free(reqs);
+        return -1;
+    }
+    for (size_t i = 0; i < pool->frame_count; i++) {
+        if (pool->frames[i].dirty && pool->frames[i].page_id != 0) {
+            dirty[count].page_id = pool->frames[i].page_id;
+            dirty[count].frame = (int32_t)i;
+            count++;
+        }
+    }
+    
+    // 按页号顺序排好后整批提交，写完再统一 fdatasync
+    qsort(dirty, count, sizeof(DirtyEntry), compare_dirty);
+    for (size_t i = 0; i < count; i++) {
+        BufferFrame *frame = &pool->frames[dirty[i].frame];
+        AioRequest req = {pool->fd, true, frame->data, PAGE_SIZE, (uint64_t)frame->page_id * PAGE_SIZE, 0};
+        reqs[i] = req;
+    }
+    if (count > 0) {
+        aio_run(&pool->aio, reqs, count);
+        pool->stats->io_batches++;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (reqs[i].result != 0) {
+            ret = -1;
+            continue;
+        }
+        pool->frames[dirty[i].frame].dirty = false;
+        pool->stats->flushed_bytes += PAGE_SIZE;
+    }
+    free(dirty);
+    free(reqs);
+    
+    if (count > 0) {
+        pool->stats->msync_calls++;
+        if (fdatasync(pool->fd) < 0) ret = -1;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return ret;
+}
+
+int bufpool_flush_page(BufferPool *pool, uint32_t page_id) {
+    int ret = 0;
+    pthread_mutex_lock(&pool->mutex);
+    int32_t f = hash_find(pool, page_id);
+    if (f != FRAME_NONE && pool->frames[f].dirty) {
+        BufferFrame *frame = &pool->frames[f];
+        if (pwrite_page(pool->fd, frame->data, page_id) < 0) {
+            ret = -1;
+        } else {
+            frame->dirty = false;
+            pool->stats->flushed_bytes += PAGE_SIZE;
+            pool->stats->msync_calls++;
+            if (fdatasync(pool->fd) < 0) ret = -1;
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return ret;
+}
+
+static int compare_page_id(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+void bufpool_discard(BufferPool *pool, uint32_t first_page) {
+    pthread_mutex_lock(&pool->mutex);
+    for (size_t i = 0; i < pool->frame_count; i++) {
+        BufferFrame *frame = &pool->frames[i];
+        if (frame->queue == QUEUE_FREE || frame->page_id < first_page || frame->pins > 0) continue;
+        queue_remove(pool, (int32_t)i);
+        hash_remove(pool, (int32_t)i);
+        frame->dirty = false;
+        queue_push_head(pool, QUEUE_FREE, (int32_t)i);
+    }
+    for (size_t page_id = first_page; page_id < pool->ghost_cap; page_id++) {
+        pool->ghost[page_id] = 0;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+size_t bufpool_dirty_count(BufferPool *pool) {
+    size_t count = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (size_t i = 0; i < pool->frame_count; i++) {
+        if (pool->frames[i].dirty) count++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return count;
+}
+
+// 从上一轮停下的位置继续轮转查找，每个脏页框都会轮到
+size_t bufpool_writeback_take(BufferPool *pool, uint32_t *ids, size_t max) {
+    size_t n = 0;
+    pthread_mutex_lock(&pool->mutex);
+    size_t i = pool->writeback_cursor;
+    for (size_t scanned = 0; scanned < pool->frame_count && n < max; scanned++, i++) {
+        if (i >= pool->frame_count) i = 0;
+        BufferFrame *frame = &pool->frames[i];
+        if (!frame->dirty || frame->page_id == 0) continue;
+        frame->dirty = false;
+        frame->pins++;
+        ids[n++] = frame->page_id;
+    }
+    pool->writeback_cursor = i;
+    pthread_mutex_unlock(&pool->mutex);
+    qsort(ids, n, sizeof(uint32_t), compare_page_id);
+    return n;
+}
+
+// 被钉住的页框不会被淘汰，其数据地址在写盘期间保持有效；写盘时页面仍可能被修改，
+// 修改者会重新标记脏页，下一轮再写
+int bufpool_writeback(BufferPool *pool, const uint32_t *ids, size_t count) {
+    if (count == 0) return 0;
+    AioRequest *reqs = calloc(count, sizeof(AioRequest));
+    
+    pthread_mutex_lock(&pool->mutex);
+    for (size_t i = 0; reqs && i < count; i++) {
+        BufferFrame *frame = &pool->frames[hash_find(pool, ids[i])];
+        AioRequest req = {pool->fd, true, frame->data, PAGE_SIZE, (uint64_t)ids[i] * PAGE_SIZE, -1};
+        reqs[i] = req;
+    }
+    if (reqs && !pool->writeback_ready &&
+        aio_init(&pool->writeback_aio, pool->aio.depth, pool->aio.backend) == 0) {
+        pool->writeback_ready = true;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    
+    if (reqs) {
+        // 创建不了批量 I/O 时逐个同步写
+        int errors = 0;
+        if (pool->writeback_ready) {
+            errors = aio_run(&pool->writeback_aio, reqs, count);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                if (aio_sync(&reqs[i]) < 0) errors++;
+            }
+        }
+        if (errors < (int)count && fdatasync(pool->fd) < 0) {
+            for (size_t i = 0; i < count; i++) {
+                reqs[i].result = -1;
+            }
+        }
+    }
+    
+    int failed = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (size_t i = 0; i < count; i++) {
+        BufferFrame *frame = &pool->frames[hash_find(pool, ids[i])];
+        if (!reqs || reqs[i].result != 0) {
+            frame->dirty = true;
+            failed++;
+        }
+        if (--frame->pins == 0 && pool->frame_count > pool->capacity) {
+            frame_release(pool, (int32_t)(frame - pool->frames));
+        }
+    }
+    pool->stats->io_batches++;
+    pthread_mutex_unlock(&pool->mutex);
+    free(reqs);
+    return failed;
+}
+
+// 预读：为不在缓冲池中的页面分配页框，整批读入后再登记到哈希表和队列。
+// 读入期间页框不在任何队列中，不会被本批后面的分配淘汰
+size_t bufpool_prefetch(BufferPool *pool, const uint32_t *page_ids, size_t count) {
+    if (count == 0) return 0;
+    uint32_t *ids = malloc(count * sizeof(uint32_t));
+    AioRequest *reqs = malloc(count * sizeof(AioRequest));
+    int32_t *frames = malloc(count * sizeof(int32_t));
+    if (!ids || !reqs || !frames) {
+        free(ids);
+        free(reqs);
+        free(frames);
+        return 0;
+    }
+    
+    // 按页号排序去重，读盘也按文件顺序提交
+    memcpy(ids, page_ids, count * sizeof(uint32_t));
+    qsort(ids, count, sizeof(uint32_t), compare_page_id);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique == 0 || ids[unique - 1] != ids[i]) ids[unique++] = ids[i];
+    }
+    
+    pthread_mutex_lock(&pool->mutex);
+    size_t limit = pool->capacity / 2;
+    size_t n = 0;
+    for (size_t i = 0; i < unique && n < limit; i++) {
+        uint32_t page_id = ids[i];
+        if (hash_find(pool, page_id) != FRAME_NONE) continue;
+        
+        int32_t f = frame_alloc(pool);
+        if (f == FRAME_NONE) break;
+        pool->frames[f].page_id = page_id;
+        AioRequest req = {pool->fd, false, pool->frames[f].data, PAGE_SIZE, (uint64_t)page_id * PAGE_SIZE, 0};
+        reqs[n] = req;
+        frames[n] = f;
+        n++;
+    }
+    
+    size_t loaded = 0;
+    if (n > 0) {
+        aio_run(&pool->aio, reqs, n);
+        pool->stats->io_batches++;
+        for (size_t i = 0; i < n; i++) {
+            if (reqs[i].result != 0) {
+                queue_push_head(pool, QUEUE_FREE, frames[i]);
+                continue;
+            }
+            frame_install(pool, frames[i], pool->frames[frames[i]].page_id);
+            loaded++;
+        }
+        pool->stats->pool_prefetched += loaded;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    free(ids);
+    free(reqs);
+    free(frames);
+    return loaded;
+}
@@ -0,0 +1,109 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include "page.h"
+#include "aio.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// 缓冲池：用固定数量的页框缓存索引文件的页面，按 pread/pwrite 读写，代替 mmap 和内核的缺页/预读。
+//
+// 淘汰策略为 2Q：第一次被访问的页面进入 FIFO 队列 A1in，从 A1in 淘汰时页号记入幽灵队列 A1out
+// （只记页号不占页框）；在 A1out 中再次被访问的页面才进入 LRU 队列 Am。A1in 超过目标长度时优先从它淘汰，
+// 否则淘汰 Am 最久未用的页面。一次性的全表扫描只会轮转 A1in，不会挤掉 Am 中反复访问的页面。
+//
+// 钉住（pin）：bufpool_get 返回的页框被调用线程钉住，记在该线程的钉住栈上，直到 bufpool_unpin_to 释放；
+// 钉住的页框不会被淘汰。所有页框都被钉住时临时增加页框而不是失败（见 PageStats.pool_overflow），
+// 多出的页框解除钉住后即淘汰并释放，页框数回落到 capacity。
+// 元数据由一个互斥锁保护，读盘和写回也在锁内进行。
+//
+// 单个页面的未命中直接 pread；预读一组页面和刷盘写回所有脏页时，请求经 aio_run 一次批量提交
+// （io_uring 或线程池，见 aio.h），同时在途的请求数为队列深度。
+
+#define BUFPOOL_MIN_FRAMES 64     // 页框数下限：一次树操作同时钉住的页面数远小于它
+
+typedef struct {
+    uint8_t *data;            // 页面内容（PAGE_SIZE 字节，地址在页框生命周期内不变）
+    uint32_t page_id;
+    uint32_t pins;            // 所有线程合计的钉住次数
+    int32_t prev, next;       // 所在队列中的前后页框
+    int32_t hash_next;        // 哈希链中的下一个页框
+    uint8_t queue;            // 所在队列
+    bool dirty;
+} BufferFrame;
+
+typedef struct {
+    int32_t head;             // 最近加入（Am 中为最近使用）的一端
+    int32_t tail;             // 下一个淘汰候选的一端
+    size_t count;
+} FrameQueue;
+
+struct BufferPool {
+    int fd;                   // 索引文件
+    PageStats *stats;         // 命中、淘汰等计数写到页面管理器的统计中
+    BufferFrame *frames;
+    size_t frame_count;       // 当前页框数（被全部钉住时会超过 capacity）
+    size_t capacity;          // 目标页框数
+    uint8_t *block;           // 前 capacity 个页框共用的内存
+    int32_t *buckets;         // 页号 -> 页框的哈希表（链式）
+    size_t bucket_mask;
+    FrameQueue free_frames;   // 尚未使用的页框
+    FrameQueue a1in;          // 2Q 的 FIFO 队列
+    FrameQueue am;            // 2Q 的 LRU 队列
+    size_t kin;               // A1in 的目标长度
+    size_t kout;              // A1out 记住的页号数
+    uint32_t *ghost;          // 按页号记录进入 A1out 时的序号（0 表示不在 A1out）
+    size_t ghost_cap;
+    uint32_t ghost_seq;       // 进入 A1out 的页号总数
+    pthread_mutex_t mutex;
+    pthread_key_t pins_key;   // 每个线程的钉住栈
+    AioContext aio;           // 预读和刷盘的批量 I/O
+    AioContext writeback_aio; // 后台写回的批量 I/O（不持有互斥锁，第一次写回时创建）
+    bool writeback_ready;
+    size_t writeback_cursor;  // 下一轮从这个页框开始找脏页
+};
+
+// 创建 capacity 个页框的缓冲池（不足 BUFPOOL_MIN_FRAMES 时取下限），批量 I/O 的队列深度为 io_depth，失败返回 NULL
+BufferPool* bufpool_create(int fd, size_t capacity, PageStats *stats, unsigned io_depth, AioBackend io_backend);
+
+// 销毁缓冲池（不写回脏页，调用者先 bufpool_flush）
+void bufpool_destroy(BufferPool *pool);
+
+// 读取页面并由调用线程钉住，读盘失败返回 NULL
+Page* bufpool_get(BufferPool *pool, uint32_t page_id);
+
+// 读取页面并一直钉住到缓冲池销毁（不记入线程的钉住栈，用于文件头）
+Page* bufpool_pin(BufferPool *pool, uint32_t page_id);
+
+// 调用线程的钉住栈深度 / 释放 mark 之后的钉住
+size_t bufpool_pin_mark(BufferPool *pool);
+void bufpool_unpin_to(BufferPool *pool, size_t mark);
+
+// 把不在缓冲池中的页面一次批量读入（不钉住），返回读入的页面数；最多读入页框数的一半，其余忽略
+size_t bufpool_prefetch(BufferPool *pool, const uint32_t *page_ids, size_t count);
+
+// 标记页面为脏（页面必须已被钉住），由干净变脏时返回 true
+bool bufpool_mark_dirty(BufferPool *pool, uint32_t page_id);
+
+// 按页号顺序批量写回所有脏页（页面 0 即文件头除外，由调用者最后单独写），然后 fdatasync
+int bufpool_flush(BufferPool *pool);
+
+// 只写回指定页面并 fdatasync（页面干净或不在缓冲池中时什么也不做）
+int bufpool_flush_page(BufferPool *pool, uint32_t page_id);
+
+// 丢弃页号不小于 first_page 的页框（不写回，文件即将在这里截短），被钉住的页框保留
+void bufpool_discard(BufferPool *pool, uint32_t first_page);
+
+// 当前的脏页框数
+size_t bufpool_dirty_count(BufferPool *pool);
+
+// 后台写回：取出最多 max 个脏页框（页面 0 除外），清除脏标记并钉住，页号按递增顺序写入 ids，返回个数
+size_t bufpool_writeback_take(BufferPool *pool, uint32_t *ids, size_t max);
+
+// 写入 bufpool_writeback_take 取出的页面（写盘时不持有互斥锁，同一时刻只能有一个线程调用），
+// 然后释放钉住。写入失败的页框重新标记为脏，返回失败数
+int bufpool_writeback(BufferPool *pool, const uint32_t *ids, size_t count);
+
+#endif // BUFPOOL_H
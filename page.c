@@ -1,5 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS、MAP_NORESERVE
 #include "page.h"
+#include "bufpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,129 +11,387 @@
 #include <sys/mman.h>
 #include <errno.h>
 
-// 文件头结构（存储在索引文件页面 0）
-typedef struct {
-    uint32_t magic;           // 魔数，用于验证文件格式
-    uint32_t version;         // 版本号
-    uint32_t page_count;      // 总页面数
-    uint32_t root_page;       // B+ 树根页面
-    uint32_t free_page_list;  // 空闲页面链表头
-    char reserved[PAGE_SIZE - 20]; // 保留空间
-} FileHeader;
+#define MIN_FILE_SIZE ((size_t)INITIAL_PAGES * PAGE_SIZE)  // 最小文件大小
 
-#define MAGIC_NUMBER 0x53514C42  // "BLSQ" (B+ Tree Storage)
-#define MIN_FILE_SIZE (MAX_PAGES * PAGE_SIZE)  // 最小文件大小
+// 预留一段只占地址空间、不占内存的虚拟区域（PROT_NONE + MAP_NORESERVE）
+static void* reserve_region(size_t min_size, size_t *reserved) {
+    for (size_t size = MAX_RESERVE_SIZE; size >= MIN_RESERVE_SIZE && size >= min_size; size /= 2) {
+        void *base = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base != MAP_FAILED) {
+            *reserved = size;
+            return base;
+        }
+    }
+    return MAP_FAILED;
+}
 
-// 初始化页面管理器
-int page_manager_init(PageManager *pm, const char *db_file) {
-    memset(pm, 0, sizeof(PageManager));
+// 将文件的 [from, to) 区间映射到预留区域的相同偏移处
+static int map_file_range(void *base, int fd, size_t from, size_t to) {
+    if (to <= from) return 0;
+    void *addr = mmap((char*)base + from, to - from, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_FIXED, fd, (off_t)from);
+    return addr == MAP_FAILED ? -1 : 0;
+}
+
+// 打开文件，文件不足最小大小时扩展
+static int open_file(const char *path, int *fd, size_t *size) {
+    *fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (*fd < 0) {
+        return -1;
+    }
     
-    // 构建索引文件和数据文件名
-    char index_file[512];
-    char data_file[512];
-    snprintf(index_file, sizeof(index_file), "%s.idx", db_file);
-    snprintf(data_file, sizeof(data_file), "%s.dat", db_file);
+    struct stat st;
+    if (fstat(*fd, &st) < 0) {
+        close(*fd);
+        return -1;
+    }
     
-    // 打开或创建索引文件
-    pm->fd_index = open(index_file, O_RDWR | O_CREAT, 0644);
-    if (pm->fd_index < 0) {
+    // 确保文件大小至少为最小大小
+    if ((size_t)st.st_size < MIN_FILE_SIZE) {
+        if (ftruncate(*fd, MIN_FILE_SIZE) < 0) {
+            close(*fd);
+            return -1;
+        }
+        st.st_size = MIN_FILE_SIZE;
+    }
+    *size = st.st_size;
+    return 0;
+}
+
+// 打开文件并映射到新预留的地址空间
+static int open_mapped_file(const char *path, int *fd, void **base, size_t *size, size_t *reserved) {
+    if (open_file(path, fd, size) < 0) {
         return -1;
     }
     
-    // 打开或创建数据文件
-    pm->fd_data = open(data_file, O_RDWR | O_CREAT, 0644);
-    if (pm->fd_data < 0) {
-        close(pm->fd_index);
+    *base = reserve_region(*size, reserved);
+    if (*base == MAP_FAILED) {
+        close(*fd);
         return -1;
     }
     
-    // 检查索引文件大小
-    struct stat st;
-    if (fstat(pm->fd_index, &st) < 0) {
-        close(pm->fd_index);
-        close(pm->fd_data);
+    if (map_file_range(*base, *fd, 0, *size) < 0) {
+        munmap(*base, *reserved);
+        close(*fd);
         return -1;
     }
     
-    // 确保文件大小至少为最小大小
-    if (st.st_size < MIN_FILE_SIZE) {
-        if (ftruncate(pm->fd_index, MIN_FILE_SIZE) < 0) {
-            close(pm->fd_index);
-            close(pm->fd_data);
+    return 0;
+}
+
+// 打开索引文件：mmap 模式下映射到预留的地址空间，缓冲池模式下创建缓冲池并常驻文件头
+static int open_index_file(PageManager *pm, const char *path, size_t pool_pages,
+                           unsigned io_depth, AioBackend io_backend) {
+    if (pool_pages == 0) {
+        if (open_mapped_file(path, &pm->fd_index, &pm->mmap_index,
+                             &pm->index_size, &pm->index_reserved) < 0) {
             return -1;
         }
-        st.st_size = MIN_FILE_SIZE;
+        pm->header = (FileHeader*)pm->mmap_index;
+        return 0;
     }
     
-    pm->index_size = st.st_size;
-    
-    // 检查数据文件大小
-    if (fstat(pm->fd_data, &st) < 0) {
+    if (open_file(path, &pm->fd_index, &pm->index_size) < 0) {
+        return -1;
+    }
+    pm->index_reserved = MAX_RESERVE_SIZE;  // 不映射，文件大小只受页号范围限制
+    pm->pool = bufpool_create(pm->fd_index, pool_pages, &pm->stats, io_depth, io_backend);
+    pm->header = pm->pool ? (FileHeader*)bufpool_pin(pm->pool, 0) : NULL;
+    if (!pm->header) {
+        bufpool_destroy(pm->pool);
+        pm->pool = NULL;
         close(pm->fd_index);
-        close(pm->fd_data);
         return -1;
     }
+    return 0;
+}
+
+// 关闭索引文件（不刷盘）
+static void close_index_file(PageManager *pm) {
+    if (pm->pool) {
+        bufpool_destroy(pm->pool);
+        pm->pool = NULL;
+    } else if (pm->mmap_index && pm->mmap_index != MAP_FAILED) {
+        munmap(pm->mmap_index, pm->index_reserved);
+    }
+    pm->mmap_index = NULL;
+    pm->header = NULL;
+    if (pm->fd_index >= 0) {
+        close(pm->fd_index);
+        pm->fd_index = -1;
+    }
+}
+
+// ---- 空闲页面位图 ----
+
+// 扩展内存中的空闲位图使其覆盖 page_id
+static int grow_free_map(PageManager *pm, uint32_t page_id) {
+    if (page_id < pm->free_map_capacity) return 0;
+    size_t capacity = pm->free_map_capacity ? pm->free_map_capacity : INITIAL_PAGES;
+    while (capacity <= page_id) {
+        capacity *= 2;
+    }
     
-    if (st.st_size < MIN_FILE_SIZE) {
-        if (ftruncate(pm->fd_data, MIN_FILE_SIZE) < 0) {
-            close(pm->fd_index);
-            close(pm->fd_data);
-            return -1;
+    uint64_t *map = realloc(pm->free_map, capacity / 8);
+    if (!map) return -1;
+    memset((char*)map + pm->free_map_capacity / 8, 0, (capacity - pm->free_map_capacity) / 8);
+    pm->free_map = map;
+    pm->free_map_capacity = capacity;
+    return 0;
+}
+
+// 页面是否空闲
+bool page_is_free(PageManager *pm, uint32_t page_id) {
+    return page_id < pm->free_map_capacity && (pm->free_map[page_id / 64] & (1ULL << (page_id % 64)));
+}
+
+static void set_free(PageManager *pm, uint32_t page_id) {
+    pm->free_map[page_id / 64] |= 1ULL << (page_id % 64);
+    pm->free_count++;
+    if (page_id < pm->free_min) pm->free_min = page_id;
+}
+
+static void clear_free(PageManager *pm, uint32_t page_id) {
+    pm->free_map[page_id / 64] &= ~(1ULL << (page_id % 64));
+    pm->free_count--;
+}
+
+// [from, to) 中页号最小的空闲页面，没有时返回 0
+static uint32_t find_free_forward(PageManager *pm, uint32_t from, uint32_t to) {
+    if (to > pm->page_count) to = pm->page_count;
+    if (to > pm->free_map_capacity) to = (uint32_t)pm->free_map_capacity;
+    for (uint32_t page_id = from; page_id < to; page_id = (page_id | 63) + 1) {
+        uint64_t word = pm->free_map[page_id / 64] & (~0ULL << (page_id % 64));
+        if (word) {
+            page_id = (page_id & ~63u) + (uint32_t)__builtin_ctzll(word);
+            return page_id < to ? page_id : 0;
         }
-        st.st_size = MIN_FILE_SIZE;
+    }
+    return 0;
+}
+
+// [from, to) 中页号最大的空闲页面，没有时返回 0
+static uint32_t find_free_backward(PageManager *pm, uint32_t from, uint32_t to) {
+    if (to > pm->page_count) to = pm->page_count;
+    if (to > pm->free_map_capacity) to = (uint32_t)pm->free_map_capacity;
+    for (uint32_t end = to; end > from; ) {
+        uint32_t last = end - 1;
+        uint64_t word = pm->free_map[last / 64] & (~0ULL >> (63 - last % 64));
+        if (word) {
+            uint32_t page_id = (last & ~63u) + 63 - (uint32_t)__builtin_clzll(word);
+            return page_id >= from ? page_id : 0;
+        }
+        end = last & ~63u;
+    }
+    return 0;
+}
+
+// 记录一个位图页，先保证数组容量
+static int map_pages_reserve(PageManager *pm) {
+    if (pm->map_page_count < pm->map_page_cap) return 0;
+    size_t cap = pm->map_page_cap ? pm->map_page_cap * 2 : 16;
+    uint32_t *pages = realloc(pm->map_pages, cap * sizeof(uint32_t));
+    if (!pages) return -1;
+    pm->map_pages = pages;
+    pm->map_page_cap = cap;
+    return 0;
+}
+
+// 版本 3 及以前的空闲链表：每个空闲页面的前 4 字节是下一个空闲页面
+static void load_free_list(PageManager *pm, uint32_t page_id) {
+    size_t pins = page_pin_mark(pm);
+    for (uint32_t steps = 0; page_id != 0 && page_id < pm->page_count && steps < pm->page_count; steps++) {
+        Page *page = page_get(pm, page_id);
+        if (!page || page_is_free(pm, page_id)) break;  // 读盘失败或链表成环
+        set_free(pm, page_id);
+        memcpy(&page_id, page->data, sizeof(uint32_t));
+        page_unpin_to(pm, pins);
+    }
+    page_unpin_to(pm, pins);
+}
+
+// 打开文件时读入空闲位图。文件头带有 HEADER_FLAG_SHADOW 时位图不可信，留空由调用者按可达性重建；
+// 位图页损坏（例如搬走后被重新使用、崩溃前没来得及写文件头）时同样留空并设置 free_map_stale
+static int load_free_map(PageManager *pm) {
+    FileHeader *header = pm->header;
+    if (pm->page_count > 0 && grow_free_map(pm, pm->page_count - 1) < 0) return -1;
+    pm->free_min = 1;
+    if (header->flags & HEADER_FLAG_SHADOW) return 0;
+    if (header->free_map_page == 0) {
+        load_free_list(pm, header->free_page_list);
+        return 0;
     }
     
-    pm->data_size = st.st_size;
+    size_t pins = page_pin_mark(pm);
+    uint32_t page_id = header->free_map_page;
+    for (size_t i = 0; page_id != 0; i++) {
+        FreeMapPage *map = NULL;
+        if (page_id < pm->page_count && i * FREE_MAP_PAGE_BITS < pm->page_count && map_pages_reserve(pm) == 0) {
+            map = (FreeMapPage*)page_get(pm, page_id);
+        }
+        if (!map || map->type != PAGE_TYPE_FREE_MAP) {
+            page_unpin_to(pm, pins);
+            memset(pm->free_map, 0, pm->free_map_capacity / 8);
+            pm->free_count = 0;
+            pm->map_page_count = 0;
+            pm->free_map_stale = true;
+            return 0;
+        }
+        pm->map_pages[pm->map_page_count++] = page_id;
+        size_t words = pm->free_map_capacity / 64 - i * FREE_MAP_WORDS;
+        memcpy(pm->free_map + i * FREE_MAP_WORDS, map->bits,
+               (words < FREE_MAP_WORDS ? words : FREE_MAP_WORDS) * sizeof(uint64_t));
+        page_id = map->next;
+        page_unpin_to(pm, pins);
+    }
     
-    // 使用 mmap 映射索引文件
-    pm->mmap_index = mmap(NULL, pm->index_size, PROT_READ | PROT_WRITE, MAP_SHARED, pm->fd_index, 0);
-    if (pm->mmap_index == MAP_FAILED) {
-        close(pm->fd_index);
-        close(pm->fd_data);
+    // 文件头、位图页和 page_count 之后的页面都不是空闲页面
+    pm->free_map[0] &= ~1ULL;
+    for (size_t i = 0; i < pm->map_page_count; i++) {
+        pm->free_map[pm->map_pages[i] / 64] &= ~(1ULL << (pm->map_pages[i] % 64));
+    }
+    for (size_t w = pm->page_count / 64; w < pm->free_map_capacity / 64; w++) {
+        pm->free_map[w] &= w == pm->page_count / 64 ? ~(~0ULL << (pm->page_count % 64)) : 0;
+    }
+    for (size_t w = 0; w < pm->free_map_capacity / 64; w++) {
+        pm->free_count += (uint32_t)__builtin_popcountll(pm->free_map[w]);
+    }
+    return 0;
+}
+
+// 把内存中的空闲位图写入位图页（调用者持有 writeback_lock）：位图页不够时分配新的，
+// 分配可能扩展文件，再检查一次；内容没变的位图页不标记为脏
+static int store_free_map(PageManager *pm) {
+    size_t pins = page_pin_mark(pm);
+    while (pm->map_page_count * FREE_MAP_PAGE_BITS < pm->page_count) {
+        if (map_pages_reserve(pm) < 0) return -1;
+        uint32_t page_id = page_alloc(pm);
+        page_unpin_to(pm, pins);
+        if (page_id == 0) return -1;
+        pm->map_pages[pm->map_page_count++] = page_id;
+    }
+    
+    FreeMapPage image;
+    for (size_t i = 0; i < pm->map_page_count; i++) {
+        memset(&image, 0, sizeof(image));
+        image.type = PAGE_TYPE_FREE_MAP;
+        image.next = i + 1 < pm->map_page_count ? pm->map_pages[i + 1] : 0;
+        size_t first = i * FREE_MAP_WORDS;
+        if (first < pm->free_map_capacity / 64) {
+            size_t words = pm->free_map_capacity / 64 - first;
+            memcpy(image.bits, pm->free_map + first, (words < FREE_MAP_WORDS ? words : FREE_MAP_WORDS) * sizeof(uint64_t));
+        }
+        
+        Page *page = page_get(pm, pm->map_pages[i]);
+        if (!page) return -1;
+        if (memcmp(page->data, &image, PAGE_SIZE) != 0) {
+            memcpy(page->data, &image, PAGE_SIZE);
+            page_mark_dirty(pm, pm->map_pages[i]);
+        }
+        page_unpin_to(pm, pins);
+    }
+    return 0;
+}
+
+// 重建空闲位图之前：全部页面视为在用，原来的位图页不再使用（下次刷盘时重新分配）
+void page_free_map_reset(PageManager *pm) {
+    if (pm->free_map) memset(pm->free_map, 0, pm->free_map_capacity / 8);
+    pm->free_count = 0;
+    pm->free_min = 1;
+    pm->map_page_count = 0;
+    pm->free_map_stale = false;
+}
+
+// 初始化页面管理器
+int page_manager_init(PageManager *pm, const char *db_file) {
+    return page_manager_init_ex(pm, db_file, 0, 0, AIO_BACKEND_AUTO);
+}
+
+// 初始化页面管理器（pool_pages 为 0 时使用 mmap）
+int page_manager_init_ex(PageManager *pm, const char *db_file, size_t pool_pages,
+                         unsigned io_depth, AioBackend io_backend) {
+    memset(pm, 0, sizeof(PageManager));
+    
+    // 构建索引文件和数据文件名
+    char index_file[512];
+    char data_file[512];
+    snprintf(index_file, sizeof(index_file), "%s.idx", db_file);
+    snprintf(data_file, sizeof(data_file), "%s.dat", db_file);
+    
+    // 打开索引文件
+    if (open_index_file(pm, index_file, pool_pages, io_depth, io_backend) < 0) {
         return -1;
     }
     
-    // 使用 mmap 映射数据文件
-    pm->mmap_data = mmap(NULL, pm->data_size, PROT_READ | PROT_WRITE, MAP_SHARED, pm->fd_data, 0);
-    if (pm->mmap_data == MAP_FAILED) {
-        munmap(pm->mmap_index, pm->index_size);
-        close(pm->fd_index);
-        close(pm->fd_data);
+    // 打开并映射数据文件
+    if (open_mapped_file(data_file, &pm->fd_data, &pm->mmap_data,
+                         &pm->data_size, &pm->data_reserved) < 0) {
+        close_index_file(pm);
         return -1;
     }
     
     // 读取或初始化文件头
-    FileHeader *header = (FileHeader*)pm->mmap_index;
+    FileHeader *header = pm->header;
     
     if (header->magic == 0 || header->magic != MAGIC_NUMBER) {
         // 新文件，初始化文件头
         memset(header, 0, sizeof(FileHeader));
         header->magic = MAGIC_NUMBER;
-        header->version = 1;
+        header->version = FORMAT_VERSION;
         header->page_count = 1;  // 至少有一个头页面
         header->root_page = 0;
         header->free_page_list = 0;
         
         pm->page_count = 1;
-        pm->free_page_list = 0;
-        pm->need_sync = true;
         
         // 同步到磁盘
-        msync(pm->mmap_index, PAGE_SIZE, MS_SYNC);
+        if (pm->pool) {
+            bufpool_mark_dirty(pm->pool, 0);
+            bufpool_flush_page(pm->pool, 0);
+        } else {
+            msync(pm->mmap_index, PAGE_SIZE, MS_SYNC);
+        }
     } else {
         // 读取现有文件头
         if (header->magic != MAGIC_NUMBER) {
-            munmap(pm->mmap_index, pm->index_size);
-            munmap(pm->mmap_data, pm->data_size);
-            close(pm->fd_index);
+            close_index_file(pm);
+            munmap(pm->mmap_data, pm->data_reserved);
             close(pm->fd_data);
             return -1;  // 文件格式错误
         }
         
+        // 文件头记录的页面数不能超出文件实际大小
+        if ((size_t)header->page_count * PAGE_SIZE > pm->index_size) {
+            close_index_file(pm);
+            munmap(pm->mmap_data, pm->data_reserved);
+            close(pm->fd_data);
+            return -1;
+        }
+        
         pm->page_count = header->page_count;
-        pm->free_page_list = header->free_page_list;
     }
     
+    // 数据文件的追加位置（检查点之后追加的内容会被 WAL 重放覆盖）
+    if (header->data_tail > pm->data_size) {
+        close_index_file(pm);
+        munmap(pm->mmap_data, pm->data_reserved);
+        close(pm->fd_data);
+        return -1;
+    }
+    pm->data_tail = header->data_tail;
+    pm->data_synced = header->data_tail;
+    
+    // 读入空闲页面位图
+    if (load_free_map(pm) < 0) {
+        free(pm->free_map);
+        free(pm->map_pages);
+        close_index_file(pm);
+        munmap(pm->mmap_data, pm->data_reserved);
+        close(pm->fd_data);
+        return -1;
+    }
+    pthread_mutex_init(&pm->writeback_lock, NULL);
+    
     return 0;
 }
 
@@ -141,32 +401,25 @@ int page_manager_close(PageManager *pm) {
         return -1;
     }
     
-    // 更新文件头
-    FileHeader *header = (FileHeader*)pm->mmap_index;
-    if (header) {
-        header->page_count = pm->page_count;
-        header->free_page_list = pm->free_page_list;
-    }
-    
-    // 同步所有更改
-    if (pm->need_sync) {
-        msync(pm->mmap_index, pm->index_size, MS_SYNC);
-        msync(pm->mmap_data, pm->data_size, MS_SYNC);
-    }
+    // 更新文件头并同步所有脏页
+    page_flush(pm);
+    free(pm->dirty_bitmap);
+    pm->dirty_bitmap = NULL;
+    free(pm->writeback_ids);
+    pm->writeback_ids = NULL;
+    free(pm->free_map);
+    pm->free_map = NULL;
+    free(pm->map_pages);
+    pm->map_pages = NULL;
+    pthread_mutex_destroy(&pm->writeback_lock);
     
-    // 取消映射
-    if (pm->mmap_index && pm->mmap_index != MAP_FAILED) {
-        munmap(pm->mmap_index, pm->index_size);
-    }
+    // 关闭索引文件，取消数据文件的映射（连同预留的地址空间）
+    close_index_file(pm);
     if (pm->mmap_data && pm->mmap_data != MAP_FAILED) {
-        munmap(pm->mmap_data, pm->data_size);
+        munmap(pm->mmap_data, pm->data_reserved);
     }
     
     // 关闭文件
-    if (pm->fd_index >= 0) {
-        close(pm->fd_index);
-        pm->fd_index = -1;
-    }
     if (pm->fd_data >= 0) {
         close(pm->fd_data);
         pm->fd_data = -1;
@@ -175,119 +428,492 @@ int page_manager_close(PageManager *pm) {
     return 0;
 }
 
-// 扩展文件大小（如果需要）
-static int ensure_page_space(PageManager *pm, uint32_t page_id) {
-    size_t needed_size = ((size_t)page_id + 1) * PAGE_SIZE;
+// 为文件预分配 [from, to) 区间的磁盘块，文件系统不支持时退化为 ftruncate
+static int preallocate_file(int fd, size_t from, size_t to) {
+    int err = posix_fallocate(fd, (off_t)from, (off_t)(to - from));
+    if (err == 0) {
+        return 0;
+    }
+    if (err == EINVAL || err == EOPNOTSUPP) {
+        return ftruncate(fd, (off_t)to);
+    }
+    return -1;
+}
+
+// 按 extent 扩展映射文件，使其至少有 needed_size 字节
+// 新增部分先用 fallocate 预分配，再用 MAP_FIXED 映射到预留区域的尾部，已有映射保持不动（base 为 NULL 时只扩展文件）。
+static int grow_mapped_file(int fd, void *base, size_t *size, size_t reserved, size_t needed_size) {
+    if (needed_size <= *size) {
+        return 0;
+    }
+    if (needed_size > reserved) {
+        return -1;  // 超出预留的地址空间
+    }
     
-    if (needed_size > pm->index_size) {
-        // 扩展索引文件
-        size_t new_size = needed_size;
-        if (new_size < pm->index_size * 2) {
-            new_size = pm->index_size * 2;
-        }
-        
-        // 取消映射
-        munmap(pm->mmap_index, pm->index_size);
-        
-        // 扩展文件
-        if (ftruncate(pm->fd_index, new_size) < 0) {
-            return -1;
-        }
-        
-        // 重新映射
-        pm->mmap_index = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, pm->fd_index, 0);
-        if (pm->mmap_index == MAP_FAILED) {
-            return -1;
-        }
-        
-        pm->index_size = new_size;
+    // extent 大小随文件增长翻倍，上限 GROW_EXTENT_MAX
+    size_t extent = *size < GROW_EXTENT_MAX ? *size : GROW_EXTENT_MAX;
+    size_t new_size = *size + extent;
+    if (new_size < needed_size) {
+        new_size = (needed_size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    }
+    if (new_size > reserved) {
+        new_size = reserved;
+    }
+    
+    if (preallocate_file(fd, *size, new_size) < 0) {
+        return -1;
     }
     
+    // 只映射新增的部分
+    if (base && map_file_range(base, fd, *size, new_size) < 0) {
+        return -1;
+    }
+    
+    *size = new_size;
     return 0;
 }
 
+// 扩展索引文件使其至少容纳 page_id。只在 page_alloc 中调用，page_get 永远不会触发扩展。
+static int grow_index_file(PageManager *pm, uint32_t page_id) {
+    return grow_mapped_file(pm->fd_index, pm->mmap_index, &pm->index_size, pm->index_reserved,
+                            ((size_t)page_id + 1) * PAGE_SIZE);
+}
+
+// 把页面清零并标记为脏，作为新分配的页面返回
+static uint32_t init_page(PageManager *pm, uint32_t page_id) {
+    Page *page = page_get(pm, page_id);
+    if (page) {
+        memset(page->data, 0, PAGE_SIZE);
+        page_mark_dirty(pm, page_id);
+    }
+    return page_id;
+}
+
 // 分配新页面
 uint32_t page_alloc(PageManager *pm) {
-    uint32_t page_id;
+    return page_alloc_near(pm, 0);
+}
+
+// 预留页面：空闲页面加上文件中已扩展但未分配的页面不少于 count
+int page_reserve(PageManager *pm, uint32_t count) {
+    if (pm->free_count >= count) return 0;
+    return grow_index_file(pm, pm->page_count + (count - pm->free_count) - 1);
+}
+
+// 在 hint 附近分配新页面
+uint32_t page_alloc_near(PageManager *pm, uint32_t hint) {
+    uint32_t page_id = 0;
     
-    if (pm->free_page_list != 0) {
-        // 从空闲链表分配
-        page_id = pm->free_page_list;
-        Page *page = page_get(pm, page_id);
-        if (!page) return 0;
-        // 读取下一个空闲页面
-        memcpy(&pm->free_page_list, page->data, sizeof(uint32_t));
+    if (pm->free_count > 0) {
+        // 先向后找（分裂出的右兄弟紧跟在左兄弟之后），再向前找
+        if (hint != 0 && hint < pm->page_count) {
+            uint32_t to = pm->page_count - hint > PAGE_ALLOC_WINDOW ? hint + 1 + PAGE_ALLOC_WINDOW : pm->page_count;
+            page_id = find_free_forward(pm, hint + 1, to);
+            if (page_id == 0) {
+                page_id = find_free_backward(pm, hint > PAGE_ALLOC_WINDOW ? hint - PAGE_ALLOC_WINDOW : 1, hint);
+            }
+        }
+        // 附近没有时取页号最小的空闲页面，文件前部先被填满
+        if (page_id == 0) {
+            page_id = find_free_forward(pm, pm->free_min, pm->page_count);
+            pm->free_min = page_id != 0 ? page_id + 1 : pm->page_count;
+        }
+    }
+    
+    if (page_id != 0) {
+        clear_free(pm, page_id);
     } else {
         // 分配新页面
-        page_id = pm->page_count++;
-        if (ensure_page_space(pm, page_id) < 0) {
+        page_id = pm->page_count;
+        if (grow_index_file(pm, page_id) < 0) {
             return 0;  // 分配失败
         }
+        pm->page_count++;
+        grow_free_map(pm, page_id);  // 失败时页面照常使用，释放时再扩展
     }
     
-    // 初始化页面
-    Page *page = page_get(pm, page_id);
-    if (page) {
-        memset(page->data, 0, PAGE_SIZE);
-        pm->need_sync = true;
-    }
+    return init_page(pm, page_id);
+}
+
+// 分配页号小于 limit 的空闲页面
+uint32_t page_alloc_below(PageManager *pm, uint32_t limit) {
+    if (pm->free_count == 0) return 0;
+    uint32_t page_id = find_free_forward(pm, pm->free_min, limit);
+    if (page_id == 0) return 0;
+    clear_free(pm, page_id);
+    pm->free_min = page_id + 1;
+    return init_page(pm, page_id);
+}
+
+// 向数据文件追加数据
+uint64_t page_data_append(PageManager *pm, const void *buf, size_t len) {
+    uint64_t offset = pm->data_tail;
     
-    return page_id;
+    if (grow_mapped_file(pm->fd_data, pm->mmap_data, &pm->data_size, pm->data_reserved,
+                         offset + len) < 0) {
+        return UINT64_MAX;
+    }
+    memcpy((char*)pm->mmap_data + offset, buf, len);
+    pm->data_tail = offset + len;
+    pm->need_sync = true;
+    return offset;
 }
 
 // 释放页面
 void page_free(PageManager *pm, uint32_t page_id) {
-    Page *page = page_get(pm, page_id);
-    if (!page) return;
+    if (page_id == 0 || page_id >= pm->page_count || page_is_free(pm, page_id)) return;
+    if (grow_free_map(pm, page_id) < 0) return;  // 内存不足：页面不再回收
+    set_free(pm, page_id);
+}
+
+// 扩展脏页位图使其覆盖 page_id
+static int grow_dirty_bitmap(PageManager *pm, uint32_t page_id) {
+    size_t capacity = pm->dirty_capacity ? pm->dirty_capacity : INITIAL_PAGES;
+    while (capacity <= page_id) {
+        capacity *= 2;
+    }
     
-    // 将页面加入空闲链表
-    memcpy(page->data, &pm->free_page_list, sizeof(uint32_t));
-    pm->free_page_list = page_id;
-    pm->need_sync = true;
+    uint64_t *bitmap = realloc(pm->dirty_bitmap, capacity / 8);
+    if (!bitmap) return -1;
+    memset((char*)bitmap + pm->dirty_capacity / 8, 0, (capacity - pm->dirty_capacity) / 8);
+    pm->dirty_bitmap = bitmap;
+    pm->dirty_capacity = capacity;
+    return 0;
 }
 
-// 读取页面（从 mmap 直接访问）
-Page* page_get(PageManager *pm, uint32_t page_id) {
-    if (page_id >= MAX_PAGES) {
-        return NULL;
+// 标记页面为脏（使用 mmap 时，修改会自动反映，但需要同步）
+void page_mark_dirty(PageManager *pm, uint32_t page_id) {
+    if (page_id >= pm->page_count) {
+        return;
+    }
+    if (pm->pool) {
+        if (bufpool_mark_dirty(pm->pool, page_id)) pm->stats.pages_dirtied++;
+        return;
+    }
+    if (page_id >= pm->dirty_capacity && grow_dirty_bitmap(pm, page_id) < 0) {
+        // 位图扩展失败时立即同步该页，保证不丢失脏页
+        msync((char*)pm->mmap_index + (size_t)page_id * PAGE_SIZE, PAGE_SIZE, MS_SYNC);
+        return;
     }
     
-    // 确保有足够空间
-    if (ensure_page_space(pm, page_id) < 0) {
-        return NULL;
+    uint64_t bit = 1ULL << (page_id % 64);
+    uint64_t *word = &pm->dirty_bitmap[page_id / 64];
+    if (*word & bit) {
+        return;
     }
     
-    // 直接从 mmap 返回页面指针
-    return (Page*)((char*)pm->mmap_index + (size_t)page_id * PAGE_SIZE);
+    *word |= bit;
+    if (pm->dirty_count == 0 || page_id < pm->dirty_min) pm->dirty_min = page_id;
+    if (pm->dirty_count == 0 || page_id > pm->dirty_max) pm->dirty_max = page_id;
+    pm->dirty_count++;
+    pm->stats.pages_dirtied++;
 }
 
-// 标记页面为脏（使用 mmap 时，修改会自动反映，但需要同步）
-void page_mark_dirty(PageManager *pm, uint32_t page_id) {
-    if (page_id < MAX_PAGES) {
-        pm->need_sync = true;
+// 同步 [first, first + count) 范围内的页面
+static int sync_pages(PageManager *pm, uint32_t first, uint32_t count) {
+    size_t len = (size_t)count * PAGE_SIZE;
+    pm->stats.msync_calls++;
+    pm->stats.flushed_bytes += len;
+    return msync((char*)pm->mmap_index + (size_t)first * PAGE_SIZE, len, MS_SYNC);
+}
+
+// 接上一轮后台写回的结果（调用者持有引擎写锁和 writeback_lock）：
+// 写入失败的页面重新标记为脏，后台已同步的数据文件区间不必再同步
+static void writeback_settle(PageManager *pm) {
+    for (size_t i = 0; i < pm->writeback_failed; i++) {
+        page_mark_dirty(pm, pm->writeback_ids[i]);
+    }
+    pm->writeback_failed = 0;
+    if (pm->writeback_data_done > pm->data_synced) {
+        pm->data_synced = pm->writeback_data_done;
+        if (pm->data_synced >= pm->data_tail) pm->need_sync = false;
     }
 }
 
 // 刷新所有脏页到磁盘
+// 文件头最后写：它引用的页面和数据全部落盘之后，新的根、页面数和空闲位图才生效
 int page_flush(PageManager *pm) {
+    int ret = 0;
+    pm->stats.flush_calls++;
+    
+    // 等待进行中的后台写回结束
+    pthread_mutex_lock(&pm->writeback_lock);
+    writeback_settle(pm);
+    
+    // 文件头中的页面数和空闲位图随刷盘一起持久化
+    FileHeader *header = pm->header;
+    if (store_free_map(pm) < 0) {
+        pthread_mutex_unlock(&pm->writeback_lock);
+        return -1;
+    }
+    uint32_t map_page = pm->map_page_count > 0 ? pm->map_pages[0] : 0;
+    // 数据文件先于文件头落盘，文件头中的 data_tail 不会指向未写入的数据
     if (pm->need_sync) {
-        msync(pm->mmap_index, pm->index_size, MS_SYNC);
-        msync(pm->mmap_data, pm->data_size, MS_SYNC);
+        size_t from = pm->data_synced / PAGE_SIZE * PAGE_SIZE;
+        if (msync((char*)pm->mmap_data + from, pm->data_tail - from, MS_SYNC) < 0) {
+            pthread_mutex_unlock(&pm->writeback_lock);
+            return -1;
+        }
+        pm->stats.msync_calls++;
+        pm->stats.flushed_bytes += pm->data_tail - from;
+        pm->data_synced = pm->data_tail;
         pm->need_sync = false;
     }
-    return 0;
+    
+    if (header->page_count != pm->page_count || header->free_map_page != map_page ||
+        header->free_page_count != pm->free_count || header->free_page_list != 0 ||
+        header->data_tail != pm->data_tail) {
+        header->page_count = pm->page_count;
+        header->free_map_page = map_page;
+        header->free_page_count = pm->free_count;
+        header->free_page_list = 0;  // 旧格式的空闲链表已转换为位图
+        header->data_tail = pm->data_tail;
+        page_mark_dirty(pm, 0);
+    }
+    
+    if (pm->pool) {
+        if (bufpool_flush(pm->pool) < 0 || bufpool_flush_page(pm->pool, 0) < 0) ret = -1;
+        pthread_mutex_unlock(&pm->writeback_lock);
+        return ret;
+    }
+    
+    // 扫描 [dirty_min, dirty_max] 范围内的位图，把连续的脏页合并成一次 msync
+    if (pm->dirty_count > 0) {
+        bool header_dirty = pm->dirty_bitmap[0] & 1;
+        pm->dirty_bitmap[0] &= ~1ULL;
+        uint32_t run_start = 0, run_len = 0;
+        for (size_t w = pm->dirty_min / 64; w <= pm->dirty_max / 64; w++) {
+            uint64_t word = pm->dirty_bitmap[w];
+            for (uint32_t b = 0; b < 64; b++) {
+                uint32_t page_id = (uint32_t)(w * 64 + b);
+                if (word & (1ULL << b)) {
+                    if (run_len == 0) run_start = page_id;
+                    run_len++;
+                } else if (run_len > 0) {
+                    if (sync_pages(pm, run_start, run_len) < 0) ret = -1;
+                    run_len = 0;
+                }
+                if (word == 0) break;  // 整个字都是干净的
+            }
+            pm->dirty_bitmap[w] = 0;
+        }
+        if (run_len > 0 && sync_pages(pm, run_start, run_len) < 0) ret = -1;
+        pm->dirty_count = 0;
+        // 有页面写入失败时文件头保持为脏，不能引用没有落盘的页面
+        if (header_dirty && ret == 0) {
+            if (sync_pages(pm, 0, 1) < 0) ret = -1;
+        } else if (header_dirty) {
+            page_mark_dirty(pm, 0);
+        }
+    }
+    
+    pthread_mutex_unlock(&pm->writeback_lock);
+    return ret;
 }
 
-// 刷新指定页面到磁盘
+// 只刷新指定页面到磁盘
 int page_flush_page(PageManager *pm, uint32_t page_id) {
-    if (page_id >= MAX_PAGES) {
+    if (pm->pool) {
+        pm->stats.flush_calls++;
+        return page_id < pm->page_count ? bufpool_flush_page(pm->pool, page_id) : 0;
+    }
+    if (page_id >= pm->page_count || page_id >= pm->dirty_capacity) {
         return 0;
     }
+    pm->stats.flush_calls++;
     
-    // 使用 mmap 时，同步整个映射区域
-    if (pm->need_sync) {
-        return page_flush(pm);
+    uint64_t bit = 1ULL << (page_id % 64);
+    uint64_t *word = &pm->dirty_bitmap[page_id / 64];
+    if (!(*word & bit)) {
+        return 0;  // 页面是干净的
     }
     
-    return 0;
+    *word &= ~bit;
+    pm->dirty_count--;
+    return sync_pages(pm, page_id, 1);
+}
+
+// 当前的脏页数
+size_t page_dirty_count(PageManager *pm) {
+    return pm->pool ? bufpool_dirty_count(pm->pool) : pm->dirty_count;
+}
+
+// 从脏页位图中取出最多 max 个脏页（文件头除外），清除其脏标记
+static size_t take_dirty_pages(PageManager *pm, uint32_t *ids, size_t max) {
+    if (pm->dirty_count == 0) return 0;
+    size_t n = 0;
+    uint32_t page_id = pm->dirty_min;
+    for (; page_id <= pm->dirty_max && n < max; page_id++) {
+        uint64_t *word = &pm->dirty_bitmap[page_id / 64];
+        if (*word == 0) {
+            page_id |= 63;  // 跳过整个干净的字
+            continue;
+        }
+        uint64_t bit = 1ULL << (page_id % 64);
+        if (page_id == 0 || !(*word & bit)) continue;
+        *word &= ~bit;
+        pm->dirty_count--;
+        ids[n++] = page_id;
+    }
+    // 下界跳过已经扫描过的区间（文件头是脏的时候下界只能停在 0）
+    if (!(pm->dirty_bitmap[0] & 1)) pm->dirty_min = page_id;
+    return n;
+}
+
+// 后台写回第一步：取出脏页
+size_t page_writeback_begin(PageManager *pm, size_t max) {
+    pthread_mutex_lock(&pm->writeback_lock);
+    writeback_settle(pm);
+    pm->writeback_count = 0;
+    pm->writeback_data_from = pm->data_synced;
+    pm->writeback_data_to = pm->data_tail;
+    
+    if (max > pm->writeback_cap) {
+        uint32_t *ids = realloc(pm->writeback_ids, max * sizeof(uint32_t));
+        if (!ids) return 0;
+        pm->writeback_ids = ids;
+        pm->writeback_cap = max;
+    }
+    if (pm->pool) {
+        pm->writeback_count = bufpool_writeback_take(pm->pool, pm->writeback_ids, max);
+    } else {
+        pm->writeback_count = take_dirty_pages(pm, pm->writeback_ids, max);
+    }
+    return pm->writeback_count;
+}
+
+// 后台写回第二步：写盘
+int page_writeback_end(PageManager *pm) {
+    int ret = 0;
+    
+    // 数据文件只追加，区间内的内容不会再变
+    if (pm->writeback_data_to > pm->writeback_data_from) {
+        size_t from = pm->writeback_data_from / PAGE_SIZE * PAGE_SIZE;
+        if (msync((char*)pm->mmap_data + from, pm->writeback_data_to - from, MS_SYNC) == 0) {
+            pm->writeback_data_done = pm->writeback_data_to;
+        } else {
+            ret = -1;
+        }
+    }
+    
+    uint32_t *ids = pm->writeback_ids;
+    size_t count = pm->writeback_count;
+    if (pm->pool) {
+        // 写入失败的页框由缓冲池重新标记为脏
+        if (bufpool_writeback(pm->pool, ids, count) > 0) ret = -1;
+    } else {
+        // 页号连续的一段合并为一次 msync，失败的页号移到数组开头
+        size_t failed = 0;
+        for (size_t i = 0; i < count; ) {
+            size_t j = i + 1;
+            while (j < count && ids[j] == ids[j - 1] + 1) j++;
+            if (msync((char*)pm->mmap_index + (size_t)ids[i] * PAGE_SIZE, (j - i) * PAGE_SIZE, MS_SYNC) < 0) {
+                for (size_t k = i; k < j; k++) {
+                    ids[failed++] = ids[k];
+                }
+                ret = -1;
+            }
+            i = j;
+        }
+        pm->writeback_failed = failed;
+    }
+    pm->writeback_count = 0;
+    pthread_mutex_unlock(&pm->writeback_lock);
+    return ret;
+}
+
+// 收缩页面数
+uint32_t page_shrink(PageManager *pm) {
+    pthread_mutex_lock(&pm->writeback_lock);
+    writeback_settle(pm);
+    uint32_t before = pm->page_count;
+    size_t pins = page_pin_mark(pm);
+    
+    for (;;) {
+        // 位图页的内容在刷盘时重写，搬动只需换一个页号
+        for (size_t i = 0; i < pm->map_page_count; i++) {
+            uint32_t page_id = page_alloc_below(pm, pm->map_pages[i]);
+            page_unpin_to(pm, pins);
+            if (page_id == 0) continue;
+            page_free(pm, pm->map_pages[i]);
+            pm->map_pages[i] = page_id;
+        }
+        
+        // 去掉尾部连续的空闲页面
+        uint32_t count = pm->page_count;
+        while (count > 1 && page_is_free(pm, count - 1)) {
+            clear_free(pm, --count);
+        }
+        pm->page_count = count;
+        if (pm->free_min > count) pm->free_min = count;
+        
+        // 多余的位图页释放后可能又在尾部
+        size_t needed = ((size_t)count + FREE_MAP_PAGE_BITS - 1) / FREE_MAP_PAGE_BITS;
+        if (pm->map_page_count <= needed) break;
+        while (pm->map_page_count > needed) {
+            page_free(pm, pm->map_pages[--pm->map_page_count]);
+        }
+    }
+    page_unpin_to(pm, pins);
+    
+    // 截掉的页面不再写回：缓冲池丢弃其页框，mmap 模式清除其脏标记
+    if (pm->pool) {
+        bufpool_discard(pm->pool, pm->page_count);
+    } else {
+        for (uint32_t page_id = pm->page_count; page_id < before && page_id < pm->dirty_capacity; page_id++) {
+            uint64_t bit = 1ULL << (page_id % 64);
+            if (pm->dirty_bitmap[page_id / 64] & bit) {
+                pm->dirty_bitmap[page_id / 64] &= ~bit;
+                pm->dirty_count--;
+            }
+        }
+        if (pm->dirty_max >= pm->page_count) pm->dirty_max = pm->page_count - 1;
+    }
+    pthread_mutex_unlock(&pm->writeback_lock);
+    return before - pm->page_count;
+}
+
+// 截短索引文件
+int64_t page_truncate(PageManager *pm) {
+    size_t size = (size_t)pm->page_count * PAGE_SIZE;
+    if (size < MIN_FILE_SIZE) size = MIN_FILE_SIZE;
+    if (size >= pm->index_size) return 0;
+    
+    pthread_mutex_lock(&pm->writeback_lock);
+    // 截掉部分的映射先换回只占地址空间的预留区域，之后访问不到文件尾之外
+    if (!pm->pool) {
+        void *addr = mmap((char*)pm->mmap_index + size, pm->index_size - size, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        if (addr == MAP_FAILED) {
+            pthread_mutex_unlock(&pm->writeback_lock);
+            return -1;
+        }
+    }
+    int64_t reclaimed = (int64_t)(pm->index_size - size);
+    pm->index_size = size;  // 截短失败时文件比记录的大，之后扩展照常进行
+    int ret = ftruncate(pm->fd_index, (off_t)size);
+    pthread_mutex_unlock(&pm->writeback_lock);
+    return ret < 0 ? -1 : reclaimed;
+}
+
+// 缓冲池模式下读取页面
+Page* page_pool_get(PageManager *pm, uint32_t page_id) {
+    return bufpool_get(pm->pool, page_id);
+}
+
+// 批量预读页面
+size_t page_prefetch(PageManager *pm, const uint32_t *page_ids, size_t count) {
+    return pm->pool ? bufpool_prefetch(pm->pool, page_ids, count) : 0;
+}
+
+// 调用线程当前钉住的页面数
+size_t page_pin_mark(PageManager *pm) {
+    return pm->pool ? bufpool_pin_mark(pm->pool) : 0;
+}
+
+// 释放调用线程在 mark 之后钉住的页面
+void page_unpin_to(PageManager *pm, size_t mark) {
+    if (pm->pool) {
+        bufpool_unpin_to(pm->pool, mark);
+    }
 }
@@ -4,16 +4,26 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <pthread.h>
+#include "aio.h"
 
 #define PAGE_SIZE 4096        // 页面大小 4KB
-#define MAX_PAGES 1024        // 最大页面数
+#define INITIAL_PAGES 1024    // 新建文件的初始页面数（4MB）
+
+// 虚拟地址空间预留：一次性预留一大段地址，文件增长时用 MAP_FIXED 映射新增部分，
+// 已映射区域的地址永不改变，因此已返回的 Page* 在文件增长后仍然有效。
+// 上限覆盖 uint32_t 页号的全部空间（2^32 页 * 4KB = 16TB），预留失败时逐次减半。
+#define MAX_RESERVE_SIZE ((size_t)1 << 44)
+#define MIN_RESERVE_SIZE ((size_t)1 << 30)
+#define GROW_EXTENT_MAX ((size_t)1 << 30)  // 文件单次扩展的最大 extent（1GB）
 
 // 页面类型
 typedef enum {
     PAGE_TYPE_FREE = 0,       // 空闲页面
     PAGE_TYPE_LEAF = 1,       // B+ 树叶子节点
     PAGE_TYPE_INTERNAL = 2,   // B+ 树内部节点
-    PAGE_TYPE_HEADER = 3      // 文件头页面
+    PAGE_TYPE_HEADER = 3,     // 文件头页面
+    PAGE_TYPE_FREE_MAP = 4    // 空闲页面位图
 } PageType;
 
 // 页面结构
@@ -21,42 +31,199 @@ typedef struct {
     uint8_t data[PAGE_SIZE];
 } Page;
 
+#define MAGIC_NUMBER 0x53514C42  // "BLSQ" (B+ Tree Storage)
+#define FORMAT_VERSION 4          // 当前文件格式版本（2：slotted page 节点格式，3：节点前缀压缩，4：空闲页面位图）
+
+// 文件头标志
+#define HEADER_FLAG_SHADOW 1      // 检查点之后有后台写回：文件头指向的页面未被改动，但空闲页面可能已被重新使用
+
+// 文件头结构（存储在索引文件页面 0）
+typedef struct {
+    uint32_t magic;           // 魔数，用于验证文件格式
+    uint32_t version;         // 版本号
+    uint32_t page_count;      // 总页面数
+    uint32_t root_page;       // B+ 树根页面
+    uint32_t free_page_list;  // 空闲页面链表头（版本 3 及以前；版本 4 恒为 0，打开旧文件时转换为位图）
+    uint32_t flags;           // HEADER_FLAG_*（旧文件中为 0）
+    uint64_t checkpoint_lsn;  // 最近一次检查点覆盖到的 WAL LSN
+    uint64_t data_tail;       // 数据文件（value 日志）已使用的字节数
+    uint32_t free_map_page;   // 第一个空闲页面位图页（0 表示没有）
+    uint32_t free_page_count; // 空闲页面数
+    char reserved[PAGE_SIZE - 48]; // 保留空间
+} FileHeader;
+
+// 空闲页面位图页：位图按页号顺序分段存放在一串位图页中，第 i 页记录页号
+// [i * FREE_MAP_PAGE_BITS, (i + 1) * FREE_MAP_PAGE_BITS) 是否空闲（置位为空闲）。
+// 内存中保存完整的位图，位图页只在刷盘时按内存内容重写，内容没变的页不写
+#define FREE_MAP_WORDS ((PAGE_SIZE - 8) / 8)
+#define FREE_MAP_PAGE_BITS (FREE_MAP_WORDS * 64)   // 每个位图页覆盖的页面数（32704 页，约 128MB）
+
+typedef struct {
+    uint16_t type;            // PAGE_TYPE_FREE_MAP（与节点头的 type 位置相同）
+    uint16_t reserved;
+    uint32_t next;            // 下一个位图页（0 表示最后一页）
+    uint64_t bits[FREE_MAP_WORDS];
+} FreeMapPage;
+
+// 分配页面时在提示页号附近查找的范围（页面数）
+#define PAGE_ALLOC_WINDOW 1024
+
+// 刷盘和缓冲池统计
+typedef struct {
+    uint64_t pages_dirtied;   // 由干净变脏的页面次数
+    uint64_t flush_calls;     // page_flush / page_flush_page 调用次数
+    uint64_t msync_calls;     // 实际发出的 msync 次数（合并后的区间数；缓冲池模式下为索引文件的 fdatasync 次数）
+    uint64_t flushed_bytes;   // msync 覆盖的总字节数（缓冲池模式下为刷盘时 pwrite 的字节数）
+    uint64_t pool_hits;       // 缓冲池命中次数（以下仅缓冲池模式）
+    uint64_t pool_misses;     // 缓冲池未命中（pread）次数
+    uint64_t pool_evictions;  // 淘汰的页框数
+    uint64_t pool_writebacks; // 淘汰时写回的脏页数
+    uint64_t pool_overflow;   // 页框全部被钉住时额外分配的页框数
+    uint64_t pool_prefetched; // 预读读入的页面数
+    uint64_t io_batches;      // 批量提交的 I/O 次数（预读和刷盘各算一次）
+} PageStats;
+
+typedef struct BufferPool BufferPool;
+
 // 页面管理器
 typedef struct {
     int fd_index;             // 索引文件描述符
     int fd_data;              // 数据文件描述符
-    void *mmap_index;         // 索引文件 mmap 映射
+    void *mmap_index;         // 索引文件 mmap 映射（缓冲池模式下为 NULL）
     void *mmap_data;          // 数据文件 mmap 映射
-    size_t index_size;        // 索引文件大小
-    size_t data_size;         // 数据文件大小
+    size_t index_size;        // 索引文件大小（已映射部分）
+    size_t data_size;         // 数据文件大小（已映射部分）
+    size_t index_reserved;    // 索引文件预留的地址空间大小
+    size_t data_reserved;     // 数据文件预留的地址空间大小
     uint32_t page_count;      // 当前页面数
-    uint32_t free_page_list;  // 空闲页面链表头
-    bool need_sync;           // 是否需要同步
+    uint64_t *free_map;       // 空闲页面位图（每页 1 bit，置位为空闲）
+    size_t free_map_capacity; // 位图可容纳的页面数
+    uint32_t free_count;      // 空闲页面数
+    uint32_t free_min;        // 最小空闲页号的下界（从这里开始查找）
+    uint32_t *map_pages;      // 保存位图的页面，按顺序
+    size_t map_page_count;
+    size_t map_page_cap;
+    bool free_map_stale;      // 打开时位图页损坏：空闲位图为空，需要按可达性重建（见 page_free_map_reset）
+    bool need_sync;           // 数据文件是否需要同步
+    uint64_t data_tail;       // 数据文件追加位置
+    uint64_t data_synced;     // 数据文件已同步到的位置
+    uint64_t *dirty_bitmap;   // 索引文件脏页位图（每页 1 bit）
+    size_t dirty_capacity;    // 位图可容纳的页面数
+    uint32_t dirty_count;     // 当前脏页数
+    uint32_t dirty_min;       // 脏页页号下界（缩小刷盘时的扫描范围）
+    uint32_t dirty_max;       // 脏页页号上界
+    PageStats stats;          // 刷盘统计
+    FileHeader *header;       // 文件头（页面 0，两种模式下都常驻内存）
+    BufferPool *pool;         // 索引文件的缓冲池（NULL 表示使用 mmap）
+    pthread_mutex_t writeback_lock;   // 一轮后台写回期间持有，page_flush 先等待它结束
+    uint32_t *writeback_ids;  // 本轮写回的页面（页号递增）；写入失败的留在开头等待重新标脏
+    size_t writeback_count;
+    size_t writeback_failed;
+    size_t writeback_cap;
+    uint64_t writeback_data_from;     // 本轮同步的数据文件区间
+    uint64_t writeback_data_to;
+    uint64_t writeback_data_done;     // 后台已同步到的数据文件位置（下次持锁时并入 data_synced）
 } PageManager;
 
-// 初始化页面管理器
+// 初始化页面管理器（索引文件使用 mmap）
 int page_manager_init(PageManager *pm, const char *filename);
 
+// 初始化页面管理器：pool_pages 为 0 时索引文件使用 mmap，否则使用 pool_pages 个页框的缓冲池（pread/pwrite），
+// 缓冲池的预读和刷盘按 io_depth 的队列深度批量提交（0 使用默认值）。数据文件（value 日志）在两种模式下都使用 mmap
+int page_manager_init_ex(PageManager *pm, const char *filename, size_t pool_pages,
+                         unsigned io_depth, AioBackend io_backend);
+
 // 关闭页面管理器
 int page_manager_close(PageManager *pm);
 
-// 分配新页面
+// 分配新页面：优先使用页号最小的空闲页面，没有时扩展文件
 uint32_t page_alloc(PageManager *pm);
 
-// 释放页面
+// 分配新页面，优先使用 hint 之后（其次之前）PAGE_ALLOC_WINDOW 个页面以内的空闲页面，
+// 例如分裂时靠近被分裂的兄弟节点；附近没有时同 page_alloc
+uint32_t page_alloc_near(PageManager *pm, uint32_t hint);
+
+// 分配页号小于 limit 的空闲页面（取最小的一个），没有时返回 0，不扩展文件
+uint32_t page_alloc_below(PageManager *pm, uint32_t limit);
+
+// 确保接下来 count 次分配不会失败：空闲页面不够时先扩展文件（不改变页面数），失败返回 -1
+int page_reserve(PageManager *pm, uint32_t count);
+
+// 释放页面：只在空闲位图中置位，不改动页面内容
 void page_free(PageManager *pm, uint32_t page_id);
 
-// 读取页面
-Page* page_get(PageManager *pm, uint32_t page_id);
+// 页面是否空闲
+bool page_is_free(PageManager *pm, uint32_t page_id);
+
+// 把除文件头以外的全部页面标记为在用并丢弃原来的位图页（重建空闲位图前调用，之后逐个 page_free 不可达的页面）
+void page_free_map_reset(PageManager *pm);
+
+// 收缩：把页号较大的位图页搬到文件前部的空闲页面，再去掉文件尾部连续的空闲页面，减少 page_count，
+// 返回减少的页面数。新的页面数随下一次 page_flush 写入文件头，文件本身由 page_truncate 截短
+uint32_t page_shrink(PageManager *pm);
+
+// 把索引文件截短到 page_count 页（不小于初始大小），返回释放的字节数，失败返回 -1。
+// 只能在 page_shrink 之后的 page_flush 成功之后调用：磁盘上的文件头不能记录比文件更多的页面
+int64_t page_truncate(PageManager *pm);
+
+// 缓冲池模式下读取页面（见 page_get）
+Page* page_pool_get(PageManager *pm, uint32_t page_id);
+
+// 读取页面（热路径：边界检查 + 指针运算，不会扩展或重新映射文件）
+// 缓冲池模式下页面被调用线程钉住，在 page_unpin_to 释放之前不会被淘汰，返回的指针一直有效
+static inline Page* page_get(PageManager *pm, uint32_t page_id) {
+    if (page_id >= pm->page_count) {
+        return NULL;
+    }
+    if (pm->pool) {
+        return page_pool_get(pm, page_id);
+    }
+    return (Page*)((char*)pm->mmap_index + (size_t)page_id * PAGE_SIZE);
+}
+
+// 缓冲池模式下把一组页面一次批量读入缓冲池（不钉住），返回读入的页面数；mmap 模式下什么也不做
+size_t page_prefetch(PageManager *pm, const uint32_t *page_ids, size_t count);
+
+// 调用线程当前钉住的页面数，作为 page_unpin_to 的位置（mmap 模式下恒为 0）
+size_t page_pin_mark(PageManager *pm);
+
+// 释放调用线程在 mark 之后钉住的页面：此后不能再使用这期间 page_get 返回的指针（mmap 模式下为空操作）
+void page_unpin_to(PageManager *pm, size_t mark);
+
+// 向数据文件追加 len 字节，返回写入的偏移（失败返回 UINT64_MAX）
+// 数据文件只追加不覆盖，返回的偏移对应的内容在文件生命周期内不变。
+uint64_t page_data_append(PageManager *pm, const void *buf, size_t len);
+
+// 读取数据文件中 [offset, offset + len) 的内容（直接指向映射区域，越界返回 NULL）
+static inline const void* page_data_get(PageManager *pm, uint64_t offset, size_t len) {
+    if (offset > pm->data_tail || len > pm->data_tail - offset) {
+        return NULL;
+    }
+    return (const char*)pm->mmap_data + offset;
+}
 
 // 标记页面为脏
 void page_mark_dirty(PageManager *pm, uint32_t page_id);
 
-// 刷新所有脏页到磁盘
+// 刷新所有脏页到磁盘（相邻脏页合并为一次 msync）
 int page_flush(PageManager *pm);
 
-// 刷新指定页面到磁盘
+// 只刷新指定页面到磁盘
 int page_flush_page(PageManager *pm, uint32_t page_id);
 
+// 当前的脏页数（包括文件头）
+size_t page_dirty_count(PageManager *pm);
+
+// 后台写回分两步，把检查点的刷盘工作摊到两次检查点之间，写盘时不持有引擎锁。
+// 只能在文件头指向的页面被冻结时使用（见 btree_shadow_advance）：写回期间页面仍可能被修改，
+// 写到磁盘上的内容可能是修改了一半的，只有在检查点写文件头之前重新刷盘后才会被引用。
+//
+// 第一步（调用者持有引擎写锁）：取出最多 max 个脏页（文件头除外）并清除脏标记，记下数据文件待同步的区间，
+// 返回取出的页面数。从这里到 page_writeback_end 之间 page_flush 会等待
+size_t page_writeback_begin(PageManager *pm, size_t max);
+
+// 第二步（不需要引擎锁）：写入取出的页面并同步数据文件。写入失败的页面在下次写回或刷盘时重新标记为脏，返回 -1
+int page_writeback_end(PageManager *pm);
+
 #endif // PAGE_H
 
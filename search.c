@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+#include "search.h"
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SEARCH_X86 1
+#endif
+
+// SIMD 实现先用标量二分把范围缩小到不超过该长度的窗口，再在窗口内逐组比较
+#define SEARCH_WINDOW 32
+
+typedef size_t (*LowerBoundFn)(const uint64_t *keys, size_t n, uint64_t key);
+
+// 二分把 [lo, hi) 缩小到不超过 window 个元素，结果仍在缩小后的区间内
+static inline void narrow(const uint64_t *keys, size_t *lo, size_t *hi, uint64_t key, size_t window) {
+    while (*hi - *lo > window) {
+        size_t mid = (*lo + *hi) / 2;
+        if (keys[mid] < key) {
+            *lo = mid + 1;
+        } else {
+            *hi = mid;
+        }
+    }
+}
+
+static size_t lower_bound_scalar(const uint64_t *keys, size_t n, uint64_t key) {
+    size_t lo = 0, hi = n;
+    narrow(keys, &lo, &hi, key, 0);
+    return lo;
+}
+
+#ifdef SEARCH_X86
+// 无符号比较：两边都翻转最高位后做有符号比较
+__attribute__((target("sse4.2")))
+static size_t lower_bound_sse42(const uint64_t *keys, size_t n, uint64_t key) {
+    size_t lo = 0, hi = n;
+    narrow(keys, &lo, &hi, key, SEARCH_WINDOW);
+    
+    const __m128i bias = _mm_set1_epi64x(INT64_MIN);
+    const __m128i k = _mm_xor_si128(_mm_set1_epi64x((long long)key), bias);
+    size_t pos = lo, i = lo;
+    for (; i + 2 <= hi; i += 2) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(keys + i)), bias);
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v)));  // v < key
+        pos += __builtin_popcount(mask);
+    }
+    for (; i < hi; i++) {
+        pos += keys[i] < key;
+    }
+    return pos;
+}
+
+__attribute__((target("avx2")))
+static size_t lower_bound_avx2(const uint64_t *keys, size_t n, uint64_t key) {
+    size_t lo = 0, hi = n;
+    narrow(keys, &lo, &hi, key, SEARCH_WINDOW);
+    
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i k = _mm256_xor_si256(_mm256_set1_epi64x((long long)key), bias);
+    size_t pos = lo, i = lo;
+    for (; i + 4 <= hi; i += 4) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), bias);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+        pos += __builtin_popcount(mask);
+    }
+    for (; i < hi; i++) {
+        pos += keys[i] < key;
+    }
+    return pos;
+}
+#endif
+
+typedef struct {
+    const char *name;
+    LowerBoundFn fn;
+    int (*supported)(void);
+} SearchImpl;
+
+static int always(void) {
+    return 1;
+}
+
+#ifdef SEARCH_X86
+static int has_sse42(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+static int has_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+// 按优先级排列
+static const SearchImpl impls[] = {
+#ifdef SEARCH_X86
+    {"avx2", lower_bound_avx2, has_avx2},
+    {"sse4.2", lower_bound_sse42, has_sse42},
+#endif
+    {"scalar", lower_bound_scalar, always},
+};
+
+static size_t lower_bound_resolve(const uint64_t *keys, size_t n, uint64_t key);
+
+static LowerBoundFn lower_bound_fn = lower_bound_resolve;
+static const char *impl_name = "scalar";
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+// 选择 CPU 支持的最快实现
+static void select_impl(void) {
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (impls[i].supported()) {
+            impl_name = impls[i].name;
+            lower_bound_fn = impls[i].fn;
+            return;
+        }
+    }
+}
+
+// 第一次调用时选择实现
+static size_t lower_bound_resolve(const uint64_t *keys, size_t n, uint64_t key) {
+    pthread_once(&select_once, select_impl);
+    return lower_bound_fn(keys, n, key);
+}
+
+size_t prefix_lower_bound(const uint64_t *keys, size_t n, uint64_t key) {
+    return lower_bound_fn(keys, n, key);
+}
+
+const char* prefix_search_impl(void) {
+    pthread_once(&select_once, select_impl);
+    return impl_name;
+}
+
+int prefix_search_set_impl(const char *name) {
+    pthread_once(&select_once, select_impl);
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (strcmp(impls[i].name, name) == 0 && impls[i].supported()) {
+            impl_name = impls[i].name;
+            lower_bound_fn = impls[i].fn;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,20 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 定长 key 前缀数组的查找：key 的前 8 字节按大端拼成 uint64_t 后，整数大小关系与按字节比较一致，
+// 有序前缀数组可以用 SIMD 一次比较多个元素。运行时按 CPU 支持的指令集选择实现：
+// AVX2（每次 4 个）> SSE4.2（每次 2 个，64 位比较需要 SSE4.2）> 标量二分。
+
+// 有序数组 keys[0, n) 中第一个 >= key 的位置
+size_t prefix_lower_bound(const uint64_t *keys, size_t n, uint64_t key);
+
+// 当前使用的实现名称（"avx2"、"sse4.2" 或 "scalar"）
+const char* prefix_search_impl(void);
+
+// 指定实现（基准测试用），CPU 不支持或名称未知时返回 -1
+int prefix_search_set_impl(const char *name);
+
+#endif // SEARCH_H
@@ -1,27 +1,338 @@
+#define _POSIX_C_SOURCE 200809L
 #include "storage.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 
-// 初始化存储引擎
+// ---- 引擎读写锁 ----
+
+static void lock_init(StorageLock *lock) {
+    pthread_mutex_init(&lock->mutex, NULL);
+    pthread_cond_init(&lock->readers_cv, NULL);
+    pthread_cond_init(&lock->writers_cv, NULL);
+    lock->readers = 0;
+    lock->writers_waiting = 0;
+    lock->writer = false;
+}
+
+static void lock_destroy(StorageLock *lock) {
+    pthread_mutex_destroy(&lock->mutex);
+    pthread_cond_destroy(&lock->readers_cv);
+    pthread_cond_destroy(&lock->writers_cv);
+}
+
+static void lock_read(StorageLock *lock) {
+    pthread_mutex_lock(&lock->mutex);
+    while (lock->writer || lock->writers_waiting > 0) {
+        pthread_cond_wait(&lock->readers_cv, &lock->mutex);
+    }
+    lock->readers++;
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+static void unlock_read(StorageLock *lock) {
+    pthread_mutex_lock(&lock->mutex);
+    if (--lock->readers == 0 && lock->writers_waiting > 0) {
+        pthread_cond_signal(&lock->writers_cv);
+    }
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+static void lock_write(StorageLock *lock) {
+    pthread_mutex_lock(&lock->mutex);
+    lock->writers_waiting++;
+    while (lock->writer || lock->readers > 0) {
+        pthread_cond_wait(&lock->writers_cv, &lock->mutex);
+    }
+    lock->writers_waiting--;
+    lock->writer = true;
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+static void unlock_write(StorageLock *lock) {
+    pthread_mutex_lock(&lock->mutex);
+    lock->writer = false;
+    if (lock->writers_waiting > 0) {
+        pthread_cond_signal(&lock->writers_cv);
+    } else {
+        pthread_cond_broadcast(&lock->readers_cv);
+    }
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+// 引擎操作的开始和结束：除了加锁，还记下调用线程的钉住位置，结束时释放期间钉住的页面
+// （缓冲池模式下被钉住的页面不会被淘汰；位置按调用栈嵌套，快照扫描的回调中可以再调用引擎接口）
+static size_t read_begin(StorageEngine *engine) {
+    lock_read(&engine->lock);
+    return page_pin_mark(&engine->pm);
+}
+
+static void read_end(StorageEngine *engine, size_t pins) {
+    page_unpin_to(&engine->pm, pins);
+    unlock_read(&engine->lock);
+}
+
+static size_t write_begin(StorageEngine *engine) {
+    lock_write(&engine->lock);
+    return page_pin_mark(&engine->pm);
+}
+
+static void write_end(StorageEngine *engine, size_t pins) {
+    page_unpin_to(&engine->pm, pins);
+    unlock_write(&engine->lock);
+}
+
+// 获取默认配置
+void storage_default_options(StorageOptions *options) {
+    memset(options, 0, sizeof(StorageOptions));
+    options->sync_mode = WAL_SYNC_BATCH;
+    options->node_cache = true;
+    options->io_depth = AIO_DEFAULT_DEPTH;
+    options->io_backend = AIO_BACKEND_AUTO;
+    options->flush_interval_ms = STORAGE_FLUSH_INTERVAL_MS;
+    options->checkpoint_wal_bytes = STORAGE_CHECKPOINT_WAL_BYTES;
+}
+
+// 重放一条 WAL 记录
+static int replay_record(void *ctx, WalRecordType type, const char *key, size_t klen,
+                         const char *value, size_t vlen) {
+    BTree *tree = ctx;
+    size_t pins = page_pin_mark(tree->pm);
+    int ret = type == WAL_DELETE ? btree_delete2(tree, key, klen)
+                                 : btree_insert2(tree, key, klen, value, vlen);
+    page_unpin_to(tree->pm, pins);
+    return ret;
+}
+
+// 检查点（调用者持有写锁）
+// 先刷数据页，再写检查点 LSN 并刷文件头，最后清空日志；
+// 任一步骤之前崩溃，重放都会从上一个检查点开始，redo 记录可重复应用。
+// 后台刷盘开启时文件头在两次检查点之间一直指向冻结的镜像：这里把当前的根写入文件头，
+// 页面和文件头落盘之后再冻结当前的树，作为下一段时间的镜像
+static int checkpoint_locked(StorageEngine *engine) {
+    uint64_t lsn = wal_last_lsn(&engine->wal);
+    StorageFlusher *flusher = &engine->flusher;
+    FileHeader *header = engine->pm.header;
+    uint32_t flags = flusher->enabled ? HEADER_FLAG_SHADOW : 0;
+    if (header->root_page != engine->btree.root_page || header->flags != flags) {
+        header->root_page = engine->btree.root_page;
+        header->flags = flags;
+        page_mark_dirty(&engine->pm, 0);
+    }
+    
+    if (page_flush(&engine->pm) < 0) {
+        return -1;
+    }
+    if (flusher->enabled) {
+        BTreeSnapshot *snap = engine->btree.shadow == &flusher->shadows[0] ? &flusher->shadows[1]
+                                                                           : &flusher->shadows[0];
+        btree_shadow_advance(&engine->btree, snap);
+    }
+    
+    if (header->checkpoint_lsn != lsn) {
+        header->checkpoint_lsn = lsn;
+        page_mark_dirty(&engine->pm, 0);
+        if (page_flush_page(&engine->pm, 0) < 0) {
+            return -1;
+        }
+    }
+    
+    return wal_reset(&engine->wal);
+}
+
+// ---- 后台刷盘 ----
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// 等到 deadline（CLOCK_MONOTONIC 毫秒）或被要求退出，返回是否要求退出
+static bool flusher_wait(StorageFlusher *flusher, double deadline) {
+    uint64_t ns = (uint64_t)(deadline * 1e6);
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    pthread_mutex_lock(&flusher->mutex);
+    while (!flusher->stop && pthread_cond_timedwait(&flusher->stop_cv, &flusher->mutex, &ts) != ETIMEDOUT) {
+    }
+    bool stop = flusher->stop;
+    pthread_mutex_unlock(&flusher->mutex);
+    return stop;
+}
+
+// 一轮写回：每批在写锁下取出最多 STORAGE_FLUSH_BATCH 个脏页，放开锁之后写盘。
+// 一轮最多写开始时的脏页数（前台持续写入时也能轮到检查点）；限速时另外不超过 rate * interval 页，
+// 并按速率在批与批之间等待
+static void flusher_writeback(StorageEngine *engine) {
+    StorageFlusher *flusher = &engine->flusher;
+    size_t pins = read_begin(engine);
+    uint64_t budget = page_dirty_count(&engine->pm);
+    read_end(engine, pins);
+    if (flusher->rate) {
+        uint64_t limit = (uint64_t)flusher->rate * flusher->interval_ms / 1000;
+        if (limit < budget) budget = limit > 0 ? limit : 1;
+    }
+    
+    uint64_t written = 0;
+    double start = now_ms();
+    while (written < budget) {
+        size_t max = budget - written < STORAGE_FLUSH_BATCH ? (size_t)(budget - written) : STORAGE_FLUSH_BATCH;
+        pins = write_begin(engine);
+        size_t n = page_writeback_begin(&engine->pm, max);
+        write_end(engine, pins);
+        if (page_writeback_end(&engine->pm) < 0 || n == 0) break;
+        written += n;
+        
+        pthread_mutex_lock(&flusher->mutex);
+        flusher->pages_written += n;
+        pthread_mutex_unlock(&flusher->mutex);
+        if (flusher->rate && flusher_wait(flusher, start + written * 1000.0 / flusher->rate)) break;
+    }
+}
+
+// 后台刷盘线程：每个周期写回一轮脏页，WAL 超过阈值时做检查点
+static void* flusher_main(void *arg) {
+    StorageEngine *engine = arg;
+    StorageFlusher *flusher = &engine->flusher;
+    
+    while (!flusher_wait(flusher, now_ms() + flusher->interval_ms)) {
+        flusher_writeback(engine);
+        
+        int ret = 0;
+        double elapsed = 0;
+        bool checkpoint = wal_size(&engine->wal) >= flusher->checkpoint_bytes;
+        if (checkpoint) {
+            size_t pins = write_begin(engine);
+            double start = now_ms();
+            ret = checkpoint_locked(engine);
+            elapsed = now_ms() - start;
+            write_end(engine, pins);
+        }
+        
+        double now = now_ms();
+        pthread_mutex_lock(&flusher->mutex);
+        if (checkpoint && ret == 0) {
+            flusher->checkpoints++;
+            flusher->last_checkpoint_ms = elapsed;
+            if (elapsed > flusher->max_checkpoint_ms) flusher->max_checkpoint_ms = elapsed;
+        }
+        if (now - flusher->window_start >= 1000) {
+            flusher->pages_per_sec = (flusher->pages_written - flusher->window_pages) * 1000.0 /
+                                     (now - flusher->window_start);
+            flusher->window_pages = flusher->pages_written;
+            flusher->window_start = now;
+        }
+        pthread_mutex_unlock(&flusher->mutex);
+    }
+    return NULL;
+}
+
+static void flusher_init(StorageFlusher *flusher, const StorageOptions *options) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&flusher->stop_cv, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&flusher->mutex, NULL);
+    flusher->enabled = options->background_flush;
+    flusher->interval_ms = options->flush_interval_ms ? options->flush_interval_ms : STORAGE_FLUSH_INTERVAL_MS;
+    flusher->rate = options->flush_rate;
+    flusher->checkpoint_bytes = options->checkpoint_wal_bytes ? options->checkpoint_wal_bytes
+                                                              : STORAGE_CHECKPOINT_WAL_BYTES;
+    flusher->window_start = now_ms();
+}
+
+// 结束后台刷盘线程（镜像仍然保留，由 storage_close 结束）
+static void flusher_stop(StorageFlusher *flusher) {
+    pthread_mutex_lock(&flusher->mutex);
+    bool started = flusher->started;
+    flusher->stop = true;
+    pthread_cond_signal(&flusher->stop_cv);
+    pthread_mutex_unlock(&flusher->mutex);
+    if (started) {
+        pthread_join(flusher->thread, NULL);
+    }
+    pthread_mutex_destroy(&flusher->mutex);
+    pthread_cond_destroy(&flusher->stop_cv);
+}
+
+// 初始化存储引擎（使用默认配置）
 int storage_init(StorageEngine *engine, const char *db_file) {
-    if (!engine || !db_file) {
+    StorageOptions options;
+    storage_default_options(&options);
+    return storage_init_ex(engine, db_file, &options);
+}
+
+// 按指定配置初始化存储引擎
+int storage_init_ex(StorageEngine *engine, const char *db_file, const StorageOptions *options) {
+    if (!engine || !db_file || !options) {
         return -1;
     }
     
     memset(engine, 0, sizeof(StorageEngine));
     
     // 初始化页面管理器
-    if (page_manager_init(&engine->pm, db_file) < 0) {
+    if (page_manager_init_ex(&engine->pm, db_file, options->buffer_pool_pages,
+                             options->io_depth, options->io_backend) < 0) {
         return -1;
     }
     
     // 初始化 B+ 树
-    if (btree_init(&engine->btree, &engine->pm) < 0) {
+    size_t pins = page_pin_mark(&engine->pm);
+    int ret = btree_init(&engine->btree, &engine->pm);
+    if (ret == 0 && !options->node_cache) {
+        btree_set_node_cache(&engine->btree, false);
+    }
+    page_unpin_to(&engine->pm, pins);
+    if (ret < 0) {
+        page_manager_close(&engine->pm);
+        return -1;
+    }
+    
+    // 上次没有正常关闭且开着后台刷盘（空闲位图可能落后于镜像），或者位图页面损坏：按可达性重建
+    FileHeader *header = engine->pm.header;
+    if ((header->flags & HEADER_FLAG_SHADOW) || engine->pm.free_map_stale) {
+        pins = page_pin_mark(&engine->pm);
+        ret = btree_rebuild_free_map(&engine->btree);
+        page_unpin_to(&engine->pm, pins);
+        if (ret < 0) {
+            btree_destroy(&engine->btree);
+            page_manager_close(&engine->pm);
+            return -1;
+        }
+    }
+    
+    // 打开 WAL 并重放检查点之后的记录；开启后台刷盘时这次检查点就冻结第一个镜像
+    char wal_file[512];
+    snprintf(wal_file, sizeof(wal_file), "%s.wal", db_file);
+    if (wal_open(&engine->wal, wal_file, options->sync_mode, header->checkpoint_lsn) < 0) {
+        btree_destroy(&engine->btree);
+        page_manager_close(&engine->pm);
+        return -1;
+    }
+    flusher_init(&engine->flusher, options);
+    if (wal_replay(&engine->wal, header->checkpoint_lsn, replay_record, &engine->btree) < 0 ||
+        checkpoint_locked(engine) < 0) {
+        flusher_stop(&engine->flusher);
+        wal_close(&engine->wal);
+        btree_destroy(&engine->btree);
         page_manager_close(&engine->pm);
         return -1;
     }
     
+    lock_init(&engine->lock);
+    pthread_mutex_init(&engine->async.mutex, NULL);
+    pthread_cond_init(&engine->async.submit_cv, NULL);
+    pthread_cond_init(&engine->async.idle_cv, NULL);
+    // 线程创建失败时不做后台写回，镜像照常随检查点推进
+    if (engine->flusher.enabled &&
+        pthread_create(&engine->flusher.thread, NULL, flusher_main, engine) == 0) {
+        engine->flusher.started = true;
+    }
     engine->initialized = true;
     return 0;
 }
@@ -31,9 +342,38 @@ int storage_close(StorageEngine *engine) {
     if (!engine || !engine->initialized) {
         return -1;
     }
+    BTree *tree = &engine->btree;
+    if (engine->view_pins > 0 || tree->snap_oldest != tree->shadow || tree->snap_newest != tree->shadow) {
+        return -1;  // 仍有视图引用数据文件的映射区域，或仍有快照未结束（检查点镜像除外）
+    }
+    
+    // 执行完排队的异步请求后结束后台线程
+    StorageAsync *async = &engine->async;
+    pthread_mutex_lock(&async->mutex);
+    bool started = async->started;
+    async->stop = true;
+    pthread_cond_signal(&async->submit_cv);
+    pthread_mutex_unlock(&async->mutex);
+    if (started) {
+        pthread_join(async->thread, NULL);
+    }
+    pthread_mutex_destroy(&async->mutex);
+    pthread_cond_destroy(&async->submit_cv);
+    pthread_cond_destroy(&async->idle_cv);
     
-    // 刷新所有页面
-    page_flush(&engine->pm);
+    // 检查点：刷新所有页面并清空日志。开启后台刷盘时先停止后台线程，这次检查点回收上一个镜像独占的页面；
+    // 随后结束镜像，再做一次检查点把回收的页面连同清除了标志的文件头落盘
+    flusher_stop(&engine->flusher);
+    size_t pins = write_begin(engine);
+    checkpoint_locked(engine);
+    if (engine->flusher.enabled) {
+        engine->flusher.enabled = false;
+        btree_shadow_end(tree);
+        checkpoint_locked(engine);
+    }
+    write_end(engine, pins);
+    
+    wal_close(&engine->wal);
     
     // 关闭 B+ 树
     btree_destroy(&engine->btree);
@@ -41,21 +381,41 @@ int storage_close(StorageEngine *engine) {
     // 关闭页面管理器
     page_manager_close(&engine->pm);
     
+    lock_destroy(&engine->lock);
     engine->initialized = false;
     return 0;
 }
 
 // 插入键值对
 int storage_put(StorageEngine *engine, const char *key, const char *value) {
+    if (!key || !value) {
+        return -1;
+    }
+    return storage_put2(engine, key, strlen(key), value, strlen(value));
+}
+
+// 插入键值对（显式长度）
+int storage_put2(StorageEngine *engine, const void *key, size_t klen, const void *value, size_t vlen) {
     if (!engine || !engine->initialized || !key || !value) {
         return -1;
     }
-    
-    if (strlen(key) > MAX_KEY_SIZE || strlen(value) > MAX_VAL_SIZE) {
+    if (klen > MAX_KEY_SIZE || vlen > MAX_VAL_SIZE) {
         return -1;
     }
     
-    return btree_insert(&engine->btree, key, value);
+    // 先写日志再改树，改树失败时撤销这条记录（否则之后的提交会让它落盘，重启后被重放）；
+    // 等待日志落盘时释放写锁，让并发提交者共享同一次 fdatasync
+    size_t pins = write_begin(engine);
+    uint64_t lsn = wal_append(&engine->wal, WAL_PUT, key, klen, value, vlen);
+    int ret = lsn != 0 ? btree_insert2(&engine->btree, key, klen, value, vlen) : -1;
+    if (ret < 0 && lsn != 0) wal_abort(&engine->wal, lsn);
+    engine->write_seq++;
+    write_end(engine, pins);
+    
+    if (ret == 0 && wal_commit(&engine->wal, lsn) < 0) {
+        return -1;
+    }
+    return ret;
 }
 
 // 获取值
@@ -64,15 +424,699 @@ int storage_get(StorageEngine *engine, const char *key, char *value, size_t valu
         return -1;
     }
     
-    return btree_get(&engine->btree, key, value, value_size);
+    size_t pins = read_begin(engine);
+    int ret = btree_get(&engine->btree, key, value, value_size);
+    read_end(engine, pins);
+    return ret;
+}
+
+// 获取值（显式长度）
+int storage_get2(StorageEngine *engine, const void *key, size_t klen,
+                 void *value, size_t value_size, size_t *vlen) {
+    if (!engine || !engine->initialized || !key) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(engine);
+    int ret = btree_get2(&engine->btree, key, klen, value, value_size, vlen);
+    read_end(engine, pins);
+    return ret;
+}
+
+// 获取 value 视图
+int storage_get_view(StorageEngine *engine, const void *key, size_t klen, StorageView *view) {
+    if (!engine || !engine->initialized || !key || !view) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(engine);
+    size_t vlen;
+    const char *value = btree_get_ref(&engine->btree, key, klen, &vlen);
+    if (value && vlen <= MAX_INLINE_VAL) {
+        memcpy(view->buf, value, vlen);
+        value = view->buf;
+    }
+    read_end(engine, pins);
+    
+    if (!value) {
+        view->engine = NULL;
+        view->data = NULL;
+        view->len = 0;
+        return -1;
+    }
+    pthread_mutex_lock(&engine->lock.mutex);
+    engine->view_pins++;
+    pthread_mutex_unlock(&engine->lock.mutex);
+    view->engine = engine;
+    view->data = value;
+    view->len = vlen;
+    return 0;
+}
+
+// 释放视图
+void storage_view_release(StorageView *view) {
+    if (!view || !view->engine) {
+        return;
+    }
+    
+    pthread_mutex_lock(&view->engine->lock.mutex);
+    view->engine->view_pins--;
+    pthread_mutex_unlock(&view->engine->lock.mutex);
+    view->engine = NULL;
+    view->data = NULL;
+    view->len = 0;
 }
 
 // 删除键值对
 int storage_delete(StorageEngine *engine, const char *key) {
+    if (!key) {
+        return -1;
+    }
+    return storage_delete2(engine, key, strlen(key));
+}
+
+// 删除键值对（显式长度）
+int storage_delete2(StorageEngine *engine, const void *key, size_t klen) {
     if (!engine || !engine->initialized || !key) {
         return -1;
     }
     
-    return btree_delete(&engine->btree, key);
+    size_t pins = write_begin(engine);
+    uint64_t lsn = wal_append(&engine->wal, WAL_DELETE, key, klen, NULL, 0);
+    int ret = lsn != 0 ? btree_delete2(&engine->btree, key, klen) : -1;
+    if (ret < 0 && lsn != 0) wal_abort(&engine->wal, lsn);  // 包括 key 不存在
+    engine->write_seq++;
+    write_end(engine, pins);
+    
+    if (ret == 0 && wal_commit(&engine->wal, lsn) < 0) {
+        return -1;
+    }
+    return ret;
+}
+
+// 批量插入
+int storage_put_batch(StorageEngine *engine, BTreeBatchItem *items, size_t count) {
+    if (!engine || !engine->initialized || (!items && count > 0)) {
+        return -1;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!items[i].key || !items[i].value ||
+            strlen(items[i].key) > MAX_KEY_SIZE || strlen(items[i].value) > MAX_VAL_SIZE) {
+            return -1;
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+    
+    WalRecord *records = malloc(count * sizeof(WalRecord));
+    if (!records) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        records[i].type = WAL_PUT;
+        records[i].key = items[i].key;
+        records[i].klen = strlen(items[i].key);
+        records[i].value = items[i].value;
+        records[i].vlen = strlen(items[i].value);
+    }
+    
+    // 日志按调用者给出的顺序一次写入，重放时同一 key 以最后一项为准，与树中的结果一致。
+    // 有项目插入失败时撤销整批日志，只按原顺序重新记录成功的项目
+    size_t pins = write_begin(engine);
+    for (size_t i = 0; i < count; i++) {
+        items[i].result = -1;
+    }
+    uint64_t lsn = wal_append_batch(&engine->wal, records, count);
+    int ret = lsn != 0 ? btree_put_batch(&engine->btree, items, count) : -1;
+    if (ret < 0 && lsn != 0 && wal_abort(&engine->wal, lsn) == 0) {
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (items[i].result == 0) records[kept++] = records[i];
+        }
+        lsn = kept > 0 ? wal_append_batch(&engine->wal, records, kept) : 0;
+    }
+    engine->write_seq++;
+    write_end(engine, pins);
+    free(records);
+    
+    if (lsn != 0 && wal_commit(&engine->wal, lsn) < 0) {
+        return -1;
+    }
+    return ret;
+}
+
+// 批量查找
+int storage_get_batch(StorageEngine *engine, BTreeBatchItem *items, size_t count) {
+    if (!engine || !engine->initialized || (!items && count > 0)) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(engine);
+    int ret = btree_get_batch(&engine->btree, items, count);
+    read_end(engine, pins);
+    return ret;
+}
+
+// ---- 异步请求 ----
+
+#define ASYNC_BATCH_MAX 1024      // 合成一次批量调用的最大请求数
+
+// 执行 ops 起的 count 个同类请求并回调
+static void async_run_batch(StorageEngine *engine, StorageAsyncOp **ops, size_t count, BTreeBatchItem *items) {
+    for (size_t i = 0; i < count; i++) {
+        items[i].key = ops[i]->key;
+        items[i].value = ops[i]->value;
+        items[i].buf = ops[i]->buf;
+        items[i].buf_size = ops[i]->buf_size;
+        items[i].result = -1;
+    }
+    if (ops[0]->is_put) {
+        storage_put_batch(engine, items, count);
+    } else {
+        storage_get_batch(engine, items, count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        StorageAsyncOp *op = ops[i];
+        op->result = items[i].result;
+        if (op->callback) {
+            op->callback(op);  // 回调之后 op 可能已被调用者释放
+        }
+    }
+}
+
+// 后台线程：每次取出全部排队的请求，按顺序把连续的同类请求合成一批执行
+static void* async_worker(void *arg) {
+    StorageEngine *engine = arg;
+    StorageAsync *async = &engine->async;
+    StorageAsyncOp *ops[ASYNC_BATCH_MAX];
+    BTreeBatchItem items[ASYNC_BATCH_MAX];
+    
+    pthread_mutex_lock(&async->mutex);
+    for (;;) {
+        while (!async->head && !async->stop) {
+            pthread_cond_wait(&async->submit_cv, &async->mutex);
+        }
+        if (!async->head) break;  // 要求退出且队列已空
+        StorageAsyncOp *list = async->head;
+        async->head = async->tail = NULL;
+        pthread_mutex_unlock(&async->mutex);
+        
+        size_t done = 0;
+        while (list) {
+            size_t count = 0;
+            bool is_put = list->is_put;
+            while (list && list->is_put == is_put && count < ASYNC_BATCH_MAX) {
+                ops[count++] = list;
+                list = list->next;
+            }
+            async_run_batch(engine, ops, count, items);
+            done += count;
+        }
+        
+        pthread_mutex_lock(&async->mutex);
+        async->outstanding -= done;
+        if (async->outstanding == 0) {
+            pthread_cond_broadcast(&async->idle_cv);
+        }
+    }
+    pthread_mutex_unlock(&async->mutex);
+    return NULL;
+}
+
+static int async_submit(StorageEngine *engine, StorageAsyncOp *op) {
+    StorageAsync *async = &engine->async;
+    pthread_mutex_lock(&async->mutex);
+    if (async->stop) {
+        pthread_mutex_unlock(&async->mutex);
+        return -1;
+    }
+    if (!async->started) {
+        if (pthread_create(&async->thread, NULL, async_worker, engine) != 0) {
+            pthread_mutex_unlock(&async->mutex);
+            return -1;
+        }
+        async->started = true;
+    }
+    op->next = NULL;
+    if (async->tail) {
+        async->tail->next = op;
+    } else {
+        async->head = op;
+    }
+    async->tail = op;
+    async->outstanding++;
+    pthread_cond_signal(&async->submit_cv);
+    pthread_mutex_unlock(&async->mutex);
+    return 0;
+}
+
+// 异步查找
+int storage_async_get(StorageEngine *engine, StorageAsyncOp *op) {
+    if (!engine || !engine->initialized || !op || !op->key || !op->buf || op->buf_size == 0) {
+        return -1;
+    }
+    op->is_put = false;
+    return async_submit(engine, op);
+}
+
+// 异步写入：提交时检查 key/value，保证整批写入不会因为个别请求被拒绝
+int storage_async_put(StorageEngine *engine, StorageAsyncOp *op) {
+    if (!engine || !engine->initialized || !op || !op->key || !op->value ||
+        strlen(op->key) > MAX_KEY_SIZE || strlen(op->value) > MAX_VAL_SIZE) {
+        return -1;
+    }
+    op->is_put = true;
+    return async_submit(engine, op);
+}
+
+// 等待异步请求全部完成
+void storage_async_wait(StorageEngine *engine) {
+    if (!engine || !engine->initialized) {
+        return;
+    }
+    StorageAsync *async = &engine->async;
+    pthread_mutex_lock(&async->mutex);
+    while (async->outstanding > 0) {
+        pthread_cond_wait(&async->idle_cv, &async->mutex);
+    }
+    pthread_mutex_unlock(&async->mutex);
+}
+
+// 确保此前所有写操作的日志已落盘
+int storage_sync(StorageEngine *engine) {
+    if (!engine || !engine->initialized) {
+        return -1;
+    }
+    
+    return wal_sync(&engine->wal, wal_last_lsn(&engine->wal));
+}
+
+// 检查点
+int storage_checkpoint(StorageEngine *engine) {
+    if (!engine || !engine->initialized) {
+        return -1;
+    }
+    
+    size_t pins = write_begin(engine);
+    int ret = checkpoint_locked(engine);
+    write_end(engine, pins);
+    return ret;
+}
+
+// 后台刷盘统计
+int storage_flusher_stats(StorageEngine *engine, StorageFlusherStats *stats) {
+    if (!engine || !engine->initialized || !stats) {
+        return -1;
+    }
+    
+    memset(stats, 0, sizeof(StorageFlusherStats));
+    StorageFlusher *flusher = &engine->flusher;
+    pthread_mutex_lock(&flusher->mutex);
+    stats->running = flusher->started && !flusher->stop;
+    stats->pages_written = flusher->pages_written;
+    stats->pages_per_sec = flusher->pages_per_sec;
+    stats->checkpoints = flusher->checkpoints;
+    stats->last_checkpoint_ms = flusher->last_checkpoint_ms;
+    stats->max_checkpoint_ms = flusher->max_checkpoint_ms;
+    pthread_mutex_unlock(&flusher->mutex);
+    
+    size_t pins = read_begin(engine);
+    uint64_t last_lsn = wal_last_lsn(&engine->wal);
+    stats->checkpoint_lsn = engine->pm.header->checkpoint_lsn;
+    stats->lag_records = last_lsn > stats->checkpoint_lsn ? last_lsn - stats->checkpoint_lsn : 0;
+    stats->lag_bytes = wal_size(&engine->wal);
+    stats->dirty_pages = page_dirty_count(&engine->pm);
+    read_end(engine, pins);
+    return 0;
+}
+
+// 压缩索引文件
+// 搬动节点时被替换的旧页面要等检查点（后台刷盘时是下一次镜像切换）之后才变成空闲，
+// 所以搬动和检查点交替进行，直到一轮没有可搬的节点；最后收缩页面数，检查点把新的页面数写入文件头之后再截短文件。
+// 中途崩溃时文件头仍是某次检查点的状态，多出来的尾部页面下次压缩时回收
+int storage_compact(StorageEngine *engine, StorageCompactStats *stats) {
+    if (!engine || !engine->initialized) {
+        return -1;
+    }
+    
+    StorageCompactStats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(StorageCompactStats));
+    size_t pins = write_begin(engine);
+    stats->pages_before = engine->pm.page_count;
+    stats->file_bytes_before = engine->pm.index_size;
+    write_end(engine, pins);
+    
+    int ret = 0;
+    for (int round = 0; round < 3 && ret == 0; round++) {
+        uint64_t round_moved = 0;
+        for (;;) {
+            size_t moved = 0;
+            pins = write_begin(engine);
+            ret = btree_compact(&engine->btree, STORAGE_COMPACT_BATCH, &moved);
+            if (moved > 0) engine->write_seq++;
+            write_end(engine, pins);
+            round_moved += moved;
+            if (ret < 0 || moved < STORAGE_COMPACT_BATCH) break;
+        }
+        stats->pages_moved += round_moved;
+        
+        // 两次检查点：第二次结束第一次冻结的镜像，回收其中被替换的页面
+        pins = write_begin(engine);
+        if (ret == 0) ret = checkpoint_locked(engine);
+        if (ret == 0 && engine->flusher.enabled) ret = checkpoint_locked(engine);
+        write_end(engine, pins);
+        if (round_moved == 0) break;
+    }
+    
+    pins = write_begin(engine);
+    if (ret == 0) {
+        page_shrink(&engine->pm);
+        ret = checkpoint_locked(engine);
+    }
+    if (ret == 0 && page_truncate(&engine->pm) < 0) {
+        ret = -1;
+    }
+    stats->pages_after = engine->pm.page_count;
+    stats->free_pages_after = engine->pm.free_count;
+    stats->file_bytes_after = engine->pm.index_size;
+    if (stats->file_bytes_after < stats->file_bytes_before) {
+        stats->reclaimed_bytes = stats->file_bytes_before - stats->file_bytes_after;
+    }
+    write_end(engine, pins);
+    return ret;
+}
+
+// 批量加载
+// 先做检查点清空日志，加载完成后再做一次检查点，使新树不依赖 WAL 即可恢复。
+int storage_bulk_load(StorageEngine *engine, StorageBulkNext next, void *ctx, double fill_factor) {
+    if (!engine || !engine->initialized || !next) {
+        return -1;
+    }
+    
+    size_t pins = write_begin(engine);
+    int ret = checkpoint_locked(engine);
+    if (ret == 0) {
+        ret = btree_bulk_load(&engine->btree, next, ctx, fill_factor);
+        engine->write_seq++;
+    }
+    if (ret == 0) {
+        ret = checkpoint_locked(engine);
+    }
+    write_end(engine, pins);
+    return ret;
+}
+
+// 沿游标扫描，直到越过 end_key、prefix 不再匹配或回调要求结束（调用者持有读锁，或 tree 为快照视图）
+static int scan_tree(BTree *tree, const char *start_key, size_t start_len,
+                     const char *end_key, size_t end_len, const char *prefix, size_t prefix_len,
+                     StorageScanCallback callback, void *ctx) {
+    BTreeCursor cursor;
+    size_t pins = page_pin_mark(tree->pm);
+    
+    btree_cursor_init(&cursor, tree);
+    if (btree_cursor_seek2(&cursor, start_key, start_len) < 0) {
+        page_unpin_to(tree->pm, pins);
+        return 0;  // 没有 >= start_key 的键
+    }
+    
+    // 游标只保存页面 ID，每个键值对交给回调后即可释放期间钉住的页面，扫描不会钉住整棵树
+    int ret = 0;
+    do {
+        size_t klen, vlen;
+        const char *key = btree_cursor_key(&cursor, &klen);
+        const char *value = btree_cursor_value(&cursor, &vlen);
+        if (!value) {
+            ret = -1;  // 数据文件中的 value 引用损坏
+            break;
+        }
+        
+        if (end_key) {
+            size_t n = klen < end_len ? klen : end_len;
+            int cmp = memcmp(key, end_key, n);
+            if (cmp > 0 || (cmp == 0 && klen >= end_len)) break;
+        }
+        if (prefix && (klen < prefix_len || memcmp(key, prefix, prefix_len) != 0)) break;
+        int stop = callback(ctx, key, klen, value, vlen);
+        page_unpin_to(tree->pm, pins);
+        if (stop != 0) break;
+    } while (btree_cursor_next(&cursor) == 0);
+    
+    page_unpin_to(tree->pm, pins);
+    return ret;
+}
+
+// 范围扫描
+int storage_scan(StorageEngine *engine, const char *start_key, const char *end_key,
+                 StorageScanCallback callback, void *ctx) {
+    return storage_scan2(engine, start_key, start_key ? strlen(start_key) : 0,
+                         end_key, end_key ? strlen(end_key) : 0, callback, ctx);
+}
+
+// 范围扫描（显式长度）
+int storage_scan2(StorageEngine *engine, const void *start_key, size_t start_len,
+                  const void *end_key, size_t end_len, StorageScanCallback callback, void *ctx) {
+    if (!engine || !engine->initialized || !callback) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(engine);
+    int ret = scan_tree(&engine->btree, start_key, start_len, end_key, end_len, NULL, 0, callback, ctx);
+    read_end(engine, pins);
+    return ret;
+}
+
+// 前缀扫描
+int storage_scan_prefix(StorageEngine *engine, const char *prefix,
+                        StorageScanCallback callback, void *ctx) {
+    if (!prefix) {
+        return -1;
+    }
+    return storage_scan_prefix2(engine, prefix, strlen(prefix), callback, ctx);
+}
+
+// 前缀扫描（显式长度）
+int storage_scan_prefix2(StorageEngine *engine, const void *prefix, size_t prefix_len,
+                         StorageScanCallback callback, void *ctx) {
+    if (!engine || !engine->initialized || !prefix || !callback) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(engine);
+    int ret = scan_tree(&engine->btree, prefix, prefix_len, NULL, 0, prefix, prefix_len, callback, ctx);
+    read_end(engine, pins);
+    return ret;
+}
+
+// 开始读快照：持有读锁时没有写入在进行，记下的根就是最近一次写入完成后的树
+int storage_snapshot_begin(StorageEngine *engine, StorageSnapshot *snapshot) {
+    if (!engine || !engine->initialized || !snapshot) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(engine);
+    pthread_mutex_lock(&engine->lock.mutex);  // 多个读者可能同时开始快照
+    btree_snapshot_begin(&engine->btree, &snapshot->snap);
+    pthread_mutex_unlock(&engine->lock.mutex);
+    read_end(engine, pins);
+    snapshot->engine = engine;
+    return 0;
+}
+
+// 结束读快照：回收页面需要修改空闲位图，与写入互斥
+void storage_snapshot_end(StorageSnapshot *snapshot) {
+    if (!snapshot || !snapshot->engine) {
+        return;
+    }
+    
+    StorageEngine *engine = snapshot->engine;
+    size_t pins = write_begin(engine);
+    btree_snapshot_end(&engine->btree, &snapshot->snap);
+    write_end(engine, pins);
+    snapshot->engine = NULL;
+}
+
+// 在快照中查找（不加锁）
+int storage_snapshot_get2(StorageSnapshot *snapshot, const void *key, size_t klen,
+                          void *value, size_t value_size, size_t *vlen) {
+    if (!snapshot || !snapshot->engine || !key) {
+        return -1;
+    }
+    PageManager *pm = &snapshot->engine->pm;
+    size_t pins = page_pin_mark(pm);
+    int ret = btree_get2(&snapshot->snap.tree, key, klen, value, value_size, vlen);
+    page_unpin_to(pm, pins);
+    return ret;
+}
+
+// 在快照中范围扫描（不加锁，回调中可以调用引擎接口）
+int storage_snapshot_scan2(StorageSnapshot *snapshot, const void *start_key, size_t start_len,
+                           const void *end_key, size_t end_len, StorageScanCallback callback, void *ctx) {
+    if (!snapshot || !snapshot->engine || !callback) {
+        return -1;
+    }
+    return scan_tree(&snapshot->snap.tree, start_key, start_len, end_key, end_len, NULL, 0, callback, ctx);
+}
+
+// 初始化游标
+int storage_cursor_init(StorageCursor *cursor, StorageEngine *engine) {
+    if (!cursor || !engine || !engine->initialized) {
+        return -1;
+    }
+    
+    cursor->engine = engine;
+    btree_cursor_init(&cursor->cursor, &engine->btree);
+    cursor->klen = 0;
+    cursor->vlen = 0;
+    return 0;
+}
+
+// 游标移动后复制当前键值对并记录写序号（调用者持有读锁）
+static int cursor_capture(StorageCursor *cursor, int ret) {
+    cursor->seq = cursor->engine->write_seq;
+    if (ret < 0 || !btree_cursor_valid(&cursor->cursor)) {
+        cursor->klen = 0;
+        cursor->vlen = 0;
+        return -1;
+    }
+    
+    size_t klen, vlen;
+    const char *key = btree_cursor_key(&cursor->cursor, &klen);
+    const char *value = btree_cursor_value(&cursor->cursor, &vlen);
+    if (!value) {
+        cursor->klen = 0;
+        cursor->vlen = 0;
+        return -1;
+    }
+    memcpy(cursor->key, key, klen);
+    cursor->key[klen] = '\0';
+    cursor->klen = klen;
+    if (vlen <= MAX_INLINE_VAL) {
+        memcpy(cursor->value, value, vlen);
+        cursor->value[vlen] = '\0';
+        cursor->value_ptr = cursor->value;
+    } else {
+        cursor->value_ptr = value;
+    }
+    cursor->vlen = vlen;
+    return 0;
+}
+
+// 树在游标定位后被修改过：按保存的 key 重新定位（调用者持有读锁）
+// 返回 0 表示仍停在原 key，1 表示原 key 已删除、停在其后继，-1 表示没有 >= 原 key 的键
+static int cursor_resync(StorageCursor *cursor) {
+    if (btree_cursor_seek2(&cursor->cursor, cursor->key, cursor->klen) < 0) {
+        return -1;
+    }
+    
+    size_t klen;
+    const char *key = btree_cursor_key(&cursor->cursor, &klen);
+    return klen == cursor->klen && memcmp(key, cursor->key, klen) == 0 ? 0 : 1;
+}
+
+// 定位到第一个 >= key 的键值对
+int storage_cursor_seek(StorageCursor *cursor, const char *key) {
+    return storage_cursor_seek2(cursor, key, key ? strlen(key) : 0);
+}
+
+// 定位到第一个 >= key 的键值对（显式长度）
+int storage_cursor_seek2(StorageCursor *cursor, const void *key, size_t klen) {
+    if (!cursor || !cursor->engine) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(cursor->engine);
+    int ret = cursor_capture(cursor, btree_cursor_seek2(&cursor->cursor, key, klen));
+    read_end(cursor->engine, pins);
+    return ret;
+}
+
+// 定位到最后一个键值对
+int storage_cursor_last(StorageCursor *cursor) {
+    if (!cursor || !cursor->engine) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(cursor->engine);
+    int ret = cursor_capture(cursor, btree_cursor_last(&cursor->cursor));
+    read_end(cursor->engine, pins);
+    return ret;
+}
+
+// 移动到下一个键值对
+int storage_cursor_next(StorageCursor *cursor) {
+    if (!storage_cursor_valid(cursor)) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(cursor->engine);
+    int ret;
+    if (cursor->seq == cursor->engine->write_seq) {
+        ret = btree_cursor_next(&cursor->cursor);
+    } else {
+        // 原 key 已被删除时重新定位的结果就是下一个键
+        ret = cursor_resync(cursor);
+        ret = ret == 0 ? btree_cursor_next(&cursor->cursor) : (ret > 0 ? 0 : -1);
+    }
+    ret = cursor_capture(cursor, ret);
+    read_end(cursor->engine, pins);
+    return ret;
+}
+
+// 移动到上一个键值对
+int storage_cursor_prev(StorageCursor *cursor) {
+    if (!storage_cursor_valid(cursor)) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(cursor->engine);
+    int ret;
+    if (cursor->seq == cursor->engine->write_seq) {
+        ret = btree_cursor_prev(&cursor->cursor);
+    } else if (cursor_resync(cursor) >= 0) {
+        ret = btree_cursor_prev(&cursor->cursor);
+    } else {
+        ret = btree_cursor_last(&cursor->cursor);  // 所有键都小于原 key
+    }
+    ret = cursor_capture(cursor, ret);
+    read_end(cursor->engine, pins);
+    return ret;
+}
+
+// 游标是否有效
+bool storage_cursor_valid(const StorageCursor *cursor) {
+    return cursor && cursor->engine && btree_cursor_valid(&cursor->cursor);
+}
+
+// 获取当前 key
+const char* storage_cursor_key(const StorageCursor *cursor, size_t *klen) {
+    if (!storage_cursor_valid(cursor)) {
+        return NULL;
+    }
+    *klen = cursor->klen;
+    return cursor->key;
+}
+
+// 获取当前 value
+const char* storage_cursor_value(const StorageCursor *cursor, size_t *vlen) {
+    if (!storage_cursor_valid(cursor)) {
+        return NULL;
+    }
+    *vlen = cursor->vlen;
+    return cursor->value_ptr;
+}
+
+// 获取 B+ 树统计信息
+int storage_stats(StorageEngine *engine, BTreeStats *stats) {
+    if (!engine || !engine->initialized || !stats) {
+        return -1;
+    }
+    
+    size_t pins = read_begin(engine);
+    int ret = btree_stats(&engine->btree, stats);
+    read_end(engine, pins);
+    return ret;
 }
 
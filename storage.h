@@ -3,18 +3,175 @@
 
 #include "btree.h"
 #include "page.h"
+#include "wal.h"
 #include <stdint.h>
+#include <pthread.h>
+
+#define STORAGE_FLUSH_INTERVAL_MS 100                    // 后台刷盘的默认周期
+#define STORAGE_FLUSH_BATCH 64                           // 后台写回每次持写锁取出的最大页面数
+#define STORAGE_CHECKPOINT_WAL_BYTES (16 * 1024 * 1024)  // 默认在 WAL 超过 16MB 时做检查点
+#define STORAGE_COMPACT_BATCH 256                        // 压缩每次持写锁搬动的最大页面数
+
+// 存储引擎配置
+typedef struct {
+    WalSyncMode sync_mode;    // WAL 同步模式（默认 WAL_SYNC_BATCH）
+    bool node_cache;          // 是否在内存中缓存上层内部节点（默认开启）
+    size_t buffer_pool_pages; // 索引文件缓冲池的页框数：0 使用 mmap（默认），否则按 pread/pwrite 读写并由缓冲池决定哪些页面常驻
+    unsigned io_depth;        // 缓冲池批量预读/刷盘的队列深度（默认 AIO_DEFAULT_DEPTH）
+    AioBackend io_backend;    // 批量 I/O 后端（默认 AIO_BACKEND_AUTO：优先 io_uring，不可用时用线程池）
+    bool background_flush;    // 是否由后台线程在两次检查点之间写回脏页并定期做检查点（默认关闭）
+    unsigned flush_interval_ms;       // 后台刷盘的周期（默认 STORAGE_FLUSH_INTERVAL_MS）
+    uint32_t flush_rate;              // 后台写回的速率上限（页/秒，0 表示不限速）
+    uint64_t checkpoint_wal_bytes;    // WAL 超过这么多字节时后台线程做检查点（默认 STORAGE_CHECKPOINT_WAL_BYTES）
+} StorageOptions;
+
+// 引擎读写锁：多个读者并发，写者独占；有写者等待时新读者排队，避免写者饿死
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t readers_cv;   // 读者等待写者离开
+    pthread_cond_t writers_cv;   // 写者等待读者和其他写者离开
+    int readers;                 // 持有读锁的线程数
+    int writers_waiting;         // 等待写锁的线程数
+    bool writer;                 // 是否有写者持有锁
+} StorageLock;
+
+typedef struct StorageAsyncOp StorageAsyncOp;
+
+// 异步请求完成回调
+typedef void (*StorageAsyncCallback)(StorageAsyncOp *op);
+
+// 异步 get/put 请求：调用者分配并在完成前保持有效，key/value 以 '\0' 结尾
+struct StorageAsyncOp {
+    const char *key;
+    const char *value;                // put：要写入的 value
+    char *buf;                        // get：输出缓冲区（结果以 '\0' 结尾）
+    size_t buf_size;                  // get：输出缓冲区大小
+    int result;                       // 完成时填写：0 成功，-1 失败或未找到
+    StorageAsyncCallback callback;    // 完成回调（可以为 NULL）
+    void *user_data;                  // 留给调用者
+    bool is_put;                      // 以下由引擎使用
+    StorageAsyncOp *next;
+};
+
+// 异步请求队列：提交的请求由引擎的后台线程按提交顺序攒批执行
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t submit_cv;         // 有新请求或要求退出
+    pthread_cond_t idle_cv;           // 已提交的请求全部完成
+    StorageAsyncOp *head, *tail;      // 等待执行的请求
+    size_t outstanding;               // 已提交、尚未完成的请求数
+    pthread_t thread;
+    bool started;                     // 后台线程在第一次提交时启动
+    bool stop;
+} StorageAsync;
+
+// 后台刷盘：每个周期把脏页分批写回（每批在写锁下取出，写盘时不持有引擎锁），WAL 超过阈值时做检查点。
+// 检查点只需再刷上一轮之后变脏的页面，持有写锁的时间很短；日志长度有上限，崩溃后重放的记录数也有上限。
+// 开启期间文件头指向的树被冻结为检查点镜像（见 btree_shadow_advance），写回的页面不会改动它
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t stop_cv;           // 要求退出
+    pthread_t thread;
+    bool enabled;                     // 后台刷盘开启（检查点据此冻结镜像）
+    bool started;
+    bool stop;
+    unsigned interval_ms;
+    uint32_t rate;
+    uint64_t checkpoint_bytes;
+    BTreeSnapshot shadows[2];         // 轮流用作检查点镜像
+    uint64_t pages_written;           // 以下为统计（受 mutex 保护）
+    double pages_per_sec;
+    uint64_t window_pages;            // 速率统计窗口开始时的 pages_written
+    double window_start;
+    uint64_t checkpoints;
+    double last_checkpoint_ms;
+    double max_checkpoint_ms;
+} StorageFlusher;
+
+// 后台刷盘统计
+typedef struct {
+    bool running;                     // 后台刷盘线程是否在运行
+    uint64_t pages_written;           // 后台写回的页面总数
+    double pages_per_sec;             // 最近约一秒的写回速率
+    uint64_t checkpoints;             // 后台线程做的检查点次数
+    double last_checkpoint_ms;        // 最近一次后台检查点持有写锁的时间
+    double max_checkpoint_ms;         // 其中最长的一次
+    uint64_t checkpoint_lsn;          // 文件头中的检查点 LSN
+    uint64_t lag_records;             // 检查点之后的日志记录数（崩溃后需要重放的记录）
+    uint64_t lag_bytes;               // 检查点之后的日志字节数
+    uint64_t dirty_pages;             // 当前的脏页数
+} StorageFlusherStats;
+
+// 压缩结果
+typedef struct {
+    uint64_t pages_moved;             // 搬动的节点数
+    uint64_t pages_before;            // 压缩前索引文件的页面数
+    uint64_t pages_after;             // 压缩后的页面数
+    uint64_t free_pages_after;        // 压缩后仍然空闲的页面数（被快照占用的页面在快照结束前无法回收）
+    uint64_t file_bytes_before;       // 压缩前索引文件的字节数
+    uint64_t file_bytes_after;        // 压缩后的字节数
+    uint64_t reclaimed_bytes;         // 截短回收的字节数
+} StorageCompactStats;
 
 // 存储引擎结构
 typedef struct {
     PageManager pm;
     BTree btree;
+    Wal wal;
+    StorageLock lock;            // 读操作共享、写操作（WAL 追加 + 树修改）独占，等待日志落盘时不持有
+    uint64_t write_seq;          // 树每被修改一次加一，游标据此发现并发写入
+    uint64_t view_pins;          // 尚未释放的 value 视图数（受 lock.mutex 保护）
+    StorageAsync async;          // 异步 get/put 队列
+    StorageFlusher flusher;      // 后台刷盘
     bool initialized;
 } StorageEngine;
 
-// 初始化存储引擎
+// 范围扫描回调：key/value 指向页面内部且不以 '\0' 结尾，返回非 0 提前结束扫描
+typedef int (*StorageScanCallback)(void *ctx, const char *key, size_t klen,
+                                   const char *value, size_t vlen);
+
+// 批量加载数据源：产生一个键值对返回 1，结束返回 0，出错返回 -1
+typedef int (*StorageBulkNext)(void *ctx, const char **key, size_t *klen,
+                               const char **value, size_t *vlen);
+
+// 有序游标：保存当前键值对的副本，移动时发现树被修改过则先按当前 key 重新定位
+// 存放在数据文件中的大 value 只追加不覆盖，游标直接引用其映射地址而不复制
+typedef struct {
+    StorageEngine *engine;
+    BTreeCursor cursor;
+    uint64_t seq;                     // 定位时引擎的 write_seq
+    char key[MAX_KEY_SIZE + 1];       // 当前 key 的副本
+    size_t klen;
+    char value[MAX_INLINE_VAL + 1];   // 当前内联 value 的副本
+    const char *value_ptr;            // 当前 value（指向 value 或数据文件映射区域）
+    size_t vlen;
+} StorageCursor;
+
+// value 视图：长 value 直接指向数据文件的映射区域（只追加不覆盖，文件增长时地址不变），
+// 内联在叶子中的短 value 会被原地修改，复制到视图内部的缓冲区
+typedef struct {
+    StorageEngine *engine;
+    const char *data;                 // value 内容（不以 '\0' 结尾）
+    size_t len;
+    char buf[MAX_INLINE_VAL];         // 内联 value 的副本
+} StorageView;
+
+// 读快照：开始时刻整棵树的一致视图。之后的写入按写时复制进行，不会修改快照能看到的页面，
+// 快照结束前这些页面也不会被回收；在快照中读取不持有引擎锁，长时间的扫描或备份不阻塞写入
+typedef struct {
+    StorageEngine *engine;
+    BTreeSnapshot snap;
+} StorageSnapshot;
+
+// 获取默认配置
+void storage_default_options(StorageOptions *options);
+
+// 初始化存储引擎（使用默认配置）
 int storage_init(StorageEngine *engine, const char *db_file);
 
+// 按指定配置初始化存储引擎，会重放 <db>.wal 中检查点之后的记录
+int storage_init_ex(StorageEngine *engine, const char *db_file, const StorageOptions *options);
+
 // 关闭存储引擎
 int storage_close(StorageEngine *engine);
 
@@ -27,5 +184,108 @@ int storage_get(StorageEngine *engine, const char *key, char *value, size_t valu
 // 删除键值对
 int storage_delete(StorageEngine *engine, const char *key);
 
-#endif // STORAGE_H
+// 以下为显式长度版本：key/value 可以包含任意字节（包括 '\0'），按字节序（memcmp）排序，
+// 适合大端整数、复合 key 等二进制数据
+
+// 插入键值对
+int storage_put2(StorageEngine *engine, const void *key, size_t klen, const void *value, size_t vlen);
 
+// 获取值：最多复制 value_size 字节（不追加 '\0'），vlen 返回 value 的完整长度
+int storage_get2(StorageEngine *engine, const void *key, size_t klen,
+                 void *value, size_t value_size, size_t *vlen);
+
+// 删除键值对
+int storage_delete2(StorageEngine *engine, const void *key, size_t klen);
+
+// 获取 value 的只读视图，不复制长 value；视图在 storage_view_release 前一直有效，不持有锁，
+// 期间可以继续读写（包括覆盖或删除该 key）。未找到返回 -1
+int storage_get_view(StorageEngine *engine, const void *key, size_t klen, StorageView *view);
+
+// 释放视图（关闭引擎前必须释放全部视图）
+void storage_view_release(StorageView *view);
+
+// 批量插入：整批日志一次追加、一次提交，树中按 key 排序后插入并复用下降路径
+// 任一项的 key/value 为空或超长时整批拒绝；返回 0 表示全部成功，各项结果见 items[i].result
+int storage_put_batch(StorageEngine *engine, BTreeBatchItem *items, size_t count);
+
+// 批量查找：结果写入 items[i].buf，返回命中数，items[i].result 为 0 表示命中
+int storage_get_batch(StorageEngine *engine, BTreeBatchItem *items, size_t count);
+
+// 异步查找 / 写入：请求入队后立即返回，由后台线程执行并在完成时调用 op->callback（在后台线程中、不持有引擎锁）。
+// 后台线程每次取出全部排队的请求，把连续的同类请求合成一次 storage_get_batch / storage_put_batch：
+// 一批写入只追加、提交一次日志，缓冲池模式下一批查找按层批量预读要访问的页面。
+// 同一线程先后提交的请求按提交顺序生效。参数无效时返回 -1 且不会回调
+int storage_async_get(StorageEngine *engine, StorageAsyncOp *op);
+int storage_async_put(StorageEngine *engine, StorageAsyncOp *op);
+
+// 等待此前提交的全部异步请求完成（storage_close 会先等待）
+void storage_async_wait(StorageEngine *engine);
+
+// 确保此前所有写操作的日志已落盘
+int storage_sync(StorageEngine *engine);
+
+// 检查点：把页面刷到磁盘，记录检查点 LSN 并清空 WAL
+int storage_checkpoint(StorageEngine *engine);
+
+// 获取后台刷盘的统计和当前的检查点滞后（未开启后台刷盘时 running 为 false，滞后照常统计）
+int storage_flusher_stats(StorageEngine *engine, StorageFlusherStats *stats);
+
+// 压缩索引文件：把文件尾部的节点搬到前面的空闲页面（每批 STORAGE_COMPACT_BATCH 个，批与批之间放开写锁），
+// 做检查点后截掉尾部的空闲页面并缩小文件。stats 可以为 NULL；返回 0 成功，-1 失败
+int storage_compact(StorageEngine *engine, StorageCompactStats *stats);
+
+// 向空数据库批量加载按 key 严格递增的键值对（不写 WAL，完成后做一次检查点）
+// fill_factor 为节点目标填充率（0~1，传 0 使用默认值 0.9）
+int storage_bulk_load(StorageEngine *engine, StorageBulkNext next, void *ctx, double fill_factor);
+
+// 按 key 顺序扫描 [start_key, end_key)，NULL 表示不设边界；扫描期间持有读锁，回调中不能再调用引擎接口
+int storage_scan(StorageEngine *engine, const char *start_key, const char *end_key,
+                 StorageScanCallback callback, void *ctx);
+
+// 按 key 顺序扫描所有以 prefix 开头的键值对
+int storage_scan_prefix(StorageEngine *engine, const char *prefix,
+                        StorageScanCallback callback, void *ctx);
+
+// 范围扫描和前缀扫描的显式长度版本（start_key/end_key 为 NULL 表示不设边界）
+int storage_scan2(StorageEngine *engine, const void *start_key, size_t start_len,
+                  const void *end_key, size_t end_len, StorageScanCallback callback, void *ctx);
+int storage_scan_prefix2(StorageEngine *engine, const void *prefix, size_t prefix_len,
+                         StorageScanCallback callback, void *ctx);
+
+// 开始读快照（关闭引擎前必须结束全部快照）
+int storage_snapshot_begin(StorageEngine *engine, StorageSnapshot *snapshot);
+
+// 结束读快照，回收只被已结束快照引用的页面
+void storage_snapshot_end(StorageSnapshot *snapshot);
+
+// 在快照中查找和范围扫描，参数与 storage_get2 / storage_scan2 相同
+int storage_snapshot_get2(StorageSnapshot *snapshot, const void *key, size_t klen,
+                          void *value, size_t value_size, size_t *vlen);
+int storage_snapshot_scan2(StorageSnapshot *snapshot, const void *start_key, size_t start_len,
+                           const void *end_key, size_t end_len, StorageScanCallback callback, void *ctx);
+
+// 初始化游标（游标本身不能被多个线程同时使用，但可以与其他线程的读写并发）
+int storage_cursor_init(StorageCursor *cursor, StorageEngine *engine);
+
+// 定位到第一个 >= key 的键值对（key 为 NULL 时定位到第一个）
+int storage_cursor_seek(StorageCursor *cursor, const char *key);
+int storage_cursor_seek2(StorageCursor *cursor, const void *key, size_t klen);
+
+// 定位到最后一个键值对
+int storage_cursor_last(StorageCursor *cursor);
+
+// 移动到下一个 / 上一个键值对，越界返回 -1
+int storage_cursor_next(StorageCursor *cursor);
+int storage_cursor_prev(StorageCursor *cursor);
+
+// 游标是否指向有效的键值对
+bool storage_cursor_valid(const StorageCursor *cursor);
+
+// 获取当前 key / value（下次移动游标前有效；key 以 '\0' 结尾，value 的长度以 vlen 为准）
+const char* storage_cursor_key(const StorageCursor *cursor, size_t *klen);
+const char* storage_cursor_value(const StorageCursor *cursor, size_t *vlen);
+
+// 获取 B+ 树的深度、扇出和填充率统计
+int storage_stats(StorageEngine *engine, BTreeStats *stats);
+
+#endif // STORAGE_H
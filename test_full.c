@@ -1,9 +1,17 @@
+#define _POSIX_C_SOURCE 200809L  // nanosleep
 #include "storage.h"
+#include "search.h"
+#include "bufpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
 
 // 测试大量插入和查找
 void test_large_insert() {
@@ -172,6 +180,2231 @@ void test_persistence() {
     storage_close(&engine);
 }
 
+// 复制文件（用于模拟崩溃时磁盘上的状态）
+static void copy_file(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb");
+    FILE *out = fopen(to, "wb");
+    assert(in && out);
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        assert(fwrite(buf, 1, n, out) == n);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+// 测试 WAL 崩溃恢复
+void test_wal_recovery() {
+    printf("\n=== 测试 WAL 崩溃恢复 ===\n");
+    StorageEngine engine;
+    StorageOptions options;
+    char value[1024];
+    char key[64];
+    
+    remove("test_wal.db.idx");
+    remove("test_wal.db.dat");
+    remove("test_wal.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_OP;
+    
+    // 检查点之前的数据
+    assert(storage_init_ex(&engine, "test_wal.db", &options) == 0);
+    for (int i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(storage_put(&engine, key, value) == 0);
+    }
+    assert(storage_checkpoint(&engine) == 0);
+    copy_file("test_wal.db.idx", "test_wal.db.idx.crash");
+    
+    // 检查点之后的写入只存在于日志中
+    for (int i = 50; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(storage_put(&engine, key, value) == 0);
+    }
+    assert(storage_put(&engine, "key0", "updated") == 0);
+    assert(storage_delete(&engine, "key1") == 0);
+    
+    // 失败的操作不留下日志记录：删除不存在的 key、追加后撤销的记录，重启后都不会被重放
+    uint64_t lsn = wal_last_lsn(&engine.wal), size = wal_size(&engine.wal);
+    assert(storage_delete(&engine, "missing") != 0);
+    assert(wal_last_lsn(&engine.wal) == lsn && wal_size(&engine.wal) == size);
+    uint64_t ghost = wal_append(&engine.wal, WAL_PUT, "ghost", 5, "boo", 3);
+    assert(ghost == lsn + 1 && wal_sync(&engine.wal, ghost) == 0);
+    assert(wal_abort(&engine.wal, ghost) == 0 && wal_abort(&engine.wal, ghost) != 0);
+    assert(wal_last_lsn(&engine.wal) == lsn && wal_size(&engine.wal) == size);
+    
+    // 只写进去一部分的记录被截掉，日志文件停在追加之前的大小，之后的记录照常追加
+    struct rlimit saved, limit;
+    assert(getrlimit(RLIMIT_FSIZE, &saved) == 0);
+    limit = saved;
+    limit.rlim_cur = size + 16;
+    memset(value, 'x', 500);
+    signal(SIGXFSZ, SIG_IGN);
+    assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+    assert(wal_append(&engine.wal, WAL_PUT, "ghost", 5, value, 500) == 0);
+    assert(setrlimit(RLIMIT_FSIZE, &saved) == 0);
+    signal(SIGXFSZ, SIG_DFL);
+    assert(wal_last_lsn(&engine.wal) == lsn && wal_size(&engine.wal) == size);
+    assert(lseek(engine.wal.fd, 0, SEEK_END) == (off_t)size);
+    assert(storage_put(&engine, "key2", "value2") == 0);
+    copy_file("test_wal.db.wal", "test_wal.db.wal.crash");
+    storage_close(&engine);
+    
+    // 模拟崩溃：索引文件回到检查点时的状态，日志保留崩溃前的内容
+    rename("test_wal.db.idx.crash", "test_wal.db.idx");
+    rename("test_wal.db.wal.crash", "test_wal.db.wal");
+    
+    assert(storage_init_ex(&engine, "test_wal.db", &options) == 0);
+    for (int i = 2; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        char result[1024];
+        assert(storage_get(&engine, key, result, sizeof(result)) == 0);
+        assert(strcmp(result, value) == 0);
+    }
+    assert(storage_get(&engine, "key0", value, sizeof(value)) == 0);
+    assert(strcmp(value, "updated") == 0);
+    assert(storage_get(&engine, "key1", value, sizeof(value)) != 0);
+    assert(storage_get(&engine, "ghost", value, sizeof(value)) != 0);
+    
+    printf("  重放检查点之后的 53 条日志记录（撤销的记录不重放）：通过\n");
+    
+    storage_close(&engine);
+}
+
+// 测试增量刷盘：只同步脏页
+void test_flush_bytes() {
+    printf("\n=== 测试增量刷盘 ===\n");
+    StorageEngine engine;
+    char value[64];
+    char key[64];
+    
+    remove("test_flush.db.idx");
+    remove("test_flush.db.dat");
+    remove("test_flush.db.wal");
+    assert(storage_init(&engine, "test_flush.db") == 0);
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "key%06d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        assert(storage_put(&engine, key, value) == 0);
+    }
+    assert(storage_checkpoint(&engine) == 0);
+    
+    // 干净状态下检查点不刷任何数据页
+    uint64_t before = engine.pm.stats.flushed_bytes;
+    assert(storage_checkpoint(&engine) == 0);
+    assert(engine.pm.stats.flushed_bytes == before);
+    
+    // 更新一个 key：只刷它所在的叶子和记录检查点 LSN 的文件头
+    assert(storage_put(&engine, "key010000", "updated") == 0);
+    before = engine.pm.stats.flushed_bytes;
+    assert(storage_checkpoint(&engine) == 0);
+    uint64_t flushed = engine.pm.stats.flushed_bytes - before;
+    printf("  更新 1 个 key 后刷盘 %llu 字节（索引文件 %zu 字节）\n",
+           (unsigned long long)flushed, engine.pm.index_size);
+    assert(flushed == 2 * PAGE_SIZE);
+    
+    // 分裂会多刷新节点和父节点，但仍远小于整个文件
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "key010000-%03d", i);
+        assert(storage_put(&engine, key, "v") == 0);
+    }
+    before = engine.pm.stats.flushed_bytes;
+    assert(storage_checkpoint(&engine) == 0);
+    flushed = engine.pm.stats.flushed_bytes - before;
+    printf("  插入 200 个相邻 key 后刷盘 %llu 字节\n", (unsigned long long)flushed);
+    assert(flushed < engine.pm.index_size / 4);
+    
+    storage_close(&engine);
+}
+
+// 范围扫描回调：检查有序并计数
+typedef struct {
+    int count;
+    char last[64];
+} ScanState;
+
+static int scan_collect(void *ctx, const char *key, size_t klen, const char *value, size_t vlen) {
+    ScanState *state = ctx;
+    char buf[64];
+    (void)value;
+    (void)vlen;
+    
+    assert(klen < sizeof(buf));
+    memcpy(buf, key, klen);
+    buf[klen] = '\0';
+    assert(state->count == 0 || strcmp(state->last, buf) < 0);
+    strcpy(state->last, buf);
+    state->count++;
+    return 0;
+}
+
+static bool cursor_key_is(StorageCursor *cursor, const char *expect) {
+    size_t klen;
+    const char *key = storage_cursor_key(cursor, &klen);
+    return key && klen == strlen(expect) && memcmp(key, expect, klen) == 0;
+}
+
+// 测试范围扫描和游标
+void test_range_scan() {
+    printf("\n=== 测试范围扫描和游标 ===\n");
+    StorageEngine engine;
+    StorageCursor cursor;
+    ScanState state;
+    char key[64];
+    size_t klen, vlen;
+    
+    remove("test_scan.db.idx");
+    remove("test_scan.db.dat");
+    remove("test_scan.db.wal");
+    assert(storage_init(&engine, "test_scan.db") == 0);
+    
+    // 只插入偶数 key，另加一组不同前缀的 key
+    for (int i = 0; i < 6000; i += 2) {
+        snprintf(key, sizeof(key), "key%05d", i);
+        assert(storage_put(&engine, key, key) == 0);
+    }
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "other%03d", i);
+        assert(storage_put(&engine, key, "x") == 0);
+    }
+    // 删除一段连续 key，让中间的叶子被合并
+    for (int i = 2000; i < 3000; i += 2) {
+        snprintf(key, sizeof(key), "key%05d", i);
+        assert(storage_delete(&engine, key) == 0);
+    }
+    int total = 3000 - 500 + 100;
+    
+    memset(&state, 0, sizeof(state));
+    assert(storage_scan(&engine, "key00100", "key00200", scan_collect, &state) == 0);
+    assert(state.count == 50);
+    assert(strcmp(state.last, "key00198") == 0);
+    
+    memset(&state, 0, sizeof(state));
+    assert(storage_scan(&engine, "key01990", "key03010", scan_collect, &state) == 0);
+    assert(state.count == 5 + 5);
+    
+    memset(&state, 0, sizeof(state));
+    assert(storage_scan_prefix(&engine, "key001", scan_collect, &state) == 0);
+    assert(state.count == 50);
+    
+    memset(&state, 0, sizeof(state));
+    assert(storage_scan_prefix(&engine, "other", scan_collect, &state) == 0);
+    assert(state.count == 100);
+    
+    memset(&state, 0, sizeof(state));
+    assert(storage_scan(&engine, NULL, NULL, scan_collect, &state) == 0);
+    assert(state.count == total);
+    printf("  范围扫描和前缀扫描结果正确\n");
+    
+    // 正向和反向遍历整棵树
+    assert(storage_cursor_init(&cursor, &engine) == 0);
+    int count = 0;
+    for (int ret = storage_cursor_seek(&cursor, NULL); ret == 0; ret = storage_cursor_next(&cursor)) {
+        count++;
+    }
+    assert(count == total);
+    
+    count = 0;
+    memset(&state, 0, sizeof(state));
+    for (int ret = storage_cursor_last(&cursor); ret == 0; ret = storage_cursor_prev(&cursor)) {
+        const char *k = storage_cursor_key(&cursor, &klen);
+        memcpy(key, k, klen);
+        key[klen] = '\0';
+        assert(count == 0 || strcmp(key, state.last) < 0);
+        strcpy(state.last, key);
+        count++;
+    }
+    assert(count == total);
+    assert(strcmp(state.last, "key00000") == 0);
+    
+    // seek 到不存在的 key 定位到后继，跨越被删除的区间后再退回
+    assert(storage_cursor_seek(&cursor, "key00101") == 0);
+    assert(cursor_key_is(&cursor, "key00102"));
+    assert(storage_cursor_prev(&cursor) == 0);
+    assert(cursor_key_is(&cursor, "key00100"));
+    const char *v = storage_cursor_value(&cursor, &vlen);
+    assert(vlen == 8 && memcmp(v, "key00100", vlen) == 0);
+    
+    assert(storage_cursor_seek(&cursor, "key02000") == 0);
+    assert(cursor_key_is(&cursor, "key03000"));
+    assert(storage_cursor_prev(&cursor) == 0);
+    assert(cursor_key_is(&cursor, "key01998"));
+    assert(storage_cursor_next(&cursor) == 0);
+    assert(cursor_key_is(&cursor, "key03000"));
+    
+    assert(storage_cursor_seek(&cursor, "zzz") == -1);
+    assert(!storage_cursor_valid(&cursor));
+    printf("  游标正向/反向遍历 %d 个 key 正确\n", total);
+    
+    storage_close(&engine);
+}
+
+// 批量加载数据源：按顺序产生 key000000 ... 的键值对
+typedef struct {
+    int next;
+    int count;
+    int step;
+    char key[64];
+    char value[64];
+} BulkSource;
+
+static int bulk_next(void *ctx, const char **key, size_t *klen, const char **value, size_t *vlen) {
+    BulkSource *src = ctx;
+    if (src->next >= src->count) return 0;
+    snprintf(src->key, sizeof(src->key), "key%06d", src->next);
+    snprintf(src->value, sizeof(src->value), "value%d", src->next);
+    src->next += src->step;
+    *key = src->key;
+    *klen = strlen(src->key);
+    *value = src->value;
+    *vlen = strlen(src->value);
+    return 1;
+}
+
+static int bulk_unsorted(void *ctx, const char **key, size_t *klen, const char **value, size_t *vlen) {
+    int *n = ctx;
+    static const char *keys[] = {"b", "c", "a"};
+    if (*n >= 3) return 0;
+    *key = keys[*n];
+    *klen = 1;
+    *value = "v";
+    *vlen = 1;
+    (*n)++;
+    return 1;
+}
+
+// 测试批量加载
+void test_bulk_load() {
+    printf("\n=== 测试批量加载 ===\n");
+    StorageEngine engine;
+    BulkSource src = {0, 50000, 2, "", ""};
+    BTreeStats stats;
+    char key[64];
+    char value[64];
+    char expected[64];
+    
+    remove("test_bulk.db.idx");
+    remove("test_bulk.db.dat");
+    remove("test_bulk.db.wal");
+    assert(storage_init(&engine, "test_bulk.db") == 0);
+    
+    // 无序输入被拒绝，树保持为空
+    int n = 0;
+    assert(storage_bulk_load(&engine, bulk_unsorted, &n, 0) == -1);
+    assert(storage_get(&engine, "b", value, sizeof(value)) == -1);
+    
+    assert(storage_bulk_load(&engine, bulk_next, &src, 0) == 0);
+    assert(storage_stats(&engine, &stats) == 0);
+    assert(stats.key_count == 25000);
+    assert(stats.leaf_fill > 0.8);
+    printf("  加载 %llu 个 key：树高 %u，叶子 %llu，叶子填充率 %.1f%%\n",
+           (unsigned long long)stats.key_count, stats.depth,
+           (unsigned long long)stats.leaf_count, stats.leaf_fill * 100);
+    
+    // 非空树不能再批量加载
+    src.next = 0;
+    assert(storage_bulk_load(&engine, bulk_next, &src, 0) == -1);
+    
+    // 加载后的树支持正常的写入和删除
+    for (int i = 1; i < 50000; i += 50) {
+        snprintf(key, sizeof(key), "key%06d", i);
+        assert(storage_put(&engine, key, "odd") == 0);
+    }
+    for (int i = 0; i < 10000; i += 2) {
+        snprintf(key, sizeof(key), "key%06d", i);
+        assert(storage_delete(&engine, key) == 0);
+    }
+    storage_close(&engine);
+    
+    assert(storage_init(&engine, "test_bulk.db") == 0);
+    for (int i = 0; i < 50000; i++) {
+        snprintf(key, sizeof(key), "key%06d", i);
+        int ret = storage_get(&engine, key, value, sizeof(value));
+        if (i % 2 == 0 && i >= 10000) {
+            snprintf(expected, sizeof(expected), "value%d", i);
+            assert(ret == 0 && strcmp(value, expected) == 0);
+        } else if (i % 50 == 1) {
+            assert(ret == 0 && strcmp(value, "odd") == 0);
+        } else {
+            assert(ret == -1);
+        }
+    }
+    printf("  加载后的写入、删除和重新打开正确\n");
+    storage_close(&engine);
+    
+    // 低填充率产生多层内部节点
+    remove("test_bulk.db.idx");
+    remove("test_bulk.db.dat");
+    remove("test_bulk.db.wal");
+    assert(storage_init(&engine, "test_bulk.db") == 0);
+    src.next = 0;
+    src.step = 1;
+    src.count = 20000;
+    assert(storage_bulk_load(&engine, bulk_next, &src, 0.1) == 0);
+    assert(storage_stats(&engine, &stats) == 0);
+    assert(stats.depth >= 3 && stats.key_count == 20000);
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "key%06d", i);
+        snprintf(expected, sizeof(expected), "value%d", i);
+        assert(storage_get(&engine, key, value, sizeof(value)) == 0 && strcmp(value, expected) == 0);
+    }
+    printf("  填充率 10%%：树高 %u，查找全部命中\n", stats.depth);
+    
+    storage_close(&engine);
+}
+
+// 测试批量 put/get
+void test_batch() {
+    printf("\n=== 测试批量操作 ===\n");
+    StorageEngine engine;
+    enum { BATCH = 2000, ROUNDS = 10, KEYS = 15000 };
+    static char keys[BATCH][32];
+    static char values[BATCH][32];
+    static char bufs[BATCH][32];
+    static int expected[KEYS];  // 每个 key 最后写入的轮次，-1 表示未写入
+    BTreeBatchItem items[BATCH];
+    char value[64];
+    
+    remove("test_batch.db.idx");
+    remove("test_batch.db.dat");
+    remove("test_batch.db.wal");
+    assert(storage_init(&engine, "test_batch.db") == 0);
+    memset(expected, -1, sizeof(expected));
+    
+    // 每轮写入一批乱序、含重复的 key，批内同一 key 以后出现的为准
+    srand(42);
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < BATCH; i++) {
+            int k = rand() % KEYS;
+            snprintf(keys[i], sizeof(keys[i]), "key%06d", k);
+            snprintf(values[i], sizeof(values[i]), "r%d-%d", round, i);
+            items[i].key = keys[i];
+            items[i].value = values[i];
+            expected[k] = round * BATCH + i;
+        }
+        assert(storage_put_batch(&engine, items, BATCH) == 0);
+        for (int i = 0; i < BATCH; i++) {
+            assert(items[i].result == 0);
+        }
+    }
+    
+    // 超长 value 整批拒绝
+    char *long_value = malloc(MAX_VAL_SIZE + 2);
+    assert(long_value);
+    memset(long_value, 'x', MAX_VAL_SIZE + 1);
+    long_value[MAX_VAL_SIZE + 1] = '\0';
+    items[0].key = "bad";
+    items[0].value = long_value;
+    assert(storage_put_batch(&engine, items, 1) == -1);
+    free(long_value);
+    
+    // 单 key 接口能读到批量写入的结果
+    int hits = 0;
+    for (int k = 0; k < KEYS; k++) {
+        snprintf(value, sizeof(value), "key%06d", k);
+        int ret = storage_get(&engine, value, bufs[0], sizeof(bufs[0]));
+        assert((ret == 0) == (expected[k] >= 0));
+        if (ret == 0) {
+            char want[32];
+            snprintf(want, sizeof(want), "r%d-%d", expected[k] / BATCH, expected[k] % BATCH);
+            assert(strcmp(bufs[0], want) == 0);
+            hits++;
+        }
+    }
+    
+    // 批量查找（乱序，含未命中）
+    int batch_hits = 0;
+    for (int start = 0; start < KEYS; start += BATCH) {
+        int n = KEYS - start < BATCH ? KEYS - start : BATCH;
+        for (int i = 0; i < n; i++) {
+            int k = start + (i * 7919) % n;
+            snprintf(keys[i], sizeof(keys[i]), "key%06d", k);
+            items[i].key = keys[i];
+            items[i].buf = bufs[i];
+            items[i].buf_size = sizeof(bufs[i]);
+        }
+        int ret = storage_get_batch(&engine, items, n);
+        assert(ret >= 0);
+        batch_hits += ret;
+        for (int i = 0; i < n; i++) {
+            int k = start + (i * 7919) % n;
+            assert((items[i].result == 0) == (expected[k] >= 0));
+            if (items[i].result == 0) {
+                char want[32];
+                snprintf(want, sizeof(want), "r%d-%d", expected[k] / BATCH, expected[k] % BATCH);
+                assert(strcmp(bufs[i], want) == 0);
+            }
+        }
+    }
+    assert(batch_hits == hits);
+    printf("  %d 轮批量写入后 %d 个 key 全部正确\n", ROUNDS, hits);
+    
+    storage_close(&engine);
+}
+
+// 并发测试：多个读线程与一个写线程同时访问
+typedef struct {
+    StorageEngine *engine;
+    volatile int *stop;
+    long reads;
+    int errors;
+} ReaderArgs;
+
+// value 总是 "<key>:<版本>"，读到的 value 必须与 key 对应
+static void *concurrent_reader(void *arg) {
+    ReaderArgs *args = arg;
+    char key[64];
+    char value[128];
+    uint32_t seed = (uint32_t)(size_t)arg;
+    
+    while (!*args->stop) {
+        seed = seed * 1664525u + 1013904223u;
+        int k = (seed >> 8) % 4000;
+        snprintf(key, sizeof(key), "ckey%05d", k);
+        if (storage_get(args->engine, key, value, sizeof(value)) == 0) {
+            if (strncmp(value, key, strlen(key)) != 0 || value[strlen(key)] != ':') {
+                args->errors++;
+            }
+        } else if (k % 2 == 0) {
+            args->errors++;  // 偶数 key 从不删除
+        }
+        args->reads++;
+        
+        // 游标遍历一小段：与写线程交错时仍然严格有序
+        if (args->reads % 64 == 0) {
+            StorageCursor cursor;
+            char last[64] = "";
+            storage_cursor_init(&cursor, args->engine);
+            int n = 0;
+            for (int ret = storage_cursor_seek(&cursor, key); ret == 0 && n < 50;
+                 ret = storage_cursor_next(&cursor), n++) {
+                size_t klen;
+                const char *ck = storage_cursor_key(&cursor, &klen);
+                if (last[0] != '\0' && strcmp(last, ck) >= 0) {
+                    args->errors++;
+                }
+                strcpy(last, ck);
+            }
+        }
+    }
+    return NULL;
+}
+
+void test_concurrent() {
+    printf("\n=== 测试并发读写 ===\n");
+    StorageEngine engine;
+    StorageOptions options;
+    enum { READERS = 4 };
+    pthread_t threads[READERS];
+    ReaderArgs args[READERS];
+    volatile int stop = 0;
+    char key[64];
+    char value[128];
+    
+    remove("test_conc.db.idx");
+    remove("test_conc.db.dat");
+    remove("test_conc.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    assert(storage_init_ex(&engine, "test_conc.db", &options) == 0);
+    for (int k = 0; k < 4000; k++) {
+        snprintf(key, sizeof(key), "ckey%05d", k);
+        snprintf(value, sizeof(value), "%s:0", key);
+        assert(storage_put(&engine, key, value) == 0);
+    }
+    
+    for (int i = 0; i < READERS; i++) {
+        args[i].engine = &engine;
+        args[i].stop = &stop;
+        args[i].reads = 0;
+        args[i].errors = 0;
+        assert(pthread_create(&threads[i], NULL, concurrent_reader, &args[i]) == 0);
+    }
+    
+    // 写线程：更新所有 key、反复删除并重新插入奇数 key，触发分裂与合并
+    for (int round = 1; round <= 5; round++) {
+        for (int k = 0; k < 4000; k++) {
+            snprintf(key, sizeof(key), "ckey%05d", k);
+            if (k % 2 == 1 && round % 2 == 1) {
+                assert(storage_delete(&engine, key) == 0);
+            } else {
+                snprintf(value, sizeof(value), "%s:%d", key, round);
+                assert(storage_put(&engine, key, value) == 0);
+            }
+        }
+    }
+    stop = 1;
+    
+    long reads = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+        assert(args[i].errors == 0);
+        reads += args[i].reads;
+    }
+    printf("  %d 个读线程共读取 %ld 次，与写线程并发时结果一致\n", READERS, reads);
+    
+    storage_close(&engine);
+}
+
+// 生成长度为 len 的 value，内容由 seed 决定
+static char *make_value(size_t len, int seed) {
+    char *value = malloc(len + 1);
+    assert(value);
+    for (size_t i = 0; i < len; i++) {
+        value[i] = (char)('a' + (i * 7 + seed) % 26);
+    }
+    value[len] = '\0';
+    return value;
+}
+
+static void check_value(StorageEngine *engine, const char *key, size_t len, int seed) {
+    char *expected = make_value(len, seed);
+    char *result = malloc(len + 2);
+    assert(result);
+    assert(storage_get(engine, key, result, len + 2) == 0);
+    assert(strcmp(result, expected) == 0);
+    free(expected);
+    free(result);
+}
+
+// 测试大 value 存放在数据文件中
+void test_large_values() {
+    printf("\n=== 测试大 value ===\n");
+    StorageEngine engine;
+    StorageOptions options;
+    static const size_t sizes[] = {100, MAX_INLINE_VAL, MAX_INLINE_VAL + 1, 4096, 65536, 1 << 20};
+    enum { NSIZES = sizeof(sizes) / sizeof(sizes[0]) };
+    char key[64];
+    
+    remove("test_large.db.idx");
+    remove("test_large.db.dat");
+    remove("test_large.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_OP;
+    assert(storage_init_ex(&engine, "test_large.db", &options) == 0);
+    
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "big%03d", i);
+        char *value = make_value(sizes[i % NSIZES], i);
+        assert(storage_put(&engine, key, value) == 0);
+        free(value);
+    }
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "big%03d", i);
+        check_value(&engine, key, sizes[i % NSIZES], i);
+    }
+    
+    // 叶子只存引用：200 个 key（总计约 45MB）仍然只占少量叶子
+    BTreeStats stats;
+    assert(storage_stats(&engine, &stats) == 0);
+    assert(stats.leaf_count <= 10);
+    
+    // 截断读取、扫描拿到完整 value
+    char small[16];
+    assert(storage_get(&engine, "big004", small, sizeof(small)) == 0);
+    assert(strlen(small) == sizeof(small) - 1);
+    StorageCursor cursor;
+    size_t vlen;
+    assert(storage_cursor_init(&cursor, &engine) == 0);
+    assert(storage_cursor_seek(&cursor, "big005") == 0);
+    const char *v = storage_cursor_value(&cursor, &vlen);
+    char *expected = make_value(sizes[5], 5);
+    assert(vlen == sizes[5] && memcmp(v, expected, vlen) == 0);
+    free(expected);
+    
+    // 大小互换的更新和删除
+    assert(storage_put(&engine, "big004", "now small") == 0);
+    char *value = make_value(100000, 77);
+    assert(storage_put(&engine, "big000", value) == 0);
+    free(value);
+    assert(storage_delete(&engine, "big010") == 0);
+    assert(storage_checkpoint(&engine) == 0);
+    copy_file("test_large.db.idx", "test_large.db.idx.crash");
+    
+    // 检查点之后写入的大 value 只在日志中，崩溃后重放时重新追加到数据文件
+    for (int i = 200; i < 220; i++) {
+        snprintf(key, sizeof(key), "big%03d", i);
+        value = make_value(sizes[i % NSIZES], i);
+        assert(storage_put(&engine, key, value) == 0);
+        free(value);
+    }
+    copy_file("test_large.db.wal", "test_large.db.wal.crash");
+    storage_close(&engine);
+    rename("test_large.db.idx.crash", "test_large.db.idx");
+    rename("test_large.db.wal.crash", "test_large.db.wal");
+    
+    assert(storage_init_ex(&engine, "test_large.db", &options) == 0);
+    for (int i = 1; i < 220; i++) {
+        snprintf(key, sizeof(key), "big%03d", i);
+        if (i == 4) {
+            assert(storage_get(&engine, key, small, sizeof(small)) == 0 && strcmp(small, "now small") == 0);
+        } else if (i == 10) {
+            assert(storage_get(&engine, key, small, sizeof(small)) == -1);
+        } else {
+            check_value(&engine, key, sizes[i % NSIZES], i);
+        }
+    }
+    check_value(&engine, "big000", 100000, 77);
+    printf("  %d 种长度的 value 读写、更新、崩溃恢复正确，叶子数 %llu\n", NSIZES,
+           (unsigned long long)stats.leaf_count);
+    
+    storage_close(&engine);
+}
+
+// 大端编码 32 位整数，使 memcmp 顺序与数值顺序一致
+static void encode_be32(unsigned char *buf, uint32_t v) {
+    buf[0] = (unsigned char)(v >> 24);
+    buf[1] = (unsigned char)(v >> 16);
+    buf[2] = (unsigned char)(v >> 8);
+    buf[3] = (unsigned char)v;
+}
+
+static int scan_be32(void *ctx, const char *key, size_t klen, const char *value, size_t vlen) {
+    uint32_t *next = ctx;
+    const unsigned char *k = (const unsigned char *)key;
+    assert(klen == 5 && vlen == 4);
+    uint32_t v = ((uint32_t)k[1] << 24) | ((uint32_t)k[2] << 16) | ((uint32_t)k[3] << 8) | k[4];
+    assert(v == *next);
+    assert(memcmp(value, key + 1, 4) == 0);
+    *next += 7;
+    return 0;
+}
+
+// 测试包含 '\0' 的二进制 key/value
+void test_binary_keys() {
+    printf("\n=== 测试二进制 key/value ===\n");
+    StorageEngine engine;
+    unsigned char key[8], buf[64];
+    size_t vlen;
+    
+    remove("test_binary.db.idx");
+    remove("test_binary.db.dat");
+    remove("test_binary.db.wal");
+    assert(storage_init(&engine, "test_binary.db") == 0);
+    
+    // 只差在 '\0' 之后的字节的 key 互不相同
+    const char a[] = {'k', 0, 'a'}, b[] = {'k', 0, 'b'}, c[] = {'k'};
+    const char va[] = {0, 1, 2, 0}, vb[] = {'x', 0, 'y'};
+    assert(storage_put2(&engine, a, sizeof(a), va, sizeof(va)) == 0);
+    assert(storage_put2(&engine, b, sizeof(b), vb, sizeof(vb)) == 0);
+    assert(storage_put2(&engine, c, sizeof(c), "", 0) == 0);
+    assert(storage_get2(&engine, a, sizeof(a), buf, sizeof(buf), &vlen) == 0);
+    assert(vlen == sizeof(va) && memcmp(buf, va, vlen) == 0);
+    assert(storage_get2(&engine, b, sizeof(b), buf, sizeof(buf), &vlen) == 0);
+    assert(vlen == sizeof(vb) && memcmp(buf, vb, vlen) == 0);
+    assert(storage_get2(&engine, c, sizeof(c), buf, sizeof(buf), &vlen) == 0 && vlen == 0);
+    
+    // 缓冲区不足时只复制前 value_size 字节，vlen 仍为完整长度
+    memset(buf, 0xAA, sizeof(buf));
+    assert(storage_get2(&engine, a, sizeof(a), buf, 2, &vlen) == 0);
+    assert(vlen == sizeof(va) && memcmp(buf, va, 2) == 0 && buf[2] == 0xAA);
+    
+    // 大端整数 key（带一个 0x00 表前缀）按数值顺序扫描
+    for (uint32_t i = 0; i < 3000; i++) {
+        key[0] = 0;
+        encode_be32(key + 1, i * 7);
+        assert(storage_put2(&engine, key, 5, key + 1, 4) == 0);
+    }
+    unsigned char start[5] = {0}, end[5] = {0};
+    encode_be32(start + 1, 700);
+    encode_be32(end + 1, 14000);
+    uint32_t next = 700;
+    assert(storage_scan2(&engine, start, 5, end, 5, scan_be32, &next) == 0);
+    assert(next == 14000);
+    next = 0;
+    assert(storage_scan_prefix2(&engine, "\0", 1, scan_be32, &next) == 0);
+    assert(next == 3000 * 7);
+    
+    // 游标按二进制 key 定位
+    StorageCursor cursor;
+    size_t klen;
+    assert(storage_cursor_init(&cursor, &engine) == 0);
+    encode_be32(key + 1, 701);
+    assert(storage_cursor_seek2(&cursor, key, 5) == 0);
+    const unsigned char *k = (const unsigned char *)storage_cursor_key(&cursor, &klen);
+    assert(klen == 5 && k[0] == 0 && k[3] == 0x02 && k[4] == 0xC3);  // 707
+    
+    // 删除 "k\0a" 不影响 "k\0b" 和 "k"
+    assert(storage_delete2(&engine, a, sizeof(a)) == 0);
+    assert(storage_delete2(&engine, a, sizeof(a)) == -1);
+    assert(storage_get2(&engine, a, sizeof(a), buf, sizeof(buf), &vlen) == -1);
+    storage_close(&engine);
+    
+    // 重新打开（经过 WAL 重放）后内容不变
+    assert(storage_init(&engine, "test_binary.db") == 0);
+    assert(storage_get2(&engine, a, sizeof(a), buf, sizeof(buf), &vlen) == -1);
+    assert(storage_get2(&engine, b, sizeof(b), buf, sizeof(buf), &vlen) == 0);
+    assert(vlen == sizeof(vb) && memcmp(buf, vb, vlen) == 0);
+    assert(storage_get2(&engine, c, sizeof(c), buf, sizeof(buf), &vlen) == 0 && vlen == 0);
+    next = 0;
+    assert(storage_scan_prefix2(&engine, "\0", 1, scan_be32, &next) == 0);
+    assert(next == 3000 * 7);
+    printf("  含 '\\0' 的 key/value、大端整数 key 的范围扫描、截断读取和重新打开均正确\n");
+    
+    storage_close(&engine);
+}
+
+// 测试 value 视图在覆盖、删除和文件增长后仍然有效
+void test_value_view() {
+    printf("\n=== 测试 value 视图 ===\n");
+    StorageEngine engine;
+    StorageView small_view, large_view, missing;
+    const size_t large_len = 100000;
+    
+    remove("test_view.db.idx");
+    remove("test_view.db.dat");
+    remove("test_view.db.wal");
+    assert(storage_init(&engine, "test_view.db") == 0);
+    
+    char *large = make_value(large_len, 3);
+    assert(storage_put(&engine, "small", "short value") == 0);
+    assert(storage_put(&engine, "large", large) == 0);
+    assert(storage_get_view(&engine, "missing", 7, &missing) == -1);
+    assert(storage_get_view(&engine, "small", 5, &small_view) == 0);
+    assert(storage_get_view(&engine, "large", 5, &large_view) == 0);
+    assert(small_view.len == 11 && memcmp(small_view.data, "short value", 11) == 0);
+    assert(large_view.len == large_len && memcmp(large_view.data, large, large_len) == 0);
+    
+    // 覆盖、删除并写入大量数据使索引文件和数据文件增长
+    assert(storage_put(&engine, "small", "changed") == 0);
+    assert(storage_delete(&engine, "large") == 0);
+    char key[32];
+    char *filler = make_value(64 * 1024, 9);
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), "fill%05d", i);
+        assert(storage_put(&engine, key, i % 20 == 0 ? filler : "x") == 0);
+    }
+    assert(small_view.len == 11 && memcmp(small_view.data, "short value", 11) == 0);
+    assert(large_view.len == large_len && memcmp(large_view.data, large, large_len) == 0);
+    
+    // 未释放的视图阻止关闭
+    assert(storage_close(&engine) == -1);
+    storage_view_release(&small_view);
+    storage_view_release(&large_view);
+    storage_view_release(&missing);
+    printf("  覆盖、删除和文件增长后视图内容不变，释放后才能关闭引擎\n");
+    
+    assert(storage_close(&engine) == 0);
+    free(large);
+    free(filler);
+}
+
+// 前缀压缩测试用的 key：大部分共享长前缀，夹杂短 key 和接近上限的长 key，迫使节点前缀缩短和在端点分裂
+static size_t prefix_test_key(int i, char *buf) {
+    static const char *regions[] = {"us-east-1", "eu-west-2", "ap-south-1"};
+    if (i % 89 == 0) {
+        return (size_t)sprintf(buf, "k%d", i);
+    }
+    int n = sprintf(buf, "tenant%03d:region-%s:object:%08d", i % 7, regions[i % 3], i);
+    if (i % 97 == 0) {
+        memset(buf + n, 'x', MAX_KEY_SIZE - n);
+        return MAX_KEY_SIZE;
+    }
+    return (size_t)n;
+}
+
+typedef struct {
+    char last[MAX_KEY_SIZE];
+    size_t last_len;
+    int count;
+    bool ordered;
+} PrefixScan;
+
+static int prefix_scan_check(void *ctx, const char *key, size_t klen, const char *value, size_t vlen) {
+    PrefixScan *scan = ctx;
+    (void)value;
+    (void)vlen;
+    if (scan->count > 0) {
+        size_t n = klen < scan->last_len ? klen : scan->last_len;
+        int cmp = memcmp(scan->last, key, n);
+        if (cmp > 0 || (cmp == 0 && scan->last_len >= klen)) scan->ordered = false;
+    }
+    memcpy(scan->last, key, klen);
+    scan->last_len = klen;
+    scan->count++;
+    return 0;
+}
+
+// 测试节点前缀压缩和分隔 key 后缀截断
+void test_prefix_keys() {
+    printf("\n=== 测试前缀压缩 ===\n");
+    enum { N = 20000 };
+    StorageEngine engine;
+    BTreeStats stats;
+    char key[MAX_KEY_SIZE + 1], value[64], result[64];
+    static int order[N];
+    static bool present[N];
+    
+    remove("test_prefix.db.idx");
+    remove("test_prefix.db.dat");
+    remove("test_prefix.db.wal");
+    assert(storage_init(&engine, "test_prefix.db") == 0);
+    
+    // 乱序插入
+    for (int i = 0; i < N; i++) order[i] = i;
+    unsigned int seed = 12345;
+    for (int i = N - 1; i > 0; i--) {
+        seed = seed * 1103515245 + 12345;
+        int j = (int)((seed >> 16) % (unsigned)(i + 1));
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (int i = 0; i < N; i++) {
+        int k = order[i];
+        size_t klen = prefix_test_key(k, key);
+        snprintf(value, sizeof(value), "v%d", k);
+        assert(storage_put2(&engine, key, klen, value, strlen(value)) == 0);
+        present[k] = true;
+    }
+    
+    // 删除一部分，触发不同前缀的叶子合并
+    for (int k = 0; k < N; k++) {
+        if (k % 3 == 0 || (k >= 5000 && k < 9000)) {
+            size_t klen = prefix_test_key(k, key);
+            assert(storage_delete2(&engine, key, klen) == 0);
+            present[k] = false;
+        }
+    }
+    
+    for (int round = 0; round < 2; round++) {
+        int expected = 0;
+        for (int k = 0; k < N; k++) {
+            size_t klen = prefix_test_key(k, key), vlen;
+            int ret = storage_get2(&engine, key, klen, result, sizeof(result), &vlen);
+            if (present[k]) {
+                snprintf(value, sizeof(value), "v%d", k);
+                assert(ret == 0 && vlen == strlen(value) && memcmp(result, value, vlen) == 0);
+                expected++;
+            } else {
+                assert(ret == -1);
+            }
+        }
+        
+        PrefixScan scan = {.ordered = true};
+        assert(storage_scan(&engine, NULL, NULL, prefix_scan_check, &scan) == 0);
+        assert(scan.ordered && scan.count == expected);
+        scan = (PrefixScan){.ordered = true};
+        assert(storage_scan_prefix(&engine, "tenant003:", prefix_scan_check, &scan) == 0);
+        assert(scan.ordered && scan.count > 0);
+        
+        // 重新打开后再检查一遍
+        storage_close(&engine);
+        assert(storage_init(&engine, "test_prefix.db") == 0);
+    }
+    
+    assert(storage_stats(&engine, &stats) == 0);
+    assert(stats.depth <= 3);
+    printf("  乱序插入、删除、扫描和重新打开正确，树高 %u，平均扇出 %.1f，叶子填充率 %.1f%%\n",
+           stats.depth, stats.avg_fanout, stats.leaf_fill * 100);
+    
+    storage_close(&engine);
+}
+
+// 测试上层节点缓存：同样的写入和删除分别在开启、关闭缓存的数据库上执行，查找结果一致
+void test_node_cache() {
+    printf("\n=== 测试上层节点缓存 ===\n");
+    enum { N = 30000 };
+    StorageEngine engines[2];
+    StorageOptions options;
+    BTreeStats stats[2];
+    char key[MAX_KEY_SIZE + 1], value[64], result[2][64];
+    const char *names[2] = {"test_cache_on.db", "test_cache_off.db"};
+    
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    for (int e = 0; e < 2; e++) {
+        char path[64];
+        snprintf(path, sizeof(path), "%s.idx", names[e]);
+        remove(path);
+        snprintf(path, sizeof(path), "%s.dat", names[e]);
+        remove(path);
+        snprintf(path, sizeof(path), "%s.wal", names[e]);
+        remove(path);
+        options.node_cache = e == 0;
+        assert(storage_init_ex(&engines[e], names[e], &options) == 0);
+    }
+    
+    // 前缀相同、只在第 8 字节之后不同的 key 使缓存中的整数前缀频繁相等，需要比较完整后缀
+    unsigned int seed = 777;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < N; i++) {
+            seed = seed * 1103515245 + 12345;
+            int k = (int)((seed >> 8) % (N * 2));
+            size_t klen = prefix_test_key(k, key);
+            snprintf(value, sizeof(value), "v%d.%d", k, round);
+            for (int e = 0; e < 2; e++) {
+                if (round > 0 && i % 3 == 0) {
+                    storage_delete2(&engines[e], key, klen);
+                } else {
+                    assert(storage_put2(&engines[e], key, klen, value, strlen(value)) == 0);
+                }
+            }
+        }
+    }
+    
+    for (int k = 0; k < N * 2; k++) {
+        size_t klen = prefix_test_key(k, key);
+        size_t vlen[2] = {0, 0};
+        int ret[2];
+        for (int e = 0; e < 2; e++) {
+            ret[e] = storage_get2(&engines[e], key, klen, result[e], sizeof(result[e]), &vlen[e]);
+        }
+        assert(ret[0] == ret[1] && vlen[0] == vlen[1]);
+        assert(ret[0] != 0 || memcmp(result[0], result[1], vlen[0]) == 0);
+    }
+    
+    for (int e = 0; e < 2; e++) {
+        assert(storage_stats(&engines[e], &stats[e]) == 0);
+    }
+    assert(stats[0].depth >= 2 && stats[0].cached_nodes > 0 && stats[1].cached_nodes == 0);
+    assert(stats[0].key_count == stats[1].key_count);
+    printf("  树高 %u，缓存 %llu 个内部节点，开启、关闭缓存的查找结果一致\n", stats[0].depth,
+           (unsigned long long)stats[0].cached_nodes);
+    
+    for (int e = 0; e < 2; e++) {
+        storage_close(&engines[e]);
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+void test_prefix_search() {
+    printf("\n=== 测试 SIMD 前缀查找 ===\n");
+    const char *names[] = {"scalar", "sse4.2", "avx2"};
+    const char *best = prefix_search_impl();
+    uint64_t keys[300];
+    unsigned int seed = 4242;
+    int checked = 0;
+    
+    // 含重复值、0、UINT64_MAX 以及最高位不同的值，覆盖无符号比较和相等的一段
+    for (int round = 0; round < 200; round++) {
+        size_t n = (size_t)(round * 7 % 300);
+        uint64_t v = round % 2 ? 0 : 0x7ffffffffffffff0ULL;
+        for (size_t i = 0; i < n; i++) {
+            seed = seed * 1103515245 + 12345;
+            if (seed % 4 != 0) v += (seed >> 20) % 3 == 0 ? ((uint64_t)seed << 40) : seed % 5;
+            keys[i] = v;
+        }
+        if (n > 0 && round % 5 == 0) keys[n - 1] = UINT64_MAX;
+        qsort(keys, n, sizeof(uint64_t), compare_u64);  // 累加可能回绕
+        for (int p = 0; p < 50; p++) {
+            seed = seed * 1103515245 + 12345;
+            uint64_t probe = n == 0 ? seed : keys[seed % n] + (seed >> 16) % 3 - 1;
+            if (p == 0) probe = 0;
+            if (p == 1) probe = UINT64_MAX;
+            size_t expect = 0;
+            while (expect < n && keys[expect] < probe) expect++;
+            for (size_t m = 0; m < sizeof(names) / sizeof(names[0]); m++) {
+                if (prefix_search_set_impl(names[m]) != 0) continue;
+                assert(prefix_lower_bound(keys, n, probe) == expect);
+                checked++;
+            }
+        }
+    }
+    assert(prefix_search_set_impl("scalar") == 0);
+    assert(prefix_search_set_impl("unknown") == -1);
+    prefix_search_set_impl(best);
+    printf("  默认实现 %s，%d 次查找与线性扫描结果一致\n", best, checked);
+}
+
+// 测试深层分裂传播：大量随机 key 使树长到 4 层以上，祖先节点连续分裂，结果与参考表逐一比对
+// 每 16 个 key 一组，组内共享 48 字节前缀，叶子之间的分隔 key 较长，内部节点扇出较低
+static size_t deep_key(uint32_t k, char *buf) {
+    uint64_t h = (uint64_t)(k >> 4) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+    int n = snprintf(buf, 64, "%016llx", (unsigned long long)h);
+    memset(buf + n, 'a' + h % 26, 32);
+    n += 32;
+    n += snprintf(buf + n, 64 - n, "%02x", k & 15);
+    return (size_t)n;
+}
+
+static size_t deep_value(uint32_t k, uint8_t version, char *buf) {
+    // 200 字节的内联 value 降低叶子扇出，使树在百万级 key 时就超过 3 层
+    int n = snprintf(buf, 32, "%u.%u.", k, version);
+    memset(buf + n, 'a' + (k + version) % 26, 200 - n);
+    return 200;
+}
+
+typedef struct {
+    uint32_t count;
+    int ordered;
+    char last[64];
+    size_t last_len;
+} DeepScanCtx;
+
+static int deep_scan_cb(void *ctx, const char *key, size_t klen, const char *value, size_t vlen) {
+    DeepScanCtx *c = ctx;
+    (void)value;
+    if (c->count > 0) {
+        int cmp = memcmp(c->last, key, klen < c->last_len ? klen : c->last_len);
+        if (cmp > 0 || (cmp == 0 && c->last_len >= klen)) c->ordered = 0;
+    }
+    memcpy(c->last, key, klen);
+    c->last_len = klen;
+    c->count++;
+    return vlen == 200 ? 0 : 1;
+}
+
+void test_deep_split() {
+    printf("\n=== 测试深层分裂传播 ===\n");
+    enum { KEYS = 500000, OPS = 1000000 };
+    StorageEngine engine;
+    StorageOptions options;
+    BTreeStats stats;
+    char key[64], value[256], result[256];
+    uint8_t *versions = calloc(KEYS, 1);  // 参考表：0 表示不存在，否则为当前 value 的版本
+    assert(versions);
+    
+    remove("test_deep.db.idx");
+    remove("test_deep.db.dat");
+    remove("test_deep.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    assert(storage_init_ex(&engine, "test_deep.db", &options) == 0);
+    
+    uint64_t seed = 20240601;
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < OPS; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t k = (uint32_t)(seed >> 33) % KEYS;
+        size_t klen = deep_key(k, key);
+        if ((seed >> 20) % 8 == 0) {
+            int ret = storage_delete2(&engine, key, klen);
+            assert((ret == 0) == (versions[k] != 0));
+            if (versions[k]) live--;
+            versions[k] = 0;
+        } else {
+            uint8_t version = versions[k] % 250 + 1;
+            size_t vlen = deep_value(k, version, value);
+            assert(storage_put2(&engine, key, klen, value, vlen) == 0);
+            if (!versions[k]) live++;
+            versions[k] = version;
+        }
+    }
+    
+    assert(storage_stats(&engine, &stats) == 0);
+    printf("  %d 次随机写入/删除后树高 %u，叶子 %llu 个，key %llu 个\n", OPS, stats.depth,
+           (unsigned long long)stats.leaf_count, (unsigned long long)stats.key_count);
+    assert(stats.depth >= 4);
+    assert(stats.key_count == live);
+    
+    for (int round = 0; round < 2; round++) {
+        for (uint32_t k = 0; k < KEYS; k++) {
+            size_t klen = deep_key(k, key);
+            size_t vlen = 0;
+            int ret = storage_get2(&engine, key, klen, result, sizeof(result), &vlen);
+            if (!versions[k]) {
+                assert(ret != 0);
+                continue;
+            }
+            assert(ret == 0 && deep_value(k, versions[k], value) == vlen);
+            assert(memcmp(result, value, vlen) == 0);
+        }
+        DeepScanCtx ctx = {0, 1, "", 0};
+        assert(storage_scan(&engine, NULL, NULL, deep_scan_cb, &ctx) == 0);
+        assert(ctx.ordered && ctx.count == live);
+        
+        // 重新打开后再验证一遍
+        if (round == 0) {
+            storage_close(&engine);
+            assert(storage_init_ex(&engine, "test_deep.db", &options) == 0);
+        }
+    }
+    printf("  %u 个 key 与参考表一致，扫描有序，重新打开后不变\n", live);
+    
+    storage_close(&engine);
+    free(versions);
+    remove("test_deep.db.idx");
+    remove("test_deep.db.dat");
+    remove("test_deep.db.wal");
+}
+
+// 测试删除后的重新平衡：删除绝大部分 key 后节点仍保持填充率，树高随之降低，删空后根回到叶子
+void test_delete_rebalance() {
+    printf("\n=== 测试删除重新平衡 ===\n");
+    enum { KEYS = 200000 };
+    StorageEngine engine;
+    StorageOptions options;
+    BTreeStats full, sparse, empty;
+    char key[64], value[256], result[256];
+    uint32_t *order = malloc(KEYS * sizeof(uint32_t));
+    assert(order);
+    
+    remove("test_rebalance.db.idx");
+    remove("test_rebalance.db.dat");
+    remove("test_rebalance.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    assert(storage_init_ex(&engine, "test_rebalance.db", &options) == 0);
+    
+    // 乱序插入，再按另一个乱序删除 97%
+    uint64_t seed = 99991;
+    for (uint32_t i = 0; i < KEYS; i++) order[i] = i;
+    for (uint32_t i = KEYS - 1; i > 0; i--) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t j = (uint32_t)(seed >> 33) % (i + 1);
+        uint32_t t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+    for (uint32_t i = 0; i < KEYS; i++) {
+        size_t klen = deep_key(order[i], key);
+        size_t vlen = deep_value(order[i], 1, value);
+        assert(storage_put2(&engine, key, klen, value, vlen) == 0);
+    }
+    assert(storage_stats(&engine, &full) == 0);
+    
+    for (uint32_t i = KEYS - 1; i > 0; i--) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t j = (uint32_t)(seed >> 33) % (i + 1);
+        uint32_t t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+    uint32_t kept = KEYS / 33;
+    for (uint32_t i = kept; i < KEYS; i++) {
+        size_t klen = deep_key(order[i], key);
+        assert(storage_delete2(&engine, key, klen) == 0);
+    }
+    assert(storage_stats(&engine, &sparse) == 0);
+    printf("  删除前树高 %u、叶子 %llu、内部节点 %llu；保留 %u 个 key 后树高 %u、叶子 %llu、内部节点 %llu，叶子填充率 %.0f%%\n",
+           full.depth, (unsigned long long)full.leaf_count, (unsigned long long)full.internal_count, kept,
+           sparse.depth, (unsigned long long)sparse.leaf_count, (unsigned long long)sparse.internal_count,
+           sparse.leaf_fill * 100);
+    assert(sparse.key_count == kept);
+    assert(sparse.depth < full.depth);
+    assert(sparse.leaf_fill > 0.3 && sparse.internal_fill > 0.25);  // 下溢阈值为 25%
+    
+    for (uint32_t i = 0; i < KEYS; i++) {
+        size_t klen = deep_key(order[i], key);
+        size_t vlen;
+        int ret = storage_get2(&engine, key, klen, result, sizeof(result), &vlen);
+        assert((ret == 0) == (i < kept));
+        if (ret == 0) {
+            assert(vlen == deep_value(order[i], 1, value) && memcmp(result, value, vlen) == 0);
+        }
+    }
+    DeepScanCtx ctx = {0, 1, "", 0};
+    assert(storage_scan(&engine, NULL, NULL, deep_scan_cb, &ctx) == 0);
+    assert(ctx.ordered && ctx.count == kept);
+    
+    // 删空后根节点回到叶子，之后仍可正常写入
+    for (uint32_t i = 0; i < kept; i++) {
+        size_t klen = deep_key(order[i], key);
+        assert(storage_delete2(&engine, key, klen) == 0);
+    }
+    assert(storage_stats(&engine, &empty) == 0);
+    assert(empty.depth == 1 && empty.key_count == 0);
+    for (uint32_t i = 0; i < 1000; i++) {
+        size_t klen = deep_key(i, key);
+        size_t vlen = deep_value(i, 2, value);
+        assert(storage_put2(&engine, key, klen, value, vlen) == 0);
+    }
+    storage_close(&engine);
+    assert(storage_init_ex(&engine, "test_rebalance.db", &options) == 0);
+    for (uint32_t i = 0; i < 1000; i++) {
+        size_t klen = deep_key(i, key);
+        size_t vlen;
+        assert(storage_get2(&engine, key, klen, result, sizeof(result), &vlen) == 0);
+        assert(vlen == deep_value(i, 2, value) && memcmp(result, value, vlen) == 0);
+    }
+    printf("  全部删除后树高 %u，重新写入并重新打开后数据正确\n", empty.depth);
+    
+    storage_close(&engine);
+    free(order);
+    remove("test_rebalance.db.idx");
+    remove("test_rebalance.db.dat");
+    remove("test_rebalance.db.wal");
+}
+
+// 测试读快照：快照中的查找和扫描始终对应开始时的内容，不受之后的写入、分裂、合并影响，
+// 快照结束后被替换的页面全部回收；另有一个线程在快照中反复扫描，与写入并发
+typedef struct {
+    const uint8_t *versions;      // 快照开始时的参考表
+    uint32_t expect;              // 快照中的 key 数
+    uint32_t count;
+    int errors;
+} SnapshotScanCtx;
+
+static int snapshot_scan_cb(void *ctx, const char *key, size_t klen, const char *value, size_t vlen) {
+    SnapshotScanCtx *c = ctx;
+    char expect[256];
+    // key 末尾的两位十六进制数与组编号无法直接还原，用 value 中记录的编号和版本核对
+    uint32_t k;
+    unsigned version;
+    if (sscanf(value, "%u.%u.", &k, &version) != 2 || c->versions[k] != version ||
+        deep_value(k, (uint8_t)version, expect) != vlen || memcmp(expect, value, vlen) != 0) {
+        c->errors++;
+    }
+    char expect_key[64];
+    if (deep_key(k, expect_key) != klen || memcmp(expect_key, key, klen) != 0) c->errors++;
+    c->count++;
+    return 0;
+}
+
+typedef struct {
+    StorageSnapshot *snapshot;
+    const uint8_t *versions;
+    uint32_t expect;
+    volatile int *stop;
+    int scans;
+    int errors;
+} SnapshotReaderArgs;
+
+static void* snapshot_reader(void *arg) {
+    SnapshotReaderArgs *a = arg;
+    while (!*a->stop || a->scans == 0) {
+        SnapshotScanCtx ctx = {a->versions, a->expect, 0, 0};
+        if (storage_snapshot_scan2(a->snapshot, NULL, 0, NULL, 0, snapshot_scan_cb, &ctx) != 0 ||
+            ctx.count != a->expect || ctx.errors != 0) {
+            a->errors++;
+        }
+        a->scans++;
+    }
+    return NULL;
+}
+
+static void snapshot_verify(StorageSnapshot *snapshot, const uint8_t *versions, uint32_t keys, uint32_t live) {
+    char key[64], value[256], result[256];
+    for (uint32_t k = 0; k < keys; k++) {
+        size_t klen = deep_key(k, key);
+        size_t vlen = 0;
+        int ret = storage_snapshot_get2(snapshot, key, klen, result, sizeof(result), &vlen);
+        assert((ret == 0) == (versions[k] != 0));
+        if (ret == 0) {
+            assert(vlen == deep_value(k, versions[k], value) && memcmp(result, value, vlen) == 0);
+        }
+    }
+    SnapshotScanCtx ctx = {versions, live, 0, 0};
+    assert(storage_snapshot_scan2(snapshot, NULL, 0, NULL, 0, snapshot_scan_cb, &ctx) == 0);
+    assert(ctx.count == live && ctx.errors == 0);
+}
+
+static uint32_t snapshot_churn(StorageEngine *engine, uint8_t *versions, uint32_t keys, uint32_t ops,
+                               uint64_t *seed, uint32_t live) {
+    char key[64], value[256];
+    for (uint32_t i = 0; i < ops; i++) {
+        *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t k = (uint32_t)(*seed >> 33) % keys;
+        size_t klen = deep_key(k, key);
+        if ((*seed >> 20) % 3 == 0) {
+            if (versions[k]) {
+                assert(storage_delete2(engine, key, klen) == 0);
+                live--;
+            }
+            versions[k] = 0;
+        } else {
+            uint8_t version = versions[k] % 250 + 1;
+            size_t vlen = deep_value(k, version, value);
+            assert(storage_put2(engine, key, klen, value, vlen) == 0);
+            if (!versions[k]) live++;
+            versions[k] = version;
+        }
+    }
+    return live;
+}
+
+void test_snapshot() {
+    printf("\n=== 测试读快照 ===\n");
+    enum { KEYS = 60000 };
+    StorageEngine engine;
+    StorageOptions options;
+    StorageSnapshot s1, s2;
+    BTreeStats stats;
+    uint8_t *live_versions = calloc(KEYS, 1);
+    uint8_t *v1 = malloc(KEYS);
+    uint8_t *v2 = malloc(KEYS);
+    assert(live_versions && v1 && v2);
+    
+    remove("test_snap.db.idx");
+    remove("test_snap.db.dat");
+    remove("test_snap.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    assert(storage_init_ex(&engine, "test_snap.db", &options) == 0);
+    
+    uint64_t seed = 31337;
+    uint32_t live = snapshot_churn(&engine, live_versions, KEYS, KEYS, &seed, 0);
+    
+    // 快照 1 开始后大量写入：分裂、合并都发生在复制出的页面上
+    assert(storage_snapshot_begin(&engine, &s1) == 0);
+    memcpy(v1, live_versions, KEYS);
+    uint32_t live1 = live;
+    live = snapshot_churn(&engine, live_versions, KEYS, KEYS, &seed, live);
+    assert(storage_close(&engine) == -1);  // 快照未结束时拒绝关闭
+    
+    assert(storage_snapshot_begin(&engine, &s2) == 0);
+    memcpy(v2, live_versions, KEYS);
+    uint32_t live2 = live;
+    
+    // 快照 2 开始后由另一个线程在快照 1 中反复扫描，同时继续写入
+    volatile int stop = 0;
+    SnapshotReaderArgs reader = {&s1, v1, live1, &stop, 0, 0};
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, snapshot_reader, &reader) == 0);
+    live = snapshot_churn(&engine, live_versions, KEYS, KEYS, &seed, live);
+    stop = 1;
+    pthread_join(thread, NULL);
+    assert(reader.errors == 0);
+    
+    snapshot_verify(&s1, v1, KEYS, live1);
+    snapshot_verify(&s2, v2, KEYS, live2);
+    assert(storage_stats(&engine, &stats) == 0);
+    uint64_t pending = stats.pending_pages;
+    assert(pending > 0);
+    
+    // 结束快照 1 后快照 2 仍然完整；全部结束后待回收页面清零
+    storage_snapshot_end(&s1);
+    snapshot_verify(&s2, v2, KEYS, live2);
+    live = snapshot_churn(&engine, live_versions, KEYS, KEYS / 4, &seed, live);
+    snapshot_verify(&s2, v2, KEYS, live2);
+    storage_snapshot_end(&s2);
+    assert(storage_stats(&engine, &stats) == 0);
+    assert(stats.pending_pages == 0 && stats.key_count == live);
+    printf("  快照中 %u / %u 个 key 在之后的写入中保持不变，后台线程扫描 %d 次，最多 %llu 个页面等待回收\n",
+           live1, live2, reader.scans, (unsigned long long)pending);
+    
+    // 没有快照时原地修改；当前树与参考表一致
+    live = snapshot_churn(&engine, live_versions, KEYS, KEYS / 4, &seed, live);
+    storage_close(&engine);
+    assert(storage_init_ex(&engine, "test_snap.db", &options) == 0);
+    char key[64], value[256], result[256];
+    for (uint32_t k = 0; k < KEYS; k++) {
+        size_t klen = deep_key(k, key);
+        size_t vlen = 0;
+        int ret = storage_get2(&engine, key, klen, result, sizeof(result), &vlen);
+        assert((ret == 0) == (live_versions[k] != 0));
+        if (ret == 0) {
+            assert(vlen == deep_value(k, live_versions[k], value) && memcmp(result, value, vlen) == 0);
+        }
+    }
+    assert(storage_stats(&engine, &stats) == 0 && stats.key_count == live);
+    printf("  快照全部结束后待回收页面为 0，当前树的 %u 个 key 重新打开后正确\n", live);
+    
+    storage_close(&engine);
+    free(live_versions);
+    free(v1);
+    free(v2);
+    remove("test_snap.db.idx");
+    remove("test_snap.db.dat");
+    remove("test_snap.db.wal");
+}
+
+// 测试变长 value 的原地更新：同一叶子内反复把 value 改长、改短、改为等长以及在内联与数据文件之间切换，
+// 其余 cell 不受影响；等长更新只弄脏叶子页，放不下时才分裂，快照中的旧 value 不变
+static size_t update_value(uint32_t k, uint32_t version, size_t len, char *buf) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (char)('A' + (k * 7 + version + i) % 26);
+    }
+    return len;
+}
+
+static void update_verify(StorageEngine *engine, const uint32_t *versions, const size_t *lens, uint32_t keys) {
+    char key[16], value[600], result[600];
+    for (uint32_t k = 0; k < keys; k++) {
+        size_t klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", k);
+        size_t vlen = 0;
+        assert(storage_get2(engine, key, klen, result, sizeof(result), &vlen) == 0);
+        assert(vlen == lens[k] && memcmp(result, value, update_value(k, versions[k], vlen, value)) == 0);
+    }
+}
+
+// 覆盖写需要分裂而分配页面失败：用 RLIMIT_FSIZE 禁止索引文件再扩展，逐个改长 value 直到 put 失败，
+// 失败的 key 保留旧 value，其余 key 不受影响；解除限制后重试成功
+static void update_fail_check() {
+    enum { KEYS = 20000 };
+    StorageEngine engine;
+    StorageOptions options;
+    char key[16], value[600];
+    uint32_t *versions = malloc(KEYS * sizeof(uint32_t));
+    size_t *lens = malloc(KEYS * sizeof(size_t));
+    assert(versions && lens);
+    
+    remove("test_update_fail.db.idx");
+    remove("test_update_fail.db.dat");
+    remove("test_update_fail.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    assert(storage_init_ex(&engine, "test_update_fail.db", &options) == 0);
+    for (uint32_t k = 0; k < KEYS; k++) {
+        size_t klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", k);
+        versions[k] = 1;
+        lens[k] = 8;
+        assert(storage_put2(&engine, key, klen, value, update_value(k, 1, lens[k], value)) == 0);
+    }
+    assert(storage_checkpoint(&engine) == 0);
+    
+    struct rlimit saved, limit;
+    assert(getrlimit(RLIMIT_FSIZE, &saved) == 0);
+    limit = saved;
+    limit.rlim_cur = engine.pm.index_size;
+    signal(SIGXFSZ, SIG_IGN);
+    assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+    
+    uint32_t failed = KEYS;
+    for (uint32_t k = 0; k < KEYS; k++) {
+        if (k % 2000 == 1999) assert(storage_checkpoint(&engine) == 0);  // 日志不会先碰到限制
+        size_t klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", k);
+        if (storage_put2(&engine, key, klen, value, update_value(k, versions[k] + 1, 250, value)) != 0) {
+            failed = k;
+            break;
+        }
+        versions[k]++;
+        lens[k] = 250;
+    }
+    assert(failed < KEYS && failed > 0 && wal_size(&engine.wal) < limit.rlim_cur);
+    update_verify(&engine, versions, lens, KEYS);
+    
+    assert(setrlimit(RLIMIT_FSIZE, &saved) == 0);
+    signal(SIGXFSZ, SIG_DFL);
+    size_t klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", failed);
+    assert(storage_put2(&engine, key, klen, value, update_value(failed, versions[failed] + 1, 250, value)) == 0);
+    versions[failed]++;
+    lens[failed] = 250;
+    update_verify(&engine, versions, lens, KEYS);
+    assert(storage_close(&engine) == 0);
+    assert(storage_init_ex(&engine, "test_update_fail.db", &options) == 0);
+    update_verify(&engine, versions, lens, KEYS);
+    assert(storage_close(&engine) == 0);
+    printf("  第 %u 次改长时索引文件无法扩展：put 失败，旧 value 保留，解除限制后重试成功\n", failed + 1);
+    
+    remove("test_update_fail.db.idx");
+    remove("test_update_fail.db.dat");
+    remove("test_update_fail.db.wal");
+    free(versions);
+    free(lens);
+}
+
+void test_value_update() {
+    printf("\n=== 测试变长 value 原地更新 ===\n");
+    enum { KEYS = 40 };
+    StorageEngine engine;
+    BTreeStats stats;
+    StorageSnapshot snapshot;
+    uint32_t versions[KEYS] = {0};
+    size_t lens[KEYS];
+    char key[16], value[600], result[600];
+    
+    remove("test_update_len.db.idx");
+    remove("test_update_len.db.dat");
+    remove("test_update_len.db.wal");
+    assert(storage_init(&engine, "test_update_len.db") == 0);
+    
+    for (uint32_t k = 0; k < KEYS; k++) {
+        size_t klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", k);
+        lens[k] = 40;
+        assert(storage_put2(&engine, key, klen, value, update_value(k, 0, lens[k], value)) == 0);
+    }
+    assert(storage_stats(&engine, &stats) == 0 && stats.leaf_count == 1);
+    
+    // 单个叶子内的随机长度更新（0~80 字节，总量始终放得下一页），每次更新后检查全部 key
+    uint64_t seed = 4242;
+    for (int i = 0; i < 3000; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t k = (uint32_t)(seed >> 33) % KEYS;
+        size_t klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", k);
+        versions[k]++;
+        lens[k] = (seed >> 20) % 81;
+        assert(storage_put2(&engine, key, klen, value, update_value(k, versions[k], lens[k], value)) == 0);
+        update_verify(&engine, versions, lens, KEYS);
+    }
+    assert(storage_stats(&engine, &stats) == 0 && stats.leaf_count == 1 && stats.key_count == KEYS);
+    
+    // 等长更新只弄脏叶子页
+    assert(storage_checkpoint(&engine) == 0);
+    uint64_t dirtied = engine.pm.stats.pages_dirtied;
+    size_t klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", 7);
+    versions[7]++;
+    assert(storage_put2(&engine, key, klen, value, update_value(7, versions[7], lens[7], value)) == 0);
+    assert(engine.pm.stats.pages_dirtied - dirtied == 1);
+    
+    // 内联与数据文件之间来回切换
+    for (int round = 0; round < 4; round++) {
+        for (uint32_t k = 0; k < KEYS; k += 5) {
+            klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", k);
+            versions[k]++;
+            lens[k] = round % 2 == 0 ? 300 + k : 10 + k;
+            assert(storage_put2(&engine, key, klen, value, update_value(k, versions[k], lens[k], value)) == 0);
+        }
+        update_verify(&engine, versions, lens, KEYS);
+    }
+    
+    // 有快照时更新复制叶子，快照中仍是旧 value
+    assert(storage_snapshot_begin(&engine, &snapshot) == 0);
+    size_t old_len = lens[3];
+    uint32_t old_version = versions[3];
+    klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", 3);
+    versions[3]++;
+    lens[3] = old_len + 20;
+    assert(storage_put2(&engine, key, klen, value, update_value(3, versions[3], lens[3], value)) == 0);
+    size_t vlen = 0;
+    assert(storage_snapshot_get2(&snapshot, key, klen, result, sizeof(result), &vlen) == 0);
+    assert(vlen == old_len && memcmp(result, value, update_value(3, old_version, vlen, value)) == 0);
+    storage_snapshot_end(&snapshot);
+    update_verify(&engine, versions, lens, KEYS);
+    
+    // 逐个改长到放不下一页时叶子分裂，其余 key 不受影响
+    for (uint32_t k = 0; k < KEYS; k++) {
+        klen = (size_t)snprintf(key, sizeof(key), "upd:%03u", k);
+        versions[k]++;
+        lens[k] = 250;
+        assert(storage_put2(&engine, key, klen, value, update_value(k, versions[k], lens[k], value)) == 0);
+        update_verify(&engine, versions, lens, KEYS);
+    }
+    assert(storage_stats(&engine, &stats) == 0 && stats.leaf_count > 1 && stats.key_count == KEYS);
+    printf("  3000 次随机长度更新后仍只有 1 个叶子，改长到放不下时分裂为 %llu 个叶子\n",
+           (unsigned long long)stats.leaf_count);
+    
+    storage_close(&engine);
+    assert(storage_init(&engine, "test_update_len.db") == 0);
+    update_verify(&engine, versions, lens, KEYS);
+    printf("  重新打开后全部 value 正确\n");
+    storage_close(&engine);
+    remove("test_update_len.db.idx");
+    remove("test_update_len.db.dat");
+    remove("test_update_len.db.wal");
+    update_fail_check();
+}
+
+// 测试缓冲池模式：64 个页框远小于数据量，随机写入/删除、批量操作、快照（含并发扫描）和批量加载
+// 在不断淘汰和写回的情况下结果与参考表一致；文件与 mmap 模式互相兼容
+void test_buffer_pool() {
+    printf("\n=== 测试缓冲池模式 ===\n");
+    enum { KEYS = 30000, BATCH = 500 };
+    StorageEngine engine;
+    StorageOptions options, mmap_options;
+    StorageSnapshot snapshot;
+    BTreeStats stats;
+    uint8_t *versions = calloc(KEYS, 1);
+    uint8_t *snap_versions = malloc(KEYS);
+    assert(versions && snap_versions);
+    
+    remove("test_pool.db.idx");
+    remove("test_pool.db.dat");
+    remove("test_pool.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    options.buffer_pool_pages = 64;
+    mmap_options = options;
+    mmap_options.buffer_pool_pages = 0;
+    assert(storage_init_ex(&engine, "test_pool.db", &options) == 0);
+    assert(engine.pm.pool != NULL && engine.pm.mmap_index == NULL);
+    
+    uint64_t seed = 777;
+    uint32_t live = snapshot_churn(&engine, versions, KEYS, KEYS * 2, &seed, 0);
+    assert(storage_stats(&engine, &stats) == 0 && stats.key_count == live);
+    assert(stats.leaf_count > 64 * 4);
+    
+    // 批量写入和批量查找，随后删除这些 key
+    BTreeBatchItem items[BATCH];
+    char keys[BATCH][16], values[BATCH][16], bufs[BATCH][16];
+    for (int i = 0; i < BATCH; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "pool%05d", (i * 7919) % BATCH);
+        snprintf(values[i], sizeof(values[i]), "v%d", (i * 7919) % BATCH);
+        items[i].key = keys[i];
+        items[i].value = values[i];
+        items[i].buf = bufs[i];
+        items[i].buf_size = sizeof(bufs[i]);
+    }
+    assert(storage_put_batch(&engine, items, BATCH) == 0);
+    assert(storage_get_batch(&engine, items, BATCH) == BATCH);
+    for (int i = 0; i < BATCH; i++) {
+        assert(strcmp(bufs[i], values[i]) == 0);
+        assert(storage_delete(&engine, keys[i]) == 0);
+    }
+    
+    // 快照期间另一个线程反复扫描快照，同时继续写入
+    assert(storage_snapshot_begin(&engine, &snapshot) == 0);
+    memcpy(snap_versions, versions, KEYS);
+    uint32_t snap_live = live;
+    volatile int stop = 0;
+    SnapshotReaderArgs reader = {&snapshot, snap_versions, snap_live, &stop, 0, 0};
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, snapshot_reader, &reader) == 0);
+    live = snapshot_churn(&engine, versions, KEYS, KEYS / 2, &seed, live);
+    stop = 1;
+    pthread_join(thread, NULL);
+    assert(reader.errors == 0);
+    snapshot_verify(&snapshot, snap_versions, KEYS, snap_live);
+    storage_snapshot_end(&snapshot);
+    assert(storage_snapshot_begin(&engine, &snapshot) == 0);
+    snapshot_verify(&snapshot, versions, KEYS, live);
+    storage_snapshot_end(&snapshot);
+    
+    PageStats ps = engine.pm.stats;
+    printf("  %d 个页框：命中 %llu，未命中 %llu，淘汰 %llu（写回 %llu），额外页框 %llu\n",
+           (int)options.buffer_pool_pages, (unsigned long long)ps.pool_hits, (unsigned long long)ps.pool_misses,
+           (unsigned long long)ps.pool_evictions, (unsigned long long)ps.pool_writebacks,
+           (unsigned long long)ps.pool_overflow);
+    assert(ps.pool_evictions > 0 && ps.pool_writebacks > 0 && ps.pool_overflow == 0);
+    
+    // 缓冲池模式写出的文件用 mmap 模式打开，反之亦然
+    storage_close(&engine);
+    assert(storage_init_ex(&engine, "test_pool.db", &mmap_options) == 0);
+    assert(engine.pm.pool == NULL);
+    assert(storage_snapshot_begin(&engine, &snapshot) == 0);
+    snapshot_verify(&snapshot, versions, KEYS, live);
+    storage_snapshot_end(&snapshot);
+    live = snapshot_churn(&engine, versions, KEYS, KEYS / 4, &seed, live);
+    storage_close(&engine);
+    assert(storage_init_ex(&engine, "test_pool.db", &options) == 0);
+    assert(storage_snapshot_begin(&engine, &snapshot) == 0);
+    snapshot_verify(&snapshot, versions, KEYS, live);
+    storage_snapshot_end(&snapshot);
+    assert(storage_stats(&engine, &stats) == 0 && stats.key_count == live);
+    printf("  %u 个 key 与参考表一致，在 mmap 与缓冲池模式之间切换打开后不变\n", live);
+    storage_close(&engine);
+    
+    // 缓冲池模式下的批量加载
+    remove("test_pool.db.idx");
+    remove("test_pool.db.dat");
+    remove("test_pool.db.wal");
+    assert(storage_init_ex(&engine, "test_pool.db", &options) == 0);
+    BulkSource src = {0, 200000, 1, "", ""};
+    assert(storage_bulk_load(&engine, bulk_next, &src, 0) == 0);
+    storage_close(&engine);
+    assert(storage_init_ex(&engine, "test_pool.db", &options) == 0);
+    char key[64], value[64], expected[64];
+    for (int i = 0; i < 200000; i += 97) {
+        snprintf(key, sizeof(key), "key%06d", i);
+        snprintf(expected, sizeof(expected), "value%d", i);
+        assert(storage_get(&engine, key, value, sizeof(value)) == 0);
+        assert(strcmp(value, expected) == 0);
+    }
+    assert(storage_stats(&engine, &stats) == 0 && stats.key_count == 200000);
+    assert(engine.pm.stats.pool_overflow == 0);
+    printf("  批量加载 200000 个 key 后重新打开，树高 %u，叶子 %llu 个\n", stats.depth,
+           (unsigned long long)stats.leaf_count);
+    
+    // 一次批量查找访问的叶子远多于页框数：逐层预读不能把缓冲池撑大
+    enum { BIG_BATCH = 3000 };
+    BTreeBatchItem *big = malloc(BIG_BATCH * sizeof(BTreeBatchItem));
+    char (*big_keys)[16] = malloc(BIG_BATCH * sizeof(*big_keys));
+    char (*big_bufs)[16] = malloc(BIG_BATCH * sizeof(*big_bufs));
+    assert(big && big_keys && big_bufs);
+    for (int i = 0; i < BIG_BATCH; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        snprintf(big_keys[i], sizeof(big_keys[i]), "key%06d", (int)((seed >> 33) % 200000));
+        big[i].key = big_keys[i];
+        big[i].buf = big_bufs[i];
+        big[i].buf_size = sizeof(big_bufs[i]);
+    }
+    assert(storage_get_batch(&engine, big, BIG_BATCH) == BIG_BATCH);
+    for (int i = 0; i < BIG_BATCH; i++) {
+        snprintf(expected, sizeof(expected), "value%d", atoi(big_keys[i] + 3));
+        assert(big[i].result == 0 && strcmp(big_bufs[i], expected) == 0);
+    }
+    assert(engine.pm.stats.pool_overflow == 0);
+    free(big);
+    free(big_keys);
+    free(big_bufs);
+    
+    storage_close(&engine);
+    free(versions);
+    free(snap_versions);
+    remove("test_pool.db.idx");
+    remove("test_pool.db.dat");
+    remove("test_pool.db.wal");
+}
+
+// 测试批量 I/O 与异步请求：两种 I/O 后端下直接读写文件、缓冲池的批量预读和刷盘，
+// 以及异步 get/put 的完成回调与提交顺序
+static void async_count(StorageAsyncOp *op) {
+    int *completed = op->user_data;
+    (*completed)++;  // 回调都在同一个后台线程中执行
+}
+
+static void aio_check_file(AioBackend backend) {
+    enum { PAGES = 256 };
+    AioContext aio;
+    assert(aio_init(&aio, 8, backend) == 0);
+    uint8_t *pages = malloc(PAGES * PAGE_SIZE);
+    uint8_t *back = malloc((PAGES + 2) * PAGE_SIZE);
+    AioRequest reqs[PAGES + 2];
+    assert(pages && back);
+    
+    remove("test_aio.db.dat");
+    int fd = open("test_aio.db.dat", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    for (int i = 0; i < PAGES; i++) {
+        memset(pages + (size_t)i * PAGE_SIZE, 'a' + i % 26, PAGE_SIZE);
+        memcpy(pages + (size_t)i * PAGE_SIZE, &i, sizeof(i));
+        AioRequest req = {fd, true, pages + (size_t)i * PAGE_SIZE, PAGE_SIZE, (uint64_t)i * PAGE_SIZE, 0};
+        reqs[i] = req;
+    }
+    assert(aio_run(&aio, reqs, PAGES) == 0);
+    
+    // 乱序读回，最后两页在文件尾之后读出全零
+    memset(back, 0xff, (PAGES + 2) * PAGE_SIZE);
+    for (int i = 0; i < PAGES + 2; i++) {
+        int page = i < PAGES ? (i * 97) % PAGES : i;
+        AioRequest req = {fd, false, back + (size_t)page * PAGE_SIZE, PAGE_SIZE, (uint64_t)page * PAGE_SIZE, 0};
+        reqs[i] = req;
+    }
+    assert(aio_run(&aio, reqs, PAGES + 2) == 0);
+    assert(memcmp(back, pages, PAGES * PAGE_SIZE) == 0);
+    for (size_t i = 0; i < 2 * PAGE_SIZE; i++) {
+        assert(back[PAGES * PAGE_SIZE + i] == 0);
+    }
+    printf("  %s：写入并乱序读回 %d 页，提交 %llu 次\n", aio_backend_name(&aio), PAGES,
+           (unsigned long long)aio.submits);
+    
+    close(fd);
+    remove("test_aio.db.dat");
+    aio_destroy(&aio);
+    free(pages);
+    free(back);
+}
+
+static void async_check_engine(AioBackend backend) {
+    enum { KEYS = 20000, BATCH = 400 };
+    StorageEngine engine;
+    StorageOptions options;
+    StorageAsyncOp *ops = calloc(KEYS, sizeof(StorageAsyncOp));
+    char (*keys)[16] = malloc(KEYS * sizeof(*keys));
+    char (*values)[16] = malloc(KEYS * sizeof(*values));
+    char (*bufs)[16] = malloc(KEYS * sizeof(*bufs));
+    assert(ops && keys && values && bufs);
+    
+    remove("test_async.db.idx");
+    remove("test_async.db.dat");
+    remove("test_async.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    options.buffer_pool_pages = 256;
+    options.io_depth = 16;
+    options.io_backend = backend;
+    assert(storage_init_ex(&engine, "test_async.db", &options) == 0);
+    assert(engine.pm.pool->aio.backend == backend);
+    
+    // 异步写入：全部完成回调后才能在同步接口中看到
+    int completed = 0;
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "async%06d", (i * 7919) % KEYS);
+        snprintf(values[i], sizeof(values[i]), "v%d", (i * 7919) % KEYS);
+        ops[i].key = keys[i];
+        ops[i].value = values[i];
+        ops[i].callback = async_count;
+        ops[i].user_data = &completed;
+        assert(storage_async_put(&engine, &ops[i]) == 0);
+    }
+    StorageAsyncOp bad = {0};
+    bad.key = "k";
+    assert(storage_async_put(&engine, &bad) == -1);  // 没有 value
+    storage_async_wait(&engine);
+    assert(completed == KEYS);
+    for (int i = 0; i < KEYS; i++) {
+        assert(ops[i].result == 0);
+    }
+    
+    // 检查点把脏页整批写回
+    uint64_t batches = engine.pm.stats.io_batches;
+    assert(storage_checkpoint(&engine) == 0);
+    assert(engine.pm.stats.io_batches == batches + 1);
+    storage_close(&engine);
+    
+    // 冷缓冲池上的批量查找：逐层预读要访问的页面
+    assert(storage_init_ex(&engine, "test_async.db", &options) == 0);
+    BTreeBatchItem items[BATCH];
+    for (int i = 0; i < BATCH; i++) {
+        int k = (i * 131) % KEYS;
+        items[i].key = keys[k];
+        items[i].buf = bufs[k];
+        items[i].buf_size = sizeof(bufs[k]);
+    }
+    assert(storage_get_batch(&engine, items, BATCH) == BATCH);
+    for (int i = 0; i < BATCH; i++) {
+        int k = (i * 131) % KEYS;
+        assert(strcmp(bufs[k], values[k]) == 0);
+    }
+    uint64_t prefetched = engine.pm.stats.pool_prefetched;
+    assert(prefetched > 0);
+    
+    // 交错提交的写入和查找按提交顺序生效
+    completed = 0;
+    for (int i = 0; i < KEYS; i++) {
+        memset(&ops[i], 0, sizeof(StorageAsyncOp));
+        ops[i].key = keys[i];
+        ops[i].callback = async_count;
+        ops[i].user_data = &completed;
+        if (i % 2 == 0) {
+            snprintf(values[i], sizeof(values[i]), "w%d", i);
+            ops[i].value = values[i];
+            assert(storage_async_put(&engine, &ops[i]) == 0);
+        } else {
+            ops[i].buf = bufs[i];
+            ops[i].buf_size = sizeof(bufs[i]);
+            assert(storage_async_get(&engine, &ops[i]) == 0);
+        }
+    }
+    StorageAsyncOp reread[4];
+    for (int i = 0; i < 4; i++) {
+        memset(&reread[i], 0, sizeof(StorageAsyncOp));
+        reread[i].key = keys[i * 2];
+        reread[i].buf = bufs[i * 2];
+        reread[i].buf_size = sizeof(bufs[i * 2]);
+        assert(storage_async_get(&engine, &reread[i]) == 0);
+    }
+    storage_async_wait(&engine);
+    assert(completed == KEYS);
+    for (int i = 0; i < KEYS; i++) {
+        assert(ops[i].result == 0);
+        if (i % 2 == 1) assert(strcmp(bufs[i], values[i]) == 0);
+    }
+    for (int i = 0; i < 4; i++) {
+        assert(reread[i].result == 0 && strcmp(bufs[i * 2], values[i * 2]) == 0);
+    }
+    printf("  %s：%d 个异步写入、%d 个交错请求全部回调，冷缓冲池批量查找 %d 个 key 预读 %llu 页\n",
+           aio_backend_name(&engine.pm.pool->aio), KEYS, KEYS, BATCH, (unsigned long long)prefetched);
+    
+    // 关闭前执行完排队的请求；mmap 模式重新打开后全部可见
+    for (int i = 0; i < KEYS; i += 2) {
+        memset(&ops[i], 0, sizeof(StorageAsyncOp));
+        ops[i].key = keys[i];
+        ops[i].value = keys[i];
+        assert(storage_async_put(&engine, &ops[i]) == 0);
+    }
+    storage_close(&engine);
+    options.buffer_pool_pages = 0;
+    assert(storage_init_ex(&engine, "test_async.db", &options) == 0);
+    char value[16];
+    for (int i = 0; i < KEYS; i++) {
+        assert(storage_get(&engine, keys[i], value, sizeof(value)) == 0);
+        assert(strcmp(value, i % 2 == 0 ? keys[i] : values[i]) == 0);
+    }
+    
+    storage_close(&engine);
+    free(ops);
+    free(keys);
+    free(values);
+    free(bufs);
+    remove("test_async.db.idx");
+    remove("test_async.db.dat");
+    remove("test_async.db.wal");
+}
+
+void test_async_io() {
+    printf("\n=== 测试批量 I/O 与异步请求 ===\n");
+    AioContext probe;
+    bool uring = aio_init(&probe, 1, AIO_BACKEND_URING) == 0;
+    if (uring) {
+        aio_destroy(&probe);
+        aio_check_file(AIO_BACKEND_URING);
+        async_check_engine(AIO_BACKEND_URING);
+    } else {
+        printf("  io_uring 不可用，只测试线程池\n");
+    }
+    aio_check_file(AIO_BACKEND_THREADS);
+    async_check_engine(AIO_BACKEND_THREADS);
+}
+
+// 后台刷盘测试的 key / value：value 带版本号，版本 0 表示已删除
+static void flush_kv(uint32_t slot, uint16_t version, char *key, char *value) {
+    snprintf(key, 32, "bg%08u", slot);
+    snprintf(value, 128, "value-%u-%u-%0*u", slot, version, (int)(slot % 40), 0);
+}
+
+// 随机写入和删除 keys 个 key 中的一部分：odd 为 0 时使用偶数编号，为 1 时使用奇数编号（插在已有 key 之间）
+static uint32_t flush_churn(StorageEngine *engine, uint16_t *versions, uint32_t keys, int odd,
+                            uint32_t ops, uint32_t seed) {
+    char key[32], value[128];
+    uint32_t x = seed;
+    for (uint32_t i = 0; i < ops; i++) {
+        x = x * 1103515245u + 12345u;
+        uint32_t slot = (x >> 8) % keys * 2 + odd;
+        if (i % 5 == 4 && versions[slot]) {
+            flush_kv(slot, 0, key, value);
+            assert(storage_delete(engine, key) == 0);
+            versions[slot] = 0;
+        } else {
+            if (++versions[slot] == 0) versions[slot] = 1;
+            flush_kv(slot, versions[slot], key, value);
+            assert(storage_put(engine, key, value) == 0);
+        }
+    }
+    return x;
+}
+
+static void flush_verify(StorageEngine *engine, const uint16_t *versions, uint32_t slots) {
+    char key[32], value[128], result[128];
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        flush_kv(slot, versions[slot], key, value);
+        if (versions[slot]) {
+            assert(storage_get(engine, key, result, sizeof(result)) == 0);
+            assert(strcmp(result, value) == 0);
+        } else {
+            assert(storage_get(engine, key, result, sizeof(result)) != 0);
+        }
+    }
+}
+
+// 轮询后台刷盘统计，直到 done 返回 true（最多约 20 秒）
+static void flush_wait(StorageEngine *engine, StorageFlusherStats *stats,
+                       bool (*done)(const StorageFlusherStats *stats, uint64_t arg), uint64_t arg) {
+    struct timespec ts = {0, 2000000};
+    for (int i = 0; i < 10000; i++) {
+        assert(storage_flusher_stats(engine, stats) == 0);
+        if (done(stats, arg)) return;
+        nanosleep(&ts, NULL);
+    }
+    assert(!"后台刷盘没有按时完成");
+}
+
+static bool flush_checkpointed(const StorageFlusherStats *stats, uint64_t wal_bytes) {
+    return stats->checkpoints > 0 && stats->lag_bytes < wal_bytes;
+}
+
+static bool flush_partly_written(const StorageFlusherStats *stats, uint64_t pages_written) {
+    return stats->pages_written >= pages_written;
+}
+
+static void flush_check(size_t pool_pages) {
+    enum { KEYS = 20000, SLOTS = 2 * KEYS };
+    StorageEngine engine;
+    StorageOptions options;
+    StorageFlusherStats stats, before;
+    uint16_t *versions = calloc(SLOTS, sizeof(uint16_t));
+    uint16_t *crash_versions = malloc(SLOTS * sizeof(uint16_t));
+    assert(versions && crash_versions);
+    
+    remove("test_bgflush.db.idx");
+    remove("test_bgflush.db.dat");
+    remove("test_bgflush.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    options.buffer_pool_pages = pool_pages;
+    options.background_flush = true;
+    options.flush_interval_ms = 5;
+    options.flush_rate = 2000;
+    options.checkpoint_wal_bytes = 256 * 1024;
+    assert(storage_init_ex(&engine, "test_bgflush.db", &options) == 0);
+    const char *mode = pool_pages ? "缓冲池" : "mmap";
+    
+    // 写入期间后台线程写回脏页并在日志超过阈值时做检查点，停止写入后日志很快回到阈值以下
+    uint32_t seed = flush_churn(&engine, versions, KEYS, 0, 60000, 1);
+    flush_wait(&engine, &stats, flush_checkpointed, options.checkpoint_wal_bytes);
+    assert(stats.running && stats.pages_written > 0 && stats.checkpoint_lsn > 0);
+    printf("  %s：后台写回 %llu 页，检查点 %llu 次（最长持锁 %.2f ms）\n", mode,
+           (unsigned long long)stats.pages_written, (unsigned long long)stats.checkpoints,
+           stats.max_checkpoint_ms);
+    flush_verify(&engine, versions, SLOTS);
+    
+    // 检查点之后在已有 key 之间插入，分裂大量叶子；限速的后台线程只写回了其中一部分页面时
+    // 复制三个文件，作为崩溃时磁盘上的状态：分裂出的新页面和被改写的父节点只有一部分落盘
+    assert(storage_checkpoint(&engine) == 0);
+    assert(storage_flusher_stats(&engine, &before) == 0 && before.lag_records == 0);
+    seed = flush_churn(&engine, versions, KEYS, 1, 3000, seed);
+    flush_wait(&engine, &stats, flush_partly_written, before.pages_written + 40);
+    assert(stats.checkpoints == before.checkpoints && stats.lag_records == 3000);
+    assert(engine.pm.header->flags & HEADER_FLAG_SHADOW);
+    copy_file("test_bgflush.db.idx", "test_bgflush.db.idx.crash");
+    copy_file("test_bgflush.db.dat", "test_bgflush.db.dat.crash");
+    copy_file("test_bgflush.db.wal", "test_bgflush.db.wal.crash");
+    memcpy(crash_versions, versions, SLOTS * sizeof(uint16_t));
+    
+    // 正常关闭后文件头的标志被清除
+    flush_churn(&engine, versions, KEYS, 0, 2000, seed);
+    assert(storage_close(&engine) == 0);
+    assert(storage_init_ex(&engine, "test_bgflush.db", &options) == 0);
+    flush_verify(&engine, versions, SLOTS);
+    assert(storage_close(&engine) == 0);
+    
+    // 从崩溃时的文件恢复：文件头指向的检查点镜像没有被后台写回改动，重建空闲位图后重放 3000 条日志
+    rename("test_bgflush.db.idx.crash", "test_bgflush.db.idx");
+    rename("test_bgflush.db.dat.crash", "test_bgflush.db.dat");
+    rename("test_bgflush.db.wal.crash", "test_bgflush.db.wal");
+    assert(storage_init_ex(&engine, "test_bgflush.db", &options) == 0);
+    flush_verify(&engine, crash_versions, SLOTS);
+    
+    // 恢复后继续写入：重新分配空闲页面不会破坏在用的页面
+    flush_churn(&engine, crash_versions, KEYS, 1, 20000, 7);
+    flush_verify(&engine, crash_versions, SLOTS);
+    assert(storage_close(&engine) == 0);
+    options.background_flush = false;
+    assert(storage_init_ex(&engine, "test_bgflush.db", &options) == 0);
+    assert(!(engine.pm.header->flags & HEADER_FLAG_SHADOW));
+    assert(storage_flusher_stats(&engine, &stats) == 0 && !stats.running);
+    flush_verify(&engine, crash_versions, SLOTS);
+    assert(storage_close(&engine) == 0);
+    printf("  %s：从后台写回了一部分页面的磁盘状态恢复（重放 3000 条日志）：通过\n", mode);
+    
+    remove("test_bgflush.db.idx");
+    remove("test_bgflush.db.dat");
+    remove("test_bgflush.db.wal");
+    free(versions);
+    free(crash_versions);
+}
+
+// 测试后台刷盘
+void test_background_flush() {
+    printf("\n=== 测试后台刷盘 ===\n");
+    flush_check(0);
+    flush_check(256);
+}
+
+// 压缩测试的 key / value：按编号乱序写入，让节点分散在整个文件中
+static void compact_kv(uint32_t k, char *key, char *value) {
+    snprintf(key, 32, "cp%08u", k);
+    snprintf(value, 128, "compact-%u-%0*u", k, (int)(60 + k % 40), 0);
+}
+
+// 编号是 step 的倍数的 key 存在，其余不存在
+static void compact_verify(StorageEngine *engine, uint32_t keys, uint32_t step) {
+    char key[32], value[128], result[128];
+    for (uint32_t k = 0; k < keys; k++) {
+        compact_kv(k, key, value);
+        if (k % step == 0) {
+            assert(storage_get(engine, key, result, sizeof(result)) == 0);
+            assert(strcmp(result, value) == 0);
+        } else {
+            assert(storage_get(engine, key, result, sizeof(result)) != 0);
+        }
+    }
+}
+
+static long compact_file_size(const char *path) {
+    FILE *f = fopen(path, "rb");
+    assert(f);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void compact_check(size_t pool_pages, bool background) {
+    enum { KEYS = 40000, STEP = 10 };
+    StorageEngine engine;
+    StorageOptions options;
+    StorageCompactStats cs;
+    BTreeStats bs;
+    StorageSnapshot snapshot;
+    char key[32], value[128], result[128];
+    
+    remove("test_compact.db.idx");
+    remove("test_compact.db.dat");
+    remove("test_compact.db.wal");
+    storage_default_options(&options);
+    options.sync_mode = WAL_SYNC_NONE;
+    options.buffer_pool_pages = pool_pages;
+    options.background_flush = background;
+    assert(storage_init_ex(&engine, "test_compact.db", &options) == 0);
+    const char *mode = background ? "后台刷盘" : pool_pages ? "缓冲池" : "mmap";
+    
+    for (uint32_t i = 0; i < KEYS; i++) {
+        uint32_t k = (uint32_t)((uint64_t)i * 7919 % KEYS);
+        compact_kv(k, key, value);
+        assert(storage_put(&engine, key, value) == 0);
+    }
+    assert(storage_checkpoint(&engine) == 0);
+    
+    // 快照持有删除前的树：压缩不能回收它引用的页面，快照照常读到已删除的 key
+    assert(storage_snapshot_begin(&engine, &snapshot) == 0);
+    for (uint32_t k = 0; k < KEYS; k++) {
+        if (k % STEP == 0) continue;
+        compact_kv(k, key, value);
+        assert(storage_delete(&engine, key) == 0);
+    }
+    assert(storage_compact(&engine, &cs) == 0);
+    assert(cs.pages_after * 2 > cs.pages_before);
+    compact_kv(1, key, value);
+    size_t vlen;
+    assert(storage_snapshot_get2(&snapshot, key, strlen(key), result, sizeof(result), &vlen) == 0);
+    assert(vlen == strlen(value) && memcmp(result, value, vlen) == 0);
+    compact_verify(&engine, KEYS, STEP);
+    storage_snapshot_end(&snapshot);
+    
+    // 快照结束后大部分页面空闲：节点搬到前部，文件截短
+    assert(storage_stats(&engine, &bs) == 0);
+    assert(bs.free_pages * 2 > bs.total_pages);
+    assert(storage_compact(&engine, &cs) == 0);
+    assert(cs.pages_moved > 0 && cs.pages_after * 3 < cs.pages_before);
+    // 文件截短到页面数对应的大小，但不小于新建文件的初始大小
+    uint64_t expect = (cs.pages_after > INITIAL_PAGES ? cs.pages_after : INITIAL_PAGES) * PAGE_SIZE;
+    assert(cs.file_bytes_after == expect && cs.reclaimed_bytes == cs.file_bytes_before - cs.file_bytes_after);
+    assert(cs.reclaimed_bytes > 0);
+    assert((long)cs.file_bytes_after == compact_file_size("test_compact.db.idx"));
+    assert(storage_stats(&engine, &bs) == 0);
+    assert(bs.total_pages == cs.pages_after && bs.free_pages == cs.free_pages_after);
+    assert(bs.free_pages * 10 < bs.total_pages);
+    compact_verify(&engine, KEYS, STEP);
+    printf("  %s：删除 90%% 后压缩，搬动 %llu 页，%llu 页 -> %llu 页，文件 %ld KB -> %ld KB（回收 %llu KB）\n", mode,
+           (unsigned long long)cs.pages_moved, (unsigned long long)cs.pages_before,
+           (unsigned long long)cs.pages_after, (long)(cs.file_bytes_before / 1024), (long)(cs.file_bytes_after / 1024),
+           (unsigned long long)(cs.reclaimed_bytes / 1024));
+    
+    // 压缩后继续写入（文件重新增长），重新打开后数据和空闲位图一致
+    for (uint32_t k = 0; k < KEYS; k += STEP) {
+        compact_kv(k + 1, key, value);
+        assert(storage_put(&engine, key, value) == 0);
+    }
+    assert(storage_close(&engine) == 0);
+    assert(storage_init_ex(&engine, "test_compact.db", &options) == 0);
+    assert(storage_stats(&engine, &bs) == 0);
+    assert(bs.internal_count + bs.leaf_count + bs.free_pages + engine.pm.map_page_count + 1 == bs.total_pages);
+    for (uint32_t k = 0; k < KEYS; k++) {
+        compact_kv(k, key, value);
+        int found = storage_get(&engine, key, result, sizeof(result)) == 0;
+        assert(found == (k % STEP <= 1));
+        if (found) assert(strcmp(result, value) == 0);
+    }
+    assert(storage_close(&engine) == 0);
+    printf("  %s：压缩后写入并重新打开：通过\n", mode);
+    
+    remove("test_compact.db.idx");
+    remove("test_compact.db.dat");
+    remove("test_compact.db.wal");
+}
+
+// 就近分配：hint 之后的空闲页面优先于页号更小的空闲页面
+static void compact_alloc_check() {
+    PageManager pm;
+    remove("test_alloc.db.idx");
+    remove("test_alloc.db.dat");
+    assert(page_manager_init(&pm, "test_alloc.db") == 0);
+    uint32_t ids[64];
+    for (int i = 0; i < 64; i++) {
+        ids[i] = page_alloc(&pm);
+        assert(ids[i] == (uint32_t)i + 1);
+    }
+    page_free(&pm, ids[3]);
+    page_free(&pm, ids[40]);
+    page_free(&pm, ids[50]);
+    assert(page_is_free(&pm, ids[40]) && pm.free_count == 3);
+    assert(page_alloc_near(&pm, ids[38]) == ids[40]);
+    assert(page_alloc_near(&pm, ids[60]) == ids[50]);
+    assert(page_alloc_below(&pm, ids[3]) == 0);
+    assert(page_alloc_near(&pm, ids[60]) == ids[3]);
+    assert(page_alloc(&pm) == ids[63] + 1 && pm.free_count == 0);
+    
+    // 空闲位图随页面一起落盘，重新打开后保持不变（第一次刷盘先为位图分配页面）
+    assert(page_flush(&pm) == 0);
+    page_free(&pm, ids[10]);
+    page_free(&pm, ids[20]);
+    assert(page_flush(&pm) == 0);
+    page_manager_close(&pm);
+    assert(page_manager_init(&pm, "test_alloc.db") == 0);
+    assert(pm.free_count == 2 && page_is_free(&pm, ids[10]) && page_is_free(&pm, ids[20]));
+    assert(page_alloc_near(&pm, ids[15]) == ids[20]);
+    page_manager_close(&pm);
+    remove("test_alloc.db.idx");
+    remove("test_alloc.db.dat");
+    printf("  就近分配和空闲位图持久化：通过\n");
+}
+
+// 测试空闲空间管理和压缩
+void test_compact() {
+    printf("\n=== 测试压缩 ===\n");
+    compact_alloc_check();
+    compact_check(0, false);
+    compact_check(256, false);
+    compact_check(0, true);
+}
+
 int main() {
     printf("开始完整 B+ 树功能测试...\n");
     
@@ -180,6 +2413,26 @@ int main() {
     test_multi_level_split();
     test_update();
     test_persistence();
+    test_wal_recovery();
+    test_flush_bytes();
+    test_range_scan();
+    test_bulk_load();
+    test_batch();
+    test_concurrent();
+    test_large_values();
+    test_binary_keys();
+    test_value_view();
+    test_prefix_keys();
+    test_node_cache();
+    test_prefix_search();
+    test_deep_split();
+    test_delete_rebalance();
+    test_snapshot();
+    test_value_update();
+    test_buffer_pool();
+    test_async_io();
+    test_background_flush();
+    test_compact();
     
     printf("\n所有完整功能测试通过！\n");
     return 0;
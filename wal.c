@@ -0,0 +1,330 @@
+#define _POSIX_C_SOURCE 200809L
+#include "wal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+// CRC32（IEEE 802.3 多项式），表在第一次使用时生成
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+// 确保编码缓冲区至少有 size 字节
+static int reserve_buf(Wal *wal, size_t size) {
+    if (size <= wal->buf_cap) return 0;
+    size_t cap = wal->buf_cap ? wal->buf_cap : 4096;
+    while (cap < size) cap *= 2;
+    uint8_t *buf = realloc(wal->buf, cap);
+    if (!buf) return -1;
+    wal->buf = buf;
+    wal->buf_cap = cap;
+    return 0;
+}
+
+// 完整写入（处理 write 的部分写）
+static int write_full(int fd, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 打开（或创建）日志文件
+int wal_open(Wal *wal, const char *path, WalSyncMode sync_mode, uint64_t start_lsn) {
+    memset(wal, 0, sizeof(Wal));
+    pthread_once(&crc_once, crc_init);
+    
+    wal->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (wal->fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(wal->fd, &st) < 0) {
+        close(wal->fd);
+        return -1;
+    }
+    
+    wal->size = (uint64_t)st.st_size;
+    wal->sync_mode = sync_mode;
+    wal->next_lsn = start_lsn + 1;
+    wal->written_lsn = start_lsn;
+    wal->synced_lsn = start_lsn;
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_cond_init(&wal->cond, NULL);
+    return 0;
+}
+
+// 关闭日志
+int wal_close(Wal *wal) {
+    if (wal->fd < 0) {
+        return -1;
+    }
+    
+    fdatasync(wal->fd);
+    close(wal->fd);
+    wal->fd = -1;
+    free(wal->buf);
+    wal->buf = NULL;
+    pthread_mutex_destroy(&wal->lock);
+    pthread_cond_destroy(&wal->cond);
+    return 0;
+}
+
+// 重放 LSN 大于 min_lsn 的记录
+int wal_replay(Wal *wal, uint64_t min_lsn, WalApplyFn apply, void *ctx) {
+    struct stat st;
+    if (fstat(wal->fd, &st) < 0) {
+        return -1;
+    }
+    
+    off_t off = 0;
+    uint64_t last_lsn = 0;
+    while (off + WAL_RECORD_HEADER <= st.st_size) {
+        uint8_t head[WAL_RECORD_HEADER];
+        if (pread(wal->fd, head, WAL_RECORD_HEADER, off) != WAL_RECORD_HEADER) break;
+        
+        uint32_t crc, len;
+        memcpy(&crc, head, sizeof(uint32_t));
+        memcpy(&len, head + 4, sizeof(uint32_t));
+        if (len < WAL_RECORD_HEADER || off + len > st.st_size) break;  // 尾部不完整
+        
+        if (reserve_buf(wal, len) < 0) return -1;
+        if (pread(wal->fd, wal->buf, len, off) != (ssize_t)len) break;
+        if (crc32(wal->buf + 4, len - 4) != crc) break;  // 记录损坏
+        
+        uint64_t lsn;
+        uint16_t klen;
+        uint32_t vlen;
+        memcpy(&lsn, wal->buf + 8, sizeof(uint64_t));
+        uint8_t type = wal->buf[16];
+        memcpy(&klen, wal->buf + 18, sizeof(uint16_t));
+        memcpy(&vlen, wal->buf + 20, sizeof(uint32_t));
+        if ((size_t)WAL_RECORD_HEADER + klen + vlen != len || lsn <= last_lsn) break;
+        
+        const char *key = (const char*)wal->buf + WAL_RECORD_HEADER;
+        if (lsn > min_lsn) {
+            apply(ctx, (WalRecordType)type, key, klen, key + klen, vlen);
+        }
+        last_lsn = lsn;
+        off += len;
+    }
+    
+    // 丢弃损坏的尾部，后续记录从有效位置继续追加
+    if (off < st.st_size && ftruncate(wal->fd, off) < 0) {
+        return -1;
+    }
+    wal->size = (uint64_t)off;
+    
+    if (last_lsn >= wal->next_lsn) {
+        wal->next_lsn = last_lsn + 1;
+        wal->written_lsn = last_lsn;
+        wal->synced_lsn = last_lsn;
+    }
+    return 0;
+}
+
+// 把一条记录编码到 rec，返回记录长度
+static uint32_t encode_record(uint8_t *rec, uint64_t lsn, const WalRecord *record) {
+    uint32_t len = (uint32_t)(WAL_RECORD_HEADER + record->klen + record->vlen);
+    uint16_t klen16 = (uint16_t)record->klen;
+    uint32_t vlen32 = (uint32_t)record->vlen;
+    
+    memcpy(rec + 4, &len, sizeof(uint32_t));
+    memcpy(rec + 8, &lsn, sizeof(uint64_t));
+    rec[16] = (uint8_t)record->type;
+    rec[17] = 0;
+    memcpy(rec + 18, &klen16, sizeof(uint16_t));
+    memcpy(rec + 20, &vlen32, sizeof(uint32_t));
+    memcpy(rec + WAL_RECORD_HEADER, record->key, record->klen);
+    if (record->vlen > 0) {
+        memcpy(rec + WAL_RECORD_HEADER + record->klen, record->value, record->vlen);
+    }
+    uint32_t crc = crc32(rec + 4, len - 4);
+    memcpy(rec, &crc, sizeof(uint32_t));
+    return len;
+}
+
+// 追加一条记录
+uint64_t wal_append(Wal *wal, WalRecordType type, const char *key, size_t klen,
+                    const char *value, size_t vlen) {
+    WalRecord record = {type, key, klen, value, vlen};
+    return wal_append_batch(wal, &record, 1);
+}
+
+// 追加多条记录：全部编码到缓冲区后一次 write
+uint64_t wal_append_batch(Wal *wal, const WalRecord *records, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += WAL_RECORD_HEADER + records[i].klen + records[i].vlen;
+    }
+    if (count == 0) return 0;
+    
+    pthread_mutex_lock(&wal->lock);
+    if (wal->broken || reserve_buf(wal, total) < 0) {
+        pthread_mutex_unlock(&wal->lock);
+        return 0;
+    }
+    
+    uint64_t lsn = wal->next_lsn;
+    size_t off = 0;
+    for (size_t i = 0; i < count; i++) {
+        off += encode_record(wal->buf + off, lsn + i, &records[i]);
+    }
+    
+    // 写了一部分就失败时截掉残缺的记录；截不掉就不再追加，否则后面的记录接在残缺记录之后，重放时读不到
+    if (write_full(wal->fd, wal->buf, total) < 0) {
+        if (ftruncate(wal->fd, (off_t)wal->size) < 0) wal->broken = true;
+        pthread_mutex_unlock(&wal->lock);
+        return 0;
+    }
+    
+    wal->last_offset = wal->size;
+    wal->last_first_lsn = lsn;
+    lsn += count - 1;
+    wal->next_lsn = lsn + 1;
+    wal->written_lsn = lsn;
+    wal->unsynced_bytes += total;
+    wal->size += total;
+    pthread_mutex_unlock(&wal->lock);
+    return lsn;
+}
+
+// 撤销最近一次追加
+// 先等正在进行的 fdatasync 结束（它完成后会把 synced_lsn 推进到覆盖这些记录的位置），再截短文件；
+// 这些记录已经同步过时截短也要同步，否则崩溃后它们可能重新出现在日志里被重放
+int wal_abort(Wal *wal, uint64_t lsn) {
+    pthread_mutex_lock(&wal->lock);
+    while (wal->syncing) {
+        pthread_cond_wait(&wal->cond, &wal->lock);
+    }
+    if (lsn == 0 || lsn != wal->written_lsn || wal->last_first_lsn == 0) {
+        pthread_mutex_unlock(&wal->lock);
+        return -1;
+    }
+    
+    uint64_t first = wal->last_first_lsn;
+    uint64_t bytes = wal->size - wal->last_offset;
+    int ret = ftruncate(wal->fd, (off_t)wal->last_offset);
+    if (ret == 0 && wal->synced_lsn >= first) {
+        ret = fdatasync(wal->fd);
+    }
+    if (ret == 0) {
+        wal->size = wal->last_offset;
+        wal->unsynced_bytes -= bytes < wal->unsynced_bytes ? bytes : wal->unsynced_bytes;
+        wal->next_lsn = first;
+        wal->written_lsn = first - 1;
+        if (wal->synced_lsn > first - 1) wal->synced_lsn = first - 1;
+        wal->last_first_lsn = 0;
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return ret;
+}
+
+// 确保 lsn 及之前的记录已落盘
+// 组提交：同一时刻只有一个线程执行 fdatasync，它会把已写入的全部记录一起落盘，
+// 其余等待中的提交者醒来后发现自己的 LSN 已被覆盖即可直接返回。
+int wal_sync(Wal *wal, uint64_t lsn) {
+    int ret = 0;
+    
+    pthread_mutex_lock(&wal->lock);
+    while (wal->synced_lsn < lsn) {
+        if (wal->syncing) {
+            pthread_cond_wait(&wal->cond, &wal->lock);
+            continue;
+        }
+        
+        // 成为 leader，覆盖当前已写入的所有记录
+        uint64_t target = wal->written_lsn;
+        wal->syncing = true;
+        wal->unsynced_bytes = 0;
+        pthread_mutex_unlock(&wal->lock);
+        
+        ret = fdatasync(wal->fd);
+        
+        pthread_mutex_lock(&wal->lock);
+        wal->syncing = false;
+        wal->sync_count++;
+        if (ret == 0 && target > wal->synced_lsn) {
+            wal->synced_lsn = target;
+        }
+        pthread_cond_broadcast(&wal->cond);
+        if (ret < 0) break;
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return ret;
+}
+
+// 按同步模式提交
+int wal_commit(Wal *wal, uint64_t lsn) {
+    switch (wal->sync_mode) {
+    case WAL_SYNC_OP:
+        return wal_sync(wal, lsn);
+    case WAL_SYNC_BATCH: {
+        pthread_mutex_lock(&wal->lock);
+        bool full = wal->unsynced_bytes >= WAL_BATCH_BYTES;
+        pthread_mutex_unlock(&wal->lock);
+        return full ? wal_sync(wal, lsn) : 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+// 最后一条已写入记录的 LSN
+uint64_t wal_last_lsn(Wal *wal) {
+    pthread_mutex_lock(&wal->lock);
+    uint64_t lsn = wal->written_lsn;
+    pthread_mutex_unlock(&wal->lock);
+    return lsn;
+}
+
+// 日志文件当前的字节数
+uint64_t wal_size(Wal *wal) {
+    pthread_mutex_lock(&wal->lock);
+    uint64_t size = wal->size;
+    pthread_mutex_unlock(&wal->lock);
+    return size;
+}
+
+// 检查点完成后清空日志（LSN 继续递增）
+int wal_reset(Wal *wal) {
+    pthread_mutex_lock(&wal->lock);
+    int ret = ftruncate(wal->fd, 0);
+    if (ret == 0) {
+        ret = fdatasync(wal->fd);
+    }
+    wal->synced_lsn = wal->written_lsn;
+    wal->unsynced_bytes = 0;
+    wal->size = 0;
+    wal->last_first_lsn = 0;
+    if (ret == 0) wal->broken = false;
+    pthread_mutex_unlock(&wal->lock);
+    return ret;
+}
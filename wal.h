@@ -0,0 +1,100 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// 预写日志（WAL）：与 .idx/.dat 同目录的 <db>.wal 文件
+// 每次 put/delete 先追加一条 redo 记录，再修改 B+ 树；
+// 打开数据库时重放检查点之后的记录，检查点完成后清空日志。
+//
+// 记录格式（小端）：
+//   crc(u32) len(u32) lsn(u64) type(u8) pad(u8) klen(u16) vlen(u32) key value
+// crc 覆盖 len 之后的全部字节，用于识别崩溃时写了一半的尾部记录。
+
+#define WAL_RECORD_HEADER 24
+#define WAL_BATCH_BYTES (1024 * 1024)  // 批量模式下累计多少未同步字节后自动同步
+
+// WAL 同步模式
+typedef enum {
+    WAL_SYNC_NONE = 0,        // 不主动同步，只在检查点/关闭时落盘
+    WAL_SYNC_BATCH = 1,       // 按批同步：累计 WAL_BATCH_BYTES 或显式 storage_sync 时同步
+    WAL_SYNC_OP = 2           // 每个操作返回前日志已落盘（并发提交者共享一次 fdatasync）
+} WalSyncMode;
+
+// 记录类型
+typedef enum {
+    WAL_PUT = 1,
+    WAL_DELETE = 2
+} WalRecordType;
+
+// 一条待追加的记录
+typedef struct {
+    WalRecordType type;
+    const char *key;
+    size_t klen;
+    const char *value;
+    size_t vlen;
+} WalRecord;
+
+// 重放回调
+typedef int (*WalApplyFn)(void *ctx, WalRecordType type, const char *key, size_t klen,
+                          const char *value, size_t vlen);
+
+typedef struct {
+    int fd;                   // 日志文件描述符
+    WalSyncMode sync_mode;    // 同步模式
+    uint64_t next_lsn;        // 下一条记录的 LSN
+    uint64_t written_lsn;     // 已写入（write 返回）的最大 LSN
+    uint64_t synced_lsn;      // 已 fdatasync 的最大 LSN
+    size_t unsynced_bytes;    // 上次同步后写入的字节数
+    uint64_t size;            // 日志文件当前的字节数（检查点清空后归零）
+    uint64_t last_offset;     // 最近一次追加之前的文件大小（wal_abort 截回这里）
+    uint64_t last_first_lsn;  // 最近一次追加的第一条记录的 LSN
+    bool syncing;             // 是否有线程正在执行 fdatasync（组提交的 leader）
+    bool broken;              // 写入失败后没能截掉残缺的记录，拒绝继续追加（直到检查点清空日志）
+    uint64_t sync_count;      // fdatasync 次数统计
+    uint8_t *buf;             // 记录编码缓冲区
+    size_t buf_cap;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Wal;
+
+// 打开（或创建）日志文件，start_lsn 之后的 LSN 从 start_lsn + 1 开始分配
+int wal_open(Wal *wal, const char *path, WalSyncMode sync_mode, uint64_t start_lsn);
+
+// 关闭日志
+int wal_close(Wal *wal);
+
+// 重放 LSN 大于 min_lsn 的记录；遇到损坏的尾部记录时截断
+int wal_replay(Wal *wal, uint64_t min_lsn, WalApplyFn apply, void *ctx);
+
+// 追加一条记录，返回其 LSN（失败返回 0）
+uint64_t wal_append(Wal *wal, WalRecordType type, const char *key, size_t klen,
+                    const char *value, size_t vlen);
+
+// 追加多条连续 LSN 的记录（一次 write），返回最后一条的 LSN（失败返回 0）
+uint64_t wal_append_batch(Wal *wal, const WalRecord *records, size_t count);
+
+// 撤销最近一次追加（lsn 为其返回值）：截掉这些记录并收回它们的 LSN，用于对应的树操作失败时。
+// 调用者保证期间没有其他追加；lsn 不是最近一次追加时返回 -1
+int wal_abort(Wal *wal, uint64_t lsn);
+
+// 按同步模式提交 lsn 及之前的记录
+int wal_commit(Wal *wal, uint64_t lsn);
+
+// 确保 lsn 及之前的记录已落盘（组提交）
+int wal_sync(Wal *wal, uint64_t lsn);
+
+// 最后一条已写入记录的 LSN
+uint64_t wal_last_lsn(Wal *wal);
+
+// 日志文件当前的字节数（上次检查点之后追加的记录）
+uint64_t wal_size(Wal *wal);
+
+// 检查点完成后清空日志
+int wal_reset(Wal *wal);
+
+#endif // WAL_H